@@ -0,0 +1,329 @@
+/**
+ * microbench 的入口：运行注册的基准，输出 JSON，和基线比较
+ *
+ *   microbench [--filter=子串] [--min-time=秒] [--repetitions=次数]
+ *              [--json=输出文件] [--baseline=基线文件] [--threshold=比例]
+ *
+ * --json 写出的文件可以直接作为新的基线；--baseline 给出时，ns/op 比基线慢超过 threshold(默认 0.15)
+ * 的基准算作退化，进程返回 1。基线里没有的基准只输出不比较。
+ */
+#include "Benchmark.h"
+#include "Logging.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <map>
+#include <sstream>
+
+namespace bench
+{
+
+int64_t nowNs()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return static_cast<int64_t>(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+State::State(int64_t iterations)
+    : iterations_(iterations),
+      startNs_(0),
+      elapsedNs_(0),
+      bytes_(0),
+      items_(0),
+      running_(false)
+{
+}
+
+void State::start()
+{
+    running_ = true;
+    startNs_ = nowNs();
+}
+
+void State::stop()
+{
+    if (running_)
+    {
+        elapsedNs_ += nowNs() - startNs_;
+        running_ = false;
+    }
+}
+
+void State::pauseTiming()
+{
+    stop();
+}
+
+void State::resumeTiming()
+{
+    start();
+}
+
+struct Entry
+{
+    std::string name;
+    Function fn;
+};
+
+static std::vector<Entry>& registry()
+{
+    static std::vector<Entry> entries;
+    return entries;
+}
+
+Registrar::Registrar(const char* name, Function fn)
+{
+    registry().push_back(Entry{name, fn});
+}
+
+struct Result
+{
+    std::string name;
+    int64_t iterations;
+    double nsPerOp;         // 各次重复的中位数
+    double minNsPerOp;
+    double bytesPerSecond;
+    double itemsPerSecond;
+};
+
+class Runner
+{
+public:
+    Runner(double minTime, int repetitions)
+        : minTime_(minTime),
+          repetitions_(repetitions)
+    {
+    }
+
+    Result run(const Entry& entry)
+    {
+        // 找到一次运行超过 minTime 的迭代次数
+        int64_t iterations = 1;
+        const int64_t minNs = static_cast<int64_t>(minTime_ * 1e9);
+        while (true)
+        {
+            State state = runOnce(entry.fn, iterations);
+            if (state.elapsedNs() >= minNs || iterations >= 1000000000)
+            {
+                break;
+            }
+            double scale = state.elapsedNs() > 0 ? 1.4 * minNs / state.elapsedNs() : 100;
+            scale = std::max(2.0, std::min(100.0, scale));
+            iterations = static_cast<int64_t>(iterations * scale);
+        }
+
+        std::vector<double> samples;
+        double bytesPerSecond = 0;
+        double itemsPerSecond = 0;
+        for (int i = 0; i < repetitions_; ++i)
+        {
+            State state = runOnce(entry.fn, iterations);
+            samples.push_back(static_cast<double>(state.elapsedNs()) / iterations);
+            if (state.bytesProcessed() > 0 && state.elapsedNs() > 0)
+            {
+                bytesPerSecond = std::max(bytesPerSecond, state.bytesProcessed() * 1e9 / state.elapsedNs());
+            }
+            if (state.itemsProcessed() > 0 && state.elapsedNs() > 0)
+            {
+                itemsPerSecond = std::max(itemsPerSecond, state.itemsProcessed() * 1e9 / state.elapsedNs());
+            }
+        }
+        std::sort(samples.begin(), samples.end());
+        Result result;
+        result.name = entry.name;
+        result.iterations = iterations;
+        result.nsPerOp = samples[samples.size() / 2];
+        result.minNsPerOp = samples.front();
+        result.bytesPerSecond = bytesPerSecond;
+        result.itemsPerSecond = itemsPerSecond;
+        return result;
+    }
+
+private:
+    State runOnce(Function fn, int64_t iterations)
+    {
+        State state(iterations);
+        state.start();
+        fn(state);
+        state.stop();
+        return state;
+    }
+
+    const double minTime_;
+    const int repetitions_;
+};
+
+// 只读自己写出的格式：每个基准一行，带 "name" 和 "ns_per_op"
+static bool loadBaseline(const std::string& path, std::map<std::string, double>* baseline)
+{
+    std::ifstream in(path.c_str());
+    if (!in)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        size_t name = line.find("\"name\": \"");
+        size_t ns = line.find("\"ns_per_op\": ");
+        if (name == std::string::npos || ns == std::string::npos)
+        {
+            continue;
+        }
+        name += 9;
+        std::string key = line.substr(name, line.find('"', name) - name);
+        (*baseline)[key] = atof(line.c_str() + ns + 13);
+    }
+    return true;
+}
+
+static std::string toJson(const std::vector<Result>& results, double minTime, int repetitions)
+{
+    char host[256] = "unknown";
+    gethostname(host, sizeof host);
+    time_t now = time(nullptr);
+    char date[64];
+    strftime(date, sizeof date, "%Y-%m-%dT%H:%M:%S", localtime(&now));
+
+    std::ostringstream out;
+    out << "{\n";
+    out << "  \"context\": {\"date\": \"" << date << "\", \"host\": \"" << host
+        << "\", \"cpus\": " << sysconf(_SC_NPROCESSORS_ONLN)
+        << ", \"min_time\": " << minTime << ", \"repetitions\": " << repetitions << "},\n";
+    out << "  \"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const Result& r = results[i];
+        char line[512];
+        snprintf(line, sizeof line,
+                 "    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": %.3f, \"min_ns_per_op\": %.3f, "
+                 "\"bytes_per_second\": %.0f, \"items_per_second\": %.0f}%s\n",
+                 r.name.c_str(), static_cast<long long>(r.iterations), r.nsPerOp, r.minNsPerOp,
+                 r.bytesPerSecond, r.itemsPerSecond, i + 1 < results.size() ? "," : "");
+        out << line;
+    }
+    out << "  ]\n}\n";
+    return out.str();
+}
+
+} // namespace bench
+
+int main(int argc, char* argv[])
+{
+    std::string filter;
+    std::string jsonPath;
+    std::string baselinePath;
+    double minTime = 0.2;
+    int repetitions = 5;
+    double threshold = 0.15;
+    for (int i = 1; i < argc; ++i)
+    {
+        const char* arg = argv[i];
+        if (strncmp(arg, "--filter=", 9) == 0)
+        {
+            filter = arg + 9;
+        }
+        else if (strncmp(arg, "--min-time=", 11) == 0)
+        {
+            minTime = atof(arg + 11);
+        }
+        else if (strncmp(arg, "--repetitions=", 14) == 0)
+        {
+            repetitions = std::max(1, atoi(arg + 14));
+        }
+        else if (strncmp(arg, "--json=", 7) == 0)
+        {
+            jsonPath = arg + 7;
+        }
+        else if (strncmp(arg, "--baseline=", 11) == 0)
+        {
+            baselinePath = arg + 11;
+        }
+        else if (strncmp(arg, "--threshold=", 12) == 0)
+        {
+            threshold = atof(arg + 12);
+        }
+        else
+        {
+            fprintf(stderr, "usage: %s [--filter=substr] [--min-time=seconds] [--repetitions=n] "
+                            "[--json=file] [--baseline=file] [--threshold=ratio]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // EventLoop 之类的 INFO 日志会混进结果表格里
+    Logger::setLogLevel(Logger::ERROR);
+
+    std::map<std::string, double> baseline;
+    if (!baselinePath.empty() && !bench::loadBaseline(baselinePath, &baseline))
+    {
+        fprintf(stderr, "cannot read baseline %s\n", baselinePath.c_str());
+        return 2;
+    }
+
+    bench::Runner runner(minTime, repetitions);
+    std::vector<bench::Result> results;
+    int regressions = 0;
+    printf("%-36s %12s %12s %12s %9s\n", "Benchmark", "ns/op", "iterations", "baseline", "change");
+    for (const bench::Entry& entry : bench::registry())
+    {
+        if (!filter.empty() && entry.name.find(filter) == std::string::npos)
+        {
+            continue;
+        }
+        bench::Result r = runner.run(entry);
+        results.push_back(r);
+        printf("%-36s %12.2f %12lld", r.name.c_str(), r.nsPerOp, static_cast<long long>(r.iterations));
+        auto it = baseline.find(r.name);
+        if (it != baseline.end() && it->second > 0)
+        {
+            double change = r.nsPerOp / it->second - 1;
+            bool regressed = change > threshold;
+            regressions += regressed;
+            printf(" %12.2f %+8.1f%%%s", it->second, change * 100, regressed ? "  REGRESSION" : "");
+        }
+        else
+        {
+            printf(" %12s %9s", "-", "-");
+        }
+        if (r.bytesPerSecond > 0)
+        {
+            printf("  %.1f MB/s", r.bytesPerSecond / 1024 / 1024);
+        }
+        if (r.itemsPerSecond > 0)
+        {
+            printf("  %.0f items/s", r.itemsPerSecond);
+        }
+        printf("\n");
+        fflush(stdout);
+    }
+
+    if (!jsonPath.empty())
+    {
+        std::string json = bench::toJson(results, minTime, repetitions);
+        FILE* fp = jsonPath == "-" ? stdout : fopen(jsonPath.c_str(), "w");
+        if (fp == nullptr)
+        {
+            fprintf(stderr, "cannot write %s\n", jsonPath.c_str());
+            return 2;
+        }
+        fwrite(json.data(), 1, json.size(), fp);
+        if (fp != stdout)
+        {
+            fclose(fp);
+        }
+    }
+    if (regressions > 0)
+    {
+        printf("%d benchmark(s) regressed more than %.0f%% against %s\n", regressions, threshold * 100,
+               baselinePath.c_str());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/**
+ * 微基准测试的小框架，不依赖第三方库
+ *
+ *   static void BM_Foo(bench::State& state)
+ *   {
+ *       for (int64_t i = 0; i < state.iterations(); ++i) { ... }
+ *   }
+ *   BENCHMARK(BM_Foo);
+ *
+ * 框架先把迭代次数翻倍，直到一次运行超过 --min-time，再按这个次数重复 --repetitions 次取中位数。
+ * 准备数据之类不想计时的部分用 pauseTiming/resumeTiming 包起来。
+ */
+namespace bench
+{
+
+class State
+{
+public:
+    explicit State(int64_t iterations);
+
+    int64_t iterations() const { return iterations_; }
+    void pauseTiming();
+    void resumeTiming();
+    // 整次运行处理的字节数，设置了就输出吞吐
+    void setBytesProcessed(int64_t bytes) { bytes_ = bytes; }
+    // 整次运行实际完成的条数(比如没有被丢弃的日志)，设置了就输出每秒条数
+    void setItemsProcessed(int64_t items) { items_ = items; }
+
+    int64_t elapsedNs() const { return elapsedNs_; }
+    int64_t bytesProcessed() const { return bytes_; }
+    int64_t itemsProcessed() const { return items_; }
+
+private:
+    friend class Runner;
+    void start();
+    void stop();
+
+    const int64_t iterations_;
+    int64_t startNs_;
+    int64_t elapsedNs_;
+    int64_t bytes_;
+    int64_t items_;
+    bool running_;
+};
+
+using Function = void (*)(State&);
+
+struct Registrar
+{
+    Registrar(const char* name, Function fn);
+};
+
+// 防止编译器把结果没有被使用的计算优化掉
+template <typename T>
+inline void doNotOptimize(const T& value)
+{
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void clobberMemory()
+{
+    asm volatile("" : : : "memory");
+}
+
+int64_t nowNs();
+
+} // namespace bench
+
+#define BENCHMARK(fn) static bench::Registrar fn##_registrar(#fn, fn)
@@ -0,0 +1,54 @@
+#include "Benchmark.h"
+#include "Buffer.h"
+#include "httpRequest.h"
+
+#include <string>
+
+static void parseLoop(bench::State& state, const std::string& request)
+{
+    HttpRequest req;
+    Buffer buf;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        req.Init();
+        buf.append(request);
+        // 首部解析完先返回一次，再调一次才读请求体，和 HttpServer 里的流程一样
+        if (!req.parse(buf) || !req.parse(buf) || !req.IsFinish())
+        {
+            abort();
+        }
+        bench::doNotOptimize(req.path());
+    }
+    state.setBytesProcessed(state.iterations() * request.size());
+}
+
+// 浏览器发来的一般 GET 请求，8 个首部
+static void BM_HttpRequestParseGet(bench::State& state)
+{
+    parseLoop(state,
+              "GET /index.html?from=bench&id=42 HTTP/1.1\r\n"
+              "Host: localhost:8080\r\n"
+              "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+              "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+              "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+              "Accept-Encoding: gzip, deflate\r\n"
+              "Cookie: session=0123456789abcdef\r\n"
+              "Cache-Control: max-age=0\r\n"
+              "Connection: keep-alive\r\n"
+              "\r\n");
+}
+BENCHMARK(BM_HttpRequestParseGet);
+
+// 带 Content-Length 请求体的 POST
+static void BM_HttpRequestParsePost(bench::State& state)
+{
+    const std::string body = "username=benchmark&password=secret&remember=on&redirect=%2Findex.html";
+    parseLoop(state,
+              "POST /api/echo HTTP/1.1\r\n"
+              "Host: localhost:8080\r\n"
+              "Content-Type: text/plain\r\n"
+              "Content-Length: " + std::to_string(body.size()) + "\r\n"
+              "Connection: keep-alive\r\n"
+              "\r\n" + body);
+}
+BENCHMARK(BM_HttpRequestParsePost);
@@ -0,0 +1,440 @@
+#include "Benchmark.h"
+#include "LogStream.h"
+#include "AsyncLogging.h"
+#include "BinaryLogging.h"
+#include "Logging.h"
+#include "Timestamp.h"
+#include "LogFile.h"
+#include "MmapLogRing.h"
+
+#include <dirent.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void BM_LogStreamInt(bench::State& state)
+{
+    LogStream stream;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        stream << static_cast<int>(i * 7919) << ' ' << static_cast<long long>(i) * 1000003;
+        if (stream.buffer().avail() < 128)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogStreamInt);
+
+static void BM_LogStreamDouble(bench::State& state)
+{
+    LogStream stream;
+    double v = 3.141592653589793;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        stream << v;
+        v += 0.37;
+        if (stream.buffer().avail() < 128)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogStreamDouble);
+
+// 微秒数按毫秒输出，耗时字段的写法
+static void BM_LogStreamFixed(bench::State& state)
+{
+    LogStream stream;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        stream << FixedPoint(i * 37 % 5000000, 3);
+        if (stream.buffer().avail() < 128)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogStreamFixed);
+
+// 一条典型的访问日志
+static void BM_LogStreamLine(bench::State& state)
+{
+    LogStream stream;
+    const std::string path = "/index.html";
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        stream << "HttpServer::onRequest " << path << " status=" << 200 << " bytes=" << 3712
+               << " cost=" << 0.000154 << "s\n";
+        if (stream.buffer().avail() < 256)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogStreamLine);
+
+// 日志行开头的时间，每次前进 37us，大约每 27000 次跨一秒
+static void BM_LogTimeCached(bench::State& state)
+{
+    int64_t micros = Timestamp::now().microSecondsSinceEpoch();
+    LogStream stream;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        stream << GeneralTemplate(formatLogTime(micros + i * 37), kLogTimeLength);
+        if (stream.buffer().avail() < 64)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogTimeCached);
+
+// 对照：每条日志都 localtime_r + snprintf
+static void BM_LogTimeLocaltime(bench::State& state)
+{
+    int64_t micros = Timestamp::now().microSecondsSinceEpoch();
+    LogStream stream;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        int64_t now = micros + i * 37;
+        time_t seconds = static_cast<time_t>(now / Timestamp::kMicroSecondsPerSecond);
+        struct tm tm_time;
+        localtime_r(&seconds, &tm_time);
+        char buf[64];
+        int n = snprintf(buf, sizeof buf, "%4d/%02d/%02d %02d:%02d:%02d.%06d ",
+                         tm_time.tm_year + 1900, tm_time.tm_mon + 1, tm_time.tm_mday,
+                         tm_time.tm_hour, tm_time.tm_min, tm_time.tm_sec,
+                         static_cast<int>(now % Timestamp::kMicroSecondsPerSecond));
+        stream << GeneralTemplate(buf, n);
+        if (stream.buffer().avail() < 64)
+        {
+            stream.resetBuffer();
+        }
+    }
+    bench::doNotOptimize(stream.buffer().length());
+}
+BENCHMARK(BM_LogTimeLocaltime);
+
+/**
+ * 日志写到临时目录，结束之后删掉。
+ * 计的是前端 append 的开销，items/s 是没有被丢弃、真正交给后端的日志条数
+ */
+class AsyncLogFixture
+{
+public:
+    AsyncLogFixture()
+    {
+        char dir[] = "/tmp/microbench-log.XXXXXX";
+        dir_ = mkdtemp(dir) ? dir : "/tmp";
+        log_.reset(new AsyncLogging(dir_ + "/bench", 64 * 1024 * 1024));
+        log_->start();
+    }
+
+    ~AsyncLogFixture()
+    {
+        log_->stop();
+        log_.reset();
+        DIR* d = opendir(dir_.c_str());
+        if (d != nullptr)
+        {
+            struct dirent* entry;
+            while ((entry = readdir(d)) != nullptr)
+            {
+                if (strncmp(entry->d_name, "bench", 5) == 0)
+                {
+                    unlink((dir_ + "/" + entry->d_name).c_str());
+                }
+            }
+            closedir(d);
+        }
+        rmdir(dir_.c_str());
+    }
+
+    AsyncLogging* log() { return log_.get(); }
+
+private:
+    std::string dir_;
+    std::unique_ptr<AsyncLogging> log_;
+};
+
+/**
+ * 后端写文件：每批 1000 行，逐行 append 进 LogFile 的缓冲区再写出去，
+ * 和直接把这 1000 行作为 iovec 一次 writev 比较
+ */
+template <bool kWritev>
+static void logFileWrite(bench::State& state)
+{
+    state.pauseTiming();
+    char dir[] = "/tmp/microbench-logfile.XXXXXX";
+    std::string path = mkdtemp(dir) ? dir : "/tmp";
+    std::unique_ptr<LogFile> file(new LogFile(path + "/bench", 1024 * 1024 * 1024, 3));
+    const char line[] = "2024/01/01 12:00:00.123456 [ INFO  ] HttpServer::onRequest /index.html 200 - httpServer.cpp:88\n";
+    const int len = sizeof line - 1;
+    const int kBatch = 1000;
+    std::vector<std::string> lines(kBatch, line);
+    std::vector<struct iovec> iov(kBatch);
+    for (int i = 0; i < kBatch; ++i)
+    {
+        iov[i].iov_base = &lines[i][0];
+        iov[i].iov_len = len;
+    }
+    state.resumeTiming();
+
+    int64_t batches = state.iterations() / kBatch + 1;
+    for (int64_t b = 0; b < batches; ++b)
+    {
+        if (kWritev)
+        {
+            file->appendv(iov.data(), kBatch);
+        }
+        else
+        {
+            for (int i = 0; i < kBatch; ++i)
+            {
+                file->append(lines[i].data(), len);
+            }
+            file->flush();
+        }
+    }
+
+    state.pauseTiming();
+    file.reset();
+    state.setBytesProcessed(batches * kBatch * len);
+    DIR* d = opendir(path.c_str());
+    if (d != nullptr)
+    {
+        struct dirent* entry;
+        while ((entry = readdir(d)) != nullptr)
+        {
+            if (strncmp(entry->d_name, "bench", 5) == 0)
+            {
+                unlink((path + "/" + entry->d_name).c_str());
+            }
+        }
+        closedir(d);
+    }
+    rmdir(path.c_str());
+}
+
+static void BM_LogFileAppend(bench::State& state)
+{
+    logFileWrite<false>(state);
+}
+BENCHMARK(BM_LogFileAppend);
+
+static void BM_LogFileWritev(bench::State& state)
+{
+    logFileWrite<true>(state);
+}
+BENCHMARK(BM_LogFileWritev);
+
+static void asyncAppend(bench::State& state, int threads)
+{
+    state.pauseTiming();
+    AsyncLogFixture fixture;
+    const char line[] = "20240101 12:00:00.123456 12345 INFO  HttpServer::onRequest /index.html 200 - httpServer.cpp:88\n";
+    const int len = sizeof line - 1;
+    const int64_t perThread = state.iterations() / threads + 1;
+    state.resumeTiming();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            for (int64_t i = 0; i < perThread; ++i)
+            {
+                fixture.log()->append(line, len);
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    state.pauseTiming();
+    int64_t delivered = perThread * threads - static_cast<int64_t>(fixture.log()->droppedMessages());
+    state.setBytesProcessed(delivered * len);
+    state.setItemsProcessed(delivered);
+}
+
+// 同样的日志直接写进 mmap 环形缓冲区，多个线程抢同一个写位置
+static void mmapRingAppend(bench::State& state, int threads)
+{
+    state.pauseTiming();
+    char path[] = "/tmp/microbench-ring.XXXXXX";
+    int fd = mkstemp(path);
+    if (fd >= 0)
+    {
+        close(fd);
+        unlink(path);
+    }
+    std::unique_ptr<MmapLogRing> ring(new MmapLogRing(path, 64 * 1024 * 1024));
+    const char line[] = "20240101 12:00:00.123456 12345 INFO  HttpServer::onRequest /index.html 200 - httpServer.cpp:88\n";
+    const int len = sizeof line - 1;
+    const int64_t perThread = state.iterations() / threads + 1;
+    state.resumeTiming();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&]() {
+            for (int64_t i = 0; i < perThread; ++i)
+            {
+                ring->append(line, len);
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    state.pauseTiming();
+    state.setBytesProcessed(perThread * threads * len);
+    state.setItemsProcessed(perThread * threads);
+    ring.reset();
+    unlink(path);
+}
+
+static void BM_MmapLogRingAppend1Threads(bench::State& state)
+{
+    mmapRingAppend(state, 1);
+}
+BENCHMARK(BM_MmapLogRingAppend1Threads);
+
+static void BM_MmapLogRingAppend8Threads(bench::State& state)
+{
+    mmapRingAppend(state, 8);
+}
+BENCHMARK(BM_MmapLogRingAppend8Threads);
+
+#define ASYNC_APPEND_BENCHMARK(n)                                   \
+    static void BM_AsyncLoggingAppend##n##Threads(bench::State& state) \
+    {                                                               \
+        asyncAppend(state, n);                                      \
+    }                                                               \
+    BENCHMARK(BM_AsyncLoggingAppend##n##Threads)
+
+ASYNC_APPEND_BENCHMARK(1);
+ASYNC_APPEND_BENCHMARK(2);
+ASYNC_APPEND_BENCHMARK(4);
+ASYNC_APPEND_BENCHMARK(8);
+ASYNC_APPEND_BENCHMARK(16);
+ASYNC_APPEND_BENCHMARK(32);
+
+// 调用线程里一条 DEBUG 日志的开销：LOG_DEBUG 当场格式化，LOG_DEBUG_BIN 只记录参数
+template <bool kBinary>
+static void loggerFrontEnd(bench::State& state)
+{
+    state.pauseTiming();
+    AsyncLogFixture fixture;
+    AsyncLogging* log = fixture.log();
+    Logger::LogLevel level = logLevel();
+    Logger::setLogLevel(Logger::DEBUG);
+    Logger::setOutput([log](const char* msg, int len) { log->append(msg, len, Logger::outputLevel()); });
+    BinaryLogging::setSink(log);
+    const std::string name = "http-server-127.0.0.1:8080#42";
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        if (kBinary)
+        {
+            LOG_DEBUG_BIN("TcpConnection {} fd {} write num: {} size: {}", name, 17, i, 4096);
+        }
+        else
+        {
+            LOG_DEBUG << "TcpConnection " << name << " fd " << 17 << " write num: " << i << " size: " << 4096;
+        }
+    }
+
+    state.pauseTiming();
+    BinaryLogging::setSink(nullptr);
+    Logger::setOutput([](const char* msg, int len) { fwrite(msg, 1, len, stdout); });
+    Logger::setLogLevel(level);
+}
+
+static void BM_LoggerDebugText(bench::State& state)
+{
+    loggerFrontEnd<false>(state);
+}
+BENCHMARK(BM_LoggerDebugText);
+
+static void BM_LoggerDebugBinary(bench::State& state)
+{
+    loggerFrontEnd<true>(state);
+}
+BENCHMARK(BM_LoggerDebugBinary);
+
+// 限流之后被压掉的日志的开销，也就是错误风暴里每次失败多花的时间
+static void BM_LoggerErrorLimited(bench::State& state)
+{
+    state.pauseTiming();
+    int64_t written = 0;
+    Logger::setOutput([&written](const char*, int) { ++written; });
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        LOG_ERROR_LIMIT(10) << "accept4() failed " << i;
+    }
+
+    state.pauseTiming();
+    Logger::setOutput([](const char* msg, int len) { fwrite(msg, 1, len, stdout); });
+    bench::doNotOptimize(written);
+}
+BENCHMARK(BM_LoggerErrorLimited);
+
+// 同一条带字段的访问日志在三种行格式下的前端开销，输出只记长度
+static void loggerFields(bench::State& state, LogFieldFormat format)
+{
+    state.pauseTiming();
+    int64_t bytes = 0;
+    Logger::LogLevel level = logLevel();
+    Logger::setLogLevel(Logger::INFO);
+    Logger::setOutput([&bytes](const char*, int len) { bytes += len; });
+    Logger::setFormat(format);
+    const std::string name = "http-server-127.0.0.1:8080#42";
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        LOG_INFO << "response" << LogField("conn", name) << LogField("status", 200) << LogField("bytes", i)
+                 << LogField("latency_ms", FixedPoint(i % 100000, 3));
+    }
+
+    state.pauseTiming();
+    Logger::setFormat(LogFieldFormat::TEXT);
+    Logger::setOutput([](const char* msg, int len) { fwrite(msg, 1, len, stdout); });
+    Logger::setLogLevel(level);
+    state.setBytesProcessed(bytes);
+}
+
+static void BM_LoggerFieldsText(bench::State& state)
+{
+    loggerFields(state, LogFieldFormat::TEXT);
+}
+BENCHMARK(BM_LoggerFieldsText);
+
+static void BM_LoggerFieldsJson(bench::State& state)
+{
+    loggerFields(state, LogFieldFormat::JSON);
+}
+BENCHMARK(BM_LoggerFieldsJson);
+
+static void BM_LoggerFieldsLogfmt(bench::State& state)
+{
+    loggerFields(state, LogFieldFormat::LOGFMT);
+}
+BENCHMARK(BM_LoggerFieldsLogfmt);
@@ -0,0 +1,327 @@
+#include "Benchmark.h"
+#include "Memory.h"
+#include "MemoryPool.h"
+
+#include <stdlib.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+#include <vector>
+
+static const int kBatch = 64;
+static const int kLive = 4096;
+
+// 16 ~ 4096 的随机大小和随机槽位，预先生成好，两边跑同一个序列
+struct MixedOps
+{
+    MixedOps()
+        : sizes(kOps),
+          slots(kOps)
+    {
+        std::mt19937 rng(12345);
+        for (int i = 0; i < kOps; ++i)
+        {
+            size_t size = 16u << (rng() % 9);
+            sizes[i] = std::min<size_t>(size / 2 + rng() % size, MP_MAX_SMALL);
+            slots[i] = static_cast<int>(rng() % kLive);
+        }
+    }
+
+    static const int kOps = 1 << 16;
+    std::vector<size_t> sizes;
+    std::vector<int> slots;
+};
+
+static const MixedOps& mixedOps()
+{
+    static MixedOps ops;
+    return ops;
+}
+
+// 一批小块申请之后全部归还，块的引用计数归零后整块复用
+static void BM_MemoryPoolSmall(bench::State& state)
+{
+    MemoryPool pool;
+    pool.createPool();
+    void* ptrs[kBatch];
+    for (int64_t i = 0; i < state.iterations(); i += kBatch)
+    {
+        for (int j = 0; j < kBatch; ++j)
+        {
+            ptrs[j] = pool.malloc(64);
+        }
+        bench::clobberMemory();
+        for (int j = 0; j < kBatch; ++j)
+        {
+            pool.freeMemory(ptrs[j]);
+        }
+    }
+    pool.destroyPool();
+}
+BENCHMARK(BM_MemoryPoolSmall);
+
+static void BM_MemoryPoolLarge(bench::State& state)
+{
+    MemoryPool pool;
+    pool.createPool();
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        void* p = pool.malloc(8192);
+        bench::doNotOptimize(p);
+        pool.freeMemory(p);
+    }
+    pool.destroyPool();
+}
+BENCHMARK(BM_MemoryPoolLarge);
+
+// 保持 kLive 个随机大小的对象存活，每次随机释放一个再申请一个，生命周期交错
+static void BM_MemoryPoolMixed(bench::State& state)
+{
+    const MixedOps& ops = mixedOps();
+    MemoryPool pool;
+    pool.createPool();
+    std::vector<void*> live(kLive, nullptr);
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        int n = static_cast<int>(i & (MixedOps::kOps - 1));
+        void*& p = live[ops.slots[n]];
+        pool.freeMemory(p);
+        p = pool.malloc(ops.sizes[n]);
+        bench::doNotOptimize(p);
+    }
+    pool.destroyPool();
+}
+BENCHMARK(BM_MemoryPoolMixed);
+
+// 一次申请 1M 个 16 ~ 256 字节的对象(每 256 个里有一个 8192 字节的大块)，按打乱的顺序释放，只统计释放
+struct RandomFreeOps
+{
+    RandomFreeOps()
+        : sizes(kObjects),
+          order(kObjects)
+    {
+        std::mt19937 rng(12345);
+        for (int i = 0; i < kObjects; ++i)
+        {
+            sizes[i] = rng() % 256 == 0 ? 8192 : 16 + rng() % 241;
+            order[i] = i;
+        }
+        std::shuffle(order.begin(), order.end(), rng);
+    }
+
+    static const int kObjects = 1 << 20;
+    std::vector<size_t> sizes;
+    std::vector<int> order;
+};
+
+static const RandomFreeOps& randomFreeOps()
+{
+    static RandomFreeOps ops;
+    return ops;
+}
+
+template <typename Alloc, typename Release>
+static void runRandomFree(bench::State& state, Alloc alloc, Release release)
+{
+    const RandomFreeOps& ops = randomFreeOps();
+    std::vector<void*> ptrs(RandomFreeOps::kObjects);
+    for (int64_t done = 0; done < state.iterations(); done += RandomFreeOps::kObjects)
+    {
+        int n = static_cast<int>(std::min<int64_t>(state.iterations() - done, RandomFreeOps::kObjects));
+        state.pauseTiming();
+        for (int i = 0; i < RandomFreeOps::kObjects; ++i)
+        {
+            ptrs[i] = alloc(ops.sizes[i]);
+        }
+        state.resumeTiming();
+        for (int i = 0; i < RandomFreeOps::kObjects; ++i)
+        {
+            release(ptrs[ops.order[i]]);
+            if (i + 1 == n)
+            {
+                // 计时只到 n 个，剩下的在暂停计时的时候放掉
+                state.pauseTiming();
+            }
+        }
+        state.resumeTiming();
+    }
+}
+
+static void BM_MemoryPoolRandomFree(bench::State& state)
+{
+    MemoryPool pool;
+    pool.createPool();
+    runRandomFree(state,
+                  [&pool](size_t size) { return pool.malloc(size); },
+                  [&pool](void* p) { pool.freeMemory(p); });
+    pool.destroyPool();
+}
+BENCHMARK(BM_MemoryPoolRandomFree);
+
+// 同样的申请模式走 glibc，作为对照
+static void BM_GlibcMallocSmall(bench::State& state)
+{
+    void* ptrs[kBatch];
+    for (int64_t i = 0; i < state.iterations(); i += kBatch)
+    {
+        for (int j = 0; j < kBatch; ++j)
+        {
+            ptrs[j] = ::malloc(64);
+        }
+        bench::clobberMemory();
+        for (int j = 0; j < kBatch; ++j)
+        {
+            ::free(ptrs[j]);
+        }
+    }
+}
+BENCHMARK(BM_GlibcMallocSmall);
+
+static void BM_GlibcMallocLarge(bench::State& state)
+{
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        void* p = ::malloc(8192);
+        bench::doNotOptimize(p);
+        ::free(p);
+    }
+}
+BENCHMARK(BM_GlibcMallocLarge);
+
+static void BM_GlibcMallocMixed(bench::State& state)
+{
+    const MixedOps& ops = mixedOps();
+    std::vector<void*> live(kLive, nullptr);
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        int n = static_cast<int>(i & (MixedOps::kOps - 1));
+        void*& p = live[ops.slots[n]];
+        ::free(p);
+        p = ::malloc(ops.sizes[n]);
+        bench::doNotOptimize(p);
+    }
+    for (void* p : live)
+    {
+        ::free(p);
+    }
+}
+BENCHMARK(BM_GlibcMallocMixed);
+
+static void BM_GlibcRandomFree(bench::State& state)
+{
+    runRandomFree(state,
+                  [](size_t size) { return ::malloc(size); },
+                  [](void* p) { ::free(p); });
+}
+BENCHMARK(BM_GlibcRandomFree);
+
+// 每个线程各自跑一遍混合负载，线程之间不共享对象，每个线程用自己的内存池
+// 能不能随线程数线性增长只能在核数够的机器上看；核比线程少时线程轮流跑，
+// 每多一个线程就多一份内存池和 kLive 个活着的块挤同一份缓存，每次操作的耗时会跟着上升
+template <typename Alloc, typename Release>
+static void mixedThreads(bench::State& state, int threads, Alloc alloc, Release release)
+{
+    state.pauseTiming();
+    const MixedOps& ops = mixedOps();
+    const int64_t perThread = state.iterations() / threads + 1;
+    state.resumeTiming();
+
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t)
+    {
+        workers.emplace_back([&, t]() {
+            std::vector<void*> live(kLive, nullptr);
+            for (int64_t i = 0; i < perThread; ++i)
+            {
+                int n = static_cast<int>((i + t * 7919) & (MixedOps::kOps - 1));
+                void*& p = live[ops.slots[n]];
+                if (p != nullptr)
+                {
+                    release(p);
+                }
+                p = alloc(ops.sizes[n]);
+                bench::doNotOptimize(p);
+            }
+            for (void* p : live)
+            {
+                if (p != nullptr)
+                {
+                    release(p);
+                }
+            }
+        });
+    }
+    for (auto& w : workers)
+    {
+        w.join();
+    }
+
+    state.pauseTiming();
+    state.setItemsProcessed(perThread * threads);
+}
+
+static void* memoryAlloc(size_t size)
+{
+    return Memory::getInstance()->allocate<char>(size).getBasePtr();
+}
+
+static void memoryRelease(void* p)
+{
+    MemoryView<char> view(static_cast<char*>(p), 1);
+    Memory::getInstance()->deallocate(view);
+}
+
+#define MEMORY_THREADS_BENCHMARK(n)                                      \
+    static void BM_MemoryMixed##n##Threads(bench::State& state)          \
+    {                                                                    \
+        mixedThreads(state, n, memoryAlloc, memoryRelease);              \
+    }                                                                    \
+    BENCHMARK(BM_MemoryMixed##n##Threads);                               \
+    static void BM_GlibcMixed##n##Threads(bench::State& state)           \
+    {                                                                    \
+        mixedThreads(state, n, ::malloc, ::free);                        \
+    }                                                                    \
+    BENCHMARK(BM_GlibcMixed##n##Threads)
+
+MEMORY_THREADS_BENCHMARK(1);
+MEMORY_THREADS_BENCHMARK(2);
+MEMORY_THREADS_BENCHMARK(4);
+MEMORY_THREADS_BENCHMARK(8);
+
+// 一个线程申请，另一个线程释放，释放全部走 remoteFree，申请的线程在下次 malloc 时收回
+static void BM_MemoryRemoteFree(bench::State& state)
+{
+    static const int kRing = 1024;
+    std::vector<std::atomic<void*>> ring(kRing);
+    for (auto& slot : ring)
+    {
+        slot.store(nullptr, std::memory_order_relaxed);
+    }
+    const int64_t total = state.iterations();
+
+    std::thread consumer([&]() {
+        for (int64_t i = 0; i < total; ++i)
+        {
+            std::atomic<void*>& slot = ring[i & (kRing - 1)];
+            void* p;
+            while ((p = slot.exchange(nullptr, std::memory_order_acquire)) == nullptr)
+            {
+                std::this_thread::yield();
+            }
+            memoryRelease(p);
+        }
+    });
+    for (int64_t i = 0; i < total; ++i)
+    {
+        void* p = memoryAlloc(64);
+        std::atomic<void*>& slot = ring[i & (kRing - 1)];
+        while (slot.load(std::memory_order_relaxed) != nullptr)
+        {
+            std::this_thread::yield();
+        }
+        slot.store(p, std::memory_order_release);
+    }
+    consumer.join();
+    state.setItemsProcessed(total);
+}
+BENCHMARK(BM_MemoryRemoteFree);
@@ -0,0 +1,147 @@
+#include "Benchmark.h"
+#include "Buffer.h"
+#include "EventLoop.h"
+#include "EventLoopThread.h"
+
+#include <atomic>
+#include <future>
+#include <string>
+
+// 一次 append 一小段再整体取走，模拟短请求的读写
+static void BM_BufferAppendRetrieve(bench::State& state)
+{
+    Buffer buf;
+    const std::string data(64, 'x');
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        buf.append(data);
+        buf.retrieve(data.size());
+    }
+    state.setBytesProcessed(state.iterations() * data.size());
+}
+BENCHMARK(BM_BufferAppendRetrieve);
+
+// 累积 16KB 之后一次性取走，覆盖 makeSpace 挪数据和扩容的路径
+static void BM_BufferAppend16K(bench::State& state)
+{
+    Buffer buf;
+    const std::string data(512, 'x');
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        for (int j = 0; j < 32; ++j)
+        {
+            buf.append(data);
+        }
+        bench::doNotOptimize(buf.peek());
+        buf.retrieveAll();
+    }
+    state.setBytesProcessed(state.iterations() * data.size() * 32);
+}
+BENCHMARK(BM_BufferAppend16K);
+
+// 在一个典型请求头里逐行找 CRLF
+static void BM_BufferFindCRLF(bench::State& state)
+{
+    const std::string request =
+        "GET /index.html HTTP/1.1\r\n"
+        "Host: localhost:8080\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko)\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8\r\n"
+        "Accept-Language: zh-CN,zh;q=0.9,en;q=0.8\r\n"
+        "Accept-Encoding: gzip, deflate\r\n"
+        "Connection: keep-alive\r\n"
+        "\r\n";
+    Buffer buf;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        buf.append(request);
+        const char* crlf;
+        while ((crlf = buf.findCRLF()) != NULL)
+        {
+            buf.retrieveUntil(crlf + 2);
+        }
+    }
+    state.setBytesProcessed(state.iterations() * request.size());
+}
+BENCHMARK(BM_BufferFindCRLF);
+
+// 在 loop 线程里投递任务，再跑一轮 loop 把它们执行掉
+static void BM_QueueInLoopSameThread(bench::State& state)
+{
+    EventLoop loop;
+    int64_t count = 0;
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        loop.queueInLoop([&count]() { ++count; });
+    }
+    loop.queueInLoop([&loop]() { loop.quit(); });
+    loop.wakeup();
+    loop.loop();
+    bench::doNotOptimize(count);
+}
+BENCHMARK(BM_QueueInLoopSameThread);
+
+// 从别的线程投递，每次都要走 eventfd 唤醒
+static void BM_QueueInLoopCrossThread(bench::State& state)
+{
+    state.pauseTiming();
+    EventLoopThread thread;
+    EventLoop* loop = thread.startLoop();
+    std::promise<void> done;
+    int64_t count = 0;
+    const int64_t n = state.iterations();
+    state.resumeTiming();
+
+    for (int64_t i = 0; i < n; ++i)
+    {
+        loop->queueInLoop([&count, &done, n]() {
+            if (++count == n)
+            {
+                done.set_value();
+            }
+        });
+    }
+    done.get_future().wait();
+
+    state.pauseTiming();
+}
+BENCHMARK(BM_QueueInLoopCrossThread);
+
+// 插入不会到期的定时器
+static void BM_TimerQueueInsert(bench::State& state)
+{
+    state.pauseTiming();
+    EventLoop loop;
+    state.resumeTiming();
+    for (int64_t i = 0; i < state.iterations(); ++i)
+    {
+        loop.runAfter(3600 + (i & 1023), []() {});
+    }
+    state.pauseTiming();
+}
+BENCHMARK(BM_TimerQueueInsert);
+
+// 插入已经到期的定时器，再由 loop 一次性取出并执行
+static void BM_TimerQueueExpire(bench::State& state)
+{
+    state.pauseTiming();
+    EventLoop loop;
+    int64_t fired = 0;
+    const int64_t n = state.iterations();
+    state.resumeTiming();
+
+    Timestamp now = Timestamp::now();
+    for (int64_t i = 0; i < n; ++i)
+    {
+        loop.runAt(now, [&]() {
+            if (++fired == n)
+            {
+                loop.quit();
+            }
+        });
+    }
+    loop.loop();
+
+    state.pauseTiming();
+}
+BENCHMARK(BM_TimerQueueExpire);
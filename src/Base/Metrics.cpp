@@ -0,0 +1,420 @@
+#include "Metrics.h"
+
+#include <stdio.h>
+#include <math.h>
+
+namespace metrics
+{
+__thread int t_shard = -1;
+
+int assignShard()
+{
+    static std::atomic<int> next(0);
+    return next.fetch_add(1, std::memory_order_relaxed) % kShards;
+}
+} // namespace metrics
+
+Counter::Counter()
+{
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        slots_[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+uint64_t Counter::value() const
+{
+    uint64_t sum = 0;
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        sum += slots_[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+Gauge::Gauge()
+{
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        slots_[i].value.store(0, std::memory_order_relaxed);
+    }
+}
+
+int64_t Gauge::value() const
+{
+    int64_t sum = 0;
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        sum += slots_[i].value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+HdrHistogram::HdrHistogram()
+    : buckets_(kBuckets, 0),
+      count_(0),
+      sum_(0),
+      min_(UINT64_MAX),
+      max_(0)
+{
+}
+
+int HdrHistogram::bucketIndex(uint64_t value)
+{
+    if (value < static_cast<uint64_t>(kSubBuckets))
+    {
+        return static_cast<int>(value);
+    }
+    int exponent = 63 - __builtin_clzll(value);
+    if (exponent > kMaxExponent)
+    {
+        return kBuckets - 1;
+    }
+    // 最高位所在的区间，加上最高位后面 kSubBucketBits 位表示的子桶
+    int shift = exponent - kSubBucketBits;
+    return (shift + 1) * kSubBuckets + static_cast<int>((value >> shift) - kSubBuckets);
+}
+
+uint64_t HdrHistogram::bucketUpperBound(int index)
+{
+    if (index < kSubBuckets)
+    {
+        return index;
+    }
+    int shift = index / kSubBuckets - 1;
+    uint64_t mantissa = index % kSubBuckets + kSubBuckets;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void HdrHistogram::recordCount(uint64_t value, uint64_t n)
+{
+    buckets_[bucketIndex(value)] += n;
+    count_ += n;
+    sum_ += value * n;
+    if (value < min_)
+    {
+        min_ = value;
+    }
+    if (value > max_)
+    {
+        max_ = value;
+    }
+}
+
+void HdrHistogram::merge(const HdrHistogram& other)
+{
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        buckets_[i] += other.buckets_[i];
+    }
+    count_ += other.count_;
+    sum_ += other.sum_;
+    if (other.min_ < min_)
+    {
+        min_ = other.min_;
+    }
+    if (other.max_ > max_)
+    {
+        max_ = other.max_;
+    }
+}
+
+void HdrHistogram::reset()
+{
+    buckets_.assign(kBuckets, 0);
+    count_ = sum_ = max_ = 0;
+    min_ = UINT64_MAX;
+}
+
+uint64_t HdrHistogram::percentile(double q) const
+{
+    if (count_ == 0)
+    {
+        return 0;
+    }
+    uint64_t target = static_cast<uint64_t>(ceil(q * count_));
+    if (target == 0)
+    {
+        target = 1;
+    }
+    uint64_t seen = 0;
+    for (int i = 0; i < kBuckets; ++i)
+    {
+        seen += buckets_[i];
+        if (seen >= target)
+        {
+            uint64_t upper = bucketUpperBound(i);
+            return upper < max_ ? upper : max_;
+        }
+    }
+    return max_;
+}
+
+uint64_t HdrHistogram::countAtOrBelow(uint64_t value) const
+{
+    uint64_t n = 0;
+    for (int i = 0; i < kBuckets && bucketUpperBound(i) <= value; ++i)
+    {
+        n += buckets_[i];
+    }
+    return n;
+}
+
+Histogram::Histogram()
+{
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        shards_[i].store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Histogram::~Histogram()
+{
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        delete shards_[i].load(std::memory_order_relaxed);
+    }
+}
+
+Histogram::Shard* Histogram::getShard()
+{
+    std::atomic<Shard*>& slot = shards_[metrics::shard()];
+    Shard* shard = slot.load(std::memory_order_acquire);
+    if (__builtin_expect(shard == nullptr, 0))
+    {
+        Shard* created = new Shard();   // 值初始化，所有计数都是 0
+        if (slot.compare_exchange_strong(shard, created, std::memory_order_acq_rel))
+        {
+            shard = created;
+        }
+        else
+        {
+            delete created;     // 共用这个分片的其他线程先分配好了
+        }
+    }
+    return shard;
+}
+
+void Histogram::record(uint64_t value)
+{
+    Shard* shard = getShard();
+    shard->buckets[HdrHistogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard->count.fetch_add(1, std::memory_order_relaxed);
+    shard->sum.fetch_add(value, std::memory_order_relaxed);
+    uint64_t max = shard->max.load(std::memory_order_relaxed);
+    while (value > max && !shard->max.compare_exchange_weak(max, value, std::memory_order_relaxed))
+    {
+    }
+}
+
+HdrHistogram Histogram::snapshot() const
+{
+    HdrHistogram result;
+    for (int i = 0; i < metrics::kShards; ++i)
+    {
+        Shard* shard = shards_[i].load(std::memory_order_acquire);
+        if (shard == nullptr)
+        {
+            continue;
+        }
+        for (int b = 0; b < HdrHistogram::kBuckets; ++b)
+        {
+            result.buckets_[b] += shard->buckets[b].load(std::memory_order_relaxed);
+        }
+        result.count_ += shard->count.load(std::memory_order_relaxed);
+        result.sum_ += shard->sum.load(std::memory_order_relaxed);
+        uint64_t max = shard->max.load(std::memory_order_relaxed);
+        if (max > result.max_)
+        {
+            result.max_ = max;
+        }
+    }
+    // 分片里没有保存最小值，用第一个非空桶的下界
+    for (int b = 0; b < HdrHistogram::kBuckets; ++b)
+    {
+        if (result.buckets_[b] > 0)
+        {
+            result.min_ = b == 0 ? 0 : HdrHistogram::bucketUpperBound(b - 1) + 1;
+            break;
+        }
+    }
+    return result;
+}
+
+MetricsRegistry& MetricsRegistry::instance()
+{
+    static MetricsRegistry registry;
+    return registry;
+}
+
+const std::vector<double>& MetricsRegistry::defaultBounds()
+{
+    static const std::vector<double> bounds = {
+        0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025, 0.05, 0.1, 0.25, 0.5, 1, 2.5, 5, 10,
+    };
+    return bounds;
+}
+
+MetricsRegistry::Series* MetricsRegistry::getSeries(const std::string& name, const std::string& help,
+                                                    const std::string& labels, Type type)
+{
+    auto it = families_.find(name);
+    if (it == families_.end())
+    {
+        Family& family = families_[name];
+        family.type = type;
+        family.help = help;
+        family.scale = 1;
+        return &family.series[labels];
+    }
+    if (it->second.type != type)
+    {
+        return nullptr;     // 同一个名字只能是一种类型
+    }
+    return &it->second.series[labels];
+}
+
+Counter* MetricsRegistry::counter(const std::string& name, const std::string& help, const std::string& labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* series = getSeries(name, help, labels, kCounter);
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    if (!series->counter)
+    {
+        series->counter.reset(new Counter);
+    }
+    return series->counter.get();
+}
+
+Gauge* MetricsRegistry::gauge(const std::string& name, const std::string& help, const std::string& labels)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* series = getSeries(name, help, labels, kGauge);
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    if (!series->gauge && !series->function)
+    {
+        series->gauge.reset(new Gauge);
+    }
+    return series->gauge.get();
+}
+
+void MetricsRegistry::gaugeFunction(const std::string& name, const std::string& help, const std::string& labels,
+                                    const GaugeFunction& fn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* series = getSeries(name, help, labels, kGauge);
+    if (series)
+    {
+        series->gauge.reset();
+        series->function = fn;
+    }
+}
+
+Histogram* MetricsRegistry::histogram(const std::string& name, const std::string& help, const std::string& labels,
+                                      double scale, const std::vector<double>& bounds)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    Series* series = getSeries(name, help, labels, kHistogram);
+    if (series == nullptr)
+    {
+        return nullptr;
+    }
+    Family& family = families_[name];
+    if (family.bounds.empty())
+    {
+        family.scale = scale;
+        family.bounds = bounds;
+    }
+    if (!series->histogram)
+    {
+        series->histogram.reset(new Histogram);
+    }
+    return series->histogram.get();
+}
+
+namespace
+{
+
+void appendSample(std::string* out, const std::string& name, const std::string& labels, double value)
+{
+    char buf[64];
+    // 计数都是整数，按整数输出；其他的值保留足够的有效位
+    if (value == floor(value) && fabs(value) < 1e15)
+    {
+        snprintf(buf, sizeof buf, " %.0f\n", value);
+    }
+    else
+    {
+        snprintf(buf, sizeof buf, " %.9g\n", value);
+    }
+    out->append(name);
+    if (!labels.empty())
+    {
+        out->append("{").append(labels).append("}");
+    }
+    out->append(buf);
+}
+
+std::string withLe(const std::string& labels, const std::string& le)
+{
+    std::string result(labels);
+    if (!result.empty())
+    {
+        result.push_back(',');
+    }
+    return result + "le=\"" + le + "\"";
+}
+
+} // namespace
+
+std::string MetricsRegistry::scrape() const
+{
+    std::string out;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& f : families_)
+    {
+        const std::string& name = f.first;
+        const Family& family = f.second;
+        static const char* kTypeNames[] = { "counter", "gauge", "histogram" };
+        out.append("# HELP ").append(name).append(" ").append(family.help).append("\n");
+        out.append("# TYPE ").append(name).append(" ").append(kTypeNames[family.type]).append("\n");
+        for (const auto& s : family.series)
+        {
+            const std::string& labels = s.first;
+            const Series& series = s.second;
+            if (series.counter)
+            {
+                appendSample(&out, name, labels, static_cast<double>(series.counter->value()));
+            }
+            else if (series.gauge)
+            {
+                appendSample(&out, name, labels, static_cast<double>(series.gauge->value()));
+            }
+            else if (series.function)
+            {
+                appendSample(&out, name, labels, series.function());
+            }
+            else if (series.histogram)
+            {
+                HdrHistogram h = series.histogram->snapshot();
+                for (double bound : family.bounds)
+                {
+                    char le[32];
+                    snprintf(le, sizeof le, "%g", bound);
+                    uint64_t raw = static_cast<uint64_t>(bound / family.scale + 0.5);
+                    appendSample(&out, name + "_bucket", withLe(labels, le), static_cast<double>(h.countAtOrBelow(raw)));
+                }
+                appendSample(&out, name + "_bucket", withLe(labels, "+Inf"), static_cast<double>(h.count()));
+                appendSample(&out, name + "_sum", labels, h.sum() * family.scale);
+                appendSample(&out, name + "_count", labels, static_cast<double>(h.count()));
+            }
+        }
+    }
+    return out;
+}
@@ -0,0 +1,195 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "noncopyable.h"
+
+/**
+ * 指标统计，输出 Prometheus 文本格式
+ * 计数器、仪表和直方图都按线程分片，每个线程只写自己的分片（分片之间隔开一个缓存行），
+ * 热路径上没有锁也没有跨线程的缓存行争用，抓取的时候才把所有分片加起来。
+ * 线程数超过 kShards 时几个线程共用一个分片，结果仍然正确，只是会有争用。
+ */
+namespace metrics
+{
+static const int kShards = 32;
+static const int kCacheLine = 64;
+
+extern __thread int t_shard;
+int assignShard();
+
+inline int shard()
+{
+    if (__builtin_expect(t_shard < 0, 0))
+    {
+        t_shard = assignShard();
+    }
+    return t_shard;
+}
+} // namespace metrics
+
+class Counter : noncopyable
+{
+public:
+    Counter();
+    void inc(uint64_t n = 1) { slots_[metrics::shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    uint64_t value() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<uint64_t> value;
+        char pad[metrics::kCacheLine - sizeof(std::atomic<uint64_t>)];
+    };
+    Slot slots_[metrics::kShards];
+};
+
+// 可增可减的值，比如连接数、队列长度；加和减可以发生在不同的线程
+class Gauge : noncopyable
+{
+public:
+    Gauge();
+    void add(int64_t n) { slots_[metrics::shard()].value.fetch_add(n, std::memory_order_relaxed); }
+    void inc() { add(1); }
+    void dec() { add(-1); }
+    int64_t value() const;
+
+private:
+    struct Slot
+    {
+        std::atomic<int64_t> value;
+        char pad[metrics::kCacheLine - sizeof(std::atomic<int64_t>)];
+    };
+    Slot slots_[metrics::kShards];
+};
+
+/**
+ * HDR 风格的对数线性直方图，只在一个线程里使用，也用来保存分片合并后的结果
+ * 每个 2 的幂区间再等分成 kSubBuckets 个桶，相对误差不超过 1/kSubBuckets，
+ * 小于 kSubBuckets 的值每个值一个桶，是精确的；超过 2^kMaxExponent 的值记在最后一个桶里
+ */
+class HdrHistogram
+{
+public:
+    static const int kSubBucketBits = 4;
+    static const int kSubBuckets = 1 << kSubBucketBits;
+    static const int kMaxExponent = 40;
+    static const int kBuckets = (kMaxExponent - kSubBucketBits + 2) * kSubBuckets;
+
+    HdrHistogram();
+
+    static int bucketIndex(uint64_t value);
+    // 第 index 个桶里值的上界（包含）
+    static uint64_t bucketUpperBound(int index);
+
+    void record(uint64_t value) { recordCount(value, 1); }
+    void recordCount(uint64_t value, uint64_t n);
+    void merge(const HdrHistogram& other);
+    void reset();
+
+    uint64_t count() const { return count_; }
+    uint64_t sum() const { return sum_; }
+    uint64_t max() const { return max_; }
+    uint64_t min() const { return count_ ? min_ : 0; }
+    double mean() const { return count_ ? static_cast<double>(sum_) / count_ : 0; }
+    // q 在 [0, 1] 之间，返回所在桶的上界，不超过记录过的最大值
+    uint64_t percentile(double q) const;
+    // 小于等于 value 的记录个数，value 不在桶的边界上时不包括 value 所在的桶
+    uint64_t countAtOrBelow(uint64_t value) const;
+    uint64_t bucket(int index) const { return buckets_[index]; }
+
+private:
+    friend class Histogram;
+
+    std::vector<uint64_t> buckets_;
+    uint64_t count_;
+    uint64_t sum_;
+    uint64_t min_;
+    uint64_t max_;
+};
+
+// 多线程记录的直方图，每个分片第一次被使用时才分配
+class Histogram : noncopyable
+{
+public:
+    Histogram();
+    ~Histogram();
+
+    void record(uint64_t value);
+    HdrHistogram snapshot() const;
+
+private:
+    struct Shard
+    {
+        std::atomic<uint64_t> buckets[HdrHistogram::kBuckets];
+        std::atomic<uint64_t> count;
+        std::atomic<uint64_t> sum;
+        std::atomic<uint64_t> max;
+        char pad[metrics::kCacheLine];     // 和后面分配的内存隔开
+    };
+    Shard* getShard();
+
+    std::atomic<Shard*> shards_[metrics::kShards];
+};
+
+/**
+ * 全局的指标表，名字和标签相同的返回同一个对象，对象一直有效，调用方可以缓存指针
+ * labels 是 Prometheus 格式的标签，比如 method="GET",route="/api"
+ */
+class MetricsRegistry : noncopyable
+{
+public:
+    using GaugeFunction = std::function<double ()>;
+
+    static MetricsRegistry& instance();
+
+    Counter* counter(const std::string& name, const std::string& help, const std::string& labels = std::string());
+    Gauge* gauge(const std::string& name, const std::string& help, const std::string& labels = std::string());
+    // scale 把记录的整数换算成输出的单位，比如记录微秒输出秒就是 1e-6；bounds 是输出的 le 边界，已经换算过单位
+    Histogram* histogram(const std::string& name, const std::string& help, const std::string& labels = std::string(),
+                         double scale = 1e-6, const std::vector<double>& bounds = defaultBounds());
+    // 抓取时才求值的仪表，比如队列长度
+    void gaugeFunction(const std::string& name, const std::string& help, const std::string& labels,
+                       const GaugeFunction& fn);
+
+    // Prometheus 文本格式(version 0.0.4)
+    std::string scrape() const;
+
+    // 0.5ms 到 10s，延迟直方图的默认边界
+    static const std::vector<double>& defaultBounds();
+
+private:
+    enum Type
+    {
+        kCounter,
+        kGauge,
+        kHistogram,
+    };
+    struct Series
+    {
+        std::unique_ptr<Counter> counter;
+        std::unique_ptr<Gauge> gauge;
+        std::unique_ptr<Histogram> histogram;
+        GaugeFunction function;
+    };
+    struct Family
+    {
+        Type type;
+        std::string help;
+        double scale;
+        std::vector<double> bounds;
+        std::map<std::string, Series> series;
+    };
+
+    Series* getSeries(const std::string& name, const std::string& help, const std::string& labels, Type type);
+
+    mutable std::mutex mutex_;
+    std::map<std::string, Family> families_;
+};
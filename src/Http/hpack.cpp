@@ -0,0 +1,835 @@
+#include "hpack.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+
+namespace
+{
+
+struct HuffmanCode
+{
+    uint32_t code;
+    uint8_t bits;
+};
+
+// RFC 7541 附录 B，下标是字节值，最后一项是 EOS
+const HuffmanCode kHuffmanCodes[257] = {
+    {0x1ff8, 13},
+    {0x7fffd8, 23},
+    {0xfffffe2, 28},
+    {0xfffffe3, 28},
+    {0xfffffe4, 28},
+    {0xfffffe5, 28},
+    {0xfffffe6, 28},
+    {0xfffffe7, 28},
+    {0xfffffe8, 28},
+    {0xffffea, 24},
+    {0x3ffffffc, 30},
+    {0xfffffe9, 28},
+    {0xfffffea, 28},
+    {0x3ffffffd, 30},
+    {0xfffffeb, 28},
+    {0xfffffec, 28},
+    {0xfffffed, 28},
+    {0xfffffee, 28},
+    {0xfffffef, 28},
+    {0xffffff0, 28},
+    {0xffffff1, 28},
+    {0xffffff2, 28},
+    {0x3ffffffe, 30},
+    {0xffffff3, 28},
+    {0xffffff4, 28},
+    {0xffffff5, 28},
+    {0xffffff6, 28},
+    {0xffffff7, 28},
+    {0xffffff8, 28},
+    {0xffffff9, 28},
+    {0xffffffa, 28},
+    {0xffffffb, 28},
+    {0x14, 6},  // ' '
+    {0x3f8, 10},  // '!'
+    {0x3f9, 10},  // '"'
+    {0xffa, 12},  // '#'
+    {0x1ff9, 13},  // '$'
+    {0x15, 6},  // '%'
+    {0xf8, 8},  // '&'
+    {0x7fa, 11},  // '''
+    {0x3fa, 10},  // '('
+    {0x3fb, 10},  // ')'
+    {0xf9, 8},  // '*'
+    {0x7fb, 11},  // '+'
+    {0xfa, 8},  // ','
+    {0x16, 6},  // '-'
+    {0x17, 6},  // '.'
+    {0x18, 6},  // '/'
+    {0x0, 5},  // '0'
+    {0x1, 5},  // '1'
+    {0x2, 5},  // '2'
+    {0x19, 6},  // '3'
+    {0x1a, 6},  // '4'
+    {0x1b, 6},  // '5'
+    {0x1c, 6},  // '6'
+    {0x1d, 6},  // '7'
+    {0x1e, 6},  // '8'
+    {0x1f, 6},  // '9'
+    {0x5c, 7},  // ':'
+    {0xfb, 8},  // ';'
+    {0x7ffc, 15},  // '<'
+    {0x20, 6},  // '='
+    {0xffb, 12},  // '>'
+    {0x3fc, 10},  // '?'
+    {0x1ffa, 13},  // '@'
+    {0x21, 6},  // 'A'
+    {0x5d, 7},  // 'B'
+    {0x5e, 7},  // 'C'
+    {0x5f, 7},  // 'D'
+    {0x60, 7},  // 'E'
+    {0x61, 7},  // 'F'
+    {0x62, 7},  // 'G'
+    {0x63, 7},  // 'H'
+    {0x64, 7},  // 'I'
+    {0x65, 7},  // 'J'
+    {0x66, 7},  // 'K'
+    {0x67, 7},  // 'L'
+    {0x68, 7},  // 'M'
+    {0x69, 7},  // 'N'
+    {0x6a, 7},  // 'O'
+    {0x6b, 7},  // 'P'
+    {0x6c, 7},  // 'Q'
+    {0x6d, 7},  // 'R'
+    {0x6e, 7},  // 'S'
+    {0x6f, 7},  // 'T'
+    {0x70, 7},  // 'U'
+    {0x71, 7},  // 'V'
+    {0x72, 7},  // 'W'
+    {0xfc, 8},  // 'X'
+    {0x73, 7},  // 'Y'
+    {0xfd, 8},  // 'Z'
+    {0x1ffb, 13},  // '['
+    {0x7fff0, 19},  // '\'
+    {0x1ffc, 13},  // ']'
+    {0x3ffc, 14},  // '^'
+    {0x22, 6},  // '_'
+    {0x7ffd, 15},  // '`'
+    {0x3, 5},  // 'a'
+    {0x23, 6},  // 'b'
+    {0x4, 5},  // 'c'
+    {0x24, 6},  // 'd'
+    {0x5, 5},  // 'e'
+    {0x25, 6},  // 'f'
+    {0x26, 6},  // 'g'
+    {0x27, 6},  // 'h'
+    {0x6, 5},  // 'i'
+    {0x74, 7},  // 'j'
+    {0x75, 7},  // 'k'
+    {0x28, 6},  // 'l'
+    {0x29, 6},  // 'm'
+    {0x2a, 6},  // 'n'
+    {0x7, 5},  // 'o'
+    {0x2b, 6},  // 'p'
+    {0x76, 7},  // 'q'
+    {0x2c, 6},  // 'r'
+    {0x8, 5},  // 's'
+    {0x9, 5},  // 't'
+    {0x2d, 6},  // 'u'
+    {0x77, 7},  // 'v'
+    {0x78, 7},  // 'w'
+    {0x79, 7},  // 'x'
+    {0x7a, 7},  // 'y'
+    {0x7b, 7},  // 'z'
+    {0x7ffe, 15},  // '{'
+    {0x7fc, 11},  // '|'
+    {0x3ffd, 14},  // '}'
+    {0x1ffd, 13},  // '~'
+    {0xffffffc, 28},
+    {0xfffe6, 20},
+    {0x3fffd2, 22},
+    {0xfffe7, 20},
+    {0xfffe8, 20},
+    {0x3fffd3, 22},
+    {0x3fffd4, 22},
+    {0x3fffd5, 22},
+    {0x7fffd9, 23},
+    {0x3fffd6, 22},
+    {0x7fffda, 23},
+    {0x7fffdb, 23},
+    {0x7fffdc, 23},
+    {0x7fffdd, 23},
+    {0x7fffde, 23},
+    {0xffffeb, 24},
+    {0x7fffdf, 23},
+    {0xffffec, 24},
+    {0xffffed, 24},
+    {0x3fffd7, 22},
+    {0x7fffe0, 23},
+    {0xffffee, 24},
+    {0x7fffe1, 23},
+    {0x7fffe2, 23},
+    {0x7fffe3, 23},
+    {0x7fffe4, 23},
+    {0x1fffdc, 21},
+    {0x3fffd8, 22},
+    {0x7fffe5, 23},
+    {0x3fffd9, 22},
+    {0x7fffe6, 23},
+    {0x7fffe7, 23},
+    {0xffffef, 24},
+    {0x3fffda, 22},
+    {0x1fffdd, 21},
+    {0xfffe9, 20},
+    {0x3fffdb, 22},
+    {0x3fffdc, 22},
+    {0x7fffe8, 23},
+    {0x7fffe9, 23},
+    {0x1fffde, 21},
+    {0x7fffea, 23},
+    {0x3fffdd, 22},
+    {0x3fffde, 22},
+    {0xfffff0, 24},
+    {0x1fffdf, 21},
+    {0x3fffdf, 22},
+    {0x7fffeb, 23},
+    {0x7fffec, 23},
+    {0x1fffe0, 21},
+    {0x1fffe1, 21},
+    {0x3fffe0, 22},
+    {0x1fffe2, 21},
+    {0x7fffed, 23},
+    {0x3fffe1, 22},
+    {0x7fffee, 23},
+    {0x7fffef, 23},
+    {0xfffea, 20},
+    {0x3fffe2, 22},
+    {0x3fffe3, 22},
+    {0x3fffe4, 22},
+    {0x7ffff0, 23},
+    {0x3fffe5, 22},
+    {0x3fffe6, 22},
+    {0x7ffff1, 23},
+    {0x3ffffe0, 26},
+    {0x3ffffe1, 26},
+    {0xfffeb, 20},
+    {0x7fff1, 19},
+    {0x3fffe7, 22},
+    {0x7ffff2, 23},
+    {0x3fffe8, 22},
+    {0x1ffffec, 25},
+    {0x3ffffe2, 26},
+    {0x3ffffe3, 26},
+    {0x3ffffe4, 26},
+    {0x7ffffde, 27},
+    {0x7ffffdf, 27},
+    {0x3ffffe5, 26},
+    {0xfffff1, 24},
+    {0x1ffffed, 25},
+    {0x7fff2, 19},
+    {0x1fffe3, 21},
+    {0x3ffffe6, 26},
+    {0x7ffffe0, 27},
+    {0x7ffffe1, 27},
+    {0x3ffffe7, 26},
+    {0x7ffffe2, 27},
+    {0xfffff2, 24},
+    {0x1fffe4, 21},
+    {0x1fffe5, 21},
+    {0x3ffffe8, 26},
+    {0x3ffffe9, 26},
+    {0xffffffd, 28},
+    {0x7ffffe3, 27},
+    {0x7ffffe4, 27},
+    {0x7ffffe5, 27},
+    {0xfffec, 20},
+    {0xfffff3, 24},
+    {0xfffed, 20},
+    {0x1fffe6, 21},
+    {0x3fffe9, 22},
+    {0x1fffe7, 21},
+    {0x1fffe8, 21},
+    {0x7ffff3, 23},
+    {0x3fffea, 22},
+    {0x3fffeb, 22},
+    {0x1ffffee, 25},
+    {0x1ffffef, 25},
+    {0xfffff4, 24},
+    {0xfffff5, 24},
+    {0x3ffffea, 26},
+    {0x7ffff4, 23},
+    {0x3ffffeb, 26},
+    {0x7ffffe6, 27},
+    {0x3ffffec, 26},
+    {0x3ffffed, 26},
+    {0x7ffffe7, 27},
+    {0x7ffffe8, 27},
+    {0x7ffffe9, 27},
+    {0x7ffffea, 27},
+    {0x7ffffeb, 27},
+    {0xffffffe, 28},
+    {0x7ffffec, 27},
+    {0x7ffffed, 27},
+    {0x7ffffee, 27},
+    {0x7ffffef, 27},
+    {0x7fffff0, 27},
+    {0x3ffffee, 26},
+    {0x3fffffff, 30},  // EOS
+};
+
+/**
+ * 解码用的二叉树，从根开始每读一位走一步，走到叶子输出一个字节
+ * 257 个叶子对应 256 个内部节点，第一次用到时构造
+ */
+struct HuffmanTree
+{
+    struct Node
+    {
+        int16_t child[2];
+        int16_t symbol;     // -1 表示内部节点
+    };
+    std::vector<Node> nodes;
+
+    HuffmanTree()
+    {
+        nodes.reserve(512);
+        nodes.push_back(newNode());
+        for (int sym = 0; sym < 257; ++sym)
+        {
+            int cur = 0;
+            for (int i = kHuffmanCodes[sym].bits - 1; i >= 0; --i)
+            {
+                int bit = (kHuffmanCodes[sym].code >> i) & 1;
+                if (nodes[cur].child[bit] < 0)
+                {
+                    nodes[cur].child[bit] = static_cast<int16_t>(nodes.size());
+                    nodes.push_back(newNode());
+                }
+                cur = nodes[cur].child[bit];
+            }
+            nodes[cur].symbol = static_cast<int16_t>(sym);
+        }
+    }
+
+    static Node newNode()
+    {
+        Node node = { { -1, -1 }, -1 };
+        return node;
+    }
+};
+
+const HuffmanTree& huffmanTree()
+{
+    static const HuffmanTree tree;
+    return tree;
+}
+
+struct StaticEntry
+{
+    std::string name;
+    std::string value;
+};
+
+// RFC 7541 附录 A
+const std::vector<StaticEntry>& staticTable()
+{
+    static const std::vector<StaticEntry> table = {
+        { ":authority", "" },
+        { ":method", "GET" },
+        { ":method", "POST" },
+        { ":path", "/" },
+        { ":path", "/index.html" },
+        { ":scheme", "http" },
+        { ":scheme", "https" },
+        { ":status", "200" },
+        { ":status", "204" },
+        { ":status", "206" },
+        { ":status", "304" },
+        { ":status", "400" },
+        { ":status", "404" },
+        { ":status", "500" },
+        { "accept-charset", "" },
+        { "accept-encoding", "gzip, deflate" },
+        { "accept-language", "" },
+        { "accept-ranges", "" },
+        { "accept", "" },
+        { "access-control-allow-origin", "" },
+        { "age", "" },
+        { "allow", "" },
+        { "authorization", "" },
+        { "cache-control", "" },
+        { "content-disposition", "" },
+        { "content-encoding", "" },
+        { "content-language", "" },
+        { "content-length", "" },
+        { "content-location", "" },
+        { "content-range", "" },
+        { "content-type", "" },
+        { "cookie", "" },
+        { "date", "" },
+        { "etag", "" },
+        { "expect", "" },
+        { "expires", "" },
+        { "from", "" },
+        { "host", "" },
+        { "if-match", "" },
+        { "if-modified-since", "" },
+        { "if-none-match", "" },
+        { "if-range", "" },
+        { "if-unmodified-since", "" },
+        { "last-modified", "" },
+        { "link", "" },
+        { "location", "" },
+        { "max-forwards", "" },
+        { "proxy-authenticate", "" },
+        { "proxy-authorization", "" },
+        { "range", "" },
+        { "referer", "" },
+        { "refresh", "" },
+        { "retry-after", "" },
+        { "server", "" },
+        { "set-cookie", "" },
+        { "strict-transport-security", "" },
+        { "transfer-encoding", "" },
+        { "user-agent", "" },
+        { "vary", "" },
+        { "via", "" },
+        { "www-authenticate", "" },
+    };
+    return table;
+}
+
+// 名字 -> 静态表中第一次出现的下标(从0开始)，同名的项在静态表中是连续的
+std::unordered_map<std::string, size_t> buildStaticNameIndex()
+{
+    std::unordered_map<std::string, size_t> index;
+    const std::vector<StaticEntry>& table = staticTable();
+    for (size_t i = table.size(); i > 0; --i)
+    {
+        index[table[i - 1].name] = i - 1;
+    }
+    return index;
+}
+
+const std::unordered_map<std::string, size_t>& staticNameIndex()
+{
+    // 多个io线程都会用到，依赖局部静态变量的线程安全初始化
+    static const std::unordered_map<std::string, size_t> index = buildStaticNameIndex();
+    return index;
+}
+
+// 首部块解码出来的首部列表的上限，防止很短的首部块通过反复引用动态表放大成巨大的首部
+const size_t kMaxHeaderListSize = 64 * 1024;
+
+} // namespace
+
+namespace hpack
+{
+
+void encodeInteger(std::string* out, uint8_t flags, int prefixBits, uint64_t value)
+{
+    const uint64_t maxPrefix = (1u << prefixBits) - 1;
+    if (value < maxPrefix)
+    {
+        out->push_back(static_cast<char>(flags | value));
+        return;
+    }
+    out->push_back(static_cast<char>(flags | maxPrefix));
+    value -= maxPrefix;
+    while (value >= 128)
+    {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+bool decodeInteger(const uint8_t** p, const uint8_t* end, int prefixBits, uint64_t* value)
+{
+    const uint8_t* cur = *p;
+    if (cur >= end)
+    {
+        return false;
+    }
+    const uint64_t maxPrefix = (1u << prefixBits) - 1;
+    uint64_t v = *cur++ & maxPrefix;
+    if (v == maxPrefix)
+    {
+        int shift = 0;
+        while (true)
+        {
+            // 超过 56 位的整数在 HTTP/2 里没有意义，按错误处理防止溢出
+            if (cur >= end || shift > 56)
+            {
+                return false;
+            }
+            uint8_t b = *cur++;
+            v += static_cast<uint64_t>(b & 0x7f) << shift;
+            shift += 7;
+            if ((b & 0x80) == 0)
+            {
+                break;
+            }
+        }
+    }
+    *value = v;
+    *p = cur;
+    return true;
+}
+
+size_t huffmanEncodedLength(const std::string& str)
+{
+    size_t bits = 0;
+    for (unsigned char c : str)
+    {
+        bits += kHuffmanCodes[c].bits;
+    }
+    return (bits + 7) / 8;
+}
+
+void huffmanEncode(const std::string& str, std::string* out)
+{
+    uint64_t acc = 0;   // 还没有输出的位，最多 7 + 30 位
+    int nbits = 0;
+    for (unsigned char c : str)
+    {
+        acc = (acc << kHuffmanCodes[c].bits) | kHuffmanCodes[c].code;
+        nbits += kHuffmanCodes[c].bits;
+        while (nbits >= 8)
+        {
+            nbits -= 8;
+            out->push_back(static_cast<char>(acc >> nbits));
+        }
+    }
+    if (nbits > 0)
+    {
+        // 用 EOS 的高位(全1)补齐最后一个字节
+        acc = (acc << (8 - nbits)) | (0xff >> nbits);
+        out->push_back(static_cast<char>(acc));
+    }
+}
+
+bool huffmanDecode(const uint8_t* data, size_t len, std::string* out)
+{
+    const std::vector<HuffmanTree::Node>& nodes = huffmanTree().nodes;
+    int cur = 0;
+    int depth = 0;          // 上一个完整字节之后又读了多少位
+    bool allOnes = true;    // 这些位是不是全 1
+    for (size_t i = 0; i < len; ++i)
+    {
+        for (int shift = 7; shift >= 0; --shift)
+        {
+            int bit = (data[i] >> shift) & 1;
+            cur = nodes[cur].child[bit];
+            if (cur < 0)
+            {
+                return false;
+            }
+            ++depth;
+            allOnes = allOnes && bit;
+            int sym = nodes[cur].symbol;
+            if (sym >= 0)
+            {
+                if (sym == 256)
+                {
+                    return false;
+                }
+                out->push_back(static_cast<char>(sym));
+                cur = 0;
+                depth = 0;
+                allOnes = true;
+            }
+        }
+    }
+    return depth <= 7 && allOnes;
+}
+
+} // namespace hpack
+
+HpackTable::HpackTable(size_t maxSize)
+    : size_(0),
+      maxSize_(maxSize)
+{
+}
+
+void HpackTable::setMaxSize(size_t maxSize)
+{
+    maxSize_ = maxSize;
+    evict(maxSize_);
+}
+
+void HpackTable::evict(size_t limit)
+{
+    while (size_ > limit && !entries_.empty())
+    {
+        const std::pair<std::string, std::string>& last = entries_.back();
+        size_ -= last.first.size() + last.second.size() + kEntryOverhead;
+        entries_.pop_back();
+    }
+}
+
+void HpackTable::add(const std::string& name, const std::string& value)
+{
+    size_t entrySize = name.size() + value.size() + kEntryOverhead;
+    // 比整张表还大的项会把表清空，自己也不插入，这是 RFC 规定的行为而不是错误
+    if (entrySize > maxSize_)
+    {
+        evict(0);
+        return;
+    }
+    evict(maxSize_ - entrySize);
+    entries_.emplace_front(name, value);
+    size_ += entrySize;
+}
+
+bool HpackTable::get(uint64_t index, const std::string** name, const std::string** value) const
+{
+    if (index == 0)
+    {
+        return false;
+    }
+    if (index <= kStaticTableSize)
+    {
+        const StaticEntry& entry = staticTable()[index - 1];
+        *name = &entry.name;
+        *value = &entry.value;
+        return true;
+    }
+    index -= kStaticTableSize + 1;
+    if (index >= entries_.size())
+    {
+        return false;
+    }
+    *name = &entries_[index].first;
+    *value = &entries_[index].second;
+    return true;
+}
+
+size_t HpackTable::find(const std::string& name, const std::string& value, bool* exact) const
+{
+    size_t nameMatch = 0;
+    const std::unordered_map<std::string, size_t>& names = staticNameIndex();
+    auto it = names.find(name);
+    if (it != names.end())
+    {
+        const std::vector<StaticEntry>& table = staticTable();
+        for (size_t i = it->second; i < table.size() && table[i].name == name; ++i)
+        {
+            if (table[i].value == value)
+            {
+                *exact = true;
+                return i + 1;
+            }
+        }
+        nameMatch = it->second + 1;
+    }
+    for (size_t i = 0; i < entries_.size(); ++i)
+    {
+        if (entries_[i].first == name)
+        {
+            if (entries_[i].second == value)
+            {
+                *exact = true;
+                return kStaticTableSize + 1 + i;
+            }
+            if (nameMatch == 0)
+            {
+                nameMatch = kStaticTableSize + 1 + i;
+            }
+        }
+    }
+    *exact = false;
+    return nameMatch;
+}
+
+HpackDecoder::HpackDecoder(size_t maxTableSize)
+    : table_(maxTableSize),
+      maxTableSizeLimit_(maxTableSize)
+{
+}
+
+bool HpackDecoder::decodeString(const uint8_t** p, const uint8_t* end, std::string* out)
+{
+    if (*p >= end)
+    {
+        return false;
+    }
+    bool huffman = (**p & 0x80) != 0;
+    uint64_t len = 0;
+    if (!hpack::decodeInteger(p, end, 7, &len) || len > static_cast<uint64_t>(end - *p))
+    {
+        return false;
+    }
+    out->clear();
+    if (huffman)
+    {
+        if (!hpack::huffmanDecode(*p, len, out))
+        {
+            return false;
+        }
+    }
+    else
+    {
+        out->assign(reinterpret_cast<const char*>(*p), len);
+    }
+    *p += len;
+    return true;
+}
+
+bool HpackDecoder::decode(const char* data, size_t len, HpackHeaderList* headers)
+{
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+    const uint8_t* end = p + len;
+    size_t listSize = 0;
+    bool fieldSeen = false;
+    while (p < end)
+    {
+        uint8_t b = *p;
+        uint64_t index = 0;
+        if (b & 0x80)
+        {
+            // 1xxxxxxx 索引表示
+            const std::string* name = nullptr;
+            const std::string* value = nullptr;
+            if (!hpack::decodeInteger(&p, end, 7, &index) || !table_.get(index, &name, &value))
+            {
+                return false;
+            }
+            headers->emplace_back(*name, *value);
+        }
+        else if ((b & 0xe0) == 0x20)
+        {
+            // 001xxxxx 动态表大小更新，只能出现在首部块的开头
+            uint64_t size = 0;
+            if (fieldSeen || !hpack::decodeInteger(&p, end, 5, &size) || size > maxTableSizeLimit_)
+            {
+                return false;
+            }
+            table_.setMaxSize(size);
+            continue;
+        }
+        else
+        {
+            // 01xxxxxx 带索引的字面量，插入动态表
+            // 0000xxxx 不带索引的字面量，0001xxxx 永不索引的字面量，这两种对解码端没有区别
+            bool incremental = (b & 0xc0) == 0x40;
+            if (!hpack::decodeInteger(&p, end, incremental ? 6 : 4, &index))
+            {
+                return false;
+            }
+            std::string name;
+            std::string value;
+            if (index == 0)
+            {
+                if (!decodeString(&p, end, &name))
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                const std::string* indexedName = nullptr;
+                const std::string* unused = nullptr;
+                if (!table_.get(index, &indexedName, &unused))
+                {
+                    return false;
+                }
+                name = *indexedName;
+            }
+            if (!decodeString(&p, end, &value))
+            {
+                return false;
+            }
+            if (incremental)
+            {
+                table_.add(name, value);
+            }
+            headers->emplace_back(std::move(name), std::move(value));
+        }
+        fieldSeen = true;
+        listSize += headers->back().first.size() + headers->back().second.size() + HpackTable::kEntryOverhead;
+        if (listSize > kMaxHeaderListSize)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+HpackEncoder::HpackEncoder(size_t maxTableSize)
+    : table_(maxTableSize),
+      maxTableSizeLimit_(maxTableSize),
+      sizeUpdatePending_(false),
+      minSizeSinceUpdate_(maxTableSize)
+{
+}
+
+void HpackEncoder::setMaxTableSize(size_t size)
+{
+    size_t newSize = std::min(size, maxTableSizeLimit_);
+    if (newSize == table_.maxSize() && !sizeUpdatePending_)
+    {
+        return;
+    }
+    minSizeSinceUpdate_ = sizeUpdatePending_ ? std::min(minSizeSinceUpdate_, newSize) : newSize;
+    sizeUpdatePending_ = true;
+    table_.setMaxSize(newSize);
+}
+
+void HpackEncoder::encodeString(const std::string& str, std::string* out)
+{
+    size_t huffmanLen = hpack::huffmanEncodedLength(str);
+    if (huffmanLen < str.size())
+    {
+        hpack::encodeInteger(out, 0x80, 7, huffmanLen);
+        hpack::huffmanEncode(str, out);
+    }
+    else
+    {
+        hpack::encodeInteger(out, 0x00, 7, str.size());
+        out->append(str);
+    }
+}
+
+void HpackEncoder::encode(const HpackHeaderList& headers, std::string* out)
+{
+    if (sizeUpdatePending_)
+    {
+        if (minSizeSinceUpdate_ < table_.maxSize())
+        {
+            hpack::encodeInteger(out, 0x20, 5, minSizeSinceUpdate_);
+        }
+        hpack::encodeInteger(out, 0x20, 5, table_.maxSize());
+        sizeUpdatePending_ = false;
+    }
+
+    for (const auto& header : headers)
+    {
+        const std::string& name = header.first;
+        const std::string& value = header.second;
+        bool exact = false;
+        size_t index = table_.find(name, value, &exact);
+        if (exact)
+        {
+            hpack::encodeInteger(out, 0x80, 7, index);
+            continue;
+        }
+        // 每个响应都不一样的值放进动态表只会把有用的项挤出去
+        bool indexing = name != "content-length" && name != "date" && name != "etag"
+                        && name != "last-modified";
+        if (indexing)
+        {
+            hpack::encodeInteger(out, 0x40, 6, index);
+        }
+        else
+        {
+            hpack::encodeInteger(out, 0x00, 4, index);
+        }
+        if (index == 0)
+        {
+            encodeString(name, out);
+        }
+        encodeString(value, out);
+        if (indexing)
+        {
+            table_.add(name, value);
+        }
+    }
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <utility>
+
+#include "noncopyable.h"
+
+/**
+ * HPACK (RFC 7541)，HTTP/2 的首部压缩
+ * 首部用 静态表(61项) + 动态表 的索引表示，字符串可以再用固定的哈夫曼编码压缩。
+ * 编码端和解码端各自维护一张动态表，两边按同样的顺序插入和淘汰，所以一个连接上的
+ * 首部块必须严格按收到的顺序解码，不能跳过。
+ */
+using HpackHeaderList = std::vector<std::pair<std::string, std::string>>;
+
+namespace hpack
+{
+    // 整数编码：第一个字节低 prefixBits 位放得下就直接放，放不下再用 7 位一组的变长编码
+    // flags 是第一个字节高位的类型标志
+    void encodeInteger(std::string* out, uint8_t flags, int prefixBits, uint64_t value);
+    bool decodeInteger(const uint8_t** p, const uint8_t* end, int prefixBits, uint64_t* value);
+
+    // 哈夫曼编码，编码长度不足整字节的部分用 EOS 的前缀(全1)补齐
+    size_t huffmanEncodedLength(const std::string& str);
+    void huffmanEncode(const std::string& str, std::string* out);
+    // 填充超过 7 位、填充不是全 1、出现 EOS 都算解码错误
+    bool huffmanDecode(const uint8_t* data, size_t len, std::string* out);
+}
+
+/**
+ * 动态表，新插入的在最前面，超过容量时从最老的开始淘汰
+ * 每项的大小按 RFC 规定是 name + value + 32
+ * 对外的索引从 1 开始，1~61 是静态表，62 开始是动态表
+ */
+class HpackTable
+{
+public:
+    static const size_t kStaticTableSize = 61;
+    static const size_t kEntryOverhead = 32;
+
+    explicit HpackTable(size_t maxSize);
+
+    size_t size() const { return size_; }
+    size_t maxSize() const { return maxSize_; }
+    void setMaxSize(size_t maxSize);
+
+    void add(const std::string& name, const std::string& value);
+    // 索引无效时返回 false
+    bool get(uint64_t index, const std::string** name, const std::string** value) const;
+    // 查找可以复用的索引，完全匹配时 *exact 为 true，只有名字匹配时为 false，都找不到返回 0
+    size_t find(const std::string& name, const std::string& value, bool* exact) const;
+
+private:
+    void evict(size_t limit);
+
+    std::deque<std::pair<std::string, std::string>> entries_;
+    size_t size_;
+    size_t maxSize_;
+};
+
+class HpackDecoder : noncopyable
+{
+public:
+    // maxTableSize 是本端在 SETTINGS_HEADER_TABLE_SIZE 中通告的上限
+    explicit HpackDecoder(size_t maxTableSize = 4096);
+
+    // 解码一个完整的首部块，失败说明两边的动态表已经不一致，只能按连接错误处理
+    bool decode(const char* data, size_t len, HpackHeaderList* headers);
+
+private:
+    bool decodeString(const uint8_t** p, const uint8_t* end, std::string* out);
+
+    HpackTable table_;
+    size_t maxTableSizeLimit_;
+};
+
+class HpackEncoder : noncopyable
+{
+public:
+    explicit HpackEncoder(size_t maxTableSize = 4096);
+
+    // 对端的 SETTINGS_HEADER_TABLE_SIZE 变化，下一个首部块开头会带上表大小更新
+    void setMaxTableSize(size_t size);
+
+    // 名字必须已经是小写
+    void encode(const HpackHeaderList& headers, std::string* out);
+
+private:
+    void encodeString(const std::string& str, std::string* out);
+
+    HpackTable table_;
+    size_t maxTableSizeLimit_;  // 本端自己允许使用的上限
+    bool sizeUpdatePending_;
+    size_t minSizeSinceUpdate_; // 两次首部块之间表大小可能先变小再变大，需要把最小值也告诉对端
+};
@@ -0,0 +1,961 @@
+#include "http2Connection.h"
+#include "httpContext.h"
+#include "httpRequest.h"
+#include "httpResponseWriter.h"
+#include "TcpConnection.h"
+#include "Logging.h"
+
+#include <string.h>
+#include <algorithm>
+
+using namespace http2;
+
+namespace
+{
+
+// HTTP2-Settings 首部是 base64url 编码、不带填充的 SETTINGS 负载
+bool base64UrlDecode(const std::string& in, std::string* out)
+{
+    uint32_t acc = 0;
+    int nbits = 0;
+    for (char c : in)
+    {
+        int v;
+        if (c >= 'A' && c <= 'Z') v = c - 'A';
+        else if (c >= 'a' && c <= 'z') v = c - 'a' + 26;
+        else if (c >= '0' && c <= '9') v = c - '0' + 52;
+        else if (c == '-' || c == '+') v = 62;
+        else if (c == '_' || c == '/') v = 63;
+        else if (c == '=') break;
+        else return false;
+        acc = (acc << 6) | v;
+        nbits += 6;
+        if (nbits >= 8)
+        {
+            nbits -= 8;
+            out->push_back(static_cast<char>(acc >> nbits));
+        }
+    }
+    return true;
+}
+
+// content-type -> Content-Type，HttpRequest 的首部是按 HTTP/1.1 的写法保存和查找的
+std::string canonicalHeaderName(const std::string& name)
+{
+    std::string result(name);
+    bool upper = true;
+    for (char& c : result)
+    {
+        if (upper && c >= 'a' && c <= 'z')
+        {
+            c = static_cast<char>(c - 'a' + 'A');
+        }
+        upper = (c == '-');
+    }
+    return result;
+}
+
+// HTTP/2 里不允许出现的逐跳首部
+bool isConnectionSpecific(const std::string& name)
+{
+    return name == "connection" || name == "keep-alive" || name == "proxy-connection"
+           || name == "transfer-encoding" || name == "upgrade";
+}
+
+const char kSwitchingProtocols[] =
+    "HTTP/1.1 101 Switching Protocols\r\nConnection: Upgrade\r\nUpgrade: h2c\r\n\r\n";
+
+} // namespace
+
+Http2Connection::Http2Connection(const TcpConnectionPtr& conn, const RequestCallback& cb, size_t maxBodySize)
+    : conn_(conn.get()),
+      requestCallback_(cb),
+      maxBodySize_(maxBodySize),
+      state_(kWaitPreface),
+      lastStreamId_(0),
+      goawayReceived_(false),
+      virtualClock_(0),
+      continuationStream_(0),
+      headerFlags_(0),
+      headerDependency_(0),
+      headerExclusive_(false),
+      headerWeight_(kDefaultWeight),
+      peerInitialWindowSize_(kDefaultWindowSize),
+      peerMaxFrameSize_(kDefaultMaxFrameSize),
+      sendWindow_(kDefaultWindowSize),
+      recvWindow_(kDefaultWindowSize)
+{
+}
+
+Http2Connection::~Http2Connection() = default;
+
+int Http2Connection::matchPreface(const Buffer& buf)
+{
+    size_t n = std::min(buf.readableBytes(), kClientPrefaceLen);
+    if (memcmp(buf.peek(), kClientPreface, n) != 0)
+    {
+        return -1;
+    }
+    return n == kClientPrefaceLen ? 1 : 0;
+}
+
+void Http2Connection::start()
+{
+    // 服务端的连接前言就是一个 SETTINGS 帧，顺便把连接级的接收窗口也调大
+    appendFrameHeader(&output_, 3 * 6, kSettings, 0, 0);
+    appendSetting(&output_, kSettingsMaxConcurrentStreams, kMaxConcurrentStreams);
+    appendSetting(&output_, kSettingsInitialWindowSize, kLocalWindowSize);
+    appendSetting(&output_, kSettingsMaxHeaderListSize, kMaxHeaderBlockSize);
+    appendWindowUpdate(&output_, 0, kLocalWindowSize - kDefaultWindowSize);
+    recvWindow_ = kLocalWindowSize;
+    flushOutput();
+}
+
+bool Http2Connection::startUpgrade(HttpRequest& request, const std::string& settings)
+{
+    std::string payload;
+    if (!base64UrlDecode(settings, &payload) || payload.size() % 6 != 0
+        || applySettings(payload.data(), payload.size()) != kNoError)
+    {
+        // 升级失败就当作没有看到 Upgrade，继续用 HTTP/1.1 处理
+        LOG_ERROR << "invalid HTTP2-Settings: " << settings;
+        return false;
+    }
+    output_.append(kSwitchingProtocols, sizeof kSwitchingProtocols - 1);
+    start();
+
+    // 升级前的请求就是 stream 1，请求已经收完整，对客户端来说是 half-closed(local)
+    Stream& stream = streams_[1];
+    stream.id = 1;
+    stream.remoteClosed = true;
+    stream.sendWindow = peerInitialWindowSize_;
+    stream.recvWindow = 0;
+    stream.headersSent = false;
+    stream.parent = 0;
+    stream.weight = kDefaultWeight;
+    stream.virtualTime = virtualClock_;
+    lastStreamId_ = 1;
+    process(1, request);
+    return true;
+}
+
+void Http2Connection::onMessage(Buffer* buf)
+{
+    while (state_ != kClosed)
+    {
+        if (state_ == kWaitPreface)
+        {
+            int ret = matchPreface(*buf);
+            if (ret == 0)
+            {
+                break;
+            }
+            if (ret < 0)
+            {
+                connectionError(kProtocolError, "invalid connection preface");
+                break;
+            }
+            buf->retrieve(kClientPrefaceLen);
+            state_ = kWaitSettings;
+            continue;
+        }
+
+        if (buf->readableBytes() < kFrameHeaderSize)
+        {
+            break;
+        }
+        FrameHeader header;
+        parseFrameHeader(buf->peek(), &header);
+        // 本端没有通告过 SETTINGS_MAX_FRAME_SIZE，对端的帧不能超过默认值
+        if (header.length > kDefaultMaxFrameSize)
+        {
+            connectionError(kFrameSizeError, "frame too large");
+            break;
+        }
+        if (buf->readableBytes() < kFrameHeaderSize + header.length)
+        {
+            break;
+        }
+        handleFrame(header, buf->peek() + kFrameHeaderSize);
+        buf->retrieve(kFrameHeaderSize + header.length);
+    }
+    if (state_ == kClosed)
+    {
+        buf->retrieveAll();
+    }
+    flushOutput();
+}
+
+void Http2Connection::handleFrame(const FrameHeader& header, const char* payload)
+{
+    if (state_ == kWaitSettings)
+    {
+        if (header.type != kSettings || (header.flags & kFlagAck))
+        {
+            connectionError(kProtocolError, "expect SETTINGS after preface");
+            return;
+        }
+        state_ = kOpen;
+    }
+    // 首部块必须连续，中间不能插入别的帧
+    if (continuationStream_ != 0
+        && (header.type != kContinuation || header.streamId != continuationStream_))
+    {
+        connectionError(kProtocolError, "expect CONTINUATION");
+        return;
+    }
+
+    switch (header.type)
+    {
+    case kData:
+        onData(header, payload);
+        break;
+    case kHeaders:
+        onHeaders(header, payload);
+        break;
+    case kPriority:
+        onPriority(header, payload);
+        break;
+    case kRstStream:
+        onRstStream(header, payload);
+        break;
+    case kSettings:
+        onSettings(header, payload);
+        break;
+    case kPushPromise:
+        connectionError(kProtocolError, "client sent PUSH_PROMISE");
+        break;
+    case kPing:
+        onPing(header, payload);
+        break;
+    case kGoaway:
+        onGoaway(header, payload);
+        break;
+    case kWindowUpdate:
+        onWindowUpdate(header, payload);
+        break;
+    case kContinuation:
+        onContinuation(header, payload);
+        break;
+    default:
+        // 不认识的帧类型必须忽略
+        break;
+    }
+}
+
+void Http2Connection::onData(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(kProtocolError, "DATA on stream 0");
+        return;
+    }
+    // 整个负载(包括填充)都计入流量控制，流不存在了也要算在连接的窗口里
+    if (header.length > recvWindow_)
+    {
+        connectionError(kFlowControlError, "connection window exceeded");
+        return;
+    }
+    recvWindow_ -= header.length;
+
+    const char* data = payload;
+    size_t len = header.length;
+    if (header.flags & kFlagPadded)
+    {
+        uint8_t pad = len > 0 ? static_cast<uint8_t>(payload[0]) : 0;
+        if (len == 0 || pad >= len)
+        {
+            connectionError(kProtocolError, "invalid DATA padding");
+            return;
+        }
+        data += 1;
+        len -= 1 + pad;
+    }
+
+    auto it = streams_.find(header.streamId);
+    if (it == streams_.end())
+    {
+        if (header.streamId > lastStreamId_)
+        {
+            connectionError(kProtocolError, "DATA on idle stream");
+            return;
+        }
+        streamError(header.streamId, kStreamClosed);
+    }
+    else if (it->second.remoteClosed)
+    {
+        streamError(header.streamId, kStreamClosed);
+    }
+    else if (header.length > it->second.recvWindow)
+    {
+        streamError(header.streamId, kFlowControlError);
+    }
+    else if (it->second.body.size() + len > maxBodySize_)
+    {
+        rejectBody(&it->second);
+    }
+    else
+    {
+        Stream& stream = it->second;
+        stream.recvWindow -= header.length;
+        stream.body.append(data, len);
+        if (header.flags & kFlagEndStream)
+        {
+            stream.remoteClosed = true;
+            dispatch(&stream);
+        }
+        else if (stream.recvWindow < kLocalWindowSize / 2)
+        {
+            appendWindowUpdate(&output_, stream.id, kLocalWindowSize - stream.recvWindow);
+            stream.recvWindow = kLocalWindowSize;
+        }
+    }
+
+    if (state_ != kClosed && recvWindow_ < kLocalWindowSize / 2)
+    {
+        appendWindowUpdate(&output_, 0, kLocalWindowSize - recvWindow_);
+        recvWindow_ = kLocalWindowSize;
+    }
+}
+
+void Http2Connection::onHeaders(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(kProtocolError, "HEADERS on stream 0");
+        return;
+    }
+    const char* p = payload;
+    size_t len = header.length;
+    uint8_t pad = 0;
+    if (header.flags & kFlagPadded)
+    {
+        if (len < 1)
+        {
+            connectionError(kFrameSizeError, "invalid HEADERS padding");
+            return;
+        }
+        pad = static_cast<uint8_t>(*p);
+        ++p;
+        --len;
+    }
+    headerDependency_ = 0;
+    headerExclusive_ = false;
+    headerWeight_ = kDefaultWeight;
+    if (header.flags & kFlagPriority)
+    {
+        if (len < 5)
+        {
+            connectionError(kFrameSizeError, "invalid HEADERS priority");
+            return;
+        }
+        uint32_t dependency = readUint32(p);
+        headerExclusive_ = (dependency >> 31) != 0;
+        headerDependency_ = dependency & 0x7fffffff;
+        headerWeight_ = static_cast<uint8_t>(p[4]) + 1;
+        p += 5;
+        len -= 5;
+    }
+    if (pad > len)
+    {
+        connectionError(kProtocolError, "invalid HEADERS padding");
+        return;
+    }
+    headerFlags_ = header.flags;
+    headerBlock_.assign(p, len - pad);
+    if (header.flags & kFlagEndHeaders)
+    {
+        onHeaderBlock(header.streamId);
+    }
+    else
+    {
+        continuationStream_ = header.streamId;
+    }
+}
+
+void Http2Connection::onContinuation(const FrameHeader& header, const char* payload)
+{
+    if (continuationStream_ == 0)
+    {
+        connectionError(kProtocolError, "unexpected CONTINUATION");
+        return;
+    }
+    if (headerBlock_.size() + header.length > kMaxHeaderBlockSize)
+    {
+        connectionError(kEnhanceYourCalm, "header block too large");
+        return;
+    }
+    headerBlock_.append(payload, header.length);
+    if (header.flags & kFlagEndHeaders)
+    {
+        continuationStream_ = 0;
+        onHeaderBlock(header.streamId);
+    }
+}
+
+void Http2Connection::onHeaderBlock(uint32_t streamId)
+{
+    // 即使这个流最后要被拒绝，首部块也必须解码，否则两边的动态表就对不上了
+    HpackHeaderList headers;
+    bool ok = decoder_.decode(headerBlock_.data(), headerBlock_.size(), &headers);
+    headerBlock_.clear();
+    if (!ok)
+    {
+        connectionError(kCompressionError, "hpack decode failed");
+        return;
+    }
+    bool endStream = (headerFlags_ & kFlagEndStream) != 0;
+
+    auto it = streams_.find(streamId);
+    if (it != streams_.end())
+    {
+        // 已经存在的流上的 HEADERS 是请求体后面的 trailer，内容这里不需要
+        Stream& stream = it->second;
+        if (stream.remoteClosed)
+        {
+            streamError(streamId, kStreamClosed);
+        }
+        else if (!endStream)
+        {
+            streamError(streamId, kProtocolError);
+        }
+        else
+        {
+            stream.remoteClosed = true;
+            dispatch(&stream);
+        }
+        return;
+    }
+    if ((streamId & 1) == 0 || streamId <= lastStreamId_)
+    {
+        connectionError(kProtocolError, "invalid stream id");
+        return;
+    }
+    lastStreamId_ = streamId;
+    if (streams_.size() >= kMaxConcurrentStreams)
+    {
+        streamError(streamId, kRefusedStream);
+        return;
+    }
+    if (headerDependency_ == streamId)
+    {
+        streamError(streamId, kProtocolError);
+        return;
+    }
+
+    Stream& stream = streams_[streamId];
+    stream.id = streamId;
+    stream.remoteClosed = endStream;
+    stream.sendWindow = peerInitialWindowSize_;
+    stream.recvWindow = kLocalWindowSize;
+    stream.headers.swap(headers);
+    stream.headersSent = false;
+    stream.parent = 0;
+    stream.weight = kDefaultWeight;
+    stream.virtualTime = virtualClock_;
+    if (headerFlags_ & kFlagPriority)
+    {
+        setPriority(&stream, headerDependency_, headerExclusive_, headerWeight_);
+    }
+    if (endStream)
+    {
+        dispatch(&stream);
+    }
+}
+
+void Http2Connection::onPriority(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId == 0)
+    {
+        connectionError(kProtocolError, "PRIORITY on stream 0");
+        return;
+    }
+    if (header.length != 5)
+    {
+        streamError(header.streamId, kFrameSizeError);
+        return;
+    }
+    uint32_t dependency = readUint32(payload);
+    bool exclusive = (dependency >> 31) != 0;
+    dependency &= 0x7fffffff;
+    if (dependency == header.streamId)
+    {
+        streamError(header.streamId, kProtocolError);
+        return;
+    }
+    // 还没有打开或者已经关闭的流的优先级没有保存的必要
+    auto it = streams_.find(header.streamId);
+    if (it != streams_.end())
+    {
+        setPriority(&it->second, dependency, exclusive, static_cast<uint8_t>(payload[4]) + 1);
+    }
+}
+
+void Http2Connection::setPriority(Stream* stream, uint32_t dependency, bool exclusive, uint32_t weight)
+{
+    // 新的父节点是自己的后代时，先把这个后代挪到自己原来的父节点下面，避免形成环(RFC 7540 5.3.3)
+    uint32_t p = dependency;
+    for (size_t depth = 0; p != 0 && depth <= streams_.size(); ++depth)
+    {
+        if (p == stream->id)
+        {
+            streams_[dependency].parent = stream->parent;
+            break;
+        }
+        auto it = streams_.find(p);
+        if (it == streams_.end())
+        {
+            break;
+        }
+        p = it->second.parent;
+    }
+    // 独占依赖：父节点原来的子节点都变成自己的子节点
+    if (exclusive)
+    {
+        for (auto& kv : streams_)
+        {
+            if (kv.second.parent == dependency && kv.first != stream->id)
+            {
+                kv.second.parent = stream->id;
+            }
+        }
+    }
+    stream->parent = dependency;
+    stream->weight = weight;
+}
+
+void Http2Connection::onRstStream(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId == 0 || header.streamId > lastStreamId_)
+    {
+        connectionError(kProtocolError, "RST_STREAM on idle stream");
+        return;
+    }
+    if (header.length != 4)
+    {
+        connectionError(kFrameSizeError, "invalid RST_STREAM");
+        return;
+    }
+    LOG_DEBUG << "stream " << header.streamId << " reset by peer, error " << readUint32(payload);
+    // 处理函数可能还在执行，之后调用 complete 时找不到流，响应直接丢弃
+    closeStream(header.streamId);
+}
+
+void Http2Connection::onSettings(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId != 0)
+    {
+        connectionError(kProtocolError, "SETTINGS on stream");
+        return;
+    }
+    if (header.flags & kFlagAck)
+    {
+        if (header.length != 0)
+        {
+            connectionError(kFrameSizeError, "SETTINGS ack with payload");
+        }
+        return;
+    }
+    if (header.length % 6 != 0)
+    {
+        connectionError(kFrameSizeError, "invalid SETTINGS length");
+        return;
+    }
+    ErrorCode code = applySettings(payload, header.length);
+    if (code != kNoError)
+    {
+        connectionError(code, "invalid SETTINGS value");
+        return;
+    }
+    appendSettingsAck(&output_);
+    // 初始窗口变大以后，等着发送的数据可能可以发了
+    flushData();
+}
+
+ErrorCode Http2Connection::applySettings(const char* data, size_t len)
+{
+    for (size_t i = 0; i + 6 <= len; i += 6)
+    {
+        uint16_t id = readUint16(data + i);
+        uint32_t value = readUint32(data + i + 2);
+        switch (id)
+        {
+        case kSettingsHeaderTableSize:
+            encoder_.setMaxTableSize(value);
+            break;
+        case kSettingsEnablePush:
+            // 服务端不推送，只检查取值
+            if (value > 1)
+            {
+                return kProtocolError;
+            }
+            break;
+        case kSettingsInitialWindowSize:
+        {
+            if (value > kMaxWindowSize)
+            {
+                return kFlowControlError;
+            }
+            // 只影响流的窗口，已经打开的流按差值调整
+            int64_t delta = static_cast<int64_t>(value) - peerInitialWindowSize_;
+            for (auto& kv : streams_)
+            {
+                kv.second.sendWindow += delta;
+                if (kv.second.sendWindow > kMaxWindowSize)
+                {
+                    return kFlowControlError;
+                }
+            }
+            peerInitialWindowSize_ = value;
+            break;
+        }
+        case kSettingsMaxFrameSize:
+            if (value < kDefaultMaxFrameSize || value > kMaxFrameSizeLimit)
+            {
+                return kProtocolError;
+            }
+            peerMaxFrameSize_ = value;
+            break;
+        default:
+            // SETTINGS_MAX_CONCURRENT_STREAMS 限制的是服务端推送的流，其他未知的设置忽略
+            break;
+        }
+    }
+    return kNoError;
+}
+
+void Http2Connection::onPing(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId != 0)
+    {
+        connectionError(kProtocolError, "PING on stream");
+        return;
+    }
+    if (header.length != 8)
+    {
+        connectionError(kFrameSizeError, "invalid PING");
+        return;
+    }
+    if (!(header.flags & kFlagAck))
+    {
+        appendPingAck(&output_, payload);
+    }
+}
+
+void Http2Connection::onGoaway(const FrameHeader& header, const char* payload)
+{
+    if (header.streamId != 0)
+    {
+        connectionError(kProtocolError, "GOAWAY on stream");
+        return;
+    }
+    if (header.length < 8)
+    {
+        connectionError(kFrameSizeError, "invalid GOAWAY");
+        return;
+    }
+    LOG_DEBUG << "GOAWAY received, error " << readUint32(payload + 4);
+    // 已经在处理的流继续处理完，全部结束后关闭连接
+    goawayReceived_ = true;
+    if (streams_.empty())
+    {
+        state_ = kClosed;
+        flushOutput();
+        conn_->shutdown();
+    }
+}
+
+void Http2Connection::onWindowUpdate(const FrameHeader& header, const char* payload)
+{
+    if (header.length != 4)
+    {
+        connectionError(kFrameSizeError, "invalid WINDOW_UPDATE");
+        return;
+    }
+    uint32_t increment = readUint32(payload) & 0x7fffffff;
+    if (header.streamId == 0)
+    {
+        if (increment == 0)
+        {
+            connectionError(kProtocolError, "zero WINDOW_UPDATE");
+            return;
+        }
+        if (sendWindow_ + increment > kMaxWindowSize)
+        {
+            connectionError(kFlowControlError, "connection window overflow");
+            return;
+        }
+        sendWindow_ += increment;
+    }
+    else
+    {
+        auto it = streams_.find(header.streamId);
+        if (it == streams_.end())
+        {
+            // 流刚关闭时对端可能还没收到 END_STREAM，这时的 WINDOW_UPDATE 忽略
+            return;
+        }
+        if (increment == 0)
+        {
+            streamError(header.streamId, kProtocolError);
+            return;
+        }
+        if (it->second.sendWindow + increment > kMaxWindowSize)
+        {
+            streamError(header.streamId, kFlowControlError);
+            return;
+        }
+        it->second.sendWindow += increment;
+    }
+    flushData();
+}
+
+void Http2Connection::dispatch(Stream* stream)
+{
+    // 把首部转成 HttpRequest，伪首部必须在普通首部前面
+    std::string method, path, scheme, authority;
+    HttpRequest request;
+    bool regular = false;
+    bool malformed = false;
+    for (const auto& header : stream->headers)
+    {
+        const std::string& name = header.first;
+        const std::string& value = header.second;
+        if (!name.empty() && name[0] == ':')
+        {
+            if (regular)
+            {
+                malformed = true;
+            }
+            else if (name == ":method") method = value;
+            else if (name == ":path") path = value;
+            else if (name == ":scheme") scheme = value;
+            else if (name == ":authority") authority = value;
+            else malformed = true;
+            continue;
+        }
+        regular = true;
+        bool upper = std::any_of(name.begin(), name.end(), [](char c) { return c >= 'A' && c <= 'Z'; });
+        if (name.empty() || upper || isConnectionSpecific(name) || (name == "te" && value != "trailers"))
+        {
+            malformed = true;
+            continue;
+        }
+        request.AddHeader(canonicalHeaderName(name), value);
+    }
+    if (method.empty() || path.empty() || scheme.empty())
+    {
+        malformed = true;
+    }
+    std::string contentLength = request.GetHeader("Content-Length");
+    if (!contentLength.empty() && strtoul(contentLength.c_str(), nullptr, 10) != stream->body.size())
+    {
+        malformed = true;
+    }
+    if (malformed)
+    {
+        LOG_ERROR << "malformed request on stream " << stream->id;
+        streamError(stream->id, kProtocolError);
+        return;
+    }
+    if (!authority.empty())
+    {
+        request.AddHeader("Host", authority);
+    }
+    request.SetRequestLine(method, path, "2.0");
+    request.SetBody(stream->body);
+    stream->headers.clear();
+    std::string().swap(stream->body);
+
+    // 处理函数可能同步完成，complete 里会把流删掉，之后不能再使用 stream
+    process(stream->id, request);
+}
+
+// 请求体超过上限：丢掉已经收到的部分，回 413 之后用 RST_STREAM(NO_ERROR) 让客户端停止发送
+void Http2Connection::rejectBody(Stream* stream)
+{
+    LOG_ERROR << "request body too large on stream " << stream->id;
+    std::string().swap(stream->body);
+    std::shared_ptr<Http2Response> resp(new Http2Response);
+    resp->headers.emplace_back(":status", "413");
+    resp->headers.emplace_back("content-length", "0");
+    stream->response = resp;
+    sendHeaders(stream);
+    streamError(stream->id, kNoError);
+}
+
+void Http2Connection::process(uint32_t streamId, HttpRequest& request)
+{
+    HttpResponseWriterPtr writer(new HttpResponseWriter(conn_->shared_from_this(), 0, streamId));
+    writer->request() = std::move(request);
+    requestCallback_(writer);
+}
+
+void Http2Connection::complete(const TcpConnectionPtr& conn, uint32_t streamId,
+                               const std::shared_ptr<Http2Response>& resp)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    if (context == nullptr || context->http2() == nullptr || !conn->connected())
+    {
+        return;
+    }
+    context->http2()->sendResponse(streamId, resp);
+}
+
+void Http2Connection::sendResponse(uint32_t streamId, const std::shared_ptr<Http2Response>& resp)
+{
+    auto it = streams_.find(streamId);
+    if (state_ == kClosed || it == streams_.end())
+    {
+        return;     // 流已经被重置了
+    }
+    Stream& stream = it->second;
+    stream.response = resp;
+    sendHeaders(&stream);
+    if (resp->body.readableBytes() == 0)
+    {
+        closeStream(streamId);
+    }
+    else
+    {
+        flushData();
+    }
+    flushOutput();
+}
+
+void Http2Connection::sendHeaders(Stream* stream)
+{
+    std::string block;
+    encoder_.encode(stream->response->headers, &block);
+    // 首部块超过对端的最大帧长度时拆成 HEADERS + CONTINUATION，END_STREAM 标志放在 HEADERS 上
+    uint8_t endStream = stream->response->body.readableBytes() == 0 ? kFlagEndStream : 0;
+    size_t offset = 0;
+    bool first = true;
+    do
+    {
+        size_t n = std::min<size_t>(block.size() - offset, peerMaxFrameSize_);
+        uint8_t flags = (offset + n == block.size()) ? kFlagEndHeaders : 0;
+        if (first)
+        {
+            flags |= endStream;
+        }
+        appendFrameHeader(&output_, n, first ? kHeaders : kContinuation, flags, stream->id);
+        output_.append(block.data() + offset, n);
+        offset += n;
+        first = false;
+    } while (offset < block.size());
+    stream->headersSent = true;
+}
+
+static bool hasPendingData(const std::shared_ptr<Http2Response>& resp)
+{
+    return resp && resp->body.readableBytes() > 0;
+}
+
+bool Http2Connection::blockedByAncestor(const Stream& stream) const
+{
+    // 祖先流还有数据、并且没有被流量控制卡住时，先把资源让给祖先
+    uint32_t p = stream.parent;
+    for (size_t depth = 0; p != 0 && depth < streams_.size(); ++depth)
+    {
+        auto it = streams_.find(p);
+        if (it == streams_.end())
+        {
+            break;  // 父节点已经关闭，相当于挂在根上
+        }
+        const Stream& parent = it->second;
+        if (parent.headersSent && hasPendingData(parent.response) && parent.sendWindow > 0)
+        {
+            return true;
+        }
+        p = parent.parent;
+    }
+    return false;
+}
+
+Http2Connection::Stream* Http2Connection::nextStream()
+{
+    Stream* best = nullptr;
+    for (auto& kv : streams_)
+    {
+        Stream& stream = kv.second;
+        if (!stream.headersSent || !hasPendingData(stream.response) || stream.sendWindow <= 0)
+        {
+            continue;
+        }
+        if (blockedByAncestor(stream))
+        {
+            continue;
+        }
+        if (best == nullptr || stream.virtualTime < best->virtualTime)
+        {
+            best = &stream;
+        }
+    }
+    return best;
+}
+
+void Http2Connection::flushData()
+{
+    while (state_ != kClosed && sendWindow_ > 0)
+    {
+        Stream* stream = nextStream();
+        if (stream == nullptr)
+        {
+            break;
+        }
+        Buffer& body = stream->response->body;
+        size_t n = std::min<int64_t>(std::min<int64_t>(sendWindow_, stream->sendWindow),
+                                     std::min<int64_t>(body.readableBytes(), peerMaxFrameSize_));
+        bool end = (n == body.readableBytes());
+        appendFrameHeader(&output_, n, kData, end ? kFlagEndStream : 0, stream->id);
+        output_.append(body.peek(), n);
+        body.retrieve(n);
+        sendWindow_ -= n;
+        stream->sendWindow -= n;
+
+        // 权重范围是 1~256，发送同样多的数据，权重越小虚拟时间前进得越多
+        virtualClock_ = stream->virtualTime;
+        stream->virtualTime += n * 256 / stream->weight;
+        if (end)
+        {
+            closeStream(stream->id);
+        }
+    }
+}
+
+void Http2Connection::closeStream(uint32_t streamId)
+{
+    streams_.erase(streamId);
+    if (goawayReceived_ && streams_.empty() && state_ != kClosed)
+    {
+        state_ = kClosed;
+        flushOutput();
+        conn_->shutdown();
+    }
+}
+
+void Http2Connection::streamError(uint32_t streamId, ErrorCode code)
+{
+    LOG_DEBUG << "stream " << streamId << " error " << code;
+    appendRstStream(&output_, streamId, code);
+    closeStream(streamId);
+}
+
+void Http2Connection::connectionError(ErrorCode code, const char* reason)
+{
+    LOG_ERROR << "http2 connection error " << code << ": " << reason;
+    appendGoaway(&output_, lastStreamId_, code);
+    state_ = kClosed;
+    streams_.clear();
+    flushOutput();
+    conn_->shutdown();
+}
+
+void Http2Connection::flushOutput()
+{
+    if (output_.readableBytes() > 0)
+    {
+        conn_->send(&output_);
+    }
+}
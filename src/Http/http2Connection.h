@@ -0,0 +1,146 @@
+#pragma once
+
+#include <map>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "Buffer.h"
+#include "hpack.h"
+#include "http2Frame.h"
+
+class HttpRequest;
+class HttpResponseWriter;
+
+// 处理函数生成的 HTTP/2 响应，首部名字都是小写，第一个是 :status
+struct Http2Response
+{
+    HpackHeaderList headers;
+    Buffer body;
+};
+
+/**
+ * 服务端的 HTTP/2 连接(h2c)，保存在 HttpContext 中，只在连接所属的loop线程访问
+ * 1. 收到的帧按顺序处理，一个流的请求首部和请求体收完整之后转成 HttpRequest，
+ *    和 HTTP/1.1 一样交给路由分发，处理函数完全不用关心协议版本
+ * 2. 流量控制：接收方向请求体一到就消费掉，窗口用掉一半就补回去；
+ *    发送方向按连接和流两级窗口发送，窗口不够的响应体留在流里，等 WINDOW_UPDATE
+ * 3. 优先级：有数据要发的流里，祖先流也在等着发的先让祖先发，其余的按权重加权公平调度
+ * 4. 同时打开的流超过 kMaxConcurrentStreams 时直接 RST_STREAM(REFUSED_STREAM)
+ * 5. 请求体超过 maxBodySize 时回 413 并重置流，已经收到的部分立即释放，不再为这个流补窗口
+ */
+class Http2Connection : noncopyable
+{
+public:
+    using RequestCallback = std::function<void (const std::shared_ptr<HttpResponseWriter>&)>;
+
+    static const uint32_t kMaxConcurrentStreams = 100;
+    static const uint32_t kLocalWindowSize = 1 << 20;       // 本端接收窗口，比默认的 64K 大，上传不用频繁等 WINDOW_UPDATE
+    static const size_t kMaxHeaderBlockSize = 64 * 1024;    // 首部块(包括 CONTINUATION)的上限
+
+    // 连接对象拥有 HttpContext，HttpContext 拥有本对象，所以保存裸指针不会悬空
+    // maxBodySize 是每个流请求体的上限，和 HTTP/1.1 的 HttpRequest::SetMaxBodySize 一致
+    Http2Connection(const TcpConnectionPtr& conn, const RequestCallback& cb, size_t maxBodySize);
+    ~Http2Connection();
+
+    // buf 开头是不是客户端连接前言：1 是，0 数据还不够判断，-1 不是
+    static int matchPreface(const Buffer& buf);
+
+    // prior knowledge，客户端直接以连接前言开始
+    void start();
+    // HTTP/1.1 Upgrade: h2c，升级前的请求作为 stream 1 处理，settings 是 HTTP2-Settings 首部 base64url 解码前的值
+    bool startUpgrade(HttpRequest& request, const std::string& settings);
+
+    void onMessage(Buffer* buf);
+
+    // 第 streamId 个流的响应已经生成，必须在连接所属的loop线程中调用
+    static void complete(const TcpConnectionPtr& conn, uint32_t streamId,
+                         const std::shared_ptr<Http2Response>& resp);
+
+private:
+    struct Stream
+    {
+        uint32_t id;
+        bool remoteClosed;              // 请求已经收完（收到 END_STREAM）
+        int64_t sendWindow;             // 发送窗口，SETTINGS 调小初始窗口时可能变成负数
+        uint32_t recvWindow;
+        HpackHeaderList headers;
+        std::string body;
+        std::shared_ptr<Http2Response> response;    // 还没发完的响应
+        bool headersSent;
+
+        // 优先级
+        uint32_t parent;
+        uint32_t weight;
+        uint64_t virtualTime;           // 加权公平调度的虚拟时间，发得越多、权重越小，时间走得越快
+    };
+    using StreamMap = std::map<uint32_t, Stream>;
+
+    void handleFrame(const http2::FrameHeader& header, const char* payload);
+    void onData(const http2::FrameHeader& header, const char* payload);
+    void onHeaders(const http2::FrameHeader& header, const char* payload);
+    void onContinuation(const http2::FrameHeader& header, const char* payload);
+    void onPriority(const http2::FrameHeader& header, const char* payload);
+    void onRstStream(const http2::FrameHeader& header, const char* payload);
+    void onSettings(const http2::FrameHeader& header, const char* payload);
+    void onPing(const http2::FrameHeader& header, const char* payload);
+    void onGoaway(const http2::FrameHeader& header, const char* payload);
+    void onWindowUpdate(const http2::FrameHeader& header, const char* payload);
+
+    // 首部块收完整之后解码，然后根据流的状态创建流或者处理 trailer
+    void onHeaderBlock(uint32_t streamId);
+    http2::ErrorCode applySettings(const char* data, size_t len);
+    void setPriority(Stream* stream, uint32_t dependency, bool exclusive, uint32_t weight);
+    void dispatch(Stream* stream);
+    void rejectBody(Stream* stream);
+    void process(uint32_t streamId, HttpRequest& request);
+    void sendResponse(uint32_t streamId, const std::shared_ptr<Http2Response>& resp);
+    void sendHeaders(Stream* stream);
+    void flushData();
+    Stream* nextStream();
+    bool blockedByAncestor(const Stream& stream) const;
+    void closeStream(uint32_t streamId);
+
+    void streamError(uint32_t streamId, http2::ErrorCode code);
+    void connectionError(http2::ErrorCode code, const char* reason);
+    void flushOutput();
+
+    enum State
+    {
+        kWaitPreface,   // 等客户端连接前言
+        kWaitSettings,  // 连接前言之后的第一个帧必须是 SETTINGS
+        kOpen,
+        kClosed,        // 出错或者收到 GOAWAY 且所有流都结束了
+    };
+
+    TcpConnection* conn_;
+    RequestCallback requestCallback_;
+    size_t maxBodySize_;
+    State state_;
+    Buffer output_;                 // 一次处理中要发送的帧先攒起来，最后一起发
+
+    HpackDecoder decoder_;
+    HpackEncoder encoder_;
+
+    StreamMap streams_;
+    uint32_t lastStreamId_;         // 已经处理过的最大客户端流 id
+    bool goawayReceived_;
+    uint64_t virtualClock_;         // 最近一次被调度的流的虚拟时间，新流从这里开始
+
+    // 正在接收的首部块，HEADERS 后面跟着 CONTINUATION 时使用
+    uint32_t continuationStream_;
+    std::string headerBlock_;
+    uint8_t headerFlags_;
+    uint32_t headerDependency_;
+    bool headerExclusive_;
+    uint32_t headerWeight_;
+
+    // 对端的设置
+    uint32_t peerInitialWindowSize_;
+    uint32_t peerMaxFrameSize_;
+
+    int64_t sendWindow_;            // 连接级发送窗口
+    uint32_t recvWindow_;           // 连接级接收窗口
+};
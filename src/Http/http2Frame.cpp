@@ -0,0 +1,101 @@
+#include "http2Frame.h"
+#include "Buffer.h"
+
+namespace http2
+{
+
+const char kClientPreface[] = "PRI * HTTP/2.0\r\n\r\nSM\r\n\r\n";
+
+uint32_t readUint32(const char* p)
+{
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (static_cast<uint32_t>(u[0]) << 24) | (static_cast<uint32_t>(u[1]) << 16)
+           | (static_cast<uint32_t>(u[2]) << 8) | u[3];
+}
+
+uint32_t readUint24(const char* p)
+{
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return (static_cast<uint32_t>(u[0]) << 16) | (static_cast<uint32_t>(u[1]) << 8) | u[2];
+}
+
+uint16_t readUint16(const char* p)
+{
+    const uint8_t* u = reinterpret_cast<const uint8_t*>(p);
+    return static_cast<uint16_t>((u[0] << 8) | u[1]);
+}
+
+static void writeUint32(char* p, uint32_t v)
+{
+    p[0] = static_cast<char>(v >> 24);
+    p[1] = static_cast<char>(v >> 16);
+    p[2] = static_cast<char>(v >> 8);
+    p[3] = static_cast<char>(v);
+}
+
+void parseFrameHeader(const char* data, FrameHeader* header)
+{
+    header->length = readUint24(data);
+    header->type = static_cast<uint8_t>(data[3]);
+    header->flags = static_cast<uint8_t>(data[4]);
+    header->streamId = readUint32(data + 5) & 0x7fffffff;  // 最高位保留，接收时忽略
+}
+
+void appendFrameHeader(Buffer* buf, uint32_t length, uint8_t type, uint8_t flags, uint32_t streamId)
+{
+    char header[kFrameHeaderSize];
+    header[0] = static_cast<char>(length >> 16);
+    header[1] = static_cast<char>(length >> 8);
+    header[2] = static_cast<char>(length);
+    header[3] = static_cast<char>(type);
+    header[4] = static_cast<char>(flags);
+    writeUint32(header + 5, streamId & 0x7fffffff);
+    buf->append(header, sizeof header);
+}
+
+void appendSetting(Buffer* buf, uint16_t id, uint32_t value)
+{
+    char setting[6];
+    setting[0] = static_cast<char>(id >> 8);
+    setting[1] = static_cast<char>(id);
+    writeUint32(setting + 2, value);
+    buf->append(setting, sizeof setting);
+}
+
+void appendSettingsAck(Buffer* buf)
+{
+    appendFrameHeader(buf, 0, kSettings, kFlagAck, 0);
+}
+
+void appendWindowUpdate(Buffer* buf, uint32_t streamId, uint32_t increment)
+{
+    char payload[4];
+    writeUint32(payload, increment & 0x7fffffff);
+    appendFrameHeader(buf, sizeof payload, kWindowUpdate, 0, streamId);
+    buf->append(payload, sizeof payload);
+}
+
+void appendRstStream(Buffer* buf, uint32_t streamId, uint32_t errorCode)
+{
+    char payload[4];
+    writeUint32(payload, errorCode);
+    appendFrameHeader(buf, sizeof payload, kRstStream, 0, streamId);
+    buf->append(payload, sizeof payload);
+}
+
+void appendGoaway(Buffer* buf, uint32_t lastStreamId, uint32_t errorCode)
+{
+    char payload[8];
+    writeUint32(payload, lastStreamId & 0x7fffffff);
+    writeUint32(payload + 4, errorCode);
+    appendFrameHeader(buf, sizeof payload, kGoaway, 0, 0);
+    buf->append(payload, sizeof payload);
+}
+
+void appendPingAck(Buffer* buf, const char* opaque)
+{
+    appendFrameHeader(buf, 8, kPing, kFlagAck, 0);
+    buf->append(opaque, 8);
+}
+
+} // namespace http2
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+class Buffer;
+
+/**
+ * HTTP/2 (RFC 7540) 帧的编解码
+ * 每个帧都是 9 字节的帧头 + 负载：
+ * +-----------------------------------------------+
+ * |                 Length (24)                   |
+ * +---------------+---------------+---------------+
+ * |   Type (8)    |   Flags (8)   |
+ * +-+-------------+---------------+-------------------------------+
+ * |R|                 Stream Identifier (31)                      |
+ * +=+=============================================================+
+ * |                   Frame Payload (0...)                      ...
+ * +---------------------------------------------------------------+
+ */
+namespace http2
+{
+    enum FrameType
+    {
+        kData = 0x0,
+        kHeaders = 0x1,
+        kPriority = 0x2,
+        kRstStream = 0x3,
+        kSettings = 0x4,
+        kPushPromise = 0x5,
+        kPing = 0x6,
+        kGoaway = 0x7,
+        kWindowUpdate = 0x8,
+        kContinuation = 0x9,
+    };
+
+    enum FrameFlag
+    {
+        kFlagEndStream = 0x1,
+        kFlagAck = 0x1,
+        kFlagEndHeaders = 0x4,
+        kFlagPadded = 0x8,
+        kFlagPriority = 0x20,
+    };
+
+    enum ErrorCode
+    {
+        kNoError = 0x0,
+        kProtocolError = 0x1,
+        kInternalError = 0x2,
+        kFlowControlError = 0x3,
+        kSettingsTimeout = 0x4,
+        kStreamClosed = 0x5,
+        kFrameSizeError = 0x6,
+        kRefusedStream = 0x7,
+        kCancel = 0x8,
+        kCompressionError = 0x9,
+        kConnectError = 0xa,
+        kEnhanceYourCalm = 0xb,
+        kInadequateSecurity = 0xc,
+        kHttp11Required = 0xd,
+    };
+
+    enum SettingsId
+    {
+        kSettingsHeaderTableSize = 0x1,
+        kSettingsEnablePush = 0x2,
+        kSettingsMaxConcurrentStreams = 0x3,
+        kSettingsInitialWindowSize = 0x4,
+        kSettingsMaxFrameSize = 0x5,
+        kSettingsMaxHeaderListSize = 0x6,
+    };
+
+    const size_t kFrameHeaderSize = 9;
+    const uint32_t kDefaultWindowSize = 65535;
+    const uint32_t kMaxWindowSize = 0x7fffffff;
+    const uint32_t kDefaultMaxFrameSize = 16384;
+    const uint32_t kMaxFrameSizeLimit = (1 << 24) - 1;
+    const uint32_t kDefaultWeight = 16;
+
+    // 客户端连接前言，prior knowledge 和 Upgrade 两种方式都要先收到它
+    extern const char kClientPreface[];
+    const size_t kClientPrefaceLen = 24;
+
+    struct FrameHeader
+    {
+        uint32_t length;
+        uint8_t type;
+        uint8_t flags;
+        uint32_t streamId;
+    };
+
+    uint32_t readUint32(const char* p);
+    uint32_t readUint24(const char* p);
+    uint16_t readUint16(const char* p);
+
+    // data 至少要有 kFrameHeaderSize 字节
+    void parseFrameHeader(const char* data, FrameHeader* header);
+    void appendFrameHeader(Buffer* buf, uint32_t length, uint8_t type, uint8_t flags, uint32_t streamId);
+
+    // 只包含帧头和固定格式负载的几种控制帧
+    void appendSetting(Buffer* buf, uint16_t id, uint32_t value);   // SETTINGS 负载中的一项
+    void appendSettingsAck(Buffer* buf);
+    void appendWindowUpdate(Buffer* buf, uint32_t streamId, uint32_t increment);
+    void appendRstStream(Buffer* buf, uint32_t streamId, uint32_t errorCode);
+    void appendGoaway(Buffer* buf, uint32_t lastStreamId, uint32_t errorCode);
+    void appendPingAck(Buffer* buf, const char* opaque);
+}
@@ -0,0 +1,137 @@
+#include "httpContext.h"
+#include "TcpConnection.h"
+
+HttpContext::~HttpContext() = default;
+
+bool HttpContext::sendResponse(const TcpConnectionPtr& conn, Buffer* buf, bool close, const ResponseRecord& record)
+{
+    if (record.route && logLevel() <= Logger::DEBUG)
+    {
+        // 访问日志，耗时算到交给连接为止
+        int64_t costUs = Timestamp::now().microSecondsSinceEpoch() - record.receiveTime.microSecondsSinceEpoch();
+        LOG_DEBUG << "response" << LogField("conn", conn->name()) << LogField("status", record.code)
+                  << LogField("bytes", buf->readableBytes()) << LogField("latency_ms", FixedPoint(costUs, 3));
+    }
+    conn->send(buf);
+    if (record.route)
+    {
+        if (conn->outputBuffer()->readableBytes() == 0)
+        {
+            record.route->observe(record.code, Timestamp::now().microSecondsSinceEpoch() - record.receiveTime.microSecondsSinceEpoch());
+        }
+        else
+        {
+            unflushed_.push_back(record);
+        }
+    }
+    if (close)
+    {
+        // shutdown 会等输出缓冲区的数据发完再关闭写端
+        conn->shutdown();
+        return false;
+    }
+    return true;
+}
+
+void HttpContext::complete(const TcpConnectionPtr& conn, uint64_t seq,
+                           const std::shared_ptr<Buffer>& buf, bool close, const ResponseRecord& record)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    if (context == nullptr || !conn->connected())
+    {
+        return;
+    }
+    context->deliver(conn, seq, buf.get(), true, close, record);
+}
+
+size_t HttpContext::stream(const TcpConnectionPtr& conn, uint64_t seq, Buffer* data)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    if (context == nullptr || !conn->connected())
+    {
+        return 0;
+    }
+    ResponseRecord none = { nullptr, 0, Timestamp() };
+    return context->deliver(conn, seq, data, false, false, none);
+}
+
+size_t HttpContext::deliver(const TcpConnectionPtr& conn, uint64_t seq, Buffer* data, bool done, bool close,
+                            const ResponseRecord& record)
+{
+    if (seq != sendSeq_)
+    {
+        // 前面的响应还没发完，先攒着
+        Pending& pending = pending_[seq];
+        if (!pending.buf)
+        {
+            pending.buf = std::make_shared<Buffer>();
+            pending.buf->swap(*data);
+        }
+        else
+        {
+            pending.buf->append(data->peek(), data->readableBytes());
+            data->retrieveAll();
+        }
+        pending.done = done;
+        pending.close = close;
+        pending.record = record;
+        return conn->outputBuffer()->readableBytes() + pending.buf->readableBytes();
+    }
+    if (!done)
+    {
+        conn->send(data);
+        return conn->outputBuffer()->readableBytes();
+    }
+
+    ++sendSeq_;
+    if (!sendResponse(conn, data, close, record))
+    {
+        pending_.clear();
+        return 0;
+    }
+    // 后面已经完成的响应接着发；遇到流式响应就把已经生成的部分发掉，剩下的由它自己直接发
+    auto it = pending_.begin();
+    while (it != pending_.end() && it->first == sendSeq_)
+    {
+        Pending& pending = it->second;
+        if (!pending.done)
+        {
+            conn->send(pending.buf.get());
+            pending_.erase(it);
+            break;
+        }
+        ++sendSeq_;
+        if (!sendResponse(conn, pending.buf.get(), pending.close, pending.record))
+        {
+            pending_.clear();
+            return 0;
+        }
+        it = pending_.erase(it);
+    }
+    return conn->outputBuffer()->readableBytes();
+}
+
+void HttpContext::writeComplete(const TcpConnectionPtr& conn)
+{
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+    // 写完回调是排队执行的，这期间可能又发了新的响应，缓冲区空了才算全部写完
+    if (context == nullptr || conn->outputBuffer()->readableBytes() > 0)
+    {
+        return;
+    }
+    int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    for (const ResponseRecord& record : context->unflushed_)
+    {
+        record.route->observe(record.code, now - record.receiveTime.microSecondsSinceEpoch());
+    }
+    context->unflushed_.clear();
+    if (!context->drained_.empty())
+    {
+        std::vector<std::function<void ()>> callbacks;
+        callbacks.swap(context->drained_);
+        for (const auto& cb : callbacks)
+        {
+            cb();
+        }
+    }
+}
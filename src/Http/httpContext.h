@@ -0,0 +1,97 @@
+#pragma once
+
+#include <map>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "httpRequest.h"
+#include "http2Connection.h"
+#include "webSocket.h"
+#include "httpResponseWriter.h"
+#include "Callback.h"
+
+/**
+ * 每个http连接的上下文，保存在 TcpConnection 的 context_ 中，只在连接所属的loop线程访问
+ * 1. 保存还没有解析完的请求，一个请求可能分好几次才能收完整
+ * 2. 给每个请求分配序号，响应可能异步完成、完成的顺序也不确定，
+ *    这里按照序号缓存并依次发送，保证流水线(pipeline)上的响应顺序和请求顺序一致
+ * 3. 连接切换到 HTTP/2 之后，后面的数据都交给 Http2Connection 处理，升级成 WebSocket 之后交给 WebSocketConnection
+ */
+class HttpContext
+{
+public:
+    HttpContext()
+        : sendSeq_(0),
+          nextSeq_(0),
+          closing_(false)
+    {
+    }
+    ~HttpContext();
+
+    HttpRequest& request() { return request_; }
+    uint64_t nextSeq() { return nextSeq_++; }
+
+    // 连接上还没有收到过完整的请求，只有这时才可能收到 HTTP/2 的连接前言
+    bool fresh() const { return nextSeq_ == 0; }
+    // 前面的请求都已经响应完了，只有这时才能升级协议
+    bool idle() const { return sendSeq_ == nextSeq_; }
+
+    Http2Connection* http2() const { return http2_.get(); }
+    void setHttp2(Http2Connection* http2) { http2_.reset(http2); }
+
+    // 正在流式接收请求体的请求，响应对象在首部收完时就已经创建好了
+    const HttpResponseWriterPtr& upload() const { return upload_; }
+    void setUpload(const HttpResponseWriterPtr& writer) { upload_ = writer; }
+
+    const WebSocketConnectionPtr& webSocket() const { return webSocket_; }
+    void setWebSocket(const WebSocketConnectionPtr& ws) { webSocket_ = ws; }
+
+    // 收到了非长连接的请求或者解析出错，之后的请求就不再处理
+    bool closing() const { return closing_; }
+    void setClosing() { closing_ = true; }
+
+    // 第seq个请求的响应已经生成，必须在conn所属的loop线程中调用
+    static void complete(const TcpConnectionPtr& conn, uint64_t seq,
+                         const std::shared_ptr<Buffer>& buf, bool close, const ResponseRecord& record);
+    /**
+     * 第seq个请求的响应的一段数据，之后还有，最后用 complete 结束。必须在conn所属的loop线程中调用
+     * 轮到它时直接发送，否则先攒着；返回连接上还没写进 socket 的字节数(包括攒着的)，连接已经断开时返回 0
+     */
+    static size_t stream(const TcpConnectionPtr& conn, uint64_t seq, Buffer* data);
+    // 输出缓冲区下一次写空时调用 cb，流式响应用来做流量控制
+    void onDrained(const std::function<void ()>& cb) { drained_.push_back(cb); }
+    // 输出缓冲区写空了，之前发出的响应都已经写进 socket，记录它们的延迟
+    static void writeComplete(const TcpConnectionPtr& conn);
+
+    // 当前请求第一个字节到达的时间
+    Timestamp receiveTime() const { return receiveTime_; }
+    void setReceiveTime(Timestamp receiveTime) { receiveTime_ = receiveTime; }
+
+private:
+    struct Pending
+    {
+        std::shared_ptr<Buffer> buf;
+        bool done;      // 响应已经结束，否则是流式响应已经生成的部分
+        bool close;
+        ResponseRecord record;
+    };
+
+    // 发送一个响应，返回false表示连接已经要关闭了
+    bool sendResponse(const TcpConnectionPtr& conn, Buffer* buf, bool close, const ResponseRecord& record);
+    // 第seq个响应的一段数据，done 表示响应结束
+    size_t deliver(const TcpConnectionPtr& conn, uint64_t seq, Buffer* data, bool done, bool close,
+                   const ResponseRecord& record);
+
+    HttpRequest request_;   // 正在解析的请求
+    uint64_t sendSeq_;      // 下一个要发送的响应序号
+    uint64_t nextSeq_;      // 下一个请求的序号
+    bool closing_;
+    std::map<uint64_t, Pending> pending_;   // 前面还有响应没完成的，先放在这里
+    std::vector<std::function<void ()>> drained_;
+    std::vector<ResponseRecord> unflushed_; // 已经发出但是还在输出缓冲区里的响应
+    Timestamp receiveTime_;
+    std::unique_ptr<Http2Connection> http2_;
+    HttpResponseWriterPtr upload_;
+    WebSocketConnectionPtr webSocket_;
+};
@@ -0,0 +1,37 @@
+#include "httpMetrics.h"
+
+RouteMetrics::RouteMetrics(const std::string& method, const std::string& route)
+    : labels_("method=\"" + method + "\",route=\"" + route + "\""),
+      latency_(MetricsRegistry::instance().histogram("myweb_http_request_duration_seconds",
+                                                     "Time from receiving a request to writing out its response",
+                                                     labels_))
+{
+    for (auto& counter : status_)
+    {
+        counter.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+Counter* RouteMetrics::statusCounter(int code)
+{
+    if (code < kMinStatus || code > kMaxStatus)
+    {
+        code = 500;
+    }
+    std::atomic<Counter*>& slot = status_[code - kMinStatus];
+    Counter* counter = slot.load(std::memory_order_acquire);
+    if (counter == nullptr)
+    {
+        // 同名同标签的计数器只有一个，并发创建也拿到同一个
+        counter = MetricsRegistry::instance().counter("myweb_http_requests_total", "HTTP requests by route and status",
+                                                      labels_ + ",status=\"" + std::to_string(code) + "\"");
+        slot.store(counter, std::memory_order_release);
+    }
+    return counter;
+}
+
+void RouteMetrics::observe(int code, int64_t latency)
+{
+    statusCounter(code)->inc();
+    latency_->record(latency > 0 ? latency : 0);
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <atomic>
+#include <string>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+#include "Metrics.h"
+
+/**
+ * 一个路由的统计：按状态码分开的请求数，以及从收到请求到响应写进 socket 的延迟
+ * 每个路由注册时创建一个，处理函数拿到的 writer 上记着它，热路径上不用再按名字查找
+ */
+class RouteMetrics : noncopyable
+{
+public:
+    RouteMetrics(const std::string& method, const std::string& route);
+
+    // latency 是微秒
+    void observe(int code, int64_t latency);
+
+private:
+    Counter* statusCounter(int code);
+
+    static const int kMinStatus = 100;
+    static const int kMaxStatus = 599;
+
+    std::string labels_;
+    Histogram* latency_;
+    std::atomic<Counter*> status_[kMaxStatus - kMinStatus + 1];    // 第一次出现某个状态码时才创建
+};
+
+// 已经发出但是可能还在输出缓冲区里的响应，写完之后才记录延迟
+struct ResponseRecord
+{
+    RouteMetrics* route;
+    int code;
+    Timestamp receiveTime;
+};
@@ -0,0 +1,1122 @@
+#include "httpProxy.h"
+#include "Connector.h"
+#include "EventLoop.h"
+#include "Logging.h"
+#include "Metrics.h"
+#include "Socket.h"
+#include "TcpClient.h"
+#include "TcpConnection.h"
+
+#include <algorithm>
+#include <string.h>
+#include <strings.h>
+#include <stdlib.h>
+
+namespace
+{
+
+// 每个代理一个不会重复的 id，线程缓存按它区分，代理销毁后地址被复用也不会认错
+std::atomic<uint64_t> g_nextProxyId(1);
+
+uint32_t fnv1a(const void* data, size_t len)
+{
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < len; ++i)
+    {
+        hash ^= p[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// 逐跳首部只对一段连接有效，不能转发；长度和编码由代理按自己的方式重新设置
+bool isHopByHop(const std::string& name)
+{
+    static const char* kHeaders[] = {
+        "Connection", "Keep-Alive", "Proxy-Connection", "Proxy-Authorization", "TE", "Trailer",
+        "Transfer-Encoding", "Upgrade", "Content-Length", "Expect",
+    };
+    for (const char* header : kHeaders)
+    {
+        if (strcasecmp(name.c_str(), header) == 0)
+        {
+            return true;
+        }
+    }
+    return !name.empty() && name[0] == ':';
+}
+
+void onClientConnClose(const TcpConnectionPtr& conn)
+{
+    conn->getLoop()->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+const int kVirtualNodes = 100;
+
+} // namespace
+
+struct HttpProxy::Upstream
+{
+    explicit Upstream(const InetAddress& address)
+        : addr(address),
+          hostPort(address.toIpPort()),
+          active(0),
+          healthy(true),
+          fails(0),
+          checking(false)
+    {
+        std::string labels = "upstream=\"" + hostPort + "\"";
+        MetricsRegistry& registry = MetricsRegistry::instance();
+        requests = registry.counter("myweb_proxy_requests_total", "Requests forwarded to each upstream", labels);
+        errors = registry.counter("myweb_proxy_errors_total", "Forwarded requests that failed (502/504 or truncated)", labels);
+        up = registry.gauge("myweb_proxy_upstream_up", "Whether the upstream is considered healthy", labels);
+        up->inc();
+    }
+
+    InetAddress addr;
+    std::string hostPort;
+    std::atomic<int> active;        // 正在转发的请求数
+    std::atomic<bool> healthy;
+    int fails;                      // 健康检查连续失败的次数，只在健康检查的 loop 里访问
+    bool checking;
+    Counter* requests;
+    Counter* errors;
+    Gauge* up;
+};
+
+// 一个 loop 上的空闲连接，只在这个 loop 的线程里访问
+struct HttpProxy::LoopPool
+{
+    std::vector<std::vector<TcpConnectionPtr>> idle;    // 下标是上游
+};
+
+// 上游连接的上下文，正在转发时持有 Exchange，转发结束时释放
+struct HttpProxy::ConnState
+{
+    explicit ConnState(int index) : upstream(index) {}
+    int upstream;
+    std::shared_ptr<Exchange> exchange;
+};
+
+// 一次健康检查
+struct HttpProxy::Probe
+{
+    int upstream;
+    bool done;
+    ConnectorPtr connector;
+    TcpConnectionPtr conn;
+};
+
+/**
+ * 一次转发，只在客户端连接所属的 loop 里访问
+ * 连接上游期间由 Connector 的回调持有，发出请求之后由上游连接的 ConnState 持有，结束时两边都断开
+ */
+class HttpProxy::Exchange : public std::enable_shared_from_this<Exchange>
+{
+public:
+    Exchange(HttpProxy* proxy, const HttpResponseWriterPtr& writer, int upstream);
+
+    void start();
+    void attach(const TcpConnectionPtr& conn);
+    void onMessage(Buffer* buf);
+    void onUpstreamClosed();
+
+private:
+    enum State
+    {
+        kStatusLine,
+        kHeaders,
+        kBody,          // 按 Content-Length
+        kChunkSize,
+        kChunkData,
+        kChunkCrlf,
+        kTrailers,
+        kUntilClose,    // 没有长度，读到上游关闭为止
+        kDone,
+    };
+
+    void buildRequest();
+    void connect();
+    void onConnectFailed();
+    void onTimeout();
+    void checkClient();
+    bool parse(Buffer* buf);
+    bool parseStatusLine(const std::string& line);
+    bool onHeaders();
+    void onBody(const char* data, size_t len);
+    void onEnd();
+    void flush();
+    void resume();
+    void fail(int code);
+    void abort();
+    void releaseUpstream(bool reuse);
+    bool headersSent() const { return stream_ && state_ > kHeaders; }
+
+    HttpProxy* proxy_;
+    HttpResponseWriterPtr writer_;
+    EventLoop* loop_;
+    int upstream_;
+    Upstream* up_;
+    TcpConnectionPtr conn_;
+    ConnectorPtr connector_;
+    std::string request_;
+    bool reused_;           // 连接是从池里拿的，上游可能刚好把它关掉了，这时换一个新连接重试一次
+    bool received_;         // 收到过上游的数据
+    bool done_;
+    bool stream_;           // HTTP/1.x 的客户端边收边发
+    bool headRequest_;
+    bool paused_;
+    bool active_;           // 计入了上游的 active
+
+    State state_;
+    int code_;
+    std::string reason_;
+    bool upstreamKeepAlive_;
+    std::vector<std::pair<std::string, std::string>> headers_;
+    size_t remaining_;
+    bool chunkToClient_;    // 上游没有给长度，用 chunked 发给客户端
+    Buffer out_;            // 还没交给客户端连接的数据
+    std::string body_;      // HTTP/2 的客户端，收完整再返回
+};
+
+HttpProxy::Exchange::Exchange(HttpProxy* proxy, const HttpResponseWriterPtr& writer, int upstream)
+    : proxy_(proxy),
+      writer_(writer),
+      loop_(writer->getLoop()),
+      upstream_(upstream),
+      up_(proxy->upstreams_[upstream].get()),
+      reused_(false),
+      received_(false),
+      done_(false),
+      stream_(writer->streamId() == 0),
+      headRequest_(writer->request().method() == "HEAD"),
+      paused_(false),
+      active_(false),
+      state_(kStatusLine),
+      code_(0),
+      upstreamKeepAlive_(true),
+      remaining_(0),
+      chunkToClient_(false)
+{
+}
+
+void HttpProxy::Exchange::buildRequest()
+{
+    const HttpRequest& req = writer_->request();
+    request_ = req.method() + " " + req.path();
+    if (!req.query().empty())
+    {
+        request_ += "?" + req.query();
+    }
+    request_ += " HTTP/1.1\r\n";
+    bool hasHost = false;
+    std::string forwardedFor;
+    for (const auto& header : req.headers())
+    {
+        if (isHopByHop(header.first))
+        {
+            continue;
+        }
+        if (strcasecmp(header.first.c_str(), "X-Forwarded-For") == 0)
+        {
+            forwardedFor = header.second + ", ";
+            continue;
+        }
+        hasHost = hasHost || strcasecmp(header.first.c_str(), "Host") == 0;
+        request_ += header.first + ": " + header.second + "\r\n";
+    }
+    if (!hasHost)
+    {
+        request_ += "Host: " + up_->hostPort + "\r\n";
+    }
+    TcpConnectionPtr client = writer_->connection();
+    if (client)
+    {
+        request_ += "X-Forwarded-For: " + forwardedFor + client->peerAddress().toIp() + "\r\n";
+    }
+    if (!req.body().empty() || req.method() == "POST" || req.method() == "PUT" || req.method() == "PATCH")
+    {
+        request_ += "Content-Length: " + std::to_string(req.body().size()) + "\r\n";
+    }
+    request_ += "\r\n";
+    request_ += req.body();
+}
+
+void HttpProxy::Exchange::start()
+{
+    active_ = true;
+    up_->active.fetch_add(1, std::memory_order_relaxed);
+    up_->requests->inc();
+    buildRequest();
+
+    std::weak_ptr<Exchange> weak(shared_from_this());
+    loop_->runAfter(proxy_->timeout_, [weak]() {
+        std::shared_ptr<Exchange> self = weak.lock();
+        if (self)
+        {
+            self->onTimeout();
+        }
+    });
+
+    TcpConnectionPtr conn = proxy_->acquire(loop_, upstream_);
+    if (conn)
+    {
+        reused_ = true;
+        attach(conn);
+    }
+    else
+    {
+        connect();
+    }
+}
+
+void HttpProxy::Exchange::connect()
+{
+    std::shared_ptr<Exchange> self(shared_from_this());
+    connector_.reset(new Connector(loop_, up_->addr));
+    connector_->setNewConnectionCallback([self](int sockfd) {
+        self->connector_.reset();
+        TcpConnectionPtr conn = self->proxy_->newConnection(self->loop_, self->upstream_, sockfd);
+        if (self->done_)
+        {
+            self->proxy_->release(conn, self->upstream_);   // 已经超时了，连接留给后面的请求用
+            return;
+        }
+        self->attach(conn);
+    });
+    connector_->setErrorCallback([self]() {
+        self->connector_.reset();
+        self->onConnectFailed();
+    });
+    connector_->start();
+}
+
+void HttpProxy::Exchange::attach(const TcpConnectionPtr& conn)
+{
+    conn_ = conn;
+    static_cast<ConnState*>(conn->getContext().get())->exchange = shared_from_this();
+    conn->send(request_);
+}
+
+void HttpProxy::Exchange::onConnectFailed()
+{
+    if (done_)
+    {
+        return;
+    }
+    LOG_WARN << "proxy: connect to " << up_->hostPort << " failed";
+    proxy_->markDown(upstream_);
+    fail(502);
+}
+
+void HttpProxy::Exchange::onTimeout()
+{
+    // 只限制等响应首部的时间，响应体可能很大，传多久都可以
+    if (done_ || state_ > kHeaders)
+    {
+        return;
+    }
+    LOG_WARN << "proxy: " << up_->hostPort << " timed out";
+    fail(504);
+}
+
+void HttpProxy::Exchange::onUpstreamClosed()
+{
+    conn_.reset();
+    if (done_)
+    {
+        return;
+    }
+    if (state_ == kUntilClose)
+    {
+        onEnd();
+    }
+    else if (reused_ && !received_)
+    {
+        reused_ = false;
+        connect();
+    }
+    else if (headersSent())
+    {
+        abort();
+    }
+    else
+    {
+        fail(502);
+    }
+}
+
+void HttpProxy::Exchange::onMessage(Buffer* buf)
+{
+    if (done_)
+    {
+        buf->retrieveAll();
+        return;
+    }
+    received_ = true;
+    if (!parse(buf))
+    {
+        LOG_WARN << "proxy: bad response from " << up_->hostPort;
+        if (headersSent())
+        {
+            abort();
+        }
+        else
+        {
+            fail(502);
+        }
+        return;
+    }
+    if (!done_)
+    {
+        flush();
+    }
+}
+
+bool HttpProxy::Exchange::parse(Buffer* buf)
+{
+    while (state_ != kDone)
+    {
+        if (state_ == kBody || state_ == kChunkData)
+        {
+            size_t n = std::min(remaining_, buf->readableBytes());
+            if (n == 0)
+            {
+                return true;
+            }
+            onBody(buf->peek(), n);
+            buf->retrieve(n);
+            remaining_ -= n;
+            if (remaining_ > 0)
+            {
+                return true;
+            }
+            if (state_ == kBody)
+            {
+                onEnd();
+            }
+            else
+            {
+                state_ = kChunkCrlf;
+            }
+            continue;
+        }
+        if (state_ == kUntilClose)
+        {
+            onBody(buf->peek(), buf->readableBytes());
+            buf->retrieveAll();
+            return true;
+        }
+
+        const char* crlf = buf->findCRLF();
+        if (crlf == nullptr)
+        {
+            return buf->readableBytes() <= kMaxLineSize;
+        }
+        std::string line(buf->peek(), crlf);
+        buf->retrieveUntil(crlf + 2);
+        switch (state_)
+        {
+        case kStatusLine:
+            if (!parseStatusLine(line))
+            {
+                return false;
+            }
+            state_ = kHeaders;
+            break;
+        case kHeaders:
+            if (line.empty())
+            {
+                if (!onHeaders())
+                {
+                    return false;
+                }
+            }
+            else
+            {
+                size_t colon = line.find(':');
+                if (colon == std::string::npos || colon == 0)
+                {
+                    return false;
+                }
+                size_t value = line.find_first_not_of(" \t", colon + 1);
+                headers_.emplace_back(line.substr(0, colon),
+                                      value == std::string::npos ? std::string() : line.substr(value));
+            }
+            break;
+        case kChunkSize:
+        {
+            char* end = nullptr;
+            remaining_ = strtoul(line.c_str(), &end, 16);
+            if (end == line.c_str())
+            {
+                return false;
+            }
+            state_ = remaining_ == 0 ? kTrailers : kChunkData;
+            break;
+        }
+        case kChunkCrlf:
+            if (!line.empty())
+            {
+                return false;
+            }
+            state_ = kChunkSize;
+            break;
+        case kTrailers:
+            if (line.empty())
+            {
+                onEnd();
+            }
+            break;
+        default:
+            break;
+        }
+    }
+    // 响应结束之后上游不应该再发数据
+    if (buf->readableBytes() > 0)
+    {
+        upstreamKeepAlive_ = false;
+        buf->retrieveAll();
+    }
+    return true;
+}
+
+bool HttpProxy::Exchange::parseStatusLine(const std::string& line)
+{
+    // HTTP/1.1 200 OK
+    if (line.compare(0, 5, "HTTP/") != 0 || line.size() < 12)
+    {
+        return false;
+    }
+    code_ = atoi(line.c_str() + 9);
+    if (code_ < 100 || code_ > 599)
+    {
+        return false;
+    }
+    reason_ = line.size() > 13 ? line.substr(13) : std::string();
+    upstreamKeepAlive_ = line.compare(0, 8, "HTTP/1.1") == 0;
+    return true;
+}
+
+bool HttpProxy::Exchange::onHeaders()
+{
+    // 100 Continue 之类的临时响应跳过
+    if (code_ < 200)
+    {
+        headers_.clear();
+        state_ = kStatusLine;
+        return true;
+    }
+
+    bool chunked = false;
+    bool hasLength = false;
+    std::string contentType;
+    std::string contentLength;
+    for (const auto& header : headers_)
+    {
+        const char* name = header.first.c_str();
+        if (strcasecmp(name, "Transfer-Encoding") == 0)
+        {
+            chunked = strcasestr(header.second.c_str(), "chunked") != nullptr;
+        }
+        else if (strcasecmp(name, "Content-Length") == 0)
+        {
+            char* end = nullptr;
+            remaining_ = strtoull(header.second.c_str(), &end, 10);
+            if (end == header.second.c_str())
+            {
+                return false;
+            }
+            hasLength = true;
+            contentLength = header.second;
+        }
+        else if (strcasecmp(name, "Connection") == 0)
+        {
+            if (strcasestr(header.second.c_str(), "close"))
+            {
+                upstreamKeepAlive_ = false;
+            }
+            else if (strcasestr(header.second.c_str(), "keep-alive"))
+            {
+                upstreamKeepAlive_ = true;
+            }
+        }
+        else if (strcasecmp(name, "Content-Type") == 0)
+        {
+            contentType = header.second;
+        }
+    }
+
+    bool noBody = headRequest_ || code_ == 204 || code_ == 304;
+    State next;
+    if (noBody)
+    {
+        next = kDone;
+    }
+    else if (chunked)
+    {
+        next = kChunkSize;
+    }
+    else if (hasLength)
+    {
+        next = remaining_ > 0 ? kBody : kDone;
+    }
+    else
+    {
+        next = kUntilClose;
+        upstreamKeepAlive_ = false;
+    }
+
+    HttpRequest& req = writer_->request();
+    HttpResponse* resp = writer_->response();
+    resp->SetCode(code_);
+    if (!stream_)
+    {
+        // HTTP/2 的响应首部由 HttpResponse 生成
+        for (const auto& header : headers_)
+        {
+            if (!isHopByHop(header.first) && strcasecmp(header.first.c_str(), "Content-Type") != 0)
+            {
+                resp->AddHeader(header.first, header.second);
+            }
+        }
+        if (!contentType.empty())
+        {
+            resp->SetContentType(contentType);
+        }
+    }
+    else
+    {
+        bool keepAlive = req.IsKeepAlive();
+        std::string head = "HTTP/1.1 " + std::to_string(code_) + " " + reason_ + "\r\n";
+        for (const auto& header : headers_)
+        {
+            if (!isHopByHop(header.first))
+            {
+                head += header.first + ": " + header.second + "\r\n";
+            }
+        }
+        if (noBody)
+        {
+            if (headRequest_ && hasLength)
+            {
+                head += "Content-Length: " + contentLength + "\r\n";
+            }
+        }
+        else if (next == kBody || next == kDone)
+        {
+            head += "Content-Length: " + std::to_string(remaining_) + "\r\n";
+        }
+        else if (req.version() == "1.1")
+        {
+            head += "Transfer-Encoding: chunked\r\n";
+            chunkToClient_ = true;
+        }
+        else
+        {
+            keepAlive = false;  // HTTP/1.0 的客户端只能用关闭连接表示结束
+        }
+        head += keepAlive ? "Connection: keep-alive\r\n\r\n" : "Connection: close\r\n\r\n";
+        resp->SetKeepAlive(keepAlive);
+        out_.append(head);
+    }
+    headers_.clear();
+    state_ = next;
+    if (state_ == kDone)
+    {
+        state_ = kHeaders;     // onEnd 会把状态设成 kDone
+        onEnd();
+    }
+    return true;
+}
+
+void HttpProxy::Exchange::onBody(const char* data, size_t len)
+{
+    if (!stream_)
+    {
+        body_.append(data, len);
+    }
+    else if (chunkToClient_)
+    {
+        char size[32];
+        snprintf(size, sizeof size, "%zx\r\n", len);
+        out_.append(size, strlen(size));
+        out_.append(data, len);
+        out_.append("\r\n", 2);
+    }
+    else
+    {
+        out_.append(data, len);
+    }
+}
+
+void HttpProxy::Exchange::onEnd()
+{
+    state_ = kDone;
+    done_ = true;
+    if (stream_)
+    {
+        if (chunkToClient_)
+        {
+            out_.append("0\r\n\r\n", 5);
+        }
+        flush();
+    }
+    else
+    {
+        writer_->response()->SetBody(body_);
+    }
+    // 读到关闭为止的响应，连接已经没有了
+    releaseUpstream(upstreamKeepAlive_ && state_ == kDone);
+    writer_->finish();
+}
+
+// 把攒下的数据交给客户端连接，积压太多就先不读上游了
+void HttpProxy::Exchange::flush()
+{
+    if (out_.readableBytes() == 0)
+    {
+        return;
+    }
+    TcpConnectionPtr client = writer_->connection();
+    if (!client || !client->connected())
+    {
+        // 客户端已经走了，上游连接上还有没读完的响应，不能再用
+        LOG_DEBUG << "proxy: client gone";
+        out_.retrieveAll();
+        if (!done_)
+        {
+            done_ = true;
+            up_->errors->inc();
+            releaseUpstream(false);
+        }
+        return;
+    }
+    size_t queued = writer_->sendRaw(&out_);
+    if (queued > kHighWaterMark && !paused_ && !done_ && conn_)
+    {
+        paused_ = true;
+        conn_->stopRead();
+        std::weak_ptr<Exchange> weak(shared_from_this());
+        writer_->onDrained([weak]() {
+            std::shared_ptr<Exchange> self = weak.lock();
+            if (self)
+            {
+                self->resume();
+            }
+        });
+        checkClient();
+    }
+}
+
+void HttpProxy::Exchange::resume()
+{
+    if (paused_)
+    {
+        paused_ = false;
+        if (conn_ && !done_)
+        {
+            conn_->startRead();
+        }
+    }
+}
+
+// 暂停期间客户端断开的话写空回调不会来，定时看一下
+void HttpProxy::Exchange::checkClient()
+{
+    std::weak_ptr<Exchange> weak(shared_from_this());
+    loop_->runAfter(1.0, [weak]() {
+        std::shared_ptr<Exchange> self = weak.lock();
+        if (!self || !self->paused_ || self->done_)
+        {
+            return;
+        }
+        TcpConnectionPtr client = self->writer_->connection();
+        if (client && client->connected())
+        {
+            self->checkClient();
+        }
+        else
+        {
+            self->done_ = true;
+            self->up_->errors->inc();
+            self->releaseUpstream(false);
+        }
+    });
+}
+
+// 还没有给客户端发过任何东西，可以返回一个完整的错误响应
+void HttpProxy::Exchange::fail(int code)
+{
+    done_ = true;
+    up_->errors->inc();
+    if (connector_)
+    {
+        connector_->stop();
+        connector_.reset();
+    }
+    releaseUpstream(false);
+    std::string noFile;
+    writer_->response()->Init("/", noFile, writer_->request().IsKeepAlive(), code);
+    writer_->finish();
+}
+
+// 响应已经发了一部分，只能关闭客户端连接让它知道响应不完整
+void HttpProxy::Exchange::abort()
+{
+    done_ = true;
+    up_->errors->inc();
+    out_.retrieveAll();
+    releaseUpstream(false);
+    writer_->response()->SetKeepAlive(false);
+    writer_->finish();
+}
+
+void HttpProxy::Exchange::releaseUpstream(bool reuse)
+{
+    if (active_)
+    {
+        active_ = false;
+        up_->active.fetch_sub(1, std::memory_order_relaxed);
+    }
+    if (conn_)
+    {
+        TcpConnectionPtr conn;
+        conn.swap(conn_);
+        static_cast<ConnState*>(conn->getContext().get())->exchange.reset();
+        if (paused_)
+        {
+            conn->startRead();
+        }
+        if (reuse && conn->connected())
+        {
+            proxy_->release(conn, upstream_);
+        }
+        else
+        {
+            conn->forceClose();
+        }
+    }
+    paused_ = false;
+}
+
+HttpProxy::HttpProxy(const std::vector<InetAddress>& upstreams, Balance balance)
+    : id_(g_nextProxyId.fetch_add(1, std::memory_order_relaxed)),
+      balance_(balance),
+      next_(0),
+      nextConnId_(0),
+      healthInterval_(5),
+      timeout_(30),
+      maxIdle_(64),
+      healthLoop_(nullptr)
+{
+    for (size_t i = 0; i < upstreams.size(); ++i)
+    {
+        upstreams_.emplace_back(new Upstream(upstreams[i]));
+        for (int v = 0; v < kVirtualNodes; ++v)
+        {
+            std::string node = upstreams_[i]->hostPort + "#" + std::to_string(v);
+            ring_.emplace_back(fnv1a(node.data(), node.size()), static_cast<int>(i));
+        }
+    }
+    std::sort(ring_.begin(), ring_.end());
+}
+
+HttpProxy::~HttpProxy() = default;
+
+bool HttpProxy::healthy(size_t index) const
+{
+    return upstreams_[index]->healthy.load(std::memory_order_relaxed);
+}
+
+void HttpProxy::handle(const HttpResponseWriterPtr& writer)
+{
+    int upstream = select(writer);
+    if (upstream < 0)
+    {
+        writer->response()->SetCode(503);
+        writer->finish();
+        return;
+    }
+    std::shared_ptr<Exchange> exchange(new Exchange(this, writer, upstream));
+    exchange->start();
+}
+
+int HttpProxy::select(const HttpResponseWriterPtr& writer)
+{
+    int n = static_cast<int>(upstreams_.size());
+    if (n == 0)
+    {
+        return -1;
+    }
+    if (balance_ == kConsistentHash)
+    {
+        TcpConnectionPtr client = writer->connection();
+        uint32_t ip = client ? client->peerAddress().getSockAddr()->sin_addr.s_addr : 0;
+        uint32_t hash = fnv1a(&ip, sizeof ip);
+        auto it = std::lower_bound(ring_.begin(), ring_.end(), std::make_pair(hash, 0));
+        // 顺着环找第一个健康的节点，一个上游摘除时只有落在它上面的客户端会换上游
+        for (size_t i = 0; i < ring_.size(); ++i, ++it)
+        {
+            if (it == ring_.end())
+            {
+                it = ring_.begin();
+            }
+            if (healthy(it->second))
+            {
+                return it->second;
+            }
+        }
+        return -1;
+    }
+
+    // 从轮询的位置开始，最少连接在连接数相同时也能分散开
+    int start = static_cast<int>(next_.fetch_add(1, std::memory_order_relaxed) % n);
+    int best = -1;
+    for (int i = 0; i < n; ++i)
+    {
+        int index = (start + i) % n;
+        if (!healthy(index))
+        {
+            continue;
+        }
+        if (balance_ == kRoundRobin)
+        {
+            return index;
+        }
+        if (best < 0 || upstreams_[index]->active.load(std::memory_order_relaxed)
+                        < upstreams_[best]->active.load(std::memory_order_relaxed))
+        {
+            best = index;
+        }
+    }
+    return best;
+}
+
+HttpProxy::LoopPool* HttpProxy::getPool(EventLoop* loop)
+{
+    // 一个 loop 只在一个线程里跑，查到的池按线程缓存起来，只有每个 loop 第一次转发时才加锁
+    struct CachedPool
+    {
+        uint64_t owner;
+        EventLoop* loop;
+        LoopPool* pool;
+    };
+    static thread_local std::vector<CachedPool> t_pools;
+    for (const CachedPool& cached : t_pools)
+    {
+        if (cached.owner == id_ && cached.loop == loop)
+        {
+            return cached.pool;
+        }
+    }
+
+    LoopPool* result;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        std::unique_ptr<LoopPool>& pool = pools_[loop];
+        if (!pool)
+        {
+            pool.reset(new LoopPool);
+            pool->idle.resize(upstreams_.size());
+        }
+        result = pool.get();
+    }
+    CachedPool cached = {id_, loop, result};
+    t_pools.push_back(cached);
+    return result;
+}
+
+TcpConnectionPtr HttpProxy::acquire(EventLoop* loop, int upstream)
+{
+    std::vector<TcpConnectionPtr>& idle = getPool(loop)->idle[upstream];
+    while (!idle.empty())
+    {
+        TcpConnectionPtr conn = idle.back();
+        idle.pop_back();
+        if (conn->connected())
+        {
+            return conn;
+        }
+    }
+    return TcpConnectionPtr();
+}
+
+void HttpProxy::release(const TcpConnectionPtr& conn, int upstream)
+{
+    std::vector<TcpConnectionPtr>& idle = getPool(conn->getLoop())->idle[upstream];
+    if (idle.size() < maxIdle_)
+    {
+        idle.push_back(conn);
+    }
+    else
+    {
+        conn->forceClose();
+    }
+}
+
+TcpConnectionPtr HttpProxy::newConnection(EventLoop* loop, int upstream, int sockfd)
+{
+    char name[64];
+    snprintf(name, sizeof name, "proxy-%s#%llu", upstreams_[upstream]->hostPort.c_str(),
+             static_cast<unsigned long long>(nextConnId_.fetch_add(1, std::memory_order_relaxed)));
+    TcpConnectionPtr conn = TcpClient::createConnection(loop, name, sockfd, upstreams_[upstream]->addr);
+    conn->socket_->setTcpNoDelay(true);
+    conn->setContext(std::make_shared<ConnState>(upstream));
+    conn->setConnectionCallback(std::bind(&HttpProxy::onUpstreamConnection, this, std::placeholders::_1));
+    conn->setMessageCallback(std::bind(&HttpProxy::onUpstreamMessage, this,
+                                       std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
+    conn->setCloseCallback(onClientConnClose);
+    conn->connectEstablished();
+    return conn;
+}
+
+void HttpProxy::onUpstreamConnection(const TcpConnectionPtr& conn)
+{
+    if (conn->connected())
+    {
+        return;
+    }
+    ConnState* state = static_cast<ConnState*>(conn->getContext().get());
+    if (state->exchange)
+    {
+        std::shared_ptr<Exchange> exchange;
+        exchange.swap(state->exchange);
+        exchange->onUpstreamClosed();
+        return;
+    }
+    // 空闲的连接被上游关掉了
+    std::vector<TcpConnectionPtr>& idle = getPool(conn->getLoop())->idle[state->upstream];
+    auto it = std::find(idle.begin(), idle.end(), conn);
+    if (it != idle.end())
+    {
+        idle.erase(it);
+    }
+}
+
+void HttpProxy::onUpstreamMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp)
+{
+    ConnState* state = static_cast<ConnState*>(conn->getContext().get());
+    if (state->exchange)
+    {
+        std::shared_ptr<Exchange> exchange(state->exchange);
+        exchange->onMessage(buf);
+        return;
+    }
+    // 空闲的连接上不应该有数据
+    buf->retrieveAll();
+    conn->forceClose();
+}
+
+void HttpProxy::markDown(int upstream)
+{
+    // 没有健康检查就没有人能把它恢复，只能一直尝试
+    if (!healthPath_.empty() && upstreams_[upstream]->healthy.exchange(false))
+    {
+        upstreams_[upstream]->up->dec();
+        LOG_WARN << "proxy: upstream " << upstreams_[upstream]->hostPort << " marked down";
+    }
+}
+
+void HttpProxy::start(EventLoop* loop)
+{
+    if (healthPath_.empty() || healthLoop_)
+    {
+        return;
+    }
+    healthLoop_ = loop;
+    loop->runEvery(healthInterval_, std::bind(&HttpProxy::checkHealth, this));
+    loop->runInLoop(std::bind(&HttpProxy::checkHealth, this));
+}
+
+void HttpProxy::checkHealth()
+{
+    for (size_t i = 0; i < upstreams_.size(); ++i)
+    {
+        if (!upstreams_[i]->checking)
+        {
+            checkOne(static_cast<int>(i));
+        }
+    }
+}
+
+void HttpProxy::checkOne(int upstream)
+{
+    Upstream* up = upstreams_[upstream].get();
+    up->checking = true;
+    std::shared_ptr<Probe> probe(new Probe);
+    probe->upstream = upstream;
+    probe->done = false;
+    probe->connector.reset(new Connector(healthLoop_, up->addr));
+    std::string request = "GET " + healthPath_ + " HTTP/1.1\r\nHost: " + up->hostPort + "\r\nConnection: close\r\n\r\n";
+    probe->connector->setNewConnectionCallback([this, probe, request](int sockfd) {
+        probe->connector.reset();
+        if (probe->done)
+        {
+            ::close(sockfd);
+            return;
+        }
+        TcpConnectionPtr conn = newConnection(healthLoop_, probe->upstream, sockfd);
+        // 只看状态行，2xx 和 3xx 算健康
+        conn->setMessageCallback([this, probe](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+            const char* crlf = buf->findCRLF();
+            if (crlf == nullptr)
+            {
+                return;
+            }
+            std::string line(buf->peek(), crlf);
+            buf->retrieveAll();
+            int code = line.size() > 9 ? atoi(line.c_str() + 9) : 0;
+            probeDone(probe, code >= 200 && code < 400);
+        });
+        conn->setConnectionCallback([this, probe](const TcpConnectionPtr& c) {
+            if (!c->connected())
+            {
+                probeDone(probe, false);
+            }
+        });
+        probe->conn = conn;
+        conn->send(request);
+    });
+    probe->connector->setErrorCallback([this, probe]() {
+        probe->connector.reset();
+        probeDone(probe, false);
+    });
+    probe->connector->start();
+    healthLoop_->runAfter(healthInterval_, [this, probe]() { probeDone(probe, false); });
+}
+
+void HttpProxy::probeDone(const std::shared_ptr<Probe>& probe, bool ok)
+{
+    if (probe->done)
+    {
+        return;
+    }
+    probe->done = true;
+    if (probe->connector)
+    {
+        probe->connector->stop();
+        probe->connector.reset();
+    }
+    if (probe->conn)
+    {
+        probe->conn->forceClose();
+        probe->conn.reset();
+    }
+    Upstream* up = upstreams_[probe->upstream].get();
+    up->checking = false;
+    if (ok)
+    {
+        up->fails = 0;
+        if (!up->healthy.exchange(true))
+        {
+            up->up->inc();
+            LOG_INFO << "proxy: upstream " << up->hostPort << " is back";
+        }
+    }
+    else if (++up->fails >= kMaxFails)
+    {
+        markDown(probe->upstream);
+    }
+}
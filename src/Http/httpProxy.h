@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "InetAddress.h"
+#include "Timestamp.h"
+#include "httpResponseWriter.h"
+
+class EventLoop;
+class Counter;
+class Gauge;
+
+/**
+ * 反向代理，把请求转发给一组上游服务器，作为 HttpServer 的异步处理函数使用
+ * - 请求在客户端连接所属的 loop 上转发，每个 loop 对每个上游有自己的长连接池，转发过程不跨线程；
+ *   每个 loop 第一次转发时加锁登记它的连接池，之后从线程缓存里取，不再加锁
+ * - 负载均衡：轮询、最少连接、按客户端 IP 一致性哈希，都会跳过不健康的上游
+ * - 主动健康检查：定时 GET healthPath，连续失败 kMaxFails 次摘除，成功一次恢复；
+ *   打开健康检查时，连接上游失败也会立刻摘除，等健康检查恢复
+ * - HTTP/1.x 的客户端，上游响应体边收边发；客户端积压超过 kHighWaterMark 时暂停读上游，写空之后恢复
+ * HTTP/2 的客户端把上游响应收完整之后一次返回；请求体已经由 HttpServer 收完整，整个转发出去
+ */
+class HttpProxy : noncopyable
+{
+public:
+    enum Balance
+    {
+        kRoundRobin,
+        kLeastConn,
+        kConsistentHash,
+    };
+
+    static const int kMaxFails = 2;
+    static const size_t kHighWaterMark = 1024 * 1024;
+    static const size_t kMaxLineSize = 64 * 1024;
+
+    explicit HttpProxy(const std::vector<InetAddress>& upstreams, Balance balance = kRoundRobin);
+    ~HttpProxy();
+
+    // 以下设置需要在 start 之前调用
+    void setHealthCheck(const std::string& path, double interval)
+    {
+        healthPath_ = path;
+        healthInterval_ = interval;
+    }
+    // 从开始转发到收到上游响应首部的超时时间，超时返回 504
+    void setTimeout(double seconds) { timeout_ = seconds; }
+    // 每个 loop 对每个上游最多保留的空闲连接数
+    void setMaxIdle(size_t n) { maxIdle_ = n; }
+
+    // 开始健康检查，由 HttpServer::start 调用
+    void start(EventLoop* loop);
+    // 转发一个请求
+    void handle(const HttpResponseWriterPtr& writer);
+
+    size_t size() const { return upstreams_.size(); }
+    bool healthy(size_t index) const;
+
+private:
+    struct Upstream;
+    struct LoopPool;
+    struct ConnState;
+    struct Probe;
+    class Exchange;
+
+    int select(const HttpResponseWriterPtr& writer);
+    LoopPool* getPool(EventLoop* loop);
+    TcpConnectionPtr acquire(EventLoop* loop, int upstream);
+    void release(const TcpConnectionPtr& conn, int upstream);
+    TcpConnectionPtr newConnection(EventLoop* loop, int upstream, int sockfd);
+    void onUpstreamConnection(const TcpConnectionPtr& conn);
+    void onUpstreamMessage(const TcpConnectionPtr& conn, Buffer* buf, Timestamp receiveTime);
+    void markDown(int upstream);
+
+    void checkHealth();
+    void checkOne(int upstream);
+    void probeDone(const std::shared_ptr<Probe>& probe, bool ok);
+
+    const uint64_t id_;
+    std::vector<std::unique_ptr<Upstream>> upstreams_;
+    const Balance balance_;
+    std::vector<std::pair<uint32_t, int>> ring_;    // 一致性哈希环，每个上游若干个虚拟节点
+    std::atomic<uint32_t> next_;                     // 轮询的位置
+    std::atomic<uint64_t> nextConnId_;
+
+    std::string healthPath_;
+    double healthInterval_;
+    double timeout_;
+    size_t maxIdle_;
+    EventLoop* healthLoop_;
+
+    std::mutex mutex_;                                          // 只保护 pools_ 的登记
+    std::map<EventLoop*, std::unique_ptr<LoopPool>> pools_;
+};
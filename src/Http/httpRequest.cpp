@@ -1,4 +1,5 @@
 #include "httpRequest.h"
+#include <algorithm>
 using namespace std;
 
 // 网页名称，和一般的前端跳转不同，这里需要将请求信息放到后端来验证一遍再上传（和小组成员还起过争执）
@@ -14,64 +15,206 @@ const unordered_map<string, int> HttpRequest::DEFAULT_HTML_TAG {
 // 初始化操作，一些清零操作
 void HttpRequest::Init() {
     state_ = REQUEST_LINE;  // 初始状态
-    method_ = path_ = version_= body_ = "";
+    contentLength_ = 0;
+    bodyRemaining_ = 0;
+    bodySize_ = 0;
+    chunked_ = false;
+    errorCode_ = 0;
+    bodyCallback_ = nullptr;
+    method_ = path_ = version_= body_ = query_ = filePath_ = "";
     header_.clear();
     post_.clear();
+    params_.clear();
 }
 
-// 解析处理
+// 解析处理，可以多次调用：数据不完整时保留已经解析的状态，等下一次数据到来再继续
+// 请求体收到多少消费多少，不会留在 buff 里等整个请求体到齐
 bool HttpRequest::parse(Buffer& buff) {
-    const char END[] = "\r\n";
-    if(buff.readableBytes() == 0)   // 没有可读的字节
-        return false;
-    // 读取数据开始
-    while(buff.readableBytes() && state_ != FINISH) {
-        // 从buff中的读指针开始到读指针结束，这块区域是未读取得数据并去处"\r\n"，返回有效数据得行末指针
-        // LOG_DEBUG<<"parse";
+    while(state_ != FINISH) {
+        if(state_ == HEADERS_DONE && !StartBody()) {
+            return false;
+        }
+        if(state_ == BODY || state_ == CHUNK_DATA) {
+            size_t n = std::min(buff.readableBytes(), bodyRemaining_);
+            if(n > 0) {
+                if(!AppendBody_(buff.peek(), n)) {
+                    return false;
+                }
+                buff.retrieve(n);
+                bodyRemaining_ -= n;
+            }
+            if(bodyRemaining_ > 0) {
+                break;  // 等剩下的数据
+            }
+            if(state_ == CHUNK_DATA) {
+                state_ = CHUNK_CRLF;
+            } else if(!EndBody_()) {
+                return false;
+            }
+            continue;
+        }
+        if(state_ == CHUNK_CRLF) {
+            // chunk 数据后面紧跟着回车换行
+            if(buff.readableBytes() < 2) {
+                break;
+            }
+            if(buff.peek()[0] != '\r' || buff.peek()[1] != '\n') {
+                errorCode_ = 400;
+                return false;
+            }
+            buff.retrieve(2);
+            state_ = CHUNK_SIZE;
+            continue;
+        }
+        // 从buff中的读指针开始找"\r\n"，找不到说明一行还没有收完整
         const char* lineend = buff.findCRLF();
-        // LOG_DEBUG<<"find: "<<
-        if(lineend==NULL) lineend = buff.beginWrite();
+        if(lineend == NULL) {
+            if(buff.readableBytes() > kMaxLineSize) {
+                errorCode_ = 400;
+                return false;
+            }
+            break;
+        }
         string line(buff.peek(), lineend);
+        buff.retrieveUntil(lineend + 2);        // 跳过回车换行
         switch (state_)
         {
         case REQUEST_LINE:
             // 解析错误
             if(!ParseRequestLine_(line)) {
+                errorCode_ = 400;
                 return false;
             }
             ParsePath_();   // 解析路径
             break;
         case HEADERS:
-            // LOG_DEBUG<<"head";
-            ParseHeader_(line);
-            if(buff.readableBytes() <= 2) {  // 说明是get请求，后面为\r\n
-                state_ = FINISH;   // 提前结束
+            if(line.empty()) {  // 空行说明首部结束，先返回一次，让调用方决定请求体交给谁
+                if(!ParseFraming_()) {
+                    return false;
+                }
+                state_ = HEADERS_DONE;
+                return true;
+            }
+            if(!ParseHeader_(line)) {
+                errorCode_ = 400;
+                return false;
             }
             break;
-        case BODY:
-            // LOG_DEBUG<<"body";
-            ParseBody_(line);
+        case CHUNK_SIZE:
+            if(!ParseChunkSize_(line)) {
+                return false;
+            }
             break;
-        default:
+        case TRAILERS:
+            // trailer 里的首部直接丢掉，空行说明请求体结束
+            if(line.empty() && !EndBody_()) {
+                return false;
+            }
             break;
-        }
-        if(lineend == buff.beginWrite()) {  // 读完了
-            buff.retrieveAll();
+        default:
             break;
         }
-        buff.retrieveUntil(lineend + 2);        // 跳过回车换行
     }
     // LOG_DEBUG("[%s], [%s], [%s]", method_.c_str(), path_.c_str(), version_.c_str());
     return true;
 }
 
+// 请求体保存在内存里的才受 maxBodySize_ 限制，流式接收的由回调自己决定收多少
+bool HttpRequest::StartBody() {
+    if(state_ != HEADERS_DONE) {
+        return true;
+    }
+    if(!bodyCallback_ && contentLength_ > maxBodySize_) {
+        errorCode_ = 413;
+        return false;
+    }
+    state_ = chunked_ ? CHUNK_SIZE : BODY;
+    bodyRemaining_ = contentLength_;
+    return true;
+}
+
+// 同时有 Content-Length 和 Transfer-Encoding 的请求可能被前后两层服务器理解成不同的边界，直接拒绝
+bool HttpRequest::ParseFraming_() {
+    string te = GetHeader("Transfer-Encoding");
+    string cl = GetHeader("Content-Length");
+    if(!te.empty()) {
+        if(strcasecmp(te.c_str(), "chunked") != 0 || !cl.empty()) {
+            errorCode_ = 400;
+            return false;
+        }
+        chunked_ = true;
+        return true;
+    }
+    if(cl.empty()) {
+        return true;
+    }
+    if(cl.find_first_not_of("0123456789") != string::npos || cl.size() > 18) {
+        errorCode_ = 400;
+        return false;
+    }
+    contentLength_ = strtoull(cl.c_str(), nullptr, 10);
+    return true;
+}
+
+// chunk 大小是十六进制，后面可能跟着 ;name=value 形式的扩展，扩展直接忽略
+bool HttpRequest::ParseChunkSize_(const string& line) {
+    size_t end = line.find(';');
+    string hex = line.substr(0, end);
+    while(!hex.empty() && (hex.back() == ' ' || hex.back() == '\t')) {
+        hex.pop_back();
+    }
+    if(hex.empty() || hex.size() > 15 || hex.find_first_not_of("0123456789abcdefABCDEF") != string::npos) {
+        errorCode_ = 400;
+        return false;
+    }
+    size_t size = strtoull(hex.c_str(), nullptr, 16);
+    if(size == 0) {
+        state_ = TRAILERS;
+        return true;
+    }
+    if(!bodyCallback_ && bodySize_ + size > maxBodySize_) {
+        errorCode_ = 413;
+        return false;
+    }
+    bodyRemaining_ = size;
+    state_ = CHUNK_DATA;
+    return true;
+}
+
+bool HttpRequest::AppendBody_(const char* data, size_t len) {
+    bodySize_ += len;
+    if(bodyCallback_) {
+        if(!bodyCallback_(data, len)) {
+            errorCode_ = 0;     // 处理函数自己中止的，由它给出响应
+            return false;
+        }
+        return true;
+    }
+    body_.append(data, len);
+    return true;
+}
+
+bool HttpRequest::EndBody_() {
+    state_ = FINISH;
+    if(bodyCallback_) {
+        BodyCallback cb;
+        cb.swap(bodyCallback_);     // 结束之后就释放回调，回调里持有的对象也跟着释放
+        return cb(nullptr, 0);
+    }
+    if(bodySize_ > 0) {
+        ParsePost_();
+        LOG_DEBUG<<"Body len:"<<body_.size();
+    }
+    return true;
+}
+
 bool HttpRequest::ParseRequestLine_(const string& line) {
     regex patten("^([^ ]*) ([^ ]*) HTTP/([^ ]*)$");
     smatch Match;   // 用来匹配patten得到结果
     // 在匹配规则中，以括号()的方式来划分组别 一共三个括号 [0]表示整体
     if(regex_match(line, Match, patten)) {  // 匹配指定字符串整体是否符合
         method_ = Match[1];
-        path_ = Match[2];
+        SetTarget_(Match[2]);
         version_ = Match[3];
         state_ = HEADERS;
         
@@ -81,36 +224,70 @@ bool HttpRequest::ParseRequestLine_(const string& line) {
     return false;
 }
 
-// 解析路径，统一一下path名称,方便后面解析资源
+// 把查询参数从路径中分离出来，路由和静态文件只看路径部分
+void HttpRequest::SetTarget_(const string& target) {
+    path_ = target;
+    size_t pos = path_.find('?');
+    if(pos != string::npos) {
+        query_ = path_.substr(pos + 1);
+        path_.resize(pos);
+    }
+}
+
+void HttpRequest::SetRequestLine(const string& method, const string& target, const string& version) {
+    method_ = method;
+    SetTarget_(target);
+    version_ = version;
+    ParsePath_();
+    state_ = HEADERS;
+}
+
+// 同名的首部合并成一个，Cookie 用分号分隔，其他的用逗号
+void HttpRequest::AddHeader(const string& key, const string& value) {
+    auto it = header_.find(key);
+    if(it == header_.end()) {
+        header_[key] = value;
+    } else {
+        it->second += (strcasecmp(key.c_str(), "Cookie") == 0 ? "; " : ", ") + value;
+    }
+}
+
+void HttpRequest::SetBody(const string& body) {
+    contentLength_ = body.size();
+    bodySize_ = body.size();
+    body_ = body;
+    EndBody_();
+}
+
+// 解析路径，统一一下path名称,方便后面解析资源；path_ 保持原样给路由用
 void HttpRequest::ParsePath_() {
     if(path_ == "/") {
-        path_ = "/index.html";
+        filePath_ = "/index.html";
     } else {
+        filePath_ = path_;
         if(DEFAULT_HTML.find(path_) != DEFAULT_HTML.end()) {
-            path_ += ".html";
+            filePath_ += ".html";
         }
     }
 }
 
-void HttpRequest::ParseHeader_(const string& line) {
+bool HttpRequest::ParseHeader_(const string& line) {
     regex patten("^([^:]*): ?(.*)$");
     smatch Match;
     if(regex_match(line, Match, patten)) {
-        header_[Match[1]] = Match[2];
-    } else {    // 匹配失败说明首部行匹配完了，状态变化
-        LOG_DEBUG<<"state change:"<<line.size();
-        state_ = BODY;
+        string key = Match[1];
+        // 多个 Content-Length 可能被前后两层服务器各取一个，直接拒绝；其他同名首部合并
+        if(strcasecmp(key.c_str(), "Content-Length") == 0 && header_.count(key)) {
+            LOG_ERROR<<"Duplicate Content-Length";
+            return false;
+        }
+        AddHeader(key, Match[2]);
+        return true;
     }
+    LOG_ERROR<<"Header Error";
+    return false;
 }
 
-void HttpRequest::ParseBody_(const string& line) {
-    body_ = line;
-    ParsePost_();
-    state_ = FINISH;    // 状态转换为下一个状态
-    LOG_DEBUG<<"Body:%s, len:%d", line.c_str(), line.size();
-}
-
-
 // 16进制转化为10进制
 int HttpRequest::ConverHex(char ch) {
     if(ch >= 'A' && ch <= 'F') 
@@ -126,16 +303,16 @@ void HttpRequest::ParsePost_() {
     if(method_ == "POST" && header_["Content-Type"] == "application/x-www-form-urlencoded") {
         // LOG_DEBUG<<"ParsePost_ IN";
         ParseFromUrlencoded_();     // POST请求体示例
-        if(DEFAULT_HTML_TAG.count(path_)) { // 如果是登录/注册的path
-            int tag = DEFAULT_HTML_TAG.find(path_)->second; 
+        if(DEFAULT_HTML_TAG.count(filePath_)) { // 如果是登录/注册的path
+            int tag = DEFAULT_HTML_TAG.find(filePath_)->second; 
             LOG_DEBUG<<"Tag:%d", tag;
             if(tag == 0 || tag == 1) {
                 bool isLogin = (tag == 1);  // 为1则是登录
                 if(UserVerify(post_["username"], post_["password"], isLogin)) {
-                    path_ = "/welcome.html";
+                    filePath_ = "/welcome.html";
                 } 
                 else {
-                    path_ = "/error.html";
+                    filePath_ = "/error.html";
                 }
             }
         }
@@ -244,14 +421,14 @@ bool HttpRequest::UserVerify(const string &name, const string &pwd, bool isLogin
     return flag;
 }
 
-std::string HttpRequest::path() const{
+const std::string& HttpRequest::path() const{
     return path_;
 }
 
 std::string& HttpRequest::path(){
     return path_;
 }
-std::string HttpRequest::method() const {
+const std::string& HttpRequest::method() const {
     return method_;
 }
 
@@ -275,9 +452,33 @@ std::string HttpRequest::GetPost(const char* key) const {
     return "";
 }
 
+std::string HttpRequest::GetHeader(const std::string& key) const {
+    auto it = header_.find(key);
+    if(it != header_.end()) {
+        return it->second;
+    }
+    return "";
+}
+
+std::string HttpRequest::param(const std::string& key) const {
+    for(int i = 0; i < params_.size(); i++) {
+        const RouteParam& p = params_[i];
+        if(*p.key == key) {
+            return path_.substr(p.offset, p.len);
+        }
+    }
+    return "";
+}
+
+// HTTP/1.1 默认是长连接，除非显式 Connection: close；HTTP/1.0 需要显式 keep-alive
 bool HttpRequest::IsKeepAlive() const {
-    if(header_.count("Connection") == 1) {
-        return header_.find("Connection")->second == "keep-alive" && version_ == "1.1";
+    string connection = GetHeader("Connection");
+    if(version_ == "1.1") {
+        return strcasecmp(connection.c_str(), "close") != 0;
     }
-    return false;
+    return strcasecmp(connection.c_str(), "keep-alive") == 0;
+}
+
+bool HttpRequest::ExpectsContinue() const {
+    return version_ == "1.1" && strcasecmp(GetHeader("Expect").c_str(), "100-continue") == 0;
 }
\ No newline at end of file
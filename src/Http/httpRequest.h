@@ -3,53 +3,131 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <string>
+#include <functional>
 #include <regex>    // 正则表达式
 #include <errno.h>     
+#include <strings.h>    // strcasecmp
 #include <mysql/mysql.h>  //mysql
 
 #include "Buffer.h"
 #include "Logging.h"
 #include "sqlConnectPool.h"
+#include "httpRouter.h"
+
+// 首部名不区分大小写：哈希按小写字母算，比较用 strcasecmp，保存的还是收到时的写法
+struct HeaderNameHash {
+    size_t operator()(const std::string& name) const {
+        size_t h = 14695981039346656037ULL;
+        for(char c : name) {
+            h = (h ^ static_cast<unsigned char>(c | 0x20)) * 1099511628211ULL;
+        }
+        return h;
+    }
+};
+
+struct HeaderNameEqual {
+    bool operator()(const std::string& a, const std::string& b) const {
+        return a.size() == b.size() && strcasecmp(a.c_str(), b.c_str()) == 0;
+    }
+};
+
+using HeaderMap = std::unordered_map<std::string, std::string, HeaderNameHash, HeaderNameEqual>;
 
 class HttpRequest {
 public:
     enum PARSE_STATE {
         REQUEST_LINE,
         HEADERS,
-        BODY,
+        HEADERS_DONE,   // 首部已经收完，parse 在这里先返回一次，调用方可以设置请求体回调
+        BODY,           // 按 Content-Length 接收请求体
+        CHUNK_SIZE,     // chunked 编码
+        CHUNK_DATA,
+        CHUNK_CRLF,
+        TRAILERS,
         FINISH,        
     };
+
+    // 流式接收请求体，数据按收到的顺序分段交给回调，请求体结束时 data 为 nullptr、len 为 0
+    // 返回 false 中止接收，parse 返回 false 且 ErrorCode() 为 0
+    using BodyCallback = std::function<bool (const char* data, size_t len)>;
+
+    static const size_t kDefaultMaxBodySize = 8 * 1024 * 1024;
+    static const size_t kMaxLineSize = 64 * 1024;   // 请求行、首部行、chunk 大小行的上限
     
-    HttpRequest() { Init(); }
-    ~HttpRequest() = default;
+    HttpRequest() : maxBodySize_(kDefaultMaxBodySize) { Init(); }
 
     void Init();
+    // 可以多次调用，返回 false 时 ErrorCode() 是应该返回给客户端的状态码
     bool parse(Buffer& buff);   
+    bool IsFinish() const { return state_ == FINISH; }   // 是否已经解析出一个完整的请求
+    bool IsEmpty() const { return state_ == REQUEST_LINE; } // 还没有开始解析请求
+    bool HeadersDone() const { return state_ == HEADERS_DONE; }
+    // 首部收完之后开始接收请求体，不调用的话下一次 parse 会自动开始；返回 false 时同 parse
+    bool StartBody();
+    int ErrorCode() const { return errorCode_; }
+
+    // 保存在内存里的请求体的上限，Content-Length 超过上限时不等请求体直接报错；Init 不会重置
+    void SetMaxBodySize(size_t size) { maxBodySize_ = size; }
+    // 设置之后请求体不再保存到 body_ 中，也不受上限限制；回调在请求体结束后释放，所以回调里可以持有 writer
+    void SetBodyCallback(const BodyCallback& cb) { bodyCallback_ = cb; }
+    BodyCallback& bodyCallback() { return bodyCallback_; }
 
-    std::string path() const;
+    // 请求里的原始路径，路由按它匹配
+    const std::string& path() const;
     std::string& path();
-    std::string method() const;
+    // 静态文件的路径："/" 换成 "/index.html"，"/login" 这类页面补上 ".html"，登录注册后换成结果页
+    const std::string& filePath() const { return filePath_; }
+    const std::string& method() const;
     std::string version() const;
+    const std::string& query() const { return query_; }
+    const std::string& body() const { return body_; }
     std::string GetPost(const std::string& key) const;
     std::string GetPost(const char* key) const;
+    // 首部名不区分大小写
+    std::string GetHeader(const std::string& key) const;
+    const HeaderMap& headers() const { return header_; }
+
+    // 路由匹配出来的路径参数，例如 /user/:id 中的 id
+    std::string param(const std::string& key) const;
+    RouteParams& params() { return params_; }
 
     bool IsKeepAlive() const;
+    // HTTP/1.1 的客户端带了 Expect: 100-continue，在等服务端先回 100 再发请求体
+    bool ExpectsContinue() const;
+
+    // HTTP/2 的请求不经过文本解析，由 Http2Connection 用解码出来的首部直接填充
+    void SetRequestLine(const std::string& method, const std::string& target, const std::string& version);
+    void AddHeader(const std::string& key, const std::string& value);
+    void SetBody(const std::string& body);
 
 private:
     bool ParseRequestLine_(const std::string& line);    // 处理请求行
-    void ParseHeader_(const std::string& line);         // 处理请求头
-    void ParseBody_(const std::string& line);           // 处理请求体
+    void SetTarget_(const std::string& target);         // 分离路径和查询参数
+    bool ParseHeader_(const std::string& line);         // 处理请求头
+    bool ParseFraming_();                               // 首部结束后确定请求体的长度和编码
+    bool ParseChunkSize_(const std::string& line);
+    bool AppendBody_(const char* data, size_t len);     // 收到一段请求体
+    bool EndBody_();                                    // 请求体收完
 
-    void ParsePath_();                                  // 处理请求路径
+    void ParsePath_();                                  // 由请求路径得到静态文件的路径
     void ParsePost_();                                  // 处理Post事件
     void ParseFromUrlencoded_();                        // 从url种解析编码
 
     static bool UserVerify(const std::string& name, const std::string& pwd, bool isLogin);  // 用户验证
 
     PARSE_STATE state_;
-    std::string method_, path_, version_, body_;
-    std::unordered_map<std::string, std::string> header_;
+    size_t contentLength_;      // Content-Length，chunked 编码时为 0
+    size_t bodyRemaining_;      // 当前请求体或者当前 chunk 还没收到的字节数
+    size_t bodySize_;           // 已经收到的请求体字节数
+    size_t maxBodySize_;
+    bool chunked_;
+    int errorCode_;
+    BodyCallback bodyCallback_;
+    std::string method_, path_, version_, body_, query_;
+    std::string filePath_;
+    HeaderMap header_;
     std::unordered_map<std::string, std::string> post_;
+    RouteParams params_;
 
     static const std::unordered_set<std::string> DEFAULT_HTML;
     static const std::unordered_map<std::string, int> DEFAULT_HTML_TAG;
@@ -1,5 +1,7 @@
 #include "httpResponse.h"
 
+#include <algorithm>
+
 using namespace std;
 
 const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
@@ -20,8 +22,8 @@ const unordered_map<string, string> HttpResponse::SUFFIX_TYPE = {
     { ".avi",   "video/x-msvideo" },
     { ".gz",    "application/x-gzip" },
     { ".tar",   "application/x-tar" },
-    { ".css",   "text/css "},
-    { ".js",    "text/javascript "},
+    { ".css",   "text/css" },
+    { ".js",    "text/javascript" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_STATUS = {
@@ -29,18 +31,26 @@ const unordered_map<int, string> HttpResponse::CODE_STATUS = {
     { 400, "Bad Request" },
     { 403, "Forbidden" },
     { 404, "Not Found" },
+    { 405, "Method Not Allowed" },
+    { 413, "Payload Too Large" },
+    { 429, "Too Many Requests" },
+    { 502, "Bad Gateway" },
+    { 503, "Service Unavailable" },
+    { 504, "Gateway Timeout" },
 };
 
 const unordered_map<int, string> HttpResponse::CODE_PATH = {
     { 400, "/400.html" },
     { 403, "/403.html" },
     { 404, "/404.html" },
+    { 405, "/405.html" },
 };
 
 HttpResponse::HttpResponse() {
     code_ = -1;
     path_ = srcDir_ = "";
     isKeepAlive_ = false;
+    isFile_ = false;
     mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
 };
@@ -56,11 +66,41 @@ void HttpResponse::Init(const string& srcDir, string& path, bool isKeepAlive, in
     isKeepAlive_ = isKeepAlive;
     path_ = path;
     srcDir_ = srcDir;
+    isFile_ = !path.empty();
+    body_.clear();
+    contentType_ = "text/plain";
+    headers_.clear();
     mmFile_ = nullptr; 
     mmFileStat_ = { 0 };
 }
 
-void HttpResponse::MakeResponse(Buffer& buff) {
+void HttpResponse::SetFile(const string& path) {
+    path_ = path;
+    isFile_ = true;
+}
+
+void HttpResponse::SetBody(const string& body) {
+    body_ = body;
+    isFile_ = false;
+}
+
+void HttpResponse::AddHeader(const string& key, const string& value) {
+    headers_.emplace_back(key, value);
+}
+
+// 确定最终的状态码和响应内容，返回 true 表示响应内容是文件
+bool HttpResponse::Prepare_() {
+    // 处理函数没有给出任何内容，错误码就返回对应的错误页面
+    if(!isFile_ && body_.empty() && CODE_PATH.count(code_) == 1) {
+        path_ = CODE_PATH.find(code_)->second;
+        isFile_ = true;
+    }
+    if(!isFile_) {
+        if(code_ == -1) {
+            code_ = 200;
+        }
+        return false;
+    }
     /* 判断请求的资源文件 */
     if(stat((srcDir_ + path_).data(), &mmFileStat_) < 0 || S_ISDIR(mmFileStat_.st_mode)) {
         code_ = 404;
@@ -72,11 +112,49 @@ void HttpResponse::MakeResponse(Buffer& buff) {
         code_ = 200; 
     }
     ErrorHtml_();
+    return true;
+}
+
+void HttpResponse::MakeResponse(Buffer& buff) {
+    if(!Prepare_()) {
+        AddStateLine_(buff);
+        AddHeader_(buff);
+        AddContentLength_(buff, body_.size());
+        buff.append(body_);
+        return;
+    }
     AddStateLine_(buff);
     AddHeader_(buff);
     AddContent_(buff);
 }
 
+void HttpResponse::MakeHttp2Response(vector<pair<string, string>>& headers, Buffer& content) {
+    bool isFile = Prepare_();
+    if(CODE_STATUS.count(code_) == 0) {
+        code_ = 400;
+    }
+    if(!isFile) {
+        content.append(body_);
+    } else if(MapFile_()) {
+        content.append(mmFile_, mmFileStat_.st_size);
+        UnmapFile();
+    } else {
+        content.append(ErrorBody_("File NotFound!"));
+    }
+    headers.emplace_back(":status", to_string(code_));
+    headers.emplace_back("content-type", isFile ? GetFileType_() : contentType_);
+    headers.emplace_back("content-length", to_string(content.readableBytes()));
+    // HTTP/2 的首部名字必须是小写，Connection 这类逐跳首部不能出现
+    for(const auto& header : headers_) {
+        string name = header.first;
+        transform(name.begin(), name.end(), name.begin(), ::tolower);
+        if(name == "connection" || name == "keep-alive" || name == "transfer-encoding") {
+            continue;
+        }
+        headers.emplace_back(name, header.second);
+    }
+}
+
 char* HttpResponse::File() {
     return mmFile_;
 }
@@ -112,27 +190,47 @@ void HttpResponse::AddHeader_(Buffer& buff) {
     } else{
         buff.append("close\r\n");
     }
-    buff.append("Content-type: " + GetFileType_() + "\r\n");
+    buff.append("Content-type: " + (isFile_ ? GetFileType_() : contentType_) + "\r\n");
+    for(const auto& header : headers_) {
+        buff.append(header.first + ": " + header.second + "\r\n");
+    }
 }
 
-void HttpResponse::AddContent_(Buffer& buff) {
+bool HttpResponse::MapFile_() {
     int srcFd = open((srcDir_ + path_).data(), O_RDONLY);
     if(srcFd < 0) { 
         LOG_DEBUG<<"open file faild";
-        ErrorContent(buff, "File NotFound!");
-        return; 
+        return false; 
     }
 
     //将文件映射到内存提高文件的访问速度  MAP_PRIVATE 建立一个写入时拷贝的私有映射
     int* mmRet = (int*)mmap(0, mmFileStat_.st_size, PROT_READ, MAP_PRIVATE, srcFd, 0);
     if(*mmRet == -1) {
         LOG_DEBUG<<"文件映射到内存失败";
-        ErrorContent(buff, "File NotFound!");
-        return; 
+        return false; 
     }
     mmFile_ = (char*)mmRet;
     close(srcFd);
-    buff.append("Content-length: " + to_string(mmFileStat_.st_size) + "\r\n\r\n");
+    return true;
+}
+
+void HttpResponse::AddContent_(Buffer& buff) {
+    if(!MapFile_()) {
+        ErrorContent(buff, "File NotFound!");
+        return;
+    }
+    AddContentLength_(buff, mmFileStat_.st_size);
+}
+
+// 最后一个首部，后面跟空行；数字直接写进栈上的缓冲，不经过 to_string
+void HttpResponse::AddContentLength_(Buffer& buff, size_t length) {
+    static const char kName[] = "Content-length: ";
+    char line[sizeof kName + kMaxNumericSize + 4];
+    memcpy(line, kName, sizeof kName - 1);
+    char* p = line + sizeof kName - 1;
+    p += formatInteger(p, length);
+    memcpy(p, "\r\n\r\n", 4);
+    buff.append(line, p + 4 - line);
 }
 
 void HttpResponse::UnmapFile() {
@@ -156,6 +254,13 @@ string HttpResponse::GetFileType_() {
 }
 
 void HttpResponse::ErrorContent(Buffer& buff, string message) 
+{
+    string body = ErrorBody_(message);
+    AddContentLength_(buff, body.size());
+    buff.append(body);
+}
+
+string HttpResponse::ErrorBody_(const string& message)
 {
     string body;
     string status;
@@ -169,7 +274,5 @@ void HttpResponse::ErrorContent(Buffer& buff, string message)
     body += to_string(code_) + " : " + status  + "\n";
     body += "<p>" + message + "</p>";
     body += "<hr><em>WebServer</em></body></html>";
-
-    buff.append("Content-length: " + to_string(body.size()) + "\r\n\r\n");
-    buff.append(body);
+    return body;
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #pragma once 
 
 #include <unordered_map>
+#include <vector>
 #include <fcntl.h>       // open
 #include <unistd.h>      // close
 #include <sys/stat.h>    // stat
@@ -16,26 +17,46 @@ public:
 
     void Init(const std::string& srcDir, std::string& path, bool isKeepAlive = false, int code = -1);
     void MakeResponse(Buffer& buff);
+    // 给 HTTP/2 使用：生成 :status 和小写的响应头，响应体(包括文件内容)放到 content 中
+    void MakeHttp2Response(std::vector<std::pair<std::string, std::string>>& headers, Buffer& content);
+
+    // 给路由处理函数使用：返回 srcDir 下的静态文件，或者直接返回内存中的响应体
+    void SetFile(const std::string& path);
+    void SetBody(const std::string& body);
+    void SetContentType(const std::string& type) { contentType_ = type; }
+    void SetCode(int code) { code_ = code; }
+    void SetKeepAlive(bool on) { isKeepAlive_ = on; }
+    void AddHeader(const std::string& key, const std::string& value);
     void UnmapFile();
     char* File();
     size_t FileLen() const;
     void ErrorContent(Buffer& buff, std::string message);
     int Code() const { return code_; }
+    bool IsKeepAlive() const { return isKeepAlive_; }
     // void processRequestLine(const char *begin, const char *end);
     // void parseRequest(Buffer* buf, Timestamp receiveTime);
 private:
     void AddStateLine_(Buffer &buff);
     void AddHeader_(Buffer &buff);
     void AddContent_(Buffer &buff);
+    void AddContentLength_(Buffer &buff, size_t length);
+    bool Prepare_();
+    bool MapFile_();
+    std::string ErrorBody_(const std::string& message);
 
     void ErrorHtml_();
     std::string GetFileType_();
 
     int code_;
     bool isKeepAlive_;
+    bool isFile_;       // true 表示响应内容是 srcDir_ + path_ 对应的文件
 
     std::string path_;
     std::string srcDir_;
+
+    std::string body_;          // 非文件响应的响应体
+    std::string contentType_;   // 非文件响应的类型
+    std::vector<std::pair<std::string, std::string>> headers_;  // 处理函数额外添加的响应头
     
     char* mmFile_; 
     struct stat mmFileStat_;
@@ -0,0 +1,88 @@
+#include "httpResponseWriter.h"
+#include "httpContext.h"
+#include "http2Connection.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+
+HttpResponseWriter::HttpResponseWriter(const TcpConnectionPtr& conn, uint64_t seq, uint32_t streamId)
+    : conn_(conn),
+      loop_(conn->getLoop()),
+      seq_(seq),
+      streamId_(streamId),
+      finished_(false),
+      raw_(false),
+      route_(nullptr)
+{
+}
+
+HttpResponseWriter::~HttpResponseWriter()
+{
+    if (!finished_)
+    {
+        finish();
+    }
+}
+
+size_t HttpResponseWriter::sendRaw(Buffer* data)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || finished_)
+    {
+        return 0;
+    }
+    raw_ = true;
+    return HttpContext::stream(conn, seq_, data);
+}
+
+void HttpResponseWriter::onDrained(const std::function<void ()>& cb)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    HttpContext* context = conn ? static_cast<HttpContext*>(conn->getContext().get()) : nullptr;
+    if (context)
+    {
+        context->onDrained(cb);
+    }
+}
+
+void HttpResponseWriter::finish()
+{
+    if (finished_.exchange(true))
+    {
+        return;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        return;
+    }
+
+    // 响应在调用线程中生成（包括读文件），然后交给io线程按顺序发送
+    if (streamId_ != 0)
+    {
+        std::shared_ptr<Http2Response> resp(new Http2Response);
+        response_.MakeHttp2Response(resp->headers, resp->body);
+        if (route_)
+        {
+            // HTTP/2 的响应要经过流量控制，这里只统计到交给连接为止
+            route_->observe(response_.Code(), Timestamp::now().microSecondsSinceEpoch() - receiveTime_.microSecondsSinceEpoch());
+        }
+        loop_->runInLoop(std::bind(&Http2Connection::complete, conn, streamId_, resp));
+        return;
+    }
+    std::shared_ptr<Buffer> buf(new Buffer);
+    ResponseRecord record = { route_, response_.Code(), receiveTime_ };
+    if (raw_)
+    {
+        // 响应已经由 sendRaw 发完了，这里只是结束它
+        loop_->runInLoop(std::bind(&HttpContext::complete, conn, seq_, buf, !response_.IsKeepAlive(), record));
+        return;
+    }
+    response_.MakeResponse(*buf);
+    if(response_.FileLen() > 0 && response_.File()) {
+        buf->append(response_.File(), response_.FileLen());
+    }
+    response_.UnmapFile();
+
+    record.code = response_.Code();
+    loop_->runInLoop(std::bind(&HttpContext::complete, conn, seq_, buf, !response_.IsKeepAlive(), record));
+}
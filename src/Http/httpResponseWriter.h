@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+#include <atomic>
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "httpRequest.h"
+#include "httpResponse.h"
+#include "httpMetrics.h"
+
+class EventLoop;
+
+/**
+ * 异步响应对象，每个请求一个，交给路由处理函数
+ * 处理函数可以先返回，等数据库、定时器或者别的连接的结果到了之后再调用 finish，
+ * finish 可以在任意线程调用，最终会转到连接所属的 EventLoop 中按请求顺序发送。
+ * 如果一直没有调用 finish，析构的时候会用当前内容自动完成，防止后面的响应被卡住。
+ * HTTP/2 的请求 streamId 不为 0，响应发到对应的流上，不需要排序，seq 也不再使用。
+ */
+class HttpResponseWriter : noncopyable
+{
+public:
+    HttpResponseWriter(const TcpConnectionPtr& conn, uint64_t seq, uint32_t streamId = 0);
+    ~HttpResponseWriter();
+
+    HttpRequest& request() { return request_; }
+    HttpResponse* response() { return &response_; }
+
+    // 连接所属的loop，可以用来注册定时器等
+    EventLoop* getLoop() const { return loop_; }
+    uint32_t streamId() const { return streamId_; }
+    // 连接已经断开时返回空
+    TcpConnectionPtr connection() const { return conn_.lock(); }
+
+    // 统计用：请求属于哪个路由、什么时候收到的，由 HttpServer 设置
+    void setRouteMetrics(RouteMetrics* route) { route_ = route; }
+    void setReceiveTime(Timestamp receiveTime) { receiveTime_ = receiveTime; }
+    Timestamp receiveTime() const { return receiveTime_; }
+
+    /**
+     * 直接发送调用方已经编好帧的 HTTP/1.x 响应数据(状态行、首部、响应体)，用于代理这种边收边发的响应。
+     * 只能在连接所属的 loop 线程调用，发完之后调用 finish 结束，统计用的状态码和是否关闭连接取自 response()。
+     * 返回连接上还没写进 socket 的字节数，调用方据此决定要不要暂停生产数据
+     */
+    size_t sendRaw(Buffer* data);
+    // 连接的输出缓冲区写空时调用一次 cb，只能在连接所属的 loop 线程调用
+    void onDrained(const std::function<void ()>& cb);
+
+    // 完成响应，线程安全，只有第一次调用有效
+    void finish();
+    bool finished() const { return finished_; }
+
+private:
+    std::weak_ptr<TcpConnection> conn_; // 不延长连接的生命周期，连接断开后 finish 直接丢弃响应
+    EventLoop* loop_;
+    const uint64_t seq_;                // 请求在这个连接上的序号
+    const uint32_t streamId_;           // HTTP/2 的流 id，HTTP/1.x 为 0
+    HttpRequest request_;
+    HttpResponse response_;
+    std::atomic_bool finished_;
+    bool raw_;                          // 已经用 sendRaw 发过数据了
+    RouteMetrics* route_;
+    Timestamp receiveTime_;
+};
+
+using HttpResponseWriterPtr = std::shared_ptr<HttpResponseWriter>;
@@ -0,0 +1,310 @@
+#include "httpRouter.h"
+#include "Logging.h"
+
+/**
+ * 路由树节点
+ * 静态节点的 path 保存压缩后的一段公共前缀，参数节点和通配节点的 path 为空，只保存参数名
+ */
+struct HttpRouter::Node
+{
+    std::string path;               // 本节点对应的静态片段
+    std::string indices;            // 静态子节点的首字符，和 children 一一对应，查找时不用遍历子节点
+    std::vector<NodePtr> children;  // 静态子节点
+    NodePtr paramChild;             // :name 子节点
+    NodePtr wildChild;              // *name 子节点
+    std::string paramName;          // 参数名（仅参数节点和通配节点使用）
+    Handler handler;                // 不为空说明有路由在此处结束
+};
+
+HttpRouter::HttpRouter() = default;
+
+HttpRouter::~HttpRouter() = default;
+
+HttpRouter::Node* HttpRouter::root(const std::string& method) const
+{
+    for (const auto& tree : trees_)
+    {
+        if (tree.first == method)
+        {
+            return tree.second.get();
+        }
+    }
+    return nullptr;
+}
+
+bool HttpRouter::addRoute(const std::string& method, const std::string& pattern, const Handler& handler)
+{
+    if (pattern.empty() || pattern[0] != '/' || !handler)
+    {
+        LOG_ERROR << "invalid route pattern: " << pattern;
+        return false;
+    }
+    Node* node = root(method);
+    // 先把整个 pattern 检查完再改树，失败时不会留下插了一半的节点
+    if (!validate(node, pattern))
+    {
+        LOG_ERROR << "route conflict: " << method << " " << pattern;
+        return false;
+    }
+    if (node == nullptr)
+    {
+        trees_.emplace_back(method, NodePtr(new Node));
+        node = trees_.back().second.get();
+    }
+    if (!insert(node, pattern, 0, handler))
+    {
+        LOG_ERROR << "route conflict: " << method << " " << pattern;
+        return false;
+    }
+    LOG_DEBUG << "add route: " << method << " " << pattern;
+    return true;
+}
+
+// 把静态片段 seg 插入到 node 下面，返回 seg 结束位置对应的节点
+HttpRouter::Node* HttpRouter::insertStatic(Node* node, const std::string& seg)
+{
+    size_t pos = 0;
+    while (pos < seg.size())
+    {
+        size_t i = node->indices.find(seg[pos]);
+        // 没有相同首字符的子节点，直接挂一个新节点
+        if (i == std::string::npos)
+        {
+            NodePtr child(new Node);
+            child->path = seg.substr(pos);
+            Node* raw = child.get();
+            node->indices.push_back(seg[pos]);
+            node->children.push_back(std::move(child));
+            return raw;
+        }
+
+        Node* child = node->children[i].get();
+        size_t common = 0;
+        while (common < child->path.size() && pos + common < seg.size()
+               && child->path[common] == seg[pos + common])
+        {
+            ++common;
+        }
+
+        // 只有部分前缀相同，需要把子节点拆成 [0, common) 和 [common, end) 两段
+        if (common < child->path.size())
+        {
+            NodePtr tail(new Node);
+            tail->path = child->path.substr(common);
+            tail->indices.swap(child->indices);
+            tail->children.swap(child->children);
+            tail->paramChild = std::move(child->paramChild);
+            tail->wildChild = std::move(child->wildChild);
+            tail->handler.swap(child->handler);
+
+            child->path.resize(common);
+            child->indices.push_back(tail->path[0]);
+            child->children.push_back(std::move(tail));
+        }
+        node = child;
+        pos += common;
+    }
+    return node;
+}
+
+// 检查 pattern 的语法，并沿着已有的树检查同一位置的参数名是否冲突，不修改树，node 可以为空
+bool HttpRouter::validate(const Node* node, const std::string& pattern) const
+{
+    size_t pos = 0;
+    while (pos < pattern.size())
+    {
+        char c = pattern[pos];
+        if (c == ':' || c == '*')
+        {
+            // 参数只能是一个完整的路径片段
+            if (pattern[pos - 1] != '/')
+            {
+                return false;
+            }
+            size_t end = pattern.find('/', pos);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            if (end == pos + 1)
+            {
+                return false;
+            }
+            // 通配符必须在末尾
+            if (c == '*' && end != pattern.size())
+            {
+                return false;
+            }
+            if (node)
+            {
+                const Node* child = (c == ':') ? node->paramChild.get() : node->wildChild.get();
+                // 同一位置的参数名不同，例如 /user/:id 和 /user/:name
+                if (child && pattern.compare(pos + 1, end - pos - 1, child->paramName) != 0)
+                {
+                    return false;
+                }
+                node = child;
+            }
+            pos = end;
+        }
+        else
+        {
+            size_t end = pattern.find_first_of(":*", pos);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            // 沿着已有的静态节点往下走，走到树里没有的部分之后后面只需要检查语法
+            while (node && pos < end)
+            {
+                size_t i = node->indices.find(pattern[pos]);
+                if (i == std::string::npos)
+                {
+                    node = nullptr;
+                    break;
+                }
+                const Node* child = node->children[i].get();
+                if (child->path.size() > end - pos || pattern.compare(pos, child->path.size(), child->path) != 0)
+                {
+                    node = nullptr;
+                    break;
+                }
+                node = child;
+                pos += child->path.size();
+            }
+            pos = end;
+        }
+    }
+    return true;
+}
+
+// pattern 已经由 validate 检查过，这里只负责建节点
+bool HttpRouter::insert(Node* node, const std::string& pattern, size_t pos, const Handler& handler)
+{
+    while (pos < pattern.size())
+    {
+        char c = pattern[pos];
+        if (c == ':' || c == '*')
+        {
+            size_t end = pattern.find('/', pos);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            NodePtr& child = (c == ':') ? node->paramChild : node->wildChild;
+            if (!child)
+            {
+                child.reset(new Node);
+                child->paramName = pattern.substr(pos + 1, end - pos - 1);
+            }
+            node = child.get();
+            pos = end;
+        }
+        else
+        {
+            size_t end = pattern.find_first_of(":*", pos);
+            if (end == std::string::npos)
+            {
+                end = pattern.size();
+            }
+            node = insertStatic(node, pattern.substr(pos, end - pos));
+            pos = end;
+        }
+    }
+
+    // 重复注册，走到这里说明整条路径原本就在树里，没有新建节点
+    if (node->handler)
+    {
+        return false;
+    }
+    node->handler = handler;
+    return true;
+}
+
+// node 自身的片段已经匹配完毕，从 path[pos] 开始继续匹配
+const HttpRouter::Node* HttpRouter::find(const Node* node, const std::string& path, size_t pos, RouteParams* params) const
+{
+    if (pos == path.size())
+    {
+        if (node->handler)
+        {
+            return node;
+        }
+        // 允许 /static/*file 匹配 /static/，此时参数为空
+        const Node* wild = node->wildChild.get();
+        if (wild && params->push(&wild->paramName, pos, 0))
+        {
+            return wild;
+        }
+        return nullptr;
+    }
+
+    // 1. 静态子节点
+    size_t i = node->indices.find(path[pos]);
+    if (i != std::string::npos)
+    {
+        const Node* child = node->children[i].get();
+        if (path.compare(pos, child->path.size(), child->path) == 0)
+        {
+            const Node* found = find(child, path, pos + child->path.size(), params);
+            if (found)
+            {
+                return found;
+            }
+        }
+    }
+
+    // 2. 参数子节点，匹配到下一个 '/'
+    const Node* param = node->paramChild.get();
+    if (param)
+    {
+        size_t end = path.find('/', pos);
+        if (end == std::string::npos)
+        {
+            end = path.size();
+        }
+        if (end > pos && params->push(&param->paramName, pos, end - pos))
+        {
+            const Node* found = find(param, path, end, params);
+            if (found)
+            {
+                return found;
+            }
+            params->pop();
+        }
+    }
+
+    // 3. 通配子节点，吃掉剩下的全部路径
+    const Node* wild = node->wildChild.get();
+    if (wild && params->push(&wild->paramName, pos, path.size() - pos))
+    {
+        return wild;
+    }
+    return nullptr;
+}
+
+const HttpRouter::Handler* HttpRouter::match(const std::string& method, const std::string& path, RouteParams* params) const
+{
+    params->clear();
+    const Node* node = root(method);
+    if (node == nullptr || path.empty())
+    {
+        return nullptr;
+    }
+    const Node* found = find(node, path, 0, params);
+    return found ? &found->handler : nullptr;
+}
+
+bool HttpRouter::matchAnyMethod(const std::string& path) const
+{
+    RouteParams params;
+    for (const auto& tree : trees_)
+    {
+        if (find(tree.second.get(), path, 0, &params))
+        {
+            return true;
+        }
+        params.clear();
+    }
+    return false;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+
+#include "noncopyable.h"
+
+class HttpResponseWriter;
+
+/**
+ * 路由匹配出来的路径参数
+ * key 指向路由树节点里保存的参数名，value 用 (offset, len) 记录在请求路径中的位置，
+ * 这样匹配过程中不需要拷贝字符串，也不会有任何堆上的分配。
+ */
+struct RouteParam
+{
+    const std::string* key;
+    size_t offset;
+    size_t len;
+};
+
+class RouteParams
+{
+public:
+    static const int kMaxParams = 8;
+
+    RouteParams() : size_(0) {}
+
+    void clear() { size_ = 0; }
+    int size() const { return size_; }
+    const RouteParam& operator[](int i) const { return params_[i]; }
+
+    bool push(const std::string* key, size_t offset, size_t len)
+    {
+        if (size_ >= kMaxParams)
+        {
+            return false;
+        }
+        params_[size_].key = key;
+        params_[size_].offset = offset;
+        params_[size_].len = len;
+        ++size_;
+        return true;
+    }
+    void pop() { --size_; }
+
+private:
+    RouteParam params_[kMaxParams];
+    int size_;
+};
+
+// 基于压缩前缀树(radix trie)的路由表，每个请求方法一棵树
+// 支持三种路径片段：
+//   静态片段    /user/list
+//   路径参数    /user/:id        匹配到下一个 '/' 为止
+//   通配符      /static/*file    匹配剩余的全部路径，只能出现在末尾
+// 匹配优先级为 静态 > 参数 > 通配符，查找的代价只和路径长度有关，和路由数量无关。
+class HttpRouter : noncopyable
+{
+public:
+    // 处理函数拿到的是异步响应对象，同步的处理函数由 HttpServer::route 包装成这种形式
+    using Handler = std::function<void (const std::shared_ptr<HttpResponseWriter>&)>;
+
+    HttpRouter();
+    ~HttpRouter();
+
+    // 注册路由，pattern 非法或者和已有路由冲突时返回 false
+    bool addRoute(const std::string& method, const std::string& pattern, const Handler& handler);
+
+    // 查找路由，找不到返回 nullptr；params 中保存匹配到的路径参数
+    const Handler* match(const std::string& method, const std::string& path, RouteParams* params) const;
+
+    // 判断是否有其他方法可以匹配这个路径，用来区分 404 和 405
+    bool matchAnyMethod(const std::string& path) const;
+
+private:
+    struct Node;
+    using NodePtr = std::unique_ptr<Node>;
+
+    Node* insertStatic(Node* node, const std::string& seg);
+    bool validate(const Node* node, const std::string& pattern) const;
+    bool insert(Node* node, const std::string& pattern, size_t pos, const Handler& handler);
+    const Node* find(const Node* node, const std::string& path, size_t pos, RouteParams* params) const;
+    Node* root(const std::string& method) const;
+
+    std::vector<std::pair<std::string, NodePtr>> trees_;    // 方法数量很少，线性查找即可
+};
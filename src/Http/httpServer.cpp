@@ -1,6 +1,8 @@
 
 #include "httpServer.h"
 #include "httpRequest.h"
+#include "httpContext.h"
+#include "http2Connection.h"
 #include "sqlConnectPool.h"
 
 HttpServer::HttpServer(EventLoop *loop, const InetAddress& listenAddr,const std::string& name,int loopThreadNum,
@@ -8,7 +10,23 @@ HttpServer::HttpServer(EventLoop *loop, const InetAddress& listenAddr,const std:
             uint16_t sqlPort, int sqlPoolMinNum,int sqlPoolMaxNum,int sqlTimeOut,int sqlMaxLiveTime,
             TcpServer::Option option
             )
-  : server_(loop, listenAddr, name, option)
+  : HttpServer(loop, listenAddr, name, loopThreadNum, option)
+{
+    //初始化数据库 ,后边的参数是按照默认的
+    LOG_DEBUG<<"ready to connect the sql";
+    SqlConnPool::getInstance()->Init(sqlUser,sqlPwd,dbName,localHost,sqlPort,sqlPoolMinNum,sqlPoolMaxNum,sqlTimeOut,sqlMaxLiveTime);
+
+    // 静态文件也只是其中一个路由，其他路由优先匹配
+    // 登录和注册页面的 POST 要查数据库，所以只有连接池初始化过的时候才注册
+    route("GET", "/*filepath", std::bind(&HttpServer::onStaticFile, this, std::placeholders::_1, std::placeholders::_2));
+    route("POST", "/*filepath", std::bind(&HttpServer::onStaticFile, this, std::placeholders::_1, std::placeholders::_2));
+}
+
+HttpServer::HttpServer(EventLoop *loop, const InetAddress& listenAddr, const std::string& name, int loopThreadNum,
+            TcpServer::Option option)
+  : server_(loop, listenAddr, name, option),
+    maxBodySize_(HttpRequest::kDefaultMaxBodySize),
+    unmatched_(newRouteMetrics("*", "none"))
 {
     LOG_DEBUG<<"这个是把httpServer 中的 setConnectionCallback";
     server_.setConnectionCallback(
@@ -17,19 +35,84 @@ HttpServer::HttpServer(EventLoop *loop, const InetAddress& listenAddr,const std:
     //这个是把httpServer中的HttpServer::onMessage与TcpServer的绑定
     server_.setMessageCallback(
         std::bind(&HttpServer::onMessage, this, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3));
-    
-    //这个是设置写完的回调，可以关闭连接。
+
+    // 输出缓冲区写空时记录还没记录的响应延迟
     server_.setWriteCompleteCallback(
-        std::bind(&HttpServer::onDestroy,this,std::placeholders::_1));
-    //初始化数据库 ,后边的参数是按照默认的
-    LOG_DEBUG<<"ready to connect the sql";
-    SqlConnPool::getInstance()->Init(sqlUser,sqlPwd,dbName,localHost,sqlPort,sqlPoolMinNum,sqlPoolMaxNum,sqlTimeOut,sqlMaxLiveTime);
+        std::bind(&HttpServer::onWriteComplete, this, std::placeholders::_1));
 
     server_.setThreadNum(loopThreadNum);
     srcDir_ = getcwd(nullptr, 256);
     strcat(srcDir_, "/resources/");
 }
 
+RouteMetrics* HttpServer::newRouteMetrics(const std::string& method, const std::string& pattern)
+{
+    routeMetrics_.emplace_back(new RouteMetrics(method, pattern));
+    return routeMetrics_.back().get();
+}
+
+bool HttpServer::route(const std::string& method, const std::string& pattern, const HttpCallback& cb)
+{
+    RouteMetrics* metrics = newRouteMetrics(method, pattern);
+    // 同步的处理函数返回时响应就已经完成了
+    return router_.addRoute(method, pattern, [cb, metrics](const HttpResponseWriterPtr& writer) {
+        writer->setRouteMetrics(metrics);
+        cb(writer->request(), writer->response());
+        writer->finish();
+    });
+}
+
+bool HttpServer::routeAsync(const std::string& method, const std::string& pattern, const AsyncHttpCallback& cb)
+{
+    RouteMetrics* metrics = newRouteMetrics(method, pattern);
+    return router_.addRoute(method, pattern, [cb, metrics](const HttpResponseWriterPtr& writer) {
+        writer->setRouteMetrics(metrics);
+        cb(writer);
+    });
+}
+
+bool HttpServer::routeUpload(const std::string& method, const std::string& pattern, const UploadCallback& cb)
+{
+    RouteMetrics* metrics = newRouteMetrics(method, pattern);
+    // 回调先放在 writer 的请求上，startBody 再把它转到正在解析的请求上
+    return uploadRouter_.addRoute(method, pattern, [cb, metrics](const HttpResponseWriterPtr& writer) {
+        writer->setRouteMetrics(metrics);
+        writer->request().SetBodyCallback(cb(writer));
+    });
+}
+
+bool HttpServer::routeProxy(const std::string& pattern, const std::shared_ptr<HttpProxy>& proxy)
+{
+    static const char* kMethods[] = { "GET", "HEAD", "POST", "PUT", "DELETE", "PATCH", "OPTIONS" };
+    HttpProxy* p = proxy.get();
+    for(const char* method : kMethods) {
+        if(!routeAsync(method, pattern, [p](const HttpResponseWriterPtr& writer) { p->handle(writer); })) {
+            return false;
+        }
+    }
+    proxies_.push_back(proxy);
+    return true;
+}
+
+void HttpServer::enableMetrics(const std::string& path)
+{
+    route("GET", path, [](const HttpRequest&, HttpResponse* resp) {
+        resp->SetContentType("text/plain; version=0.0.4");
+        resp->SetBody(MetricsRegistry::instance().scrape());
+    });
+}
+
+void HttpServer::setRateLimit(double requestsPerSecond, double burst, int maxConnectionsPerIp, int maxConnections)
+{
+    limiter_.reset(new RateLimiter(requestsPerSecond, burst, maxConnectionsPerIp, maxConnections));
+    server_.setRateLimiter(limiter_.get());
+}
+
+void HttpServer::onStaticFile(const HttpRequest& req, HttpResponse* resp)
+{
+    resp->SetFile(req.filePath());
+}
+
 //这个是在tcpserver中当新连接建立得时候会被调用。
 /**
  * ioLoop->runInLoop(
@@ -46,55 +129,285 @@ void HttpServer::onConnection(const TcpConnectionPtr& conn)
     if (conn->connected())
     {
         LOG_DEBUG << "new Connection arrived";
+        std::shared_ptr<HttpContext> context = std::make_shared<HttpContext>();
+        context->request().SetMaxBodySize(maxBodySize_);
+        conn->setContext(context);
     }
     else 
     {
-        LOG_INFO << "Connection closed";
+        LOG_INFO << "Connection closed" << LogField("conn", conn->name());
+        HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+        if(context && context->webSocket()) {
+            context->webSocket()->onDisconnected();
+        }
+        if(context && context->upload()) {
+            // 上传到一半断开了，回调里持有的资源(比如打开的文件)现在就释放
+            context->request().Init();
+            context->setUpload(nullptr);
+        }
     }
 }
 
-//消息发送完的业务处理。
-void HttpServer::onDestroy(const TcpConnectionPtr& conn){
-    conn->shutdown(); //这个发送消息后直接断开。
-    
-}
-
-
 // 有消息到来时的业务处理
+// 一次可能收到多个请求(pipeline)，也可能只收到半个请求，没解析完的请求保存在连接的上下文中
 void HttpServer::onMessage(const TcpConnectionPtr& conn,
                            Buffer* buf,
                            Timestamp receiveTime)
 {
-    HttpResponse response_;
     LOG_DEBUG<< "onMessage on : "<<receiveTime.toFormattedString();
-    HttpRequest res;
-    
-    if(!res.parse(*buf))
+    HttpContext* context = static_cast<HttpContext*>(conn->getContext().get());
+
+    if(context->http2()) {
+        context->http2()->onMessage(buf);
+        return;
+    }
+    if(context->webSocket()) {
+        context->webSocket()->onMessage(buf);
+        return;
+    }
+    // 连接上的第一个请求之前先看是不是 HTTP/2 的连接前言(prior knowledge)
+    if(context->fresh() && context->request().IsEmpty()) {
+        int ret = Http2Connection::matchPreface(*buf);
+        if(ret == 0) {
+            return;     // 数据还不够判断
+        }
+        if(ret > 0) {
+            LOG_DEBUG << "http2 with prior knowledge";
+            context->setHttp2(new Http2Connection(conn, std::bind(&HttpServer::onRequest, this, std::placeholders::_1), maxBodySize_));
+            context->http2()->start();
+            context->http2()->onMessage(buf);
+            return;
+        }
+    }
+
+    while(!context->closing())
     {
-            //如果解析错误，则直接输出
-        LOG_ERROR << "parseRequest failed!";
-        conn->send("HTTP/1.1 400 Bad Request\r\n\r\n");
-        conn->shutdown();
-    }
-    //判断是不是keep-alieve
-    bool close = res.IsKeepAlive();
-    LOG_DEBUG<<res.path();
-    response_.Init(srcDir_,res.path(),close,200);
-    Buffer buff;
-    response_.MakeResponse(buff);
-    // 响应头
-    LOG_DEBUG<<conn->socket_->fd()<<" file: "<<res.path()<<"\tbuff size:"<<buff.readableBytes();
-    // 文件
-    if(response_.FileLen() > 0  && response_.File()) {
-        buff.append(response_.File(),response_.FileLen());
-    }
-   
-    conn->send(&buff);
-    
+        HttpRequest& req = context->request();
+        if(req.IsEmpty() && buf->readableBytes() > 0) {
+            context->setReceiveTime(receiveTime);   // 延迟从读到请求第一个字节的那次 poll 开始算
+            // 新请求的第一个字节到了就检查令牌，超限的请求不用再解析
+            if(limiter_ && !limiter_->allowRequest(conn->peerAddress(), receiveTime)) {
+                onRateLimited(conn, context);
+                break;
+            }
+        }
+        if(!req.parse(*buf))
+        {
+            onParseError(conn, context);
+            break;
+        }
+        if(req.HeadersDone())
+        {
+            if(!startBody(conn, context))
+            {
+                onParseError(conn, context);
+                break;
+            }
+            continue;   // 请求体可能已经在 buf 里了
+        }
+        if(!req.IsFinish())
+        {
+            break;  // 等剩下的数据
+        }
+        if(context->upload()) {
+            // 流式上传的请求体已经交给处理函数了，响应也由它完成
+            HttpResponseWriterPtr writer = context->upload();
+            context->setUpload(nullptr);
+            if(!writer->request().IsKeepAlive()) {
+                context->setClosing();
+            }
+            req.Init();
+            continue;
+        }
+        if(upgradeHttp2(conn, context)) {
+            // 101 之后剩下的数据是客户端的连接前言和 HTTP/2 的帧
+            context->http2()->onMessage(buf);
+            return;
+        }
+        if(upgradeWebSocket(conn, context)) {
+            // 握手之后剩下的数据已经是 WebSocket 的帧了
+            if(buf->readableBytes() > 0) {
+                context->webSocket()->onMessage(buf);
+            }
+            return;
+        }
+
+        HttpResponseWriterPtr writer(new HttpResponseWriter(conn, context->nextSeq()));
+        writer->setReceiveTime(context->receiveTime());
+        writer->request() = std::move(req);
+        req.Init();
+        //不是keep-alive的话，这个请求之后的数据都不再处理
+        if(!writer->request().IsKeepAlive())
+        {
+            context->setClosing();
+        }
+        onRequest(writer);
+    }
+    if(context->closing())
+    {
+        buf->retrieveAll();
+    }
+}
+
+// 首部收完了，请求体还没开始收：匹配到上传路由的话，请求体直接交给处理函数
+bool HttpServer::startBody(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    HttpRequest& req = context->request();
+    bool idle = context->idle();
+    RouteParams params;
+    const HttpRouter::Handler* handler = uploadRouter_.match(req.method(), req.path(), &params);
+    if(handler) {
+        HttpResponseWriterPtr writer(new HttpResponseWriter(conn, context->nextSeq()));
+        writer->setReceiveTime(context->receiveTime());
+        writer->request() = req;
+        writer->request().params() = params;
+        std::string noFile;
+        writer->response()->Init(srcDir_, noFile, req.IsKeepAlive(), 200);
+        context->setUpload(writer);
+        (*handler)(writer);
+        req.SetBodyCallback(writer->request().bodyCallback());
+        writer->request().SetBodyCallback(nullptr);
+    }
+    if(!req.StartBody()) {
+        return false;
+    }
+    // 客户端在等 100 Continue 才发请求体，前面还有响应没发完时不能插进去，客户端超时之后也会直接发
+    if(idle && req.ExpectsContinue()) {
+        conn->send(std::string("HTTP/1.1 100 Continue\r\n\r\n"));
+    }
+    return true;
+}
+
+// 解析错误按顺序返回错误码后关闭连接，流式上传的请求用首部收完时创建的响应对象
+void HttpServer::onParseError(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    HttpRequest& req = context->request();
+    HttpResponseWriterPtr writer = context->upload();
+    context->setUpload(nullptr);
+    if(!writer) {
+        writer.reset(new HttpResponseWriter(conn, context->nextSeq()));
+        writer->setReceiveTime(context->receiveTime());
+        writer->setRouteMetrics(unmatched_);
+    }
+    int code = req.ErrorCode();
+    LOG_ERROR << "parseRequest failed! " << code;
+    if(code != 0) {
+        std::string noFile;
+        writer->response()->Init(srcDir_, noFile, false, code);
+    } else {
+        writer->response()->SetKeepAlive(false);    // 处理函数中止了上传，响应由它给出
+    }
+    req.Init();     // 释放请求体回调
+    writer->finish();
+    context->setClosing();
+}
+
+// 请求没有解析，不知道它在哪里结束，返回 429 之后关闭连接
+void HttpServer::onRateLimited(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    HttpResponseWriterPtr writer(new HttpResponseWriter(conn, context->nextSeq()));
+    writer->setReceiveTime(context->receiveTime());
+    writer->setRouteMetrics(unmatched_);
+    std::string noFile;
+    writer->response()->Init(srcDir_, noFile, false, 429);
+    writer->response()->AddHeader("Retry-After", "1");
+    writer->finish();
+    context->setClosing();
+}
+
+// 升级请求本身作为 stream 1 处理，前面还有没完成的响应时不升级，继续用 HTTP/1.1
+bool HttpServer::upgradeHttp2(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    HttpRequest& req = context->request();
+    if(strcasecmp(req.GetHeader("Upgrade").c_str(), "h2c") != 0 || !context->idle()) {
+        return false;
+    }
+    std::string settings = req.GetHeader("HTTP2-Settings");
+    if(settings.empty()) {
+        return false;
+    }
+    // 处理函数可能同步完成响应，所以要先挂到上下文上再开始处理 stream 1
+    context->setHttp2(new Http2Connection(conn, std::bind(&HttpServer::onRequest, this, std::placeholders::_1), maxBodySize_));
+    if(!context->http2()->startUpgrade(req, settings)) {
+        context->setHttp2(nullptr);
+        return false;
+    }
+    LOG_DEBUG << "upgrade to h2c";
+    req.Init();
+    return true;
+}
+
+// 只接受版本 13，路径没有注册的当作普通请求处理，最后会得到 404
+bool HttpServer::upgradeWebSocket(const TcpConnectionPtr& conn, HttpContext* context)
+{
+    HttpRequest& req = context->request();
+    std::string handshake;
+    if(!context->idle() || !WebSocketConnection::handshake(req, &handshake)) {
+        return false;
+    }
+    auto it = wsHandlers_.find(req.path());
+    if(it == wsHandlers_.end()) {
+        return false;
+    }
+
+    WebSocketConnectionPtr ws(new WebSocketConnection(conn, it->second));
+    context->setWebSocket(ws);
+    LOG_DEBUG << "upgrade to websocket " << req.path();
+    ws->start(req, handshake);
+    req.Init();
+    return true;
+}
+
+void HttpServer::onRequest(const HttpResponseWriterPtr& writer)
+{
+    HttpRequest& req = writer->request();
+    LOG_DEBUG<<req.path();
+    if(writer->receiveTime() == Timestamp::invalid()) {
+        writer->setReceiveTime(Timestamp::now());   // HTTP/2 的请求在帧解析完时才有 writer
+    }
+    std::string noFile;
+    writer->response()->Init(srcDir_, noFile, req.IsKeepAlive(), 200);
+    // HTTP/1.x 的请求在 onMessage 里已经检查过了，HTTP/2 的每个流在这里检查，只拒绝这个流
+    if(limiter_ && writer->streamId() != 0) {
+        TcpConnectionPtr conn = writer->connection();
+        if(conn && !limiter_->allowRequest(conn->peerAddress(), writer->receiveTime())) {
+            writer->setRouteMetrics(unmatched_);
+            writer->response()->SetCode(429);
+            writer->response()->AddHeader("Retry-After", "1");
+            writer->finish();
+            return;
+        }
+    }
+    // 路由分发，路径存在但是方法不对返回405，否则返回404
+    const HttpRouter::Handler* handler = router_.match(req.method(), req.path(), &req.params());
+    if(handler)
+    {
+        (*handler)(writer);
+    }
+    else
+    {
+        writer->setRouteMetrics(unmatched_);
+        writer->response()->SetCode(router_.matchAnyMethod(req.path()) ? 405 : 404);
+        writer->finish();
+    }
+}
+
+void HttpServer::onWriteComplete(const TcpConnectionPtr& conn)
+{
+    HttpContext::writeComplete(conn);
 }
 
 void HttpServer::start()
 {
     LOG_INFO << "HttpServer[" << server_.name().c_str() << "] starts listening on " << server_.ipPort().c_str();
+    if(limiter_) {
+        RateLimiter* limiter = limiter_.get();
+        getLoop()->runEvery(RateLimiter::kExpireInterval, [limiter]() {
+            limiter->expire(Timestamp::now());
+        });
+    }
+    for(auto& proxy : proxies_) {
+        proxy->start(getLoop());
+    }
     server_.start();
 }
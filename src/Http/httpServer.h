@@ -1,36 +1,100 @@
 #pragma once
 #include "noncopyable.h"
 #include "TcpServer.h"
+#include "httpRequest.h"
 #include "httpResponse.h"
+#include "httpRouter.h"
+#include "httpResponseWriter.h"
 #include "TimerQueue.h"
-class HttpRequest;
+#include "webSocket.h"
+#include "httpMetrics.h"
+#include "httpProxy.h"
+#include <unordered_map>
+#include <vector>
+#include <memory>
+class HttpContext;
 
 
 class HttpServer :noncopyable
 {
 public:
     using HttpCallback = std::function<void (const HttpRequest&, HttpResponse*)>;
+    // 异步处理函数，处理完成后调用 writer->finish()，可以在任意线程调用
+    using AsyncHttpCallback = std::function<void (const HttpResponseWriterPtr&)>;
 
     HttpServer(EventLoop *loop, const InetAddress& listenAddr,const std::string& name,int loopThreadNum,
             const std::string sqlUser, const std::string sqlPwd, const std::string dbName, const std::string localHost, 
             uint16_t sqlPort=3306, int sqlPoolMinNum=1,int sqlPoolMaxNum=4,int sqlTimeOut=1000,int sqlMaxLiveTime=6000000
             ,TcpServer::Option option = TcpServer::kNoReusePort);
+    // 不初始化数据库连接池，也不注册静态文件路由，只有自己注册的路由，其余的返回 404，压测或者只用路由的时候使用
+    HttpServer(EventLoop *loop, const InetAddress& listenAddr, const std::string& name, int loopThreadNum,
+            TcpServer::Option option = TcpServer::kNoReusePort);
     
     void setHttpCallback(const HttpCallback& cb)
     {
         httpCallback_ = cb;
     }
+    // 注册路由，需要在 start 之前调用
+    // pattern 支持 /user/:id 形式的路径参数和 /static/*file 形式的通配符，
+    // 参数通过 HttpRequest::param 获取。带数据库的构造函数默认注册了 GET/POST /*filepath 的静态文件路由。
+    bool route(const std::string& method, const std::string& pattern, const HttpCallback& cb);
+    // 注册异步路由，处理函数返回时响应不一定完成，io线程不会被阻塞
+    bool routeAsync(const std::string& method, const std::string& pattern, const AsyncHttpCallback& cb);
+    /**
+     * 注册流式上传路由，首部收完时就调用 cb，cb 返回的回调按收到的顺序接收请求体，
+     * 请求体不在内存中累积，结束时(data 为 nullptr)由它调用 writer->finish() 完成响应
+     */
+    using UploadCallback = std::function<HttpRequest::BodyCallback (const HttpResponseWriterPtr&)>;
+    bool routeUpload(const std::string& method, const std::string& pattern, const UploadCallback& cb);
+    // 请求体的上限，超过的请求返回 413 并关闭连接(HTTP/2 只重置这个流)，流式上传的不受限制，需要在 start 之前调用
+    void setMaxBodySize(size_t size) { maxBodySize_ = size; }
+    // 注册 WebSocket 路径，路径是精确匹配，需要在 start 之前调用
+    void routeWebSocket(const std::string& path, const WebSocketHandler& handler)
+    {
+        wsHandlers_[path] = handler;
+    }
+    /**
+     * 在 path 上提供 Prometheus 格式的指标：每个路由按状态码的请求数和延迟直方图，
+     * 每个 loop 的连接数和待执行任务数，收发字节数，数据库连接池的等待时间。需要在 start 之前调用
+     */
+    void enableMetrics(const std::string& path = "/metrics");
+    /**
+     * 按对端 IP 限流，需要在 start 之前调用，参数为 0 表示不限制这一项
+     * 每个 IP 每秒 requestsPerSecond 个请求、最多突发 burst 个，超过的请求不再解析，直接返回 429；
+     * 每个 IP 最多 maxConnectionsPerIp 个连接，总共最多 maxConnections 个，超过的连接 accept 之后直接关闭
+     */
+    void setRateLimit(double requestsPerSecond, double burst, int maxConnectionsPerIp, int maxConnections);
+    // 把匹配 pattern 的请求转发给 proxy 的上游，pattern 一般是 /api/*path 这种通配符，
+    // 转发时保留原始路径。需要在 start 之前调用，proxy 的健康检查在 start 时开始
+    bool routeProxy(const std::string& pattern, const std::shared_ptr<HttpProxy>& proxy);
     EventLoop* getLoop() const { return server_.getLoop(); }
+    // 每个 io 线程的 loop 创建之后在该线程里调用，比如绑定 cpu，需要在 start 之前调用
+    void setThreadInitCallback(const TcpServer::ThreadInitCallback& cb) { server_.setThreadInitCallback(cb); }
     void start();
 private:
     void onConnection(const TcpConnectionPtr& conn);
     void onMessage(const TcpConnectionPtr &conn,
                     Buffer *buf,
                     Timestamp receiveTime);
-    void onRequest(const TcpConnectionPtr& conn, const HttpRequest& req);
-    void onDestroy(const TcpConnectionPtr& conn); //这个应该是删除连接，写完删或者到期删！！！  待实现。
+    void onRequest(const HttpResponseWriterPtr& writer);
+    void onWriteComplete(const TcpConnectionPtr& conn);
+    void onRateLimited(const TcpConnectionPtr& conn, HttpContext* context);
+    RouteMetrics* newRouteMetrics(const std::string& method, const std::string& pattern);
+    bool upgradeHttp2(const TcpConnectionPtr& conn, HttpContext* context); // HTTP/1.1 Upgrade: h2c
+    bool startBody(const TcpConnectionPtr& conn, HttpContext* context);   // 首部收完，开始接收请求体
+    void onParseError(const TcpConnectionPtr& conn, HttpContext* context);
+    bool upgradeWebSocket(const TcpConnectionPtr& conn, HttpContext* context); // Upgrade: websocket
+    void onStaticFile(const HttpRequest& req, HttpResponse* resp);  // 静态文件路由
     TcpServer server_;
     HttpCallback httpCallback_;
+    HttpRouter router_;
+    HttpRouter uploadRouter_;
+    size_t maxBodySize_;
+    std::unordered_map<std::string, WebSocketHandler> wsHandlers_;
+    std::vector<std::unique_ptr<RouteMetrics>> routeMetrics_;
+    RouteMetrics* unmatched_;       // 没有匹配到路由的请求和解析错误
+    std::unique_ptr<RateLimiter> limiter_;
+    std::vector<std::shared_ptr<HttpProxy>> proxies_;
     //std::unordered_map<int, HttpConn> users_;//这个是用来保存新连接，其实和ConnectionMap connections_;这个差不多一样
     char* srcDir_;
     struct iovec iov_[2];
@@ -0,0 +1,50 @@
+// 压测模式下 /favicon.ico 直接返回的 16x16 PNG，不读磁盘
+char favicon[555] = {
+    '\x89', '\x50', '\x4e', '\x47', '\x0d', '\x0a', '\x1a', '\x0a', '\x00', '\x00', '\x00', '\x0d',
+    '\x49', '\x48', '\x44', '\x52', '\x00', '\x00', '\x00', '\x10', '\x00', '\x00', '\x00', '\x10',
+    '\x08', '\x03', '\x00', '\x00', '\x00', '\x28', '\x2d', '\x0f', '\x53', '\x00', '\x00', '\x00',
+    '\xb1', '\x50', '\x4c', '\x54', '\x45', '\x00', '\x00', '\x00', '\xff', '\xff', '\xff', '\x28',
+    '\x6e', '\xdc', '\x29', '\x6f', '\xdb', '\x2a', '\x71', '\xda', '\x2b', '\x72', '\xd9', '\x2c',
+    '\x74', '\xd9', '\x2d', '\x76', '\xd8', '\x2e', '\x77', '\xd7', '\x2f', '\x79', '\xd7', '\x30',
+    '\x7a', '\xd6', '\x31', '\x7c', '\xd5', '\x32', '\x7e', '\xd4', '\x33', '\x7f', '\xd4', '\x34',
+    '\x81', '\xd3', '\x35', '\x82', '\xd2', '\x37', '\x84', '\xd2', '\x38', '\x86', '\xd1', '\x39',
+    '\x87', '\xd0', '\x3a', '\x89', '\xcf', '\x3b', '\x8a', '\xcf', '\x3c', '\x8c', '\xce', '\x3d',
+    '\x8e', '\xcd', '\x3e', '\x8f', '\xcd', '\x3f', '\x91', '\xcc', '\x40', '\x92', '\xcb', '\x41',
+    '\x94', '\xca', '\x42', '\x96', '\xca', '\x43', '\x97', '\xc9', '\x44', '\x99', '\xc8', '\x46',
+    '\x9b', '\xc8', '\x47', '\x9c', '\xc7', '\x48', '\x9e', '\xc6', '\x49', '\x9f', '\xc5', '\x4a',
+    '\xa1', '\xc5', '\x4b', '\xa3', '\xc4', '\x4c', '\xa4', '\xc3', '\x4d', '\xa6', '\xc3', '\x4e',
+    '\xa7', '\xc2', '\x4f', '\xa9', '\xc1', '\x50', '\xab', '\xc0', '\x51', '\xac', '\xc0', '\x52',
+    '\xae', '\xbf', '\x53', '\xaf', '\xbe', '\x55', '\xb1', '\xbe', '\x56', '\xb3', '\xbd', '\x57',
+    '\xb4', '\xbc', '\x58', '\xb6', '\xbb', '\x59', '\xb7', '\xbb', '\x5a', '\xb9', '\xba', '\x5b',
+    '\xbb', '\xb9', '\x5c', '\xbc', '\xb9', '\x5d', '\xbe', '\xb8', '\x5e', '\xbf', '\xb7', '\x5f',
+    '\xc1', '\xb6', '\x60', '\xc3', '\xb6', '\x61', '\xc4', '\xb5', '\x62', '\xc6', '\xb4', '\x64',
+    '\xc8', '\xb4', '\xe9', '\x87', '\x3e', '\x91', '\x00', '\x00', '\x00', '\x0e', '\x74', '\x52',
+    '\x4e', '\x53', '\x00', '\xff', '\xff', '\xff', '\xff', '\xff', '\xff', '\xff', '\xff', '\xff',
+    '\xff', '\xff', '\xff', '\xff', '\x57', '\x4a', '\xdb', '\x14', '\x00', '\x00', '\x01', '\x1b',
+    '\x49', '\x44', '\x41', '\x54', '\x78', '\x01', '\x01', '\x10', '\x01', '\xef', '\xfe', '\x00',
+    '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00',
+    '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x02', '\x02', '\x02', '\x02', '\x03', '\x03',
+    '\x03', '\x04', '\x04', '\x04', '\x04', '\x05', '\x05', '\x05', '\x00', '\x00', '\x00', '\x06',
+    '\x06', '\x06', '\x06', '\x07', '\x07', '\x07', '\x08', '\x08', '\x08', '\x08', '\x09', '\x09',
+    '\x09', '\x00', '\x00', '\x00', '\x0a', '\x0a', '\x01', '\x0b', '\x0b', '\x0b', '\x0b', '\x0c',
+    '\x0c', '\x0c', '\x0d', '\x01', '\x0d', '\x0d', '\x00', '\x00', '\x00', '\x0e', '\x0e', '\x01',
+    '\x01', '\x0f', '\x0f', '\x0f', '\x10', '\x10', '\x10', '\x01', '\x01', '\x11', '\x11', '\x00',
+    '\x00', '\x00', '\x12', '\x12', '\x01', '\x13', '\x01', '\x13', '\x14', '\x14', '\x14', '\x01',
+    '\x15', '\x01', '\x15', '\x16', '\x00', '\x00', '\x00', '\x16', '\x16', '\x01', '\x17', '\x17',
+    '\x01', '\x18', '\x18', '\x01', '\x18', '\x19', '\x01', '\x19', '\x1a', '\x00', '\x00', '\x00',
+    '\x1a', '\x1a', '\x01', '\x1b', '\x1b', '\x1b', '\x01', '\x01', '\x1c', '\x1d', '\x1d', '\x01',
+    '\x1d', '\x1e', '\x00', '\x00', '\x00', '\x1e', '\x1e', '\x01', '\x1f', '\x1f', '\x1f', '\x01',
+    '\x01', '\x20', '\x21', '\x21', '\x01', '\x21', '\x22', '\x00', '\x00', '\x00', '\x22', '\x22',
+    '\x01', '\x23', '\x23', '\x24', '\x24', '\x24', '\x24', '\x25', '\x25', '\x01', '\x26', '\x26',
+    '\x00', '\x00', '\x00', '\x26', '\x26', '\x01', '\x27', '\x27', '\x28', '\x28', '\x28', '\x28',
+    '\x29', '\x29', '\x01', '\x2a', '\x2a', '\x00', '\x00', '\x00', '\x2a', '\x2b', '\x01', '\x2b',
+    '\x2b', '\x2c', '\x2c', '\x2c', '\x2d', '\x2d', '\x2d', '\x01', '\x2e', '\x2e', '\x00', '\x00',
+    '\x00', '\x2e', '\x2f', '\x01', '\x2f', '\x2f', '\x30', '\x30', '\x30', '\x31', '\x31', '\x31',
+    '\x01', '\x32', '\x32', '\x00', '\x00', '\x00', '\x32', '\x33', '\x33', '\x33', '\x34', '\x34',
+    '\x34', '\x34', '\x35', '\x35', '\x35', '\x36', '\x36', '\x36', '\x00', '\x00', '\x00', '\x36',
+    '\x37', '\x37', '\x37', '\x38', '\x38', '\x38', '\x38', '\x39', '\x39', '\x39', '\x3a', '\x3a',
+    '\x3a', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00',
+    '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x00', '\x36', '\x89', '\x13', '\xb9', '\x06',
+    '\xf6', '\x35', '\x62', '\x00', '\x00', '\x00', '\x00', '\x49', '\x45', '\x4e', '\x44', '\xae',
+    '\x42', '\x60', '\x82',
+};
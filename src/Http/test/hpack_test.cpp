@@ -0,0 +1,177 @@
+#include "hpack.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+
+// RFC 7541 附录 C 中的例子都是十六进制字符串
+static std::string fromHex(const std::string& hex)
+{
+    std::string out;
+    for (size_t i = 0; i + 1 < hex.size(); i += 2)
+    {
+        out.push_back(static_cast<char>(std::stoi(hex.substr(i, 2), nullptr, 16)));
+    }
+    return out;
+}
+
+static std::string huffman(const std::string& str)
+{
+    std::string out;
+    hpack::huffmanEncode(str, &out);
+    assert(out.size() == hpack::huffmanEncodedLength(str));
+    return out;
+}
+
+static bool unhuffman(const std::string& data, std::string* out)
+{
+    out->clear();
+    return hpack::huffmanDecode(reinterpret_cast<const uint8_t*>(data.data()), data.size(), out);
+}
+
+static void testInteger()
+{
+    std::string out;
+    hpack::encodeInteger(&out, 0x00, 5, 10);
+    assert(out == fromHex("0a"));
+    out.clear();
+    hpack::encodeInteger(&out, 0x00, 5, 1337);
+    assert(out == fromHex("1f9a0a"));
+    out.clear();
+    hpack::encodeInteger(&out, 0x00, 8, 42);
+    assert(out == fromHex("2a"));
+
+    const uint8_t* p = reinterpret_cast<const uint8_t*>("\x1f\x9a\x0a");
+    uint64_t value = 0;
+    assert(hpack::decodeInteger(&p, p + 3, 5, &value) && value == 1337);
+    // 数据不完整
+    p = reinterpret_cast<const uint8_t*>("\x1f\x9a");
+    assert(!hpack::decodeInteger(&p, p + 2, 5, &value));
+}
+
+static void testHuffman()
+{
+    const char* cases[][2] = {
+        { "www.example.com", "f1e3c2e5f23a6ba0ab90f4ff" },
+        { "no-cache", "a8eb10649cbf" },
+        { "custom-key", "25a849e95ba97d7f" },
+        { "custom-value", "25a849e95bb8e8b4bf" },
+        { "302", "6402" },
+        { "private", "aec3771a4b" },
+        { "Mon, 21 Oct 2013 20:13:21 GMT", "d07abe941054d444a8200595040b8166e082a62d1bff" },
+        { "https://www.example.com", "9d29ad171863c78f0b97c8e9ae82ae43d3" },
+    };
+    std::string decoded;
+    for (const auto& c : cases)
+    {
+        assert(huffman(c[0]) == fromHex(c[1]));
+        assert(unhuffman(fromHex(c[1]), &decoded) && decoded == c[0]);
+    }
+
+    // 所有字节值都能往返
+    std::string all;
+    for (int i = 0; i < 256; ++i)
+    {
+        all.push_back(static_cast<char>(i));
+    }
+    assert(unhuffman(huffman(all), &decoded) && decoded == all);
+
+    // 填充不是全1、填充超过7位、出现 EOS 都是错误
+    assert(!unhuffman(fromHex("00"), &decoded));
+    assert(!unhuffman(fromHex("1fff"), &decoded));
+    assert(!unhuffman(fromHex("ffffffff"), &decoded));
+}
+
+// RFC 7541 C.4，同一个解码器连续解码三个请求，动态表依次增长
+static void testDecoder()
+{
+    HpackDecoder decoder;
+    HpackHeaderList headers;
+
+    std::string block = fromHex("828684418cf1e3c2e5f23a6ba0ab90f4ff");
+    assert(decoder.decode(block.data(), block.size(), &headers));
+    assert(headers.size() == 4);
+    assert(headers[0].first == ":method" && headers[0].second == "GET");
+    assert(headers[1].first == ":scheme" && headers[1].second == "http");
+    assert(headers[2].first == ":path" && headers[2].second == "/");
+    assert(headers[3].first == ":authority" && headers[3].second == "www.example.com");
+
+    headers.clear();
+    block = fromHex("828684be5886a8eb10649cbf");
+    assert(decoder.decode(block.data(), block.size(), &headers));
+    assert(headers.size() == 5);
+    assert(headers[3].second == "www.example.com");
+    assert(headers[4].first == "cache-control" && headers[4].second == "no-cache");
+
+    headers.clear();
+    block = fromHex("828785bf408825a849e95ba97d7f8925a849e95bb8e8b4bf");
+    assert(decoder.decode(block.data(), block.size(), &headers));
+    assert(headers.size() == 5);
+    assert(headers[1].second == "https");
+    assert(headers[2].second == "/index.html");
+    assert(headers[3].second == "www.example.com");
+    assert(headers[4].first == "custom-key" && headers[4].second == "custom-value");
+
+    // 引用不存在的索引
+    headers.clear();
+    block = fromHex("ff00");
+    assert(!decoder.decode(block.data(), block.size(), &headers));
+
+    // 表大小更新超过本端通告的上限，或者出现在首部之后
+    HpackDecoder small(256);
+    std::string update;
+    hpack::encodeInteger(&update, 0x20, 5, 512);
+    assert(!small.decode(update.data(), update.size(), &headers));
+    block = fromHex("82") + fromHex("20");
+    assert(!small.decode(block.data(), block.size(), &headers));
+}
+
+// 编码器和解码器各自维护动态表，多个首部块之后仍然一致
+static void testRoundTrip()
+{
+    HpackEncoder encoder;
+    HpackDecoder decoder;
+    for (int round = 0; round < 50; ++round)
+    {
+        HpackHeaderList in;
+        in.emplace_back(":status", round % 2 ? "200" : "302");
+        in.emplace_back("content-type", "text/html");
+        in.emplace_back("content-length", std::to_string(round * 100));
+        in.emplace_back("x-round", "value-" + std::to_string(round % 7));
+        in.emplace_back("x-long", std::string(300, static_cast<char>('a' + round % 26)));
+        if (round == 20)
+        {
+            encoder.setMaxTableSize(0);         // 对端要求清空动态表
+        }
+        if (round == 30)
+        {
+            encoder.setMaxTableSize(100);
+            encoder.setMaxTableSize(4096);      // 先变小再变大，两次更新都要告诉对端
+        }
+
+        std::string block;
+        encoder.encode(in, &block);
+        HpackHeaderList out;
+        assert(decoder.decode(block.data(), block.size(), &out));
+        assert(out == in);
+    }
+
+    // 完全相同的首部第二次只需要一个字节的索引
+    HpackEncoder e;
+    HpackHeaderList h;
+    h.emplace_back("x-custom", "hello");
+    std::string first, second;
+    e.encode(h, &first);
+    e.encode(h, &second);
+    assert(second.size() == 1 && static_cast<uint8_t>(second[0]) == 0x80 + 62);
+}
+
+int main()
+{
+    testInteger();
+    testHuffman();
+    testDecoder();
+    testRoundTrip();
+    printf("hpack_test passed\n");
+    return 0;
+}
@@ -0,0 +1,180 @@
+#include "httpServer.h"
+#include "http2Frame.h"
+#include "hpack.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <string>
+#include <thread>
+
+using namespace http2;
+
+static const uint16_t kPort = 18090;
+static const size_t kMaxBody = 4096;
+
+struct Frame
+{
+    FrameHeader header;
+    std::string payload;
+};
+
+// prior knowledge 的 h2c 客户端，只实现测试用到的几种帧
+class Client
+{
+public:
+    Client()
+    {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kPort);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int ret = ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof addr);
+        assert(ret == 0);
+        (void)ret;
+
+        Buffer out;
+        out.append(kClientPreface, kClientPrefaceLen);
+        appendFrameHeader(&out, 0, kSettings, 0, 0);
+        send(&out);
+    }
+
+    ~Client() { ::close(fd_); }
+
+    void post(uint32_t streamId, const std::string& path, const std::string& body, size_t frameSize)
+    {
+        HpackHeaderList headers;
+        headers.emplace_back(":method", "POST");
+        headers.emplace_back(":scheme", "http");
+        headers.emplace_back(":path", path);
+        headers.emplace_back(":authority", "test");
+        std::string block;
+        encoder_.encode(headers, &block);
+
+        Buffer out;
+        appendFrameHeader(&out, block.size(), kHeaders, kFlagEndHeaders, streamId);
+        out.append(block.data(), block.size());
+        for (size_t pos = 0; pos < body.size(); pos += frameSize)
+        {
+            size_t n = std::min(frameSize, body.size() - pos);
+            appendFrameHeader(&out, n, kData, pos + n == body.size() ? kFlagEndStream : 0, streamId);
+            out.append(body.data() + pos, n);
+        }
+        send(&out);
+    }
+
+    // 读下一个属于 streamId 的帧，连接级的帧跳过
+    Frame next(uint32_t streamId)
+    {
+        while (true)
+        {
+            while (buf_.size() < kFrameHeaderSize)
+            {
+                fill();
+            }
+            Frame frame;
+            parseFrameHeader(buf_.data(), &frame.header);
+            while (buf_.size() < kFrameHeaderSize + frame.header.length)
+            {
+                fill();
+            }
+            frame.payload = buf_.substr(kFrameHeaderSize, frame.header.length);
+            buf_.erase(0, kFrameHeaderSize + frame.header.length);
+            if (frame.header.streamId == streamId)
+            {
+                return frame;
+            }
+        }
+    }
+
+    std::string status(const Frame& frame)
+    {
+        assert(frame.header.type == kHeaders);
+        HpackHeaderList headers;
+        bool ok = decoder_.decode(frame.payload.data(), frame.payload.size(), &headers);
+        assert(ok && !headers.empty() && headers[0].first == ":status");
+        (void)ok;
+        return headers[0].second;
+    }
+
+private:
+    void send(Buffer* out)
+    {
+        ssize_t n = ::write(fd_, out->peek(), out->readableBytes());
+        assert(n == static_cast<ssize_t>(out->readableBytes()));
+        (void)n;
+        out->retrieveAll();
+    }
+
+    void fill()
+    {
+        char data[65536];
+        ssize_t n = ::read(fd_, data, sizeof data);
+        assert(n > 0);
+        buf_.append(data, n);
+    }
+
+    int fd_;
+    std::string buf_;
+    HpackEncoder encoder_;
+    HpackDecoder decoder_;
+};
+
+static void runClient(EventLoop* loop)
+{
+    Client client;
+
+    // 上限以内的请求体正常处理
+    std::string body(kMaxBody, 'a');
+    client.post(1, "/echo", body, 1000);
+    Frame frame = client.next(1);
+    assert(client.status(frame) == "200");
+    std::string echo;
+    do
+    {
+        frame = client.next(1);
+        assert(frame.header.type == kData);
+        echo += frame.payload;
+    } while (!(frame.header.flags & kFlagEndStream));
+    assert(echo == body);
+
+    // 超过上限：413 之后 RST_STREAM(NO_ERROR)，中间不会给这个流补窗口
+    client.post(3, "/echo", std::string(kMaxBody + 1, 'b'), 1000);
+    frame = client.next(3);
+    assert(client.status(frame) == "413");
+    assert(frame.header.flags & kFlagEndStream);
+    frame = client.next(3);
+    assert(frame.header.type == kRstStream && readUint32(frame.payload.data()) == kNoError);
+
+    // 只重置了那一个流，连接还能继续用
+    client.post(5, "/echo", "ok", 1000);
+    assert(client.status(client.next(5)) == "200");
+    frame = client.next(5);
+    assert(frame.header.type == kData && frame.payload == "ok");
+
+    loop->quit();
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::FATAL);
+    EventLoop loop;
+    HttpServer server(&loop, InetAddress(kPort), "http2-test", 0);
+    server.setMaxBodySize(kMaxBody);
+    server.route("POST", "/echo", [](const HttpRequest& req, HttpResponse* resp) {
+        resp->SetContentType("text/plain");
+        resp->SetBody(req.body());
+    });
+    server.start();
+
+    std::thread client(runClient, &loop);
+    loop.loop();
+    client.join();
+    printf("http2 test passed\n");
+    return 0;
+}
@@ -3,24 +3,53 @@
 #include "httpResponse.h"
 #include "Timestamp.h"
 #include "AsyncLogging.h"
+#include "BinaryLogging.h"
+#include "LogArchiver.h"
+#include "MmapLogRing.h"
+#include <pthread.h>
+#include <sched.h>
+#include <atomic>
 int kRollSize = 500*1000*1000;
 
+// 滚动下来的日志在后台压缩，最多保留 20 个、共 2GB
+std::unique_ptr<LogArchiver> g_archiver;
 // 异步日志
 std::unique_ptr<AsyncLogging> g_asyncLog;
 
+// 崩溃时也不会丢的环形日志，-R 指定文件时代替异步日志
+std::unique_ptr<MmapLogRing> g_ringLog;
+
 void asyncOutput(const char* msg, int len)
 {
-    g_asyncLog->append(msg, len);
+    g_asyncLog->append(msg, len, Logger::outputLevel());
 }
 
-void setLogging(const char* argv0)
+void setLogging(const char* argv0, Logger::LogLevel level, bool binary, const std::string& ringFile)
 {
+    if(!ringFile.empty()) {
+        // 每个线程直接写映射，进程被杀掉时内容还在文件里，用 myweb-logring 取出来
+        g_ringLog.reset(new MmapLogRing(ringFile, 64 * 1024 * 1024));
+        Logger::setOutput([](const char* msg, int len) { g_ringLog->append(msg, len); });
+        Logger::setFlush([]() { g_ringLog->flush(); });
+        Logger::setLogLevel(level);
+        return;
+    }
     Logger::setOutput(asyncOutput);
     char name[256];
     strncpy(name, argv0, 256);
     // std::cout<<name<<std::endl;
     g_asyncLog.reset(new AsyncLogging(::basename(name), kRollSize));
-    Logger::setLogLevel(Logger::DEBUG);
+    g_archiver.reset(new LogArchiver(::basename(name)));
+    g_archiver->setMaxFiles(20);
+    g_archiver->setMaxTotalBytes(2ULL * 1024 * 1024 * 1024);
+    g_archiver->start();
+    g_asyncLog->setRollCallback([](const std::string& closedFile) {
+        g_archiver->submit(closedFile);
+    });
+    Logger::setLogLevel(level);
+    // LOG_XXX_BIN 的记录也交给后端线程格式化，binary 时原样写文件，用 myweb-logdecode 查看
+    g_asyncLog->setBinaryOutput(binary);
+    BinaryLogging::setSink(g_asyncLog.get());
     g_asyncLog->start();
 }
 
@@ -28,14 +57,196 @@ void setLogging(const char* argv0)
 extern char favicon[555];
 bool benchmark = false;
 
+struct Options {
+    uint16_t port = 8080;
+    int threads = -1;                   // -1 表示按模式取默认值
+    int level = -1;
+    std::vector<int> cpus;              // 依次绑定主 loop 和各个 io 线程
+    bool binaryLog = false;
+    std::string ringFile;
+    LogFieldFormat format = LogFieldFormat::TEXT;
+};
+
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [-b] [-p port] [-t threads] [-l TRACE|DEBUG|INFO|WARN|ERROR] [-a cpu,cpu,...] [-B] [-R ring-file] [-F json|logfmt]\n"
+                    "  -b  benchmark mode: only /hello and /favicon.ico from memory, no database\n"
+                    "  -B  write the log in binary form, decode it with myweb-logdecode\n"
+                    "  -R  log into a crash-safe mmap ring instead, read it with myweb-logring\n"
+                    "  -F  write structured log lines, one JSON object or logfmt record per line (not with -B)\n", argv0);
+    exit(1);
+}
+
+int parseLevel(const char* name)
+{
+    static const char* names[] = {"TRACE", "DEBUG", "INFO", "WARN", "ERROR", "FATAL"};
+    for(int i = 0; i < Logger::LEVEL_COUNT; ++i) {
+        if(strcasecmp(name, names[i]) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+void pinThread(int cpu)
+{
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpu, &set);
+    int ret = pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+    if(ret != 0) {
+        LOG_ERROR << "pin thread to cpu " << cpu << " failed: " << strerror(ret);
+    }
+}
+
+// 压测模式：响应都在内存里，不碰磁盘和数据库，只测网络栈和 HTTP 处理本身的上限
+void setupBenchmark(HttpServer& server)
+{
+    server.route("GET", "/hello", [](const HttpRequest&, HttpResponse* resp) {
+        resp->SetContentType("text/plain");
+        resp->SetBody("hello, world!\n");
+    });
+    server.route("GET", "/favicon.ico", [](const HttpRequest&, HttpResponse* resp) {
+        resp->SetContentType("image/png");
+        resp->SetBody(std::string(favicon, sizeof favicon));
+    });
+}
+
 int main(int argc, char* argv[])
 {
-    setLogging(argv[0]);
+    Options opt;
+    int c;
+    while((c = getopt(argc, argv, "bBp:t:l:a:R:F:")) != -1) {
+        switch(c) {
+        case 'b': benchmark = true; break;
+        case 'B': opt.binaryLog = true; break;
+        case 'R': opt.ringFile = optarg; break;
+        case 'F':
+            if(strcasecmp(optarg, "json") == 0) {
+                opt.format = LogFieldFormat::JSON;
+            } else if(strcasecmp(optarg, "logfmt") == 0) {
+                opt.format = LogFieldFormat::LOGFMT;
+            } else {
+                usage(argv[0]);
+            }
+            break;
+        case 'p': opt.port = static_cast<uint16_t>(atoi(optarg)); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'l':
+            opt.level = parseLevel(optarg);
+            if(opt.level < 0) {
+                usage(argv[0]);
+            }
+            break;
+        case 'a':
+            for(char* p = strtok(optarg, ","); p; p = strtok(nullptr, ",")) {
+                opt.cpus.push_back(atoi(p));
+            }
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    // 压测模式默认每个 cpu 一个 io 线程，只打 WARN 以上的日志
+    if(opt.threads < 0) {
+        opt.threads = benchmark ? static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)) : 10;
+    }
+    if(opt.level < 0) {
+        opt.level = benchmark ? Logger::WARN : Logger::DEBUG;
+    }
+    // 二进制日志在解码时才排版，没有结构化的形式
+    if(opt.binaryLog && opt.format != LogFieldFormat::TEXT) {
+        usage(argv[0]);
+    }
+    Logger::setFormat(opt.format);
+    setLogging(argv[0], static_cast<Logger::LogLevel>(opt.level), opt.binaryLog, opt.ringFile);
     LOG_INFO << "pid = " << getpid();
-    
+
     EventLoop loop;
-    HttpServer server(&loop, InetAddress(8080), std::string("http-server"),10,std::string("ming")
+    std::atomic<size_t> nextCpu(0);
+    if(!opt.cpus.empty()) {
+        pinThread(opt.cpus[nextCpu++]);
+    }
+
+    if(benchmark) {
+        HttpServer server(&loop, InetAddress(opt.port), std::string("http-bench"), opt.threads);
+        if(!opt.cpus.empty()) {
+            // cpu 不够的时候从头开始循环使用
+            server.setThreadInitCallback([&opt, &nextCpu](EventLoop*) {
+                pinThread(opt.cpus[nextCpu++ % opt.cpus.size()]);
+            });
+        }
+        setupBenchmark(server);
+        server.start();
+        loop.loop();
+        return 0;
+    }
+
+    HttpServer server(&loop, InetAddress(opt.port), std::string("http-server"),opt.threads,std::string("ming")
     ,std::string("111111"),std::string("ming_database"),std::string("localHost"));
+    if(!opt.cpus.empty()) {
+        server.setThreadInitCallback([&opt, &nextCpu](EventLoop*) {
+            pinThread(opt.cpus[nextCpu++ % opt.cpus.size()]);
+        });
+    }
+    // 动态路由示例，curl http://127.0.0.1:8080/api/hello/ming
+    server.route("GET", "/api/hello/:name", [](const HttpRequest& req, HttpResponse* resp) {
+        resp->SetContentType("application/json");
+        resp->SetBody("{\"hello\":\"" + req.param("name") + "\"}");
+    });
+    // 异步路由示例，处理函数直接返回，1秒后由定时器完成响应，期间io线程可以继续处理别的请求
+    server.routeAsync("GET", "/api/delay", [](const HttpResponseWriterPtr& writer) {
+        writer->getLoop()->runAfter(1.0, [writer]() {
+            writer->response()->SetBody("done\n");
+            writer->finish();
+        });
+    });
+    // 流式上传示例，请求体边收边写到文件里，不会在内存中攒成一整块
+    // curl -T bigfile http://127.0.0.1:8080/upload/bigfile
+    server.routeUpload("PUT", "/upload/:name", [](const HttpResponseWriterPtr& writer) -> HttpRequest::BodyCallback {
+        std::string file = "/tmp/myweb-upload-" + writer->request().param("name");
+        // 回调在请求体结束或者连接断开时释放，文件跟着关闭
+        std::shared_ptr<int> fd(new int(::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644)), [](int* p) {
+            if(*p >= 0) {
+                ::close(*p);
+            }
+            delete p;
+        });
+        std::shared_ptr<size_t> total(new size_t(0));
+        return [writer, fd, total](const char* data, size_t len) {
+            if(*fd < 0 || (data && ::write(*fd, data, len) != static_cast<ssize_t>(len))) {
+                writer->response()->SetCode(403);
+                return false;
+            }
+            *total += len;
+            if(data == nullptr) {
+                writer->response()->SetBody("received " + std::to_string(*total) + " bytes\n");
+                writer->finish();
+            }
+            return true;
+        };
+    });
+    // WebSocket 示例，/echo 原样返回，/chat 广播给所有连接
+    WebSocketHandler echo;
+    echo.onMessage = [](const WebSocketConnectionPtr& ws, const char* data, size_t len, bool binary) {
+        if(binary) {
+            ws->sendBinary(data, len);
+        } else {
+            ws->sendText(std::string(data, len));
+        }
+    };
+    server.routeWebSocket("/echo", echo);
+    WebSocketHub hub;
+    WebSocketHandler chat;
+    chat.onOpen = [&hub](const WebSocketConnectionPtr& ws, const HttpRequest&) { hub.add(ws); };
+    chat.onMessage = [&hub](const WebSocketConnectionPtr&, const char* data, size_t len, bool) {
+        hub.broadcast(std::string(data, len));
+    };
+    chat.onClose = [&hub](const WebSocketConnectionPtr& ws) { hub.remove(ws); };
+    server.routeWebSocket("/chat", chat);
+    // 指标，curl http://127.0.0.1:8080/metrics
+    server.enableMetrics();
+    // 每个 IP 每秒 100 个请求(最多突发 200 个)、最多 64 个连接，总共最多 10000 个连接
+    server.setRateLimit(100, 200, 64, 10000);
     server.start();
     loop.loop();
 }
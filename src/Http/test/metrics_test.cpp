@@ -0,0 +1,94 @@
+#include "Metrics.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// 桶的上界单调递增，每个值都落在上界不小于它的第一个桶里
+static void testBuckets()
+{
+    for (int i = 1; i < HdrHistogram::kBuckets; ++i)
+    {
+        assert(HdrHistogram::bucketUpperBound(i) > HdrHistogram::bucketUpperBound(i - 1));
+    }
+    for (uint64_t v = 0; v < (1 << 20); v += 7)
+    {
+        int index = HdrHistogram::bucketIndex(v);
+        assert(HdrHistogram::bucketUpperBound(index) >= v);
+        assert(index == 0 || HdrHistogram::bucketUpperBound(index - 1) < v);
+    }
+    // 相对误差不超过 1/kSubBuckets
+    uint64_t v = 123456789;
+    uint64_t upper = HdrHistogram::bucketUpperBound(HdrHistogram::bucketIndex(v));
+    assert(upper - v <= v / HdrHistogram::kSubBuckets);
+}
+
+static void testPercentile()
+{
+    HdrHistogram h;
+    for (uint64_t v = 1; v <= 1000; ++v)
+    {
+        h.record(v);
+    }
+    assert(h.count() == 1000 && h.min() == 1 && h.max() == 1000);
+    assert(h.sum() == 500500);
+    uint64_t p50 = h.percentile(0.5);
+    uint64_t p99 = h.percentile(0.99);
+    assert(p50 >= 500 && p50 <= 500 + 500 / HdrHistogram::kSubBuckets);
+    assert(p99 >= 990 && p99 <= 1000);
+    assert(h.percentile(1) == 1000);
+    assert(h.countAtOrBelow(15) == 15);
+}
+
+// 多个线程同时记录，合并之后一个都不少
+static void testConcurrent()
+{
+    Counter counter;
+    Histogram histogram;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t)
+    {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 100000; ++i)
+            {
+                counter.inc();
+                histogram.record(i % 1000);
+            }
+        });
+    }
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    assert(counter.value() == 800000);
+    HdrHistogram h = histogram.snapshot();
+    assert(h.count() == 800000 && h.max() == 999);
+}
+
+static void testScrape()
+{
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    Counter* c = registry.counter("test_requests_total", "test", "route=\"/a\"");
+    assert(c == registry.counter("test_requests_total", "test", "route=\"/a\""));
+    c->inc(3);
+    Histogram* h = registry.histogram("test_latency_seconds", "test");
+    h->record(700);     // 0.7ms
+    std::string text = registry.scrape();
+    assert(text.find("# TYPE test_requests_total counter\n") != std::string::npos);
+    assert(text.find("test_requests_total{route=\"/a\"} 3\n") != std::string::npos);
+    assert(text.find("test_latency_seconds_bucket{le=\"0.0005\"} 0\n") != std::string::npos);
+    assert(text.find("test_latency_seconds_bucket{le=\"0.001\"} 1\n") != std::string::npos);
+    assert(text.find("test_latency_seconds_count 1\n") != std::string::npos);
+}
+
+int main()
+{
+    testBuckets();
+    testPercentile();
+    testConcurrent();
+    testScrape();
+    printf("metrics_test passed\n");
+    return 0;
+}
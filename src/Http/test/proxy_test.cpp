@@ -0,0 +1,366 @@
+#include "httpServer.h"
+#include "httpProxy.h"
+#include "EventLoop.h"
+#include "TcpServer.h"
+#include "TcpConnection.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <atomic>
+#include <set>
+#include <string>
+#include <thread>
+
+static const uint16_t kFrontPort = 18080;
+static const size_t kBigSize = 2 * 1024 * 1024;
+
+// 代替真实上游的后端：只认识几个固定的路径，按后缀匹配，所以前面加什么路由前缀都可以
+class Backend
+{
+public:
+    Backend(EventLoop* loop, uint16_t port)
+        : server_(loop, InetAddress(port, "127.0.0.1"), "backend"),
+          port_(port),
+          proxied_(0)
+    {
+        server_.setConnectionCallback([](const TcpConnectionPtr& conn) {
+            if (conn->connected())
+            {
+                conn->setContext(std::make_shared<bool>(false));
+            }
+        });
+        server_.setMessageCallback(std::bind(&Backend::onMessage, this,
+                                             std::placeholders::_1, std::placeholders::_2));
+        server_.start();
+    }
+
+    // 收到过转发请求(不算健康检查)的连接数
+    int proxied() const { return proxied_.load(); }
+
+private:
+    static bool endsWith(const std::string& s, const char* suffix)
+    {
+        size_t n = strlen(suffix);
+        return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+    {
+        while (true)
+        {
+            const char* end = static_cast<const char*>(memmem(buf->peek(), buf->readableBytes(), "\r\n\r\n", 4));
+            if (end == nullptr)
+            {
+                return;
+            }
+            std::string head(buf->peek(), end + 4);
+            size_t length = 0;
+            const char* cl = strcasestr(head.c_str(), "\r\nContent-Length:");
+            if (cl)
+            {
+                length = strtoul(cl + 17, nullptr, 10);
+            }
+            if (buf->readableBytes() < head.size() + length)
+            {
+                return;
+            }
+            buf->retrieve(head.size());
+            std::string body(buf->peek(), length);
+            buf->retrieve(length);
+
+            std::string method = head.substr(0, head.find(' '));
+            std::string path = head.substr(method.size() + 1, head.find(' ', method.size() + 1) - method.size() - 1);
+            path = path.substr(0, path.find('?'));
+            if (!endsWith(path, "/health"))
+            {
+                bool* counted = static_cast<bool*>(conn->getContext().get());
+                if (!*counted)
+                {
+                    *counted = true;
+                    ++proxied_;
+                }
+            }
+            respond(conn, method, path, head, body);
+        }
+    }
+
+    void respond(const TcpConnectionPtr& conn, const std::string& method, const std::string& path,
+                 const std::string& head, const std::string& body)
+    {
+        std::string id = std::to_string(port_);
+        if (endsWith(path, "/big"))
+        {
+            // 分块发 2MB，内容是可以校验的字节序列
+            std::string out = "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\nContent-Type: application/octet-stream\r\n\r\n";
+            std::string chunk(64 * 1024, '\0');
+            for (size_t offset = 0; offset < kBigSize; offset += chunk.size())
+            {
+                for (size_t i = 0; i < chunk.size(); ++i)
+                {
+                    chunk[i] = static_cast<char>((offset + i) % 251);
+                }
+                char size[16];
+                snprintf(size, sizeof size, "%zx\r\n", chunk.size());
+                out += size + chunk + "\r\n";
+            }
+            out += "0\r\n\r\n";
+            conn->send(out);
+        }
+        else if (endsWith(path, "/close"))
+        {
+            // HTTP/1.0 风格，没有长度，关闭连接表示结束
+            conn->send("HTTP/1.0 200 OK\r\nX-Backend: " + id + "\r\n\r\nclosed-body");
+            conn->shutdown();
+        }
+        else if (endsWith(path, "/echo"))
+        {
+            std::string xff;
+            const char* p = strcasestr(head.c_str(), "\r\nX-Forwarded-For: ");
+            if (p)
+            {
+                xff.assign(p + 19, strstr(p + 19, "\r\n"));
+            }
+            conn->send("HTTP/1.1 201 Created\r\nContent-Length: " + std::to_string(body.size()) +
+                       "\r\nX-Forwarded-For: " + xff + "\r\nX-Method: " + method + "\r\n\r\n" + body);
+        }
+        else
+        {
+            conn->send("HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(id.size()) +
+                       "\r\nX-Backend: " + id + "\r\n\r\n" + (method == "HEAD" ? std::string() : id));
+        }
+    }
+
+    TcpServer server_;
+    uint16_t port_;
+    std::atomic<int> proxied_;
+};
+
+struct Response
+{
+    int code;
+    std::string head;
+    std::string body;
+
+    std::string header(const char* name) const
+    {
+        std::string key = std::string("\r\n") + name + ": ";
+        size_t pos = head.find(key);
+        if (pos == std::string::npos)
+        {
+            return std::string();
+        }
+        pos += key.size();
+        return head.substr(pos, head.find("\r\n", pos) - pos);
+    }
+};
+
+// 阻塞的 HTTP/1.1 客户端，能读 Content-Length 和 chunked 的响应
+class Client
+{
+public:
+    Client() : fd_(::socket(AF_INET, SOCK_STREAM, 0))
+    {
+        sockaddr_in addr;
+        memset(&addr, 0, sizeof addr);
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(kFrontPort);
+        ::inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+        int ret = ::connect(fd_, (sockaddr *)&addr, sizeof addr);
+        assert(ret == 0);
+        (void)ret;
+    }
+    ~Client() { ::close(fd_); }
+
+    Response request(const std::string& method, const std::string& path, const std::string& body = std::string(),
+                     double slowReader = 0)
+    {
+        std::string req = method + " " + path + " HTTP/1.1\r\nHost: test\r\n";
+        if (!body.empty())
+        {
+            req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+        }
+        req += "\r\n" + body;
+        ssize_t n = ::write(fd_, req.data(), req.size());
+        assert(n == static_cast<ssize_t>(req.size()));
+        (void)n;
+
+        Response resp;
+        size_t end;
+        while ((end = buf_.find("\r\n\r\n")) == std::string::npos)
+        {
+            fill();
+        }
+        resp.head = buf_.substr(0, end + 2);
+        buf_.erase(0, end + 4);
+        resp.code = atoi(resp.head.c_str() + 9);
+        if (slowReader > 0)
+        {
+            // 先不读，让代理的输出堆积起来
+            usleep(static_cast<useconds_t>(slowReader * 1000 * 1000));
+        }
+        if (method == "HEAD")
+        {
+            return resp;
+        }
+        std::string length = resp.header("Content-Length");
+        if (length.empty())
+        {
+            length = resp.header("Content-length");
+        }
+        if (!length.empty())
+        {
+            size_t len = strtoul(length.c_str(), nullptr, 10);
+            while (buf_.size() < len)
+            {
+                fill();
+            }
+            resp.body = buf_.substr(0, len);
+            buf_.erase(0, len);
+        }
+        else if (resp.header("Transfer-Encoding") == "chunked")
+        {
+            while (true)
+            {
+                while ((end = buf_.find("\r\n")) == std::string::npos)
+                {
+                    fill();
+                }
+                size_t size = strtoul(buf_.c_str(), nullptr, 16);
+                while (buf_.size() < end + 2 + size + 2)
+                {
+                    fill();
+                }
+                resp.body.append(buf_, end + 2, size);
+                buf_.erase(0, end + 2 + size + 2);
+                if (size == 0)
+                {
+                    break;
+                }
+            }
+        }
+        return resp;
+    }
+
+private:
+    void fill()
+    {
+        char data[65536];
+        ssize_t n = ::read(fd_, data, sizeof data);
+        assert(n > 0);
+        buf_.append(data, n);
+    }
+
+    int fd_;
+    std::string buf_;
+};
+
+static void runClient(EventLoop* loop, HttpProxy* rr, Backend* a, Backend* b)
+{
+    // 健康检查把没有监听的上游摘掉
+    for (int i = 0; i < 50 && rr->healthy(2); ++i)
+    {
+        usleep(50 * 1000);
+    }
+    assert(rr->healthy(0) && rr->healthy(1) && !rr->healthy(2));
+
+    // 轮询：同一个客户端连接上的请求分到两个后端，上游连接复用
+    {
+        Client client;
+        std::set<std::string> backends;
+        for (int i = 0; i < 10; ++i)
+        {
+            Response resp = client.request("GET", "/rr/small");
+            assert(resp.code == 200);
+            assert(resp.body == resp.header("X-Backend"));
+            backends.insert(resp.body);
+        }
+        assert(backends.size() == 2);
+        assert(a->proxied() + b->proxied() <= 2);
+
+        Response head = client.request("HEAD", "/rr/small");
+        assert(head.code == 200 && head.header("Content-Length") == "5");
+
+        // 请求体和方法原样转发，X-Forwarded-For 加上客户端地址
+        Response echo = client.request("POST", "/rr/echo?x=1", "hello proxy");
+        assert(echo.code == 201 && echo.body == "hello proxy");
+        assert(echo.header("X-Method") == "POST");
+        assert(echo.header("X-Forwarded-For") == "127.0.0.1");
+
+        // 上游分块发的大响应，客户端读得慢，代理会暂停读上游
+        Response big = client.request("GET", "/rr/big", std::string(), 0.5);
+        assert(big.code == 200 && big.body.size() == kBigSize);
+        for (size_t i = 0; i < kBigSize; ++i)
+        {
+            assert(static_cast<unsigned char>(big.body[i]) == i % 251);
+        }
+
+        // 上游用关闭连接表示结束，代理给 HTTP/1.1 客户端改成 chunked，客户端连接保持
+        Response closed = client.request("GET", "/rr/close");
+        assert(closed.code == 200 && closed.body == "closed-body");
+        assert(closed.header("Transfer-Encoding") == "chunked");
+        Response again = client.request("GET", "/rr/small");
+        assert(again.code == 200);
+    }
+
+    // 一致性哈希：同一个 IP 总是落到同一个后端
+    {
+        Client client;
+        std::string first = client.request("GET", "/hash/small").body;
+        for (int i = 0; i < 10; ++i)
+        {
+            assert(client.request("GET", "/hash/small").body == first);
+        }
+    }
+
+    // 唯一的上游连不上
+    {
+        Client client;
+        assert(client.request("GET", "/dead/small").code == 502);
+        assert(client.request("GET", "/dead/small").code == 502);
+    }
+
+    loop->quit();
+}
+
+static void runTest()
+{
+    EventLoop loop;
+    Backend a(&loop, 18081);
+    Backend b(&loop, 18082);
+
+    std::vector<InetAddress> upstreams;
+    upstreams.push_back(InetAddress(18081, "127.0.0.1"));
+    upstreams.push_back(InetAddress(18082, "127.0.0.1"));
+    std::shared_ptr<HttpProxy> hash(new HttpProxy(upstreams, HttpProxy::kConsistentHash));
+    upstreams.push_back(InetAddress(18083, "127.0.0.1"));   // 没有监听
+    std::shared_ptr<HttpProxy> rr(new HttpProxy(upstreams, HttpProxy::kRoundRobin));
+    rr->setHealthCheck("/health", 0.1);
+    std::shared_ptr<HttpProxy> dead(new HttpProxy(std::vector<InetAddress>(1, InetAddress(18083, "127.0.0.1"))));
+
+    HttpServer server(&loop, InetAddress(kFrontPort), "proxy-test", 2,
+                      "test", "test", "test", "127.0.0.1");
+    assert(server.routeProxy("/rr/*path", rr));
+    assert(server.routeProxy("/hash/*path", hash));
+    assert(server.routeProxy("/dead/*path", dead));
+    server.start();
+
+    std::thread client(runClient, &loop, rr.get(), &a, &b);
+    loop.loop();
+    client.join();
+}
+
+int main()
+{
+    Logger::setLogLevel(Logger::ERROR);
+    runTest();
+    printf("proxy test passed\n");
+    fflush(stdout);
+    // 数据库连接池的后台线程是分离的，一直等在条件变量上，静态析构的时候会卡住，这里直接退出
+    _exit(0);
+}
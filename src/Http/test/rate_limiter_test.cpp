@@ -0,0 +1,84 @@
+#include "RateLimiter.h"
+#include "InetAddress.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <arpa/inet.h>
+
+static InetAddress peer(const char* ip)
+{
+    sockaddr_in addr;
+    memset(&addr, 0, sizeof addr);
+    addr.sin_family = AF_INET;
+    ::inet_pton(AF_INET, ip, &addr.sin_addr);
+    return InetAddress(addr);
+}
+
+static Timestamp at(double seconds)
+{
+    return Timestamp(static_cast<int64_t>(seconds * Timestamp::kMicroSecondsPerSecond));
+}
+
+// 先用完突发的令牌，之后按速率补充，补充不会超过 burst
+static void testTokenBucket()
+{
+    RateLimiter limiter(10, 5, 0, 0);
+    InetAddress a = peer("10.0.0.1");
+    InetAddress b = peer("10.0.0.2");
+    for (int i = 0; i < 5; ++i)
+    {
+        assert(limiter.allowRequest(a, at(100)));
+    }
+    assert(!limiter.allowRequest(a, at(100)));
+    // 另一个 IP 不受影响
+    assert(limiter.allowRequest(b, at(100)));
+    // 0.1 秒补充一个
+    assert(limiter.allowRequest(a, at(100.1)));
+    assert(!limiter.allowRequest(a, at(100.1)));
+    int allowed = 0;
+    while (limiter.allowRequest(a, at(200)))
+    {
+        ++allowed;
+    }
+    assert(allowed == 5);
+}
+
+static void testConnections()
+{
+    RateLimiter limiter(0, 0, 2, 3);
+    InetAddress a = peer("10.0.0.1");
+    InetAddress b = peer("10.0.0.2");
+    assert(limiter.acquireConnection(a));
+    assert(limiter.acquireConnection(a));
+    assert(!limiter.acquireConnection(a));      // 单个 IP 的上限
+    assert(limiter.acquireConnection(b));
+    assert(!limiter.acquireConnection(b));      // 总数的上限
+    assert(limiter.connections() == 3);
+    limiter.releaseConnection(a);
+    assert(limiter.acquireConnection(b));
+    assert(limiter.connections() == 3);
+}
+
+// 没有连接、令牌桶补满了的 IP 才会被清理
+static void testExpire()
+{
+    RateLimiter limiter(10, 5, 10, 0);
+    InetAddress a = peer("10.0.0.1");
+    InetAddress b = peer("10.0.0.2");
+    assert(limiter.acquireConnection(a));
+    assert(limiter.allowRequest(b, Timestamp::now()));
+    assert(limiter.expire(Timestamp::now()) == 0);
+    assert(limiter.expire(Timestamp(Timestamp::now().microSecondsSinceEpoch() + 1000 * 1000)) == 1);
+    limiter.releaseConnection(a);
+    assert(limiter.expire(Timestamp(Timestamp::now().microSecondsSinceEpoch() + 1000 * 1000)) == 1);
+}
+
+int main()
+{
+    testTokenBucket();
+    testConnections();
+    testExpire();
+    printf("rate_limiter_test passed\n");
+    return 0;
+}
@@ -0,0 +1,236 @@
+#include "httpRequest.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string>
+
+// 把数据按 step 字节一段段喂给解析器，模拟分多次收到
+static bool feed(HttpRequest& req, Buffer& buf, const std::string& data, size_t step)
+{
+    for (size_t i = 0; i < data.size(); i += step)
+    {
+        buf.append(data.data() + i, std::min(step, data.size() - i));
+        if (!req.parse(buf))
+        {
+            return false;
+        }
+        // 请求体是收多少消费多少的，缓冲区里不会攒下整个请求体
+        assert(buf.readableBytes() <= HttpRequest::kMaxLineSize);
+    }
+    return req.parse(buf);
+}
+
+static void testContentLength()
+{
+    std::string body = "line1\r\nline2\r\n\r\nline3";
+    std::string data = "POST /echo HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body
+                       + "GET /next HTTP/1.1\r\n\r\n";
+    for (size_t step = 1; step <= data.size(); step += 7)
+    {
+        HttpRequest req;
+        Buffer buf;
+        assert(feed(req, buf, data, step));
+        assert(req.IsFinish());
+        assert(req.body() == body);
+        // 后面流水线过来的请求还留在缓冲区里
+        assert(std::string(buf.peek(), buf.readableBytes()) == "GET /next HTTP/1.1\r\n\r\n");
+    }
+}
+
+static void testChunked()
+{
+    std::string data = "POST /echo HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n"
+                       "5\r\nhello\r\n"
+                       "7;ext=1\r\n, world\r\n"
+                       "0\r\nX-Trailer: 1\r\n\r\n";
+    for (size_t step = 1; step <= data.size(); ++step)
+    {
+        HttpRequest req;
+        Buffer buf;
+        assert(feed(req, buf, data, step));
+        assert(req.IsFinish());
+        assert(req.body() == "hello, world");
+        assert(buf.readableBytes() == 0);
+    }
+
+    // chunk 后面不是回车换行、大小不是十六进制
+    HttpRequest req;
+    Buffer buf;
+    std::string bad = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n3\r\nabcX\r\n";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+    req.Init();
+    buf.retrieveAll();
+    bad = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\n";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+    // 同时有 Content-Length 和 Transfer-Encoding
+    req.Init();
+    buf.retrieveAll();
+    bad = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\nContent-Length: 3\r\n\r\n";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+}
+
+// 首部名不区分大小写，小写的 Content-Length 和 Transfer-Encoding 一样决定请求体的边界
+static void testHeaderCase()
+{
+    std::string data = "POST /echo HTTP/1.1\r\ncontent-length: 5\r\n\r\nhelloGET /next HTTP/1.1\r\n\r\n";
+    HttpRequest req;
+    Buffer buf;
+    assert(feed(req, buf, data, data.size()));
+    assert(req.IsFinish() && req.body() == "hello");
+    assert(std::string(buf.peek(), buf.readableBytes()) == "GET /next HTTP/1.1\r\n\r\n");
+    assert(req.GetHeader("CONTENT-LENGTH") == "5");
+
+    req.Init();
+    buf.retrieveAll();
+    data = "POST /echo HTTP/1.1\r\ntransfer-encoding: chunked\r\n\r\n5\r\nhello\r\n0\r\n\r\n";
+    assert(feed(req, buf, data, data.size()));
+    assert(req.IsFinish() && req.body() == "hello" && buf.readableBytes() == 0);
+
+    // 小写的 Content-Length 加上 Transfer-Encoding 也要拒绝
+    req.Init();
+    buf.retrieveAll();
+    std::string bad = "POST / HTTP/1.1\r\ntransfer-encoding: chunked\r\ncontent-length: 3\r\n\r\n";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+
+    // 重复的 Content-Length，不管值相同还是不同，也不管大小写
+    req.Init();
+    buf.retrieveAll();
+    bad = "POST / HTTP/1.1\r\nContent-Length: 3\r\ncontent-length: 5\r\n\r\nabcde";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+    req.Init();
+    buf.retrieveAll();
+    bad = "POST / HTTP/1.1\r\nContent-Length: 3\r\nContent-Length: 3\r\n\r\nabc";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+
+    // 重复的 Transfer-Encoding 合并之后不是单独的 chunked，同样拒绝
+    req.Init();
+    buf.retrieveAll();
+    bad = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\ntransfer-encoding: identity\r\n\r\n";
+    assert(!feed(req, buf, bad, bad.size()) && req.ErrorCode() == 400);
+}
+
+// Connection 和 Expect 也不区分大小写
+static void testKeepAliveAndExpect()
+{
+    HttpRequest req;
+    Buffer buf;
+    std::string data = "GET / HTTP/1.1\r\nconnection: close\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsFinish());
+    assert(!req.IsKeepAlive());
+
+    req.Init();
+    data = "GET / HTTP/1.0\r\nCONNECTION: Keep-Alive\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsFinish());
+    assert(req.IsKeepAlive());
+
+    req.Init();
+    data = "GET / HTTP/1.1\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsKeepAlive() && !req.ExpectsContinue());
+
+    req.Init();
+    data = "POST / HTTP/1.1\r\nexpect: 100-continue\r\ncontent-length: 2\r\n\r\n";
+    buf.append(data.data(), data.size());
+    assert(req.parse(buf) && req.HeadersDone());
+    assert(req.ExpectsContinue());
+}
+
+// h2c 升级和 WebSocket 握手的首部按小写发过来也要认出来
+static void testUpgradeHeaders()
+{
+    HttpRequest req;
+    Buffer buf;
+    std::string data = "GET / HTTP/1.1\r\nhost: a\r\nconnection: Upgrade, HTTP2-Settings\r\n"
+                       "upgrade: h2c\r\nhttp2-settings: AAMAAABkAAQAAP__\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsFinish());
+    assert(strcasecmp(req.GetHeader("Upgrade").c_str(), "h2c") == 0);
+    assert(req.GetHeader("HTTP2-Settings") == "AAMAAABkAAQAAP__");
+
+    // HTTP/2 解码出来的首部名本来就是小写的
+    req.Init();
+    req.AddHeader("content-length", "5");
+    assert(req.GetHeader("Content-Length") == "5");
+}
+
+static void testPath()
+{
+    // 路由用原始路径，只有静态文件才映射成 /index.html、/login.html
+    HttpRequest req;
+    Buffer buf;
+    std::string data = "GET / HTTP/1.1\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsFinish());
+    assert(req.path() == "/");
+    assert(req.filePath() == "/index.html");
+
+    req.Init();
+    data = "GET /login HTTP/1.1\r\n\r\n";
+    assert(feed(req, buf, data, data.size()) && req.IsFinish());
+    assert(req.path() == "/login");
+    assert(req.filePath() == "/login.html");
+}
+
+static void testMaxBodySize()
+{
+    HttpRequest req;
+    req.SetMaxBodySize(10);
+    Buffer buf;
+    // Content-Length 超过上限时不等请求体就报错
+    std::string data = "POST / HTTP/1.1\r\nContent-Length: 11\r\n\r\n";
+    assert(!feed(req, buf, data, data.size()) && req.ErrorCode() == 413);
+
+    // chunked 的在累计超过上限时报错；Init 不会重置上限
+    req.Init();
+    buf.retrieveAll();
+    data = "POST / HTTP/1.1\r\nTransfer-Encoding: chunked\r\n\r\n6\r\nabcdef\r\n5\r\n";
+    assert(!feed(req, buf, data, data.size()) && req.ErrorCode() == 413);
+}
+
+static void testBodyCallback()
+{
+    std::string received;
+    bool ended = false;
+    HttpRequest req;
+    req.SetMaxBodySize(1000);    // 流式接收的请求体不受上限限制
+    Buffer buf;
+    std::string body(300 * 1000, 'x');
+    std::string data = "PUT /upload HTTP/1.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+
+    buf.append(data.data(), 100);
+    assert(req.parse(buf) && req.HeadersDone());
+    req.SetBodyCallback([&](const char* p, size_t len) {
+        if (p == nullptr)
+        {
+            ended = true;
+        }
+        else
+        {
+            received.append(p, len);
+        }
+        return true;
+    });
+    assert(req.StartBody());
+    assert(feed(req, buf, data.substr(100), 4096));
+    assert(req.IsFinish() && ended && received == body);
+    assert(req.body().empty() && !req.bodyCallback());
+
+    // 回调返回 false 中止
+    req.Init();
+    buf.retrieveAll();
+    buf.append(data.data(), data.size());
+    assert(req.parse(buf) && req.HeadersDone());
+    req.SetBodyCallback([](const char*, size_t) { return false; });
+    assert(!req.parse(buf) && req.ErrorCode() == 0);
+}
+
+int main()
+{
+    testContentLength();
+    testChunked();
+    testHeaderCase();
+    testKeepAliveAndExpect();
+    testUpgradeHeaders();
+    testPath();
+    testMaxBodySize();
+    testBodyCallback();
+    printf("request_test passed\n");
+    return 0;
+}
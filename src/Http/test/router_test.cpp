@@ -0,0 +1,98 @@
+#include "httpRouter.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+// 每个路由的处理函数只记录自己的编号，方便断言匹配到了哪一个
+static int g_hit = 0;
+
+static HttpRouter::Handler makeHandler(int id)
+{
+    return [id](const std::shared_ptr<HttpResponseWriter>&) { g_hit = id; };
+}
+
+static int dispatch(const HttpRouter& router, const std::string& method, const std::string& path, RouteParams* params)
+{
+    g_hit = 0;
+    const HttpRouter::Handler* h = router.match(method, path, params);
+    if (h == nullptr)
+    {
+        return 0;
+    }
+    (*h)(nullptr);
+    return g_hit;
+}
+
+static std::string value(const std::string& path, const RouteParams& params, const std::string& key)
+{
+    for (int i = 0; i < params.size(); ++i)
+    {
+        if (*params[i].key == key)
+        {
+            return path.substr(params[i].offset, params[i].len);
+        }
+    }
+    return "<none>";
+}
+
+int main()
+{
+    HttpRouter router;
+    RouteParams params;
+
+    assert(router.addRoute("GET", "/", makeHandler(1)));
+    assert(router.addRoute("GET", "/api/users", makeHandler(2)));
+    assert(router.addRoute("GET", "/api/users/:id", makeHandler(3)));
+    assert(router.addRoute("GET", "/api/users/:id/posts/:post", makeHandler(4)));
+    assert(router.addRoute("GET", "/api/user", makeHandler(5)));        // 会拆分 /api/users 节点
+    assert(router.addRoute("GET", "/static/*file", makeHandler(6)));
+    assert(router.addRoute("GET", "/api/users/me", makeHandler(7)));    // 静态优先于参数
+    assert(router.addRoute("POST", "/api/users", makeHandler(8)));
+    assert(router.addRoute("GET", "/*filepath", makeHandler(9)));
+
+    // 冲突和非法的路由
+    assert(!router.addRoute("GET", "/api/users", makeHandler(10)));
+    assert(!router.addRoute("GET", "/api/users/:name", makeHandler(10)));
+    assert(!router.addRoute("GET", "/bad/*file/more", makeHandler(10)));
+    assert(!router.addRoute("GET", "/bad/x:y", makeHandler(10)));
+    assert(!router.addRoute("GET", "noslash", makeHandler(10)));
+
+    assert(dispatch(router, "GET", "/", &params) == 1);
+    assert(dispatch(router, "GET", "/api/users", &params) == 2);
+    assert(dispatch(router, "GET", "/api/user", &params) == 5);
+    assert(dispatch(router, "GET", "/api/users/me", &params) == 7);
+
+    std::string path = "/api/users/42";
+    assert(dispatch(router, "GET", path, &params) == 3);
+    assert(params.size() == 1 && value(path, params, "id") == "42");
+
+    path = "/api/users/42/posts/7";
+    assert(dispatch(router, "GET", path, &params) == 4);
+    assert(value(path, params, "id") == "42" && value(path, params, "post") == "7");
+
+    path = "/static/css/style.css";
+    assert(dispatch(router, "GET", path, &params) == 6);
+    assert(value(path, params, "file") == "css/style.css");
+
+    // 参数分支走不通时回退到通配符
+    path = "/api/users/42/comments";
+    assert(dispatch(router, "GET", path, &params) == 9);
+    assert(value(path, params, "filepath") == "api/users/42/comments");
+
+    assert(dispatch(router, "POST", "/api/users", &params) == 8);
+    assert(dispatch(router, "POST", "/api/users/42", &params) == 0);
+    assert(router.matchAnyMethod("/api/users/42"));
+    assert(dispatch(router, "DELETE", "/api/users", &params) == 0);
+
+    // 被拒绝的路由不能在树里留下节点，否则之后合法的路由会被误判为冲突
+    HttpRouter other;
+    assert(other.addRoute("GET", "/u/:id", makeHandler(1)));
+    assert(!other.addRoute("GET", "/u/:id/new/:name/*rest/x", makeHandler(2)));
+    assert(other.addRoute("GET", "/u/:id/new/:other", makeHandler(3)));
+    path = "/u/1/new/2";
+    assert(dispatch(other, "GET", path, &params) == 3);
+    assert(value(path, params, "other") == "2");
+
+    printf("router test passed\n");
+    return 0;
+}
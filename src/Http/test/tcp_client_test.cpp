@@ -0,0 +1,80 @@
+#include "TcpClient.h"
+#include "TcpServer.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <memory>
+#include <string>
+
+static const uint16_t kPort = 18090;
+
+/**
+ * 先让客户端去连一个还没有监听的端口，按退避时间重试，
+ * 服务端起来之后连上、收发数据；服务端把连接关掉之后客户端自动重连
+ */
+int main()
+{
+    Logger::setLogLevel(Logger::ERROR);
+    EventLoop loop;
+    InetAddress addr(kPort, "127.0.0.1");
+
+    int ups = 0;
+    int downs = 0;
+    std::string echoed;
+    Timestamp start = Timestamp::now();
+    double firstUp = 0;
+
+    TcpClient client(&loop, addr, "client");
+    client.enableRetry();
+    client.setConnectionCallback([&](const TcpConnectionPtr& conn) {
+        if (conn->connected())
+        {
+            if (++ups == 1)
+            {
+                firstUp = static_cast<double>(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch())
+                          / Timestamp::kMicroSecondsPerSecond;
+            }
+            conn->send("ping" + std::to_string(ups));
+        }
+        else
+        {
+            ++downs;
+        }
+    });
+    client.setMessageCallback([&](const TcpConnectionPtr&, Buffer* buf, Timestamp) {
+        echoed += buf->retrieveAllAsString();
+        if (ups == 2 && echoed == "ping1ping2")
+        {
+            loop.quit();
+        }
+    });
+    client.connect();
+
+    // 第一次连接失败之后 0.5 秒重试一次，再失败 1 秒之后重试，服务端在这两次之间起来
+    std::unique_ptr<TcpServer> server;
+    loop.runAfter(0.8, [&]() {
+        server.reset(new TcpServer(&loop, addr, "echo"));
+        server->setConnectionCallback([](const TcpConnectionPtr&) {});
+        server->setMessageCallback([](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            std::string msg = buf->retrieveAllAsString();
+            conn->send(msg);
+            if (msg == "ping1")
+            {
+                conn->shutdown();   // 第一条连接由服务端关掉，客户端应该重连
+            }
+        });
+        server->start();
+    });
+    loop.runAfter(10, [&]() { loop.quit(); });
+    loop.loop();
+
+    assert(ups == 2 && downs == 1);
+    assert(echoed == "ping1ping2");
+    // 没有在服务端起来之前连上，也没有等到下一次 2 秒的重试
+    assert(firstUp > 0.8 && firstUp < 2.0);
+    assert(client.connection() && client.connection()->connected());
+    printf("tcp client test passed\n");
+    return 0;
+}
@@ -0,0 +1,97 @@
+#include "webSocket.h"
+#include "httpRequest.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+
+// RFC 6455 1.3 中的例子
+static void testAcceptKey()
+{
+    assert(WebSocketConnection::acceptKey("dGhlIHNhbXBsZSBub25jZQ==") == "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+// 向量化的解掩码和逐字节异或的结果一致，长度覆盖 16/8 字节块和零头的各种组合
+static void testUnmask()
+{
+    const char mask[4] = { 0x37, static_cast<char>(0xfa), 0x21, 0x3d };
+    for (size_t len = 0; len < 300; ++len)
+    {
+        std::string data;
+        for (size_t i = 0; i < len; ++i)
+        {
+            data.push_back(static_cast<char>(rand()));
+        }
+        std::string expected(data);
+        for (size_t i = 0; i < len; ++i)
+        {
+            expected[i] ^= mask[i % 4];
+        }
+        // 起始地址不对齐
+        std::string buf = "x" + data;
+        WebSocketConnection::unmask(&buf[1], len, mask);
+        assert(buf.substr(1) == expected);
+    }
+
+    // RFC 6455 5.7 带掩码的 "Hello"
+    std::string hello("\x7f\x9f\x4d\x51\x58", 5);
+    WebSocketConnection::unmask(&hello[0], hello.size(), "\x37\xfa\x21\x3d");
+    assert(hello == "Hello");
+}
+
+static void testEncodeFrame()
+{
+    WebSocketFrame frame = WebSocketConnection::encodeFrame(WebSocketConnection::kText, "Hello", 5);
+    assert(*frame == std::string("\x81\x05Hello", 7));
+
+    // 长度分别用 7 位、16 位、64 位表示
+    std::string data(70000, 'a');
+    frame = WebSocketConnection::encodeFrame(WebSocketConnection::kBinary, data.data(), 125);
+    assert(frame->size() == 2 + 125 && static_cast<uint8_t>((*frame)[1]) == 125);
+    frame = WebSocketConnection::encodeFrame(WebSocketConnection::kBinary, data.data(), 256);
+    assert(frame->size() == 4 + 256 && (*frame)[0] == static_cast<char>(0x82));
+    assert(std::string(frame->data() + 1, 3) == std::string("\x7e\x01\x00", 3));
+    frame = WebSocketConnection::encodeFrame(WebSocketConnection::kBinary, data.data(), data.size());
+    assert(frame->size() == 10 + data.size());
+    assert(std::string(frame->data() + 1, 9) == std::string("\x7f\x00\x00\x00\x00\x00\x01\x11\x70", 9));
+}
+
+// 首部名全部小写的握手同样得到 101，版本不对或者不是 websocket 的不升级
+static void testHandshake()
+{
+    HttpRequest req;
+    Buffer buf;
+    std::string data = "GET /chat HTTP/1.1\r\nhost: server.example.com\r\nupgrade: websocket\r\n"
+                       "connection: Upgrade\r\nsec-websocket-key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                       "sec-websocket-version: 13\r\n\r\n";
+    buf.append(data.data(), data.size());
+    assert(req.parse(buf) && req.parse(buf) && req.IsFinish());
+    std::string response;
+    assert(WebSocketConnection::handshake(req, &response));
+    assert(response.compare(0, 13, "HTTP/1.1 101 ") == 0);
+    assert(response.find("Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n") != std::string::npos);
+
+    req.Init();
+    data = "GET /chat HTTP/1.1\r\nupgrade: websocket\r\nsec-websocket-key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+           "sec-websocket-version: 8\r\n\r\n";
+    buf.append(data.data(), data.size());
+    assert(req.parse(buf) && req.parse(buf) && req.IsFinish());
+    assert(!WebSocketConnection::handshake(req, &response));
+
+    req.Init();
+    data = "GET /chat HTTP/1.1\r\nupgrade: h2c\r\n\r\n";
+    buf.append(data.data(), data.size());
+    assert(req.parse(buf) && req.parse(buf) && req.IsFinish());
+    assert(!WebSocketConnection::handshake(req, &response));
+}
+
+int main()
+{
+    testAcceptKey();
+    testUnmask();
+    testEncodeFrame();
+    testHandshake();
+    printf("websocket_test passed\n");
+    return 0;
+}
@@ -0,0 +1,543 @@
+#include "webSocket.h"
+#include "httpRequest.h"
+#include "TcpConnection.h"
+#include "EventLoop.h"
+#include "Buffer.h"
+#include "Logging.h"
+
+#include <string.h>
+#include <vector>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// 握手只需要 SHA-1 一次，没有必要为它引入 OpenSSL
+std::string sha1(const std::string& input)
+{
+    uint32_t h[5] = { 0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0 };
+    std::string msg(input);
+    uint64_t bitLen = static_cast<uint64_t>(input.size()) * 8;
+    msg.push_back(static_cast<char>(0x80));
+    while (msg.size() % 64 != 56)
+    {
+        msg.push_back(0);
+    }
+    for (int i = 7; i >= 0; --i)
+    {
+        msg.push_back(static_cast<char>(bitLen >> (i * 8)));
+    }
+
+    for (size_t chunk = 0; chunk < msg.size(); chunk += 64)
+    {
+        uint32_t w[80];
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(msg.data() + chunk);
+        for (int i = 0; i < 16; ++i)
+        {
+            w[i] = (p[4 * i] << 24) | (p[4 * i + 1] << 16) | (p[4 * i + 2] << 8) | p[4 * i + 3];
+        }
+        for (int i = 16; i < 80; ++i)
+        {
+            uint32_t v = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+            w[i] = (v << 1) | (v >> 31);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; ++i)
+        {
+            uint32_t f, k;
+            if (i < 20)      { f = (b & c) | (~b & d);          k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d;                   k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else             { f = b ^ c ^ d;                   k = 0xCA62C1D6; }
+            uint32_t temp = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = (b << 30) | (b >> 2);
+            b = a;
+            a = temp;
+        }
+        h[0] += a; h[1] += b; h[2] += c; h[3] += d; h[4] += e;
+    }
+
+    std::string digest;
+    for (int i = 0; i < 5; ++i)
+    {
+        for (int j = 3; j >= 0; --j)
+        {
+            digest.push_back(static_cast<char>(h[i] >> (j * 8)));
+        }
+    }
+    return digest;
+}
+
+std::string base64Encode(const std::string& input)
+{
+    static const char kTable[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    size_t i = 0;
+    for (; i + 3 <= input.size(); i += 3)
+    {
+        uint32_t v = (static_cast<uint8_t>(input[i]) << 16) | (static_cast<uint8_t>(input[i + 1]) << 8)
+                     | static_cast<uint8_t>(input[i + 2]);
+        out.push_back(kTable[(v >> 18) & 63]);
+        out.push_back(kTable[(v >> 12) & 63]);
+        out.push_back(kTable[(v >> 6) & 63]);
+        out.push_back(kTable[v & 63]);
+    }
+    size_t rest = input.size() - i;
+    if (rest > 0)
+    {
+        uint32_t v = static_cast<uint8_t>(input[i]) << 16;
+        if (rest == 2)
+        {
+            v |= static_cast<uint8_t>(input[i + 1]) << 8;
+        }
+        out.push_back(kTable[(v >> 18) & 63]);
+        out.push_back(kTable[(v >> 12) & 63]);
+        out.push_back(rest == 2 ? kTable[(v >> 6) & 63] : '=');
+        out.push_back('=');
+    }
+    return out;
+}
+
+} // namespace
+
+constexpr double WebSocketConnection::kPingInterval;
+const size_t WebSocketConnection::kMaxMessageSize;
+
+WebSocketConnection::WebSocketConnection(const TcpConnectionPtr& conn, const WebSocketHandler& handler)
+    : conn_(conn),
+      loop_(conn->getLoop()),
+      handler_(handler),
+      closed_(false),
+      closeSent_(false),
+      opening_(false),
+      fragmented_(false),
+      messageOpcode_(kText),
+      lastReceive_(Timestamp::now())
+{
+}
+
+std::string WebSocketConnection::acceptKey(const std::string& key)
+{
+    return base64Encode(sha1(key + "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"));
+}
+
+bool WebSocketConnection::handshake(const HttpRequest& request, std::string* response)
+{
+    if (strcasecmp(request.GetHeader("Upgrade").c_str(), "websocket") != 0)
+    {
+        return false;
+    }
+    std::string key = request.GetHeader("Sec-WebSocket-Key");
+    if (key.empty() || request.GetHeader("Sec-WebSocket-Version") != "13")
+    {
+        return false;
+    }
+    *response = "HTTP/1.1 101 Switching Protocols\r\n"
+                "Upgrade: websocket\r\n"
+                "Connection: Upgrade\r\n"
+                "Sec-WebSocket-Accept: " + acceptKey(key) + "\r\n\r\n";
+    return true;
+}
+
+WebSocketFrame WebSocketConnection::encodeFrame(Opcode opcode, const char* data, size_t len)
+{
+    std::shared_ptr<std::string> frame(new std::string);
+    frame->reserve(len + 10);
+    frame->push_back(static_cast<char>(0x80 | opcode));    // 发出去的消息都不分片
+    if (len < 126)
+    {
+        frame->push_back(static_cast<char>(len));
+    }
+    else if (len <= 0xffff)
+    {
+        frame->push_back(126);
+        frame->push_back(static_cast<char>(len >> 8));
+        frame->push_back(static_cast<char>(len));
+    }
+    else
+    {
+        frame->push_back(127);
+        for (int i = 7; i >= 0; --i)
+        {
+            frame->push_back(static_cast<char>(static_cast<uint64_t>(len) >> (i * 8)));
+        }
+    }
+    frame->append(data, len);
+    return frame;
+}
+
+void WebSocketConnection::unmask(char* data, size_t len, const char mask[4])
+{
+    uint32_t m32;
+    memcpy(&m32, mask, 4);
+    size_t i = 0;
+    // 每一块的长度都是 4 的倍数，块的起点和掩码的相位始终对齐
+#ifdef __SSE2__
+    __m128i m128 = _mm_set1_epi32(static_cast<int>(m32));
+    for (; i + 16 <= len; i += 16)
+    {
+        __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(data + i), _mm_xor_si128(v, m128));
+    }
+#endif
+    uint64_t m64 = (static_cast<uint64_t>(m32) << 32) | m32;
+    for (; i + 8 <= len; i += 8)
+    {
+        uint64_t v;
+        memcpy(&v, data + i, 8);
+        v ^= m64;
+        memcpy(data + i, &v, 8);
+    }
+    for (; i < len; ++i)
+    {
+        data[i] ^= mask[i & 3];
+    }
+}
+
+void WebSocketConnection::sendText(const std::string& message)
+{
+    sendFrame(encodeFrame(kText, message.data(), message.size()));
+}
+
+void WebSocketConnection::sendBinary(const void* data, size_t len)
+{
+    sendFrame(encodeFrame(kBinary, static_cast<const char*>(data), len));
+}
+
+void WebSocketConnection::sendFrame(const WebSocketFrame& frame)
+{
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn || closeSent_)
+    {
+        return;
+    }
+    // 在loop线程中 send 直接写 socket，不拷贝；其他线程只多持有一份引用
+    if (loop_->isInLoopThread())
+    {
+        write(*frame);
+    }
+    else
+    {
+        std::shared_ptr<WebSocketConnection> self(shared_from_this());
+        loop_->queueInLoop([self, frame]() { self->write(*frame); });
+    }
+}
+
+void WebSocketConnection::write(const std::string& data)
+{
+    if (opening_)
+    {
+        openingOutput_.append(data);
+        return;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (conn)
+    {
+        conn->send(data);
+    }
+}
+
+void WebSocketConnection::close(uint16_t code, const std::string& reason)
+{
+    std::shared_ptr<WebSocketConnection> self(shared_from_this());
+    loop_->runInLoop([self, code, reason]() {
+        self->sendClose(code, reason);
+    });
+}
+
+void WebSocketConnection::sendClose(uint16_t code, const std::string& reason)
+{
+    if (closeSent_.exchange(true))
+    {
+        return;
+    }
+    TcpConnectionPtr conn = conn_.lock();
+    if (!conn)
+    {
+        return;
+    }
+    std::string payload;
+    payload.push_back(static_cast<char>(code >> 8));
+    payload.push_back(static_cast<char>(code));
+    payload.append(reason, 0, 123);     // 控制帧的负载不能超过 125 字节
+    write(*encodeFrame(kClose, payload.data(), payload.size()));
+    // 对端收到关闭帧后会回一个关闭帧再断开，这里不再等待，发完就关闭写端
+    if (!opening_)
+    {
+        conn->shutdown();
+    }
+}
+
+void WebSocketConnection::start(const HttpRequest& request, const std::string& handshake)
+{
+    opening_ = true;
+    openingOutput_ = handshake;
+    if (handler_.onOpen)
+    {
+        handler_.onOpen(shared_from_this(), request);
+    }
+    opening_ = false;
+    TcpConnectionPtr conn = conn_.lock();
+    if (conn)
+    {
+        conn->send(openingOutput_);
+        if (closeSent_)
+        {
+            conn->shutdown();    // onOpen 中拒绝了这个连接
+        }
+    }
+    std::string().swap(openingOutput_);
+    scheduleKeepalive();
+}
+
+// TimerQueue 没有取消接口，用一次性定时器链起来，连接没了链就断了
+void WebSocketConnection::scheduleKeepalive()
+{
+    std::weak_ptr<WebSocketConnection> weak(shared_from_this());
+    loop_->runAfter(kPingInterval, [weak]() {
+        std::shared_ptr<WebSocketConnection> self = weak.lock();
+        if (self)
+        {
+            self->keepalive();
+        }
+    });
+}
+
+void WebSocketConnection::keepalive()
+{
+    if (closed_ || closeSent_ || conn_.expired())
+    {
+        return;
+    }
+    int64_t idle = Timestamp::now().microSecondsSinceEpoch() - lastReceive_.microSecondsSinceEpoch();
+    if (idle > static_cast<int64_t>(2 * kPingInterval * Timestamp::kMicroSecondsPerSecond))
+    {
+        // 对端多半已经不在了，不会回关闭帧，也不会完成 FIN 握手，半关闭的连接要等到 TCP keepalive
+        // 才会释放，所以这里不走关闭握手，直接关掉连接，onClose 由断开回调触发
+        LOG_INFO << "websocket keepalive timeout";
+        closed_ = true;
+        closeSent_ = true;
+        TcpConnectionPtr conn = conn_.lock();
+        if (conn)
+        {
+            conn->forceClose();
+        }
+        return;
+    }
+    sendFrame(encodeFrame(kPing, nullptr, 0));
+    scheduleKeepalive();
+}
+
+void WebSocketConnection::onMessage(Buffer* buf)
+{
+    lastReceive_ = Timestamp::now();
+    while (!closed_ && buf->readableBytes() >= 2)
+    {
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(buf->peek());
+        bool fin = (p[0] & 0x80) != 0;
+        int opcode = p[0] & 0x0f;
+        // 客户端发来的帧必须带掩码，保留位必须为 0
+        if ((p[0] & 0x70) || !(p[1] & 0x80))
+        {
+            fail(1002);
+            break;
+        }
+        size_t headerLen = 2;
+        uint64_t len = p[1] & 0x7f;
+        if (len == 126)
+        {
+            headerLen += 2;
+        }
+        else if (len == 127)
+        {
+            headerLen += 8;
+        }
+        headerLen += 4;     // 掩码
+        if (buf->readableBytes() < headerLen)
+        {
+            break;
+        }
+        if (len == 126)
+        {
+            len = (p[2] << 8) | p[3];
+        }
+        else if (len == 127)
+        {
+            len = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                len = (len << 8) | p[2 + i];
+            }
+        }
+
+        // 控制帧不能分片，负载不能超过 125 字节
+        if ((opcode & 0x8) && (!fin || len > 125))
+        {
+            fail(1002);
+            break;
+        }
+        if (len > kMaxMessageSize || message_.size() + len > kMaxMessageSize)
+        {
+            fail(1009);
+            break;
+        }
+        if (buf->readableBytes() < headerLen + len)
+        {
+            break;
+        }
+
+        char* data = buf->beginRead() + headerLen;
+        unmask(data, len, reinterpret_cast<const char*>(p) + headerLen - 4);
+        handleFrame(fin, opcode, data, len);
+        buf->retrieve(headerLen + len);
+    }
+    if (closed_)
+    {
+        buf->retrieveAll();
+    }
+}
+
+void WebSocketConnection::handleFrame(bool fin, int opcode, const char* data, size_t len)
+{
+    switch (opcode)
+    {
+    case kText:
+    case kBinary:
+        if (fragmented_)
+        {
+            fail(1002);     // 上一条分片消息还没结束
+            return;
+        }
+        if (fin)
+        {
+            if (handler_.onMessage)
+            {
+                handler_.onMessage(shared_from_this(), data, len, opcode == kBinary);
+            }
+        }
+        else
+        {
+            fragmented_ = true;
+            messageOpcode_ = opcode;
+            message_.assign(data, len);
+        }
+        break;
+    case kContinuation:
+        if (!fragmented_)
+        {
+            fail(1002);
+            return;
+        }
+        message_.append(data, len);
+        if (fin)
+        {
+            fragmented_ = false;
+            if (handler_.onMessage)
+            {
+                handler_.onMessage(shared_from_this(), message_.data(), message_.size(), messageOpcode_ == kBinary);
+            }
+            std::string().swap(message_);
+        }
+        break;
+    case kPing:
+        sendFrame(encodeFrame(kPong, data, len));
+        break;
+    case kPong:
+        break;
+    case kClose:
+    {
+        // 回一个同样状态码的关闭帧，没有状态码就回 1000
+        uint16_t code = 1000;
+        if (len == 1)
+        {
+            code = 1002;
+        }
+        else if (len >= 2)
+        {
+            code = static_cast<uint16_t>((static_cast<uint8_t>(data[0]) << 8) | static_cast<uint8_t>(data[1]));
+        }
+        closed_ = true;
+        sendClose(code, std::string());
+        break;
+    }
+    default:
+        fail(1002);
+        break;
+    }
+}
+
+void WebSocketConnection::fail(uint16_t code)
+{
+    LOG_DEBUG << "websocket closed with " << code;
+    closed_ = true;
+    sendClose(code, std::string());
+}
+
+void WebSocketConnection::onDisconnected()
+{
+    closed_ = true;
+    closeSent_ = true;
+    if (handler_.onClose)
+    {
+        handler_.onClose(shared_from_this());
+    }
+}
+
+void WebSocketHub::add(const WebSocketConnectionPtr& conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    conns_[conn.get()] = conn;
+}
+
+void WebSocketHub::remove(const WebSocketConnectionPtr& conn)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    conns_.erase(conn.get());
+}
+
+size_t WebSocketHub::size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return conns_.size();
+}
+
+void WebSocketHub::broadcast(const std::string& message, bool binary)
+{
+    broadcast(WebSocketConnection::encodeFrame(binary ? WebSocketConnection::kBinary : WebSocketConnection::kText,
+                                               message.data(), message.size()));
+}
+
+void WebSocketHub::broadcast(const WebSocketFrame& frame)
+{
+    // 锁里只做分组，发送在各自的loop线程中进行
+    std::map<EventLoop*, std::vector<WebSocketConnectionPtr>> groups;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = conns_.begin(); it != conns_.end();)
+        {
+            WebSocketConnectionPtr conn = it->second.lock();
+            if (!conn)
+            {
+                it = conns_.erase(it);
+                continue;
+            }
+            groups[conn->getLoop()].push_back(conn);
+            ++it;
+        }
+    }
+    for (auto& group : groups)
+    {
+        std::shared_ptr<std::vector<WebSocketConnectionPtr>> conns(
+            new std::vector<WebSocketConnectionPtr>(std::move(group.second)));
+        group.first->runInLoop([conns, frame]() {
+            for (const WebSocketConnectionPtr& conn : *conns)
+            {
+                conn->sendFrame(frame);
+            }
+        });
+    }
+}
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <stdint.h>
+#include <map>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <functional>
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "Timestamp.h"
+
+class Buffer;
+class EventLoop;
+class HttpRequest;
+class WebSocketConnection;
+
+using WebSocketConnectionPtr = std::shared_ptr<WebSocketConnection>;
+using WebSocketFrame = std::shared_ptr<const std::string>;     // 编码好的帧，可以被多个连接共享
+
+// WebSocket 路径上的回调，都在连接所属的loop线程中调用
+struct WebSocketHandler
+{
+    std::function<void (const WebSocketConnectionPtr&, const HttpRequest&)> onOpen;
+    // 没有分片的消息直接指向输入缓冲区，不经过拷贝，回调返回后就失效了
+    std::function<void (const WebSocketConnectionPtr&, const char* data, size_t len, bool binary)> onMessage;
+    std::function<void (const WebSocketConnectionPtr&)> onClose;
+};
+
+/**
+ * 升级成 WebSocket 之后的连接，保存在 HttpContext 中
+ * 1. 收到的帧在输入缓冲区里原地解掩码，完整的消息不再拷贝，分片的消息拼起来再交给回调
+ * 2. 定时发 ping，一段时间内什么都没收到就认为对端已经断开
+ * 3. 发送的接口都是线程安全的
+ */
+class WebSocketConnection : noncopyable,
+    public std::enable_shared_from_this<WebSocketConnection>
+{
+public:
+    enum Opcode
+    {
+        kContinuation = 0x0,
+        kText = 0x1,
+        kBinary = 0x2,
+        kClose = 0x8,
+        kPing = 0x9,
+        kPong = 0xa,
+    };
+
+    static const size_t kMaxMessageSize = 16 * 1024 * 1024;
+    static constexpr double kPingInterval = 30.0;  // 秒，超过两个周期没有收到任何数据就关闭连接
+
+    WebSocketConnection(const TcpConnectionPtr& conn, const WebSocketHandler& handler);
+
+    // 握手响应中的 Sec-WebSocket-Accept
+    static std::string acceptKey(const std::string& key);
+    // 检查升级请求的首部(名字不区分大小写)，是版本 13 的 WebSocket 握手时生成 101 响应并返回 true
+    static bool handshake(const HttpRequest& request, std::string* response);
+    // 服务端发出的帧不加掩码
+    static WebSocketFrame encodeFrame(Opcode opcode, const char* data, size_t len);
+    // 掩码每 4 字节重复一次，扩展成 16 字节一次异或一整块
+    static void unmask(char* data, size_t len, const char mask[4]);
+
+    void sendText(const std::string& message);
+    void sendBinary(const void* data, size_t len);
+    void sendFrame(const WebSocketFrame& frame);
+    void close(uint16_t code = 1000, const std::string& reason = std::string());
+
+    EventLoop* getLoop() const { return loop_; }
+    TcpConnectionPtr connection() const { return conn_.lock(); }
+
+    // 以下由 HttpServer 调用
+    // handshake 是 101 响应，onOpen 返回之后才和 onOpen 里发送的帧一起发出去，
+    // 这样客户端收到 101 时 onOpen 里的注册(比如加入 WebSocketHub)一定已经完成了
+    void start(const HttpRequest& request, const std::string& handshake);
+    void onMessage(Buffer* buf);
+    void onDisconnected();
+
+private:
+    void write(const std::string& data);
+    void handleFrame(bool fin, int opcode, const char* data, size_t len);
+    void fail(uint16_t code);
+    void sendClose(uint16_t code, const std::string& reason);
+    void scheduleKeepalive();
+    void keepalive();
+
+    std::weak_ptr<TcpConnection> conn_;
+    EventLoop* loop_;
+    WebSocketHandler handler_;
+    bool closed_;                   // 收到或者发出了关闭帧，之后收到的数据都丢掉
+    std::atomic_bool closeSent_;
+    bool opening_;                  // 正在执行 onOpen
+    std::string openingOutput_;     // 握手响应和 onOpen 中发送的数据
+    bool fragmented_;               // 正在接收分片的消息
+    int messageOpcode_;
+    std::string message_;           // 分片消息拼接到这里
+    Timestamp lastReceive_;
+};
+
+/**
+ * 一组 WebSocket 连接，广播的时候帧只编码一次，
+ * 按 loop 分组之后每个 loop 只投递一个任务，所有连接发送同一份数据
+ */
+class WebSocketHub : noncopyable
+{
+public:
+    void add(const WebSocketConnectionPtr& conn);
+    void remove(const WebSocketConnectionPtr& conn);
+    size_t size() const;
+
+    void broadcast(const std::string& message, bool binary = false);
+    void broadcast(const WebSocketFrame& frame);
+
+private:
+    mutable std::mutex mutex_;
+    std::map<WebSocketConnection*, std::weak_ptr<WebSocketConnection>> conns_;
+};
@@ -1,125 +1,601 @@
 #include "AsyncLogging.h"
+#include "BinaryLogging.h"
 #include "Timestamp.h"
+#include "CurrentThread.h"
+#include "Metrics.h"
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <new>
+
+// 一个线程独占的单生产者单消费者环形缓冲区
+struct LogStage
+{
+    explicit LogStage(size_t capacity)
+        : data(new char[capacity]),
+          capacity(capacity),
+          tid(CurrentThread::tid()),
+          head(0),
+          tail(0),
+          signaled(false),
+          closed(false),
+          cachedTail(0),
+          stalledTail(UINT64_MAX)
+    {
+        for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+        {
+            dropped[i] = 0;
+            reported[i] = 0;
+        }
+    }
+
+    std::unique_ptr<char[]> data;
+    const size_t capacity;
+    const int tid;
+    // head 只由生产者写，tail 只由后端写，分开放避免来回抢同一个缓存行
+    alignas(64) std::atomic<uint64_t> head;
+    alignas(64) std::atomic<uint64_t> tail;
+    std::atomic<uint64_t> dropped[Logger::LEVEL_COUNT];
+    std::atomic<bool> signaled;     // 过半之后已经叫过后端了，后端取走数据后清掉
+    std::atomic<bool> closed;       // 线程退出了，后端取完剩下的数据就回收
+    uint64_t cachedTail;            // 生产者看到的 tail，不够用时才重新读
+    uint64_t stalledTail;           // 上次等空间超时时的 tail，后端没有进展之前不再等
+    uint64_t reported[Logger::LEVEL_COUNT];    // 后端已经写过丢弃提示的条数，只在后端使用
+
+    // C++11 的 new 不保证 alignas(64) 的对齐，用 posix_memalign 分配，destroy 释放
+    static LogStage* create(size_t capacity)
+    {
+        void* p = nullptr;
+        if (posix_memalign(&p, alignof(LogStage), sizeof(LogStage)) != 0)
+        {
+            throw std::bad_alloc();
+        }
+        try
+        {
+            return new (p) LogStage(capacity);
+        }
+        catch (...)
+        {
+            free(p);
+            throw;
+        }
+    }
+
+    static void destroy(LogStage* stage)
+    {
+        stage->~LogStage();
+        free(stage);
+    }
+};
+
+namespace
+{
+
+std::atomic<uint64_t> g_nextLoggerId(1);
+
+const char* kLevelLabels[Logger::LEVEL_COUNT] = {"trace", "debug", "info", "warn", "error", "fatal"};
+// 结构化格式下每个等级丢弃数量的字段名
+const LogKey kDroppedKeys[Logger::LEVEL_COUNT] = {
+    "dropped_trace", "dropped_debug", "dropped_info", "dropped_warn", "dropped_error", "dropped_fatal"
+};
+
+// 所有 AsyncLogging 实例共用的指标
+struct LogMetrics
+{
+    LogMetrics()
+    {
+        MetricsRegistry& registry = MetricsRegistry::instance();
+        queueBytes = registry.gauge("myweb_log_queue_bytes",
+                                    "Log bytes staged by front-end threads when the backend last drained them");
+        for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+        {
+            dropped[i] = registry.counter("myweb_log_dropped_total", "Log messages dropped under overload",
+                                          std::string("level=\"") + kLevelLabels[i] + "\"");
+        }
+    }
+
+    Gauge* queueBytes;
+    Counter* dropped[Logger::LEVEL_COUNT];
+};
+
+LogMetrics& logMetrics()
+{
+    static LogMetrics metrics;
+    return metrics;
+}
+
+// 线程退出时通知后端这个缓冲区不会再有新数据
+struct LocalStage
+{
+    uint64_t owner = 0;
+    std::shared_ptr<LogStage> stage;
+
+    void release()
+    {
+        if (stage)
+        {
+            stage->closed.store(true, std::memory_order_release);
+            stage.reset();
+        }
+        owner = 0;
+    }
+
+    ~LocalStage() { release(); }
+};
+
+thread_local LocalStage t_stage;
+
+// 按环形缓冲区的逻辑位置读写，跨过末尾时分两段
+void copyIn(LogStage& stage, uint64_t pos, const char* data, size_t len)
+{
+    size_t offset = pos % stage.capacity;
+    size_t first = std::min(len, stage.capacity - offset);
+    memcpy(stage.data.get() + offset, data, first);
+    memcpy(stage.data.get(), data + first, len - first);
+}
+
+void copyOut(const LogStage& stage, uint64_t pos, void* dst, size_t len)
+{
+    size_t offset = pos % stage.capacity;
+    size_t first = std::min(len, stage.capacity - offset);
+    memcpy(dst, stage.data.get() + offset, first);
+    memcpy(static_cast<char*>(dst) + first, stage.data.get(), len - first);
+}
+
+// 格式化出来的文本先攒在这里，和缓冲区里的数据一起 writev
+const size_t kArenaBytes = 64 * 1024;
+
+} // namespace
 
 AsyncLogging::AsyncLogging(const std::string& basename,
                            off_t rollSize,
-                           int flushInterval)
+                           int flushInterval,
+                           size_t stagingBytes)
     : flushInterval_(flushInterval),
       running_(false),
       basename_(basename),
       rollSize_(rollSize),
+      stagingBytes_(stagingBytes < static_cast<size_t>(kSmallBuffer) ? kSmallBuffer : stagingBytes),
+      id_(g_nextLoggerId.fetch_add(1)),
       thread_(std::bind(&AsyncLogging::threadFunc, this), "Logging"),
       mutex_(),
       cond_(),
-      currentBuffer_(new Buffer),
-      nextBuffer_(new Buffer),
-      buffers_()
+      wakeup_(false),
+      blockLevel_(Logger::ERROR),
+      blockTimeoutMs_(100),
+      stages_(),
+      binaryOutput_(false),
+      formatsFile_(0),
+      formatsWritten_(0),
+      publishedDepth_(0),
+      syncInterval_(0),
+      preallocate_(false)
 {
-    currentBuffer_->bzero();
-    nextBuffer_->bzero();
-    buffers_.reserve(16);
+    arena_.reserve(kArenaBytes);
+    for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+    {
+        retiredDropped_[i] = 0;
+    }
+    setDropThreshold(Logger::TRACE, 0.5);
+    setDropThreshold(Logger::DEBUG, 0.5);
+    setDropThreshold(Logger::INFO, 0.75);
+    setDropThreshold(Logger::WARN, 1.0);
+    setDropThreshold(Logger::ERROR, 1.0);
+    setDropThreshold(Logger::FATAL, 1.0);
+    logMetrics();
 }
 
-void AsyncLogging::append(const char* logline, int len)
+void AsyncLogging::setDropThreshold(Logger::LogLevel level, double fraction)
 {
-    // lock在构造函数中自动绑定它的互斥体并加锁，在析构函数中解锁，大大减少了死锁的风险
-    std::lock_guard<std::mutex> lock(mutex_);
-    // 缓冲区剩余空间足够则直接写入
-    if (currentBuffer_->avail() > len)
+    fraction = std::max(0.0, std::min(fraction, 1.0));
+    dropAbove_[level] = static_cast<size_t>(static_cast<double>(stagingBytes_) * fraction);
+}
+
+void AsyncLogging::setBlockPolicy(Logger::LogLevel level, int timeoutMs)
+{
+    blockLevel_ = level;
+    blockTimeoutMs_ = timeoutMs;
+}
+
+LogStage* AsyncLogging::localStage()
+{
+    if (t_stage.owner == id_)
     {
-        currentBuffer_->append(logline, len);
+        return t_stage.stage.get();
     }
-    else
+    // 这个线程第一次写这个实例的日志，分配并登记它的缓冲区
+    t_stage.release();
+    StagePtr stage(LogStage::create(stagingBytes_), LogStage::destroy);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages_.push_back(stage);
+    }
+    t_stage.owner = id_;
+    t_stage.stage = stage;
+    return stage.get();
+}
+
+void AsyncLogging::signal(LogStage* stage)
+{
+    if (!stage->signaled.load(std::memory_order_relaxed)
+        && !stage->signaled.exchange(true, std::memory_order_acq_rel))
     {
-        // 当前缓冲区空间不够，将新信息写入备用缓冲区
-        buffers_.push_back(std::move(currentBuffer_));
-        if (nextBuffer_) 
-        {
-            currentBuffer_ = std::move(nextBuffer_);
-        } 
-        else 
         {
-            // 备用缓冲区也不够时，重新分配缓冲区，这种情况很少见
-            currentBuffer_.reset(new Buffer);
+            std::lock_guard<std::mutex> lock(mutex_);
+            wakeup_ = true;
         }
-        currentBuffer_->append(logline, len);
-        // std::cout << "After append, currentBuffer_->length(): " << currentBuffer_->length() << std::endl;
-        // 唤醒写入磁盘得后端线程
         cond_.notify_one();
     }
 }
-void AsyncLogging::threadFunc()
+
+bool AsyncLogging::append(const char* logline, int len, Logger::LogLevel level)
 {
-    LogFile output(basename_, rollSize_, false);
-    BufferPtr newBuffer1(new Buffer);
-    BufferPtr newBuffer2(new Buffer);
-    newBuffer1->bzero();
-    newBuffer2->bzero();
-    // std::cout<<"newBuffer1->length():"<<newBuffer1->length()<<std::endl;
-    BufferVector buffersToWrite;
-    buffersToWrite.reserve(16);
+    LogRecordHeader header;
+    header.size = static_cast<uint32_t>(sizeof header + len);
+    header.format = kLogTextRecord;
+    return push(reinterpret_cast<const char*>(&header), sizeof header, logline, static_cast<size_t>(len), level);
+}
 
-    while (running_)
+bool AsyncLogging::appendRecord(const char* record, size_t len, Logger::LogLevel level)
+{
+    return push(record, len, nullptr, 0, level);
+}
+
+bool AsyncLogging::push(const char* data, size_t len, const char* extra, size_t extraLen, Logger::LogLevel level)
+{
+    LogStage* stage = localStage();
+    const uint64_t head = stage->head.load(std::memory_order_relaxed);
+    const size_t n = len + extraLen;
+    const size_t limit = dropAbove_[level];
+    if (head + n - stage->cachedTail > limit)
     {
+        stage->cachedTail = stage->tail.load(std::memory_order_acquire);
+        if (head + n - stage->cachedTail > limit
+            && !(level >= blockLevel_ && limit == stage->capacity && waitForSpace(stage, head, n)))
         {
-            std::unique_lock<std::mutex> lock(mutex_);
-            if (buffers_.empty())
+            stage->dropped[level].fetch_add(1, std::memory_order_relaxed);
+            signal(stage);
+            return false;
+        }
+    }
+    copyIn(*stage, head, data, len);
+    if (extraLen > 0)
+    {
+        copyIn(*stage, head + len, extra, extraLen);
+    }
+    stage->head.store(head + n, std::memory_order_release);
+
+    if (head + n - stage->cachedTail > stage->capacity / 2)
+    {
+        signal(stage);
+    }
+    return true;
+}
+
+// 缓冲区满了，叫醒后端并等它腾出空间，超时返回 false
+bool AsyncLogging::waitForSpace(LogStage* stage, uint64_t head, size_t n)
+{
+    if (blockTimeoutMs_ <= 0 || !running_ || n > stage->capacity || stage->cachedTail == stage->stalledTail)
+    {
+        return false;
+    }
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(blockTimeoutMs_);
+    std::unique_lock<std::mutex> lock(mutex_);
+    wakeup_ = true;
+    cond_.notify_one();
+    while (true)
+    {
+        stage->cachedTail = stage->tail.load(std::memory_order_acquire);
+        if (head + n - stage->cachedTail <= stage->capacity)
+        {
+            return true;
+        }
+        if (!running_ || spaceCond_.wait_until(lock, deadline) == std::cv_status::timeout)
+        {
+            stage->cachedTail = stage->tail.load(std::memory_order_acquire);
+            if (head + n - stage->cachedTail <= stage->capacity)
             {
-                cond_.wait_for(lock, std::chrono::seconds(3));
+                return true;
             }
-            // std::cout<<"out_currentBuffer_->length():"<< currentBuffer_->length()<<std::endl;
-            // 确保只写入有内容的 buffer
-            if (currentBuffer_->length() > 0)
+            // 后端卡住了(比如磁盘写不动)，之后的日志直接丢，免得每条都等一次
+            stage->stalledTail = stage->cachedTail;
+            return false;
+        }
+    }
+}
+
+uint64_t AsyncLogging::droppedMessages(Logger::LogLevel level) const
+{
+    int first = level == Logger::LEVEL_COUNT ? 0 : level;
+    int last = level == Logger::LEVEL_COUNT ? Logger::LEVEL_COUNT : level + 1;
+    uint64_t total = 0;
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (int i = first; i < last; ++i)
+    {
+        total += retiredDropped_[i].load(std::memory_order_relaxed);
+        for (const StagePtr& stage : stages_)
+        {
+            total += stage->dropped[i].load(std::memory_order_relaxed);
+        }
+    }
+    return total;
+}
+
+// 依次把每个线程缓冲区里已经提交的日志写到文件，线程已经退出的取完之后回收
+void AsyncLogging::drain(LogFile& output)
+{
+    if (binaryOutput_)
+    {
+        writeFormats(output);
+    }
+    std::vector<StagePtr> stages;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stages = stages_;
+    }
+    bool retired = false;
+    int64_t depth = 0;
+    for (const StagePtr& stage : stages)
+    {
+        // 先看 closed 再读 head，保证读到的是线程退出前最后的位置
+        bool closed = stage->closed.load(std::memory_order_acquire);
+        uint64_t tail = stage->tail.load(std::memory_order_relaxed);
+        uint64_t head = stage->head.load(std::memory_order_acquire);
+        depth += static_cast<int64_t>(head - tail);
+        if (head != tail)
+        {
+            // iovec 指向缓冲区里的数据，写完之后才能把空间还给前端
+            drainStage(*stage, tail, head, output);
+            writeBatch(output);
+            stage->tail.store(head, std::memory_order_release);
+        }
+        stage->signaled.store(false, std::memory_order_release);
+        // 丢弃提示写在腾出空间之后，紧跟在丢日志之前写进缓冲区的内容后面
+        reportDropped(*stage, output);
+        retired = retired || closed;
+    }
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (retired)
+        {
+            for (auto it = stages_.begin(); it != stages_.end();)
             {
-                // std::cout<<"currentBuffer_->length():"<< currentBuffer_->length()<<std::endl;
-                buffers_.push_back(std::move(currentBuffer_));
+                // 只回收已经取空的，closed 之后不会再有新数据
+                if ((*it)->closed.load(std::memory_order_acquire)
+                    && (*it)->head.load(std::memory_order_acquire) == (*it)->tail.load(std::memory_order_relaxed))
+                {
+                    for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+                    {
+                        retiredDropped_[i].fetch_add((*it)->dropped[i].load(std::memory_order_relaxed),
+                                                     std::memory_order_relaxed);
+                    }
+                    it = stages_.erase(it);
+                }
+                else
+                {
+                    ++it;
+                }
             }
-            // std::cout<<"movecurrentBuffer"<<std::endl;
-            currentBuffer_ = std::move(newBuffer1);
-            buffersToWrite.swap(buffers_);
+        }
+    }
+    // 有前端在等空间的话叫醒它们
+    spaceCond_.notify_all();
+    logMetrics().queueBytes->add(depth - publishedDepth_);
+    publishedDepth_ = depth;
+    // 写的过程中文件可能滚动了，新文件里也要有格式串定义
+    if (binaryOutput_)
+    {
+        writeFormats(output);
+    }
+}
 
-            if (!nextBuffer_)
+void AsyncLogging::drainStage(LogStage& stage, uint64_t tail, uint64_t head, LogFile& output)
+{
+    uint64_t pos = tail;
+    while (pos < head)
+    {
+        LogRecordHeader header;
+        copyOut(stage, pos, &header, sizeof header);
+        if (binaryOutput_)
+        {
+            addRing(stage, pos, header.size);
+        }
+        else if (header.format == kLogTextRecord)
+        {
+            addRing(stage, pos + sizeof header, header.size - sizeof header);
+        }
+        else
+        {
+            // 二进制记录在后端线程格式化
+            const LogFormat* format = BinaryLogging::format(header.format);
+            scratch_.resize(header.size);
+            copyOut(stage, pos, scratch_.data(), header.size);
+            LogStream stream;
+            if (format != nullptr && BinaryLogging::formatRecord(*format, scratch_.data(), header.size, stream,
+                                                                 Logger::format(), stage.tid))
             {
-                nextBuffer_ = std::move(newBuffer2);
+                addCopy(stream.buffer().data(), stream.buffer().length(), output);
             }
         }
-        // std::cout<<"out struct"<<std::endl;
-        // **确保只写入有效数据**
-        for (const auto& buffer : buffersToWrite)
+        pos += header.size;
+    }
+}
+
+// 相邻的数据合并成一个 iovec，二进制输出时整段缓冲区就是一两个 iovec
+void AsyncLogging::addIov(const char* data, size_t len)
+{
+    if (len == 0)
+    {
+        return;
+    }
+    if (!iov_.empty())
+    {
+        struct iovec& last = iov_.back();
+        if (static_cast<char*>(last.iov_base) + last.iov_len == data)
         {
-            output.append(buffer->data(), buffer->length()); 
-            // std::cout<<"buffer->length():"<< buffer->length()<<std::endl;
+            last.iov_len += len;
+            return;
         }
-        // std::cout<<"out struct1"<<std::endl;
-        // **只保留两个 buffer** 如果不够就进行扩容，为了分配给newBuffer1 和 newBuffer2
-        if (buffersToWrite.size() > 2)
+    }
+    struct iovec iov;
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = len;
+    iov_.push_back(iov);
+}
+
+// 缓冲区里 [pos, pos + len) 这段，跨过末尾时分两段
+void AsyncLogging::addRing(const LogStage& stage, uint64_t pos, size_t len)
+{
+    size_t offset = pos % stage.capacity;
+    size_t first = std::min(len, stage.capacity - offset);
+    addIov(stage.data.get() + offset, first);
+    addIov(stage.data.get(), len - first);
+}
+
+// 后端自己生成的文本拷到 arena_ 里，arena_ 满了先把这一批写出去，保证指针不失效
+void AsyncLogging::addCopy(const char* data, size_t len, LogFile& output)
+{
+    if (arena_.size() + len > arena_.capacity())
+    {
+        writeBatch(output);
+    }
+    if (len > arena_.capacity())
+    {
+        output.append(data, static_cast<int>(len));
+        return;
+    }
+    size_t offset = arena_.size();
+    arena_.append(data, len);
+    addIov(&arena_[offset], len);
+}
+
+void AsyncLogging::writeBatch(LogFile& output)
+{
+    if (!iov_.empty())
+    {
+        output.appendv(iov_.data(), static_cast<int>(iov_.size()));
+        iov_.clear();
+    }
+    arena_.clear();
+}
+
+// 把这个线程新丢弃的条数写成一行日志，同时计入指标
+void AsyncLogging::reportDropped(LogStage& stage, LogFile& output)
+{
+    uint64_t total = 0;
+    uint64_t counts[Logger::LEVEL_COUNT];
+    for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+    {
+        uint64_t dropped = stage.dropped[i].load(std::memory_order_relaxed);
+        counts[i] = dropped - stage.reported[i];
+        stage.reported[i] = dropped;
+        total += counts[i];
+        if (counts[i] > 0)
         {
-            buffersToWrite.erase(buffersToWrite.begin() + 2, buffersToWrite.end());
-        }else if(buffersToWrite.size()==1){
-            buffersToWrite.emplace_back(new Buffer);
-        }else if(buffersToWrite.size()==0){
-            buffersToWrite.emplace_back(new Buffer);
-            buffersToWrite.emplace_back(new Buffer);
+            logMetrics().dropped[i]->inc(counts[i]);
         }
-        // std::cout<<"out struct2"<<std::endl;
-        if (!newBuffer1)
+    }
+    if (total == 0)
+    {
+        return;
+    }
+
+    LogStream stream;
+    const int64_t now = Timestamp::now().microSecondsSinceEpoch();
+    const LogFieldFormat format = Logger::format();
+    int msgBegin = 0;
+    if (format == LogFieldFormat::TEXT)
+    {
+        stream << GeneralTemplate(formatLogTime(now), kLogTimeLength) << "[ WARN  ] ";
+    }
+    else
+    {
+        msgBegin = beginStructuredLog(stream, format, Logger::WARN, now, CurrentThread::tid());
+    }
+    stream << "AsyncLogging dropped " << total << " messages from thread " << stage.tid << " (";
+    const char* sep = "";
+    for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
+    {
+        if (counts[i] > 0)
         {
-            newBuffer1 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer1->bzero();  // **清除残留数据**
+            stream << sep << kLevelLabels[i] << ' ' << counts[i];
+            sep = ", ";
         }
-        // std::cout<<"out struct3"<<std::endl;
-        if (!newBuffer2)
+    }
+    stream << ")";
+    if (format == LogFieldFormat::TEXT)
+    {
+        stream << "\n";
+    }
+    else
+    {
+        // 和 Logger 的行一样，数量另外作为字段给下游统计
+        LogFieldBuffer fields(format);
+        fields.add(LogField("dropped", total));
+        fields.add(LogField("thread", stage.tid));
+        for (int i = 0; i < Logger::LEVEL_COUNT; ++i)
         {
-            newBuffer2 = std::move(buffersToWrite.back());
-            buffersToWrite.pop_back();
-            newBuffer2->bzero();  // **清除残留数据**
+            if (counts[i] > 0)
+            {
+                fields.add(LogField(kDroppedKeys[i], counts[i]));
+            }
         }
+        endStructuredLog(stream, msgBegin, fields, nullptr, nullptr, 0, 0);
+    }
+    if (binaryOutput_)
+    {
+        // 二进制文件里也要有头部，解码工具才能原样输出
+        LogRecordHeader header;
+        header.size = static_cast<uint32_t>(sizeof header + stream.buffer().length());
+        header.format = kLogTextRecord;
+        output.append(reinterpret_cast<const char*>(&header), sizeof header);
+    }
+    output.append(stream.buffer().data(), stream.buffer().length());
+}
+
+// 二进制输出时，把还没写进当前文件的格式串定义补上
+void AsyncLogging::writeFormats(LogFile& output)
+{
+    if (output.fileCount() != formatsFile_)
+    {
+        formatsFile_ = output.fileCount();
+        formatsWritten_ = 0;
+    }
+    uint32_t count = BinaryLogging::formatCount();
+    for (uint32_t id = formatsWritten_ + 1; id <= count; ++id)
+    {
+        std::string definition = BinaryLogging::encodeFormat(id, *BinaryLogging::format(id));
+        output.append(definition.data(), static_cast<int>(definition.size()));
+    }
+    formatsWritten_ = count;
+}
 
-        buffersToWrite.clear();  // 彻底清除已写入的 buffer
-        if(::time(NULL)-output.getLastFlush()>3)
-            output.flush();  // **确保数据真正落盘**
+void AsyncLogging::threadFunc()
+{
+    LogFile output(basename_, rollSize_, false);
+    output.setSyncInterval(syncInterval_);
+    output.setPreallocate(preallocate_);
+    output.setRollCallback(rollCallback_);
+    while (running_)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            if (!wakeup_)
+            {
+                cond_.wait_for(lock, std::chrono::seconds(flushInterval_));
+            }
+            wakeup_ = false;
+        }
+        drain(output);
+        if (::time(NULL) - output.getLastFlush() > flushInterval_)
+        {
+            output.flush();  // 设置了 syncInterval 时到点还会 fdatasync
+        }
     }
+    // 退出前把剩下的都写出去
+    drain(output);
+    output.flush();
+    logMetrics().queueBytes->add(-publishedDepth_);
+    publishedDepth_ = 0;
 }
@@ -5,19 +5,38 @@
 #include "FixedBuffer.h"
 #include "LogStream.h"
 #include "LogFile.h"
-
+#include "Logging.h"
 
 #include <vector>
 #include <memory>
 #include <mutex>
+#include <atomic>
 #include <condition_variable>
 
-class AsyncLogging
+struct LogStage;
+
+/**
+ * 异步日志
+ *
+ * 前端每个线程第一次 append 时分到一个自己的暂存环形缓冲区，之后写日志只是 memcpy 加一次 release 写，
+ * 不再和其他线程抢同一把锁。后端线程定期(或者某个缓冲区过半时被唤醒)把所有线程的缓冲区依次写进文件。
+ * 内存占用最多是 线程数 * stagingBytes，磁盘写不动时按等级丢日志而不是无限增长：
+ * 缓冲区用量超过某个等级的阈值后丢弃这个等级的日志(默认 DEBUG 及以下过半就丢，INFO 超过 3/4 丢，WARN 用满才丢)，
+ * ERROR 及以上在缓冲区满时最多等后端一小段时间，还是没有空间才丢。
+ * 丢了的条数由后端在腾出空间后写一行 "AsyncLogging dropped N messages" 记下来，同时导出到 MetricsRegistry。
+ * 缓冲区里每条日志前面有一个 LogRecordHeader，文本日志和 BinaryLogging 的二进制记录共用一个缓冲区。
+ * 同一个线程的日志保持顺序，不同线程之间的日志在同一批里按线程分组，不再严格按时间交错。
+ * 后端把一个线程缓冲区里的日志攒成一组 iovec 用 writev 直接交给内核，中间不经过 stdio 的缓冲区。
+ */
+class AsyncLogging : noncopyable
 {
 public:
+    static const size_t kDefaultStagingBytes = 1024 * 1024;
+
     AsyncLogging(const std::string& basename,
                  off_t rollSize,
-                 int flushInterval = 3);
+                 int flushInterval = 3,
+                 size_t stagingBytes = kDefaultStagingBytes);
     ~AsyncLogging()
     {
         if (running_)
@@ -26,8 +45,30 @@ public:
         }
     }
 
-    // 前端调用 append 写入日志
-    void append(const char* logling, int len);
+    // 前端调用 append 写入日志，按 level 的策略被丢弃时返回 false
+    bool append(const char* logline, int len, Logger::LogLevel level = Logger::INFO);
+    // 写入一条 BinaryLogging 编码好的记录，由后端格式化或者原样写到文件
+    bool appendRecord(const char* record, size_t len, Logger::LogLevel level = Logger::INFO);
+
+    // 线程缓冲区的用量超过 fraction(0~1) 时丢弃 level 等级的日志
+    void setDropThreshold(Logger::LogLevel level, double fraction);
+    // level 及以上等级的日志在缓冲区满时最多等 timeoutMs 毫秒，默认 ERROR 等 100ms；timeoutMs 为 0 时不等
+    void setBlockPolicy(Logger::LogLevel level, int timeoutMs);
+
+    /**
+     * 打开之后后端不再格式化二进制记录，连同格式串定义原样写进文件，
+     * 用 tools/myweb-logdecode 还原成文本；需要在 start 之前调用
+     */
+    void setBinaryOutput(bool on) { binaryOutput_ = on; }
+    // 每隔 seconds 秒 fdatasync 一次日志文件，0 表示不主动落盘；需要在 start 之前调用
+    void setSyncInterval(int seconds) { syncInterval_ = seconds; }
+    // 新的日志文件按 rollSize 预先分配磁盘空间；需要在 start 之前调用
+    void setPreallocate(bool on) { preallocate_ = on; }
+    /**
+     * 日志文件滚动之后在后端线程调用，参数是关掉的旧文件，比如交给 LogArchiver::submit 压缩；
+     * 回调不能阻塞，否则会拖住后端；需要在 start 之前调用
+     */
+    void setRollCallback(const LogFile::RollCallback& cb) { rollCallback_ = cb; }
 
     void start()
     {
@@ -37,28 +78,63 @@ public:
 
     void stop()
     {
-        running_ = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_ = false;
+            wakeup_ = true;
+        }
         cond_.notify_one();
         thread_.join();
     }
 
+    // 被丢弃的日志条数，level 为 LEVEL_COUNT 时是所有等级的总数
+    uint64_t droppedMessages(Logger::LogLevel level = Logger::LEVEL_COUNT) const;
+
 private:
-    using Buffer = FixedBuffer<kLargeBuffer>;
-    using BufferVector = std::vector<std::unique_ptr<Buffer>>;
-    using BufferPtr = BufferVector::value_type;
+    using StagePtr = std::shared_ptr<LogStage>;
 
+    LogStage* localStage();
+    void signal(LogStage* stage);
+    bool push(const char* data, size_t len, const char* extra, size_t extraLen, Logger::LogLevel level);
+    bool waitForSpace(LogStage* stage, uint64_t head, size_t n);
     void threadFunc();
+    void drain(LogFile& output);
+    void drainStage(LogStage& stage, uint64_t tail, uint64_t head, LogFile& output);
+    void writeFormats(LogFile& output);
+    void addIov(const char* data, size_t len);
+    void addRing(const LogStage& stage, uint64_t pos, size_t len);
+    void addCopy(const char* data, size_t len, LogFile& output);
+    void writeBatch(LogFile& output);
+    void reportDropped(LogStage& stage, LogFile& output);
 
     const int flushInterval_;
     std::atomic<bool> running_;
     const std::string basename_;
     const off_t rollSize_;
+    const size_t stagingBytes_;
+    const uint64_t id_;          // 区分线程局部变量属于哪个实例，地址可能被复用
     Thread thread_;
-    std::mutex mutex_;
+    mutable std::mutex mutex_;
     std::condition_variable cond_;
+    std::condition_variable spaceCond_;     // 后端取走数据之后通知等空间的前端
+    bool wakeup_;
 
-    BufferPtr currentBuffer_;
-    BufferPtr nextBuffer_;
-    BufferVector buffers_;
-};
+    size_t dropAbove_[Logger::LEVEL_COUNT];  // 用量超过这个字节数就丢弃这个等级
+    Logger::LogLevel blockLevel_;
+    int blockTimeoutMs_;
 
+    std::vector<StagePtr> stages_;
+    std::atomic<uint64_t> retiredDropped_[Logger::LEVEL_COUNT];  // 已经回收的缓冲区丢弃的条数
+
+    // 以下只在后端线程使用
+    bool binaryOutput_;
+    int formatsFile_;               // 格式串定义写到了第几个文件
+    uint32_t formatsWritten_;       // 当前文件里已经写了定义的格式个数
+    std::vector<char> scratch_;     // 跨过缓冲区末尾的记录拷到这里再格式化
+    int64_t publishedDepth_;        // 已经算进 myweb_log_queue_bytes 的字节数
+    int syncInterval_;
+    bool preallocate_;
+    LogFile::RollCallback rollCallback_;
+    std::vector<struct iovec> iov_; // 这一批要写的数据，文本日志直接指向线程缓冲区，不再拷贝
+    std::string arena_;             // 格式化出来的文本，容量固定，iov_ 可以指向里面
+};
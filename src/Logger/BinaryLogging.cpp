@@ -0,0 +1,354 @@
+#include "BinaryLogging.h"
+#include "AsyncLogging.h"
+#include "CurrentThread.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <mutex>
+
+extern Logger::OutputFunc g_output;
+extern const char* getLevelName[Logger::LogLevel::LEVEL_COUNT];
+namespace ThreadInfo
+{
+    extern __thread Logger::LogLevel t_outputLevel;
+}
+
+namespace
+{
+
+// 登记表只增不减，登记之后的内容不再改，读的时候不用加锁
+const uint32_t kMaxFormats = 65536;
+LogFormat g_formats[kMaxFormats];
+std::atomic<uint32_t> g_formatCount(0);
+std::mutex g_registerMutex;
+
+std::atomic<AsyncLogging*> g_sink(nullptr);
+
+// 字符串参数最多写到一行只剩这么多空间，后面的源码位置和换行才放得下
+const int kLineTailReserve = 256;
+
+// 从记录里按顺序取出参数
+class ArgReader
+{
+public:
+    ArgReader(const char* data, const char* end)
+        : cur_(data),
+          end_(end)
+    {
+    }
+
+    bool empty() const { return cur_ >= end_; }
+
+    // 取下一个参数写到 out，数据不完整时返回 false
+    bool next(LogStream& out)
+    {
+        if (cur_ >= end_)
+        {
+            return false;
+        }
+        char type = *cur_++;
+        switch (type)
+        {
+        case 'c':
+            if (end_ - cur_ < 1)
+            {
+                return false;
+            }
+            out << *cur_++;
+            return true;
+        case 'i':
+        {
+            int64_t v;
+            if (!take(&v, sizeof v))
+            {
+                return false;
+            }
+            out << static_cast<long long>(v);
+            return true;
+        }
+        case 'u':
+        {
+            uint64_t v;
+            if (!take(&v, sizeof v))
+            {
+                return false;
+            }
+            out << static_cast<unsigned long long>(v);
+            return true;
+        }
+        case 'd':
+        {
+            double v;
+            if (!take(&v, sizeof v))
+            {
+                return false;
+            }
+            out << v;
+            return true;
+        }
+        case 'p':
+        {
+            uint64_t v;
+            if (!take(&v, sizeof v))
+            {
+                return false;
+            }
+            char buf[32];
+            int len = snprintf(buf, sizeof buf, "0x%llx", static_cast<unsigned long long>(v));
+            out.append(buf, len);
+            return true;
+        }
+        case 's':
+        {
+            uint32_t len;
+            if (!take(&len, sizeof len) || static_cast<size_t>(end_ - cur_) < len)
+            {
+                return false;
+            }
+            // LogStream 放不下时整段丢掉，所以先截短，截掉的部分还是要跳过
+            int room = std::max(out.buffer().avail() - kLineTailReserve, 0);
+            out.append(cur_, std::min(static_cast<int>(len), room));
+            cur_ += len;
+            return true;
+        }
+        default:
+            return false;
+        }
+    }
+
+private:
+    bool take(void* dst, size_t len)
+    {
+        if (static_cast<size_t>(end_ - cur_) < len)
+        {
+            return false;
+        }
+        memcpy(dst, cur_, len);
+        cur_ += len;
+        return true;
+    }
+
+    const char* cur_;
+    const char* end_;
+};
+
+} // namespace
+
+uint32_t BinaryLogging::registerFormat(Logger::LogLevel level, const char* file, int line,
+                                       const char* func, const char* fmt)
+{
+    std::lock_guard<std::mutex> lock(g_registerMutex);
+    uint32_t count = g_formatCount.load(std::memory_order_relaxed);
+    if (count + 1 >= kMaxFormats)
+    {
+        return kLogTextRecord;     // 登记满了，这个调用点的日志丢掉
+    }
+    LogFormat& format = g_formats[count + 1];
+    format.level = level;
+    format.line = line;
+    format.file = file;
+    format.func = func;
+    format.fmt = fmt;
+    g_formatCount.store(count + 1, std::memory_order_release);
+    return count + 1;
+}
+
+const LogFormat* BinaryLogging::format(uint32_t id)
+{
+    if (id == kLogTextRecord || id > g_formatCount.load(std::memory_order_acquire))
+    {
+        return nullptr;
+    }
+    return &g_formats[id];
+}
+
+uint32_t BinaryLogging::formatCount()
+{
+    return g_formatCount.load(std::memory_order_acquire);
+}
+
+void BinaryLogging::setSink(AsyncLogging* sink)
+{
+    g_sink.store(sink, std::memory_order_release);
+}
+
+void BinaryLogging::commit(const char* record, size_t len)
+{
+    LogRecordHeader header;
+    memcpy(&header, record, sizeof header);
+    if (header.format == kLogTextRecord)
+    {
+        return;
+    }
+    const LogFormat* logFormat = format(header.format);
+    AsyncLogging* sink = g_sink.load(std::memory_order_acquire);
+    if (sink != nullptr)
+    {
+        sink->appendRecord(record, len, logFormat->level);
+        return;
+    }
+    // 没有后端可以交给，在当前线程格式化
+    LogStream stream;
+    if (formatRecord(*logFormat, record, len, stream, Logger::format(), CurrentThread::tid()))
+    {
+        ThreadInfo::t_outputLevel = logFormat->level;
+        g_output(stream.buffer().data(), stream.buffer().length());
+    }
+}
+
+bool BinaryLogging::formatRecord(const LogFormat& format, const char* record, size_t len, LogStream& out,
+                                 LogFieldFormat lineFormat, int tid)
+{
+    int64_t micros;
+    if (len < sizeof(LogRecordHeader) + sizeof micros)
+    {
+        return false;
+    }
+    memcpy(&micros, record + sizeof(LogRecordHeader), sizeof micros);
+
+    // 和 Logger 的行格式保持一致：时间 [ 等级 ] 函数名 内容 - 文件:行号
+    int level = format.level >= 0 && format.level < Logger::LEVEL_COUNT ? format.level : Logger::INFO;
+    const bool structured = lineFormat != LogFieldFormat::TEXT;
+    int msgBegin = 0;
+    if (structured)
+    {
+        msgBegin = beginStructuredLog(out, lineFormat, static_cast<Logger::LogLevel>(level), micros, tid);
+    }
+    else
+    {
+        out << GeneralTemplate(formatLogTime(micros), kLogTimeLength);
+        out << "[ " << GeneralTemplate(getLevelName[level], 6) << "] ";
+        if (format.func != nullptr && *format.func != '\0')
+        {
+            out << format.func << ' ';
+        }
+    }
+
+    ArgReader args(record + sizeof(LogRecordHeader) + sizeof micros, record + len);
+    const char* fmt = format.fmt;
+    const char* literal = fmt;
+    for (const char* p = fmt; *p != '\0'; ++p)
+    {
+        if (p[0] == '{' && p[1] == '}')
+        {
+            out.append(literal, static_cast<int>(p - literal));
+            if (!args.next(out))
+            {
+                out << "{}";
+            }
+            literal = p + 2;
+            ++p;
+        }
+    }
+    out << literal;
+    // 参数比占位符多的话接在后面
+    while (!args.empty())
+    {
+        out << ' ';
+        if (!args.next(out))
+        {
+            break;
+        }
+    }
+
+    SourceFile file(format.file);
+    if (structured)
+    {
+        // 参数没有名字，都留在 msg 里
+        LogFieldBuffer fields(lineFormat);
+        const char* func = format.func != nullptr && *format.func != '\0' ? format.func : nullptr;
+        endStructuredLog(out, msgBegin, fields, func, &file, format.line, 0);
+        return true;
+    }
+    out << " - " << GeneralTemplate(file.data_, file.size_) << ':' << format.line << '\n';
+    return true;
+}
+
+std::string BinaryLogging::encodeFormat(uint32_t id, const LogFormat& format)
+{
+    std::string out(sizeof(LogRecordHeader), '\0');
+    int32_t level = format.level;
+    int32_t line = format.line;
+    out.append(reinterpret_cast<const char*>(&id), sizeof id);
+    out.append(reinterpret_cast<const char*>(&level), sizeof level);
+    out.append(reinterpret_cast<const char*>(&line), sizeof line);
+    const char* strings[] = {format.file, format.func, format.fmt};
+    for (const char* s : strings)
+    {
+        size_t len = s ? strlen(s) : 0;
+        uint16_t n = static_cast<uint16_t>(std::min<size_t>(len, 0xffff));
+        out.append(reinterpret_cast<const char*>(&n), sizeof n);
+        out.append(s ? s : "", n);
+    }
+    LogRecordHeader header;
+    header.size = static_cast<uint32_t>(out.size());
+    header.format = kLogFormatDefinition;
+    memcpy(&out[0], &header, sizeof header);
+    return out;
+}
+
+namespace
+{
+
+bool readString(const char*& p, const char* end, std::string* out)
+{
+    uint16_t n;
+    if (end - p < static_cast<ptrdiff_t>(sizeof n))
+    {
+        return false;
+    }
+    memcpy(&n, p, sizeof n);
+    p += sizeof n;
+    if (end - p < n)
+    {
+        return false;
+    }
+    out->assign(p, n);
+    p += n;
+    return true;
+}
+
+} // namespace
+
+bool BinaryLogDecoder::addDefinition(const char* record, size_t len)
+{
+    const char* p = record + sizeof(LogRecordHeader);
+    const char* end = record + len;
+    uint32_t id;
+    int32_t level;
+    int32_t line;
+    if (end - p < static_cast<ptrdiff_t>(sizeof id + sizeof level + sizeof line))
+    {
+        return false;
+    }
+    memcpy(&id, p, sizeof id);
+    memcpy(&level, p + sizeof id, sizeof level);
+    memcpy(&line, p + sizeof id + sizeof level, sizeof line);
+    p += sizeof id + sizeof level + sizeof line;
+
+    DecodedFormat& decoded = formats_[id];
+    if (!readString(p, end, &decoded.file) || !readString(p, end, &decoded.func)
+        || !readString(p, end, &decoded.fmt))
+    {
+        formats_.erase(id);
+        return false;
+    }
+    decoded.format.level = static_cast<Logger::LogLevel>(level);
+    decoded.format.line = line;
+    decoded.format.file = decoded.file.c_str();
+    decoded.format.func = decoded.func.c_str();
+    decoded.format.fmt = decoded.fmt.c_str();
+    return true;
+}
+
+bool BinaryLogDecoder::decode(const char* record, size_t len, LogStream& out) const
+{
+    LogRecordHeader header;
+    if (len < sizeof header)
+    {
+        return false;
+    }
+    memcpy(&header, record, sizeof header);
+    auto it = formats_.find(header.format);
+    return it != formats_.end() && BinaryLogging::formatRecord(it->second.format, record, len, out);
+}
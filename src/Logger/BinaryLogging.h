@@ -0,0 +1,226 @@
+#pragma once
+
+#include "Logging.h"
+#include "Timestamp.h"
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <map>
+#include <string>
+
+class AsyncLogging;
+
+/**
+ * 延迟格式化的二进制日志
+ *
+ *   LOG_DEBUG_BIN("fd {} write {} of {}", fd, nwrote, len);
+ *
+ * 每个调用点第一次执行时登记格式串拿到一个 id，之后只把 id、时间戳和参数的原始值写进线程自己的缓冲区，
+ * 整数转换、拼接格式都交给 AsyncLogging 的后端线程做；后端设置成二进制输出时直接写原始记录，
+ * 由 tools/myweb-logdecode 离线还原成文本。没有设置 setSink 时在调用线程直接格式化，效果和 LOG_XXX 一样。
+ *
+ * 格式串用 {} 作为占位符，参数支持整数、浮点数、字符、字符串和指针，字符串会被拷贝。
+ */
+
+// 缓冲区和日志文件里每条记录的头部，size 包括头部自己
+struct LogRecordHeader
+{
+    uint32_t size;
+    uint32_t format;
+};
+
+// format 为 0 的记录是已经格式化好的文本，二进制日志文件里的 kLogFormatDefinition 是格式串的定义
+const uint32_t kLogTextRecord = 0;
+const uint32_t kLogFormatDefinition = 0xffffffff;
+const size_t kMaxLogRecord = kSmallBuffer;
+
+// 调用点登记的格式
+struct LogFormat
+{
+    Logger::LogLevel level;
+    int line;
+    const char* file;
+    const char* func;
+    const char* fmt;
+};
+
+class BinaryLogRecord
+{
+public:
+    BinaryLogRecord(char* buf, size_t cap, uint32_t format)
+        : buf_(buf),
+          cur_(buf + sizeof(LogRecordHeader)),
+          end_(buf + cap),
+          format_(format)
+    {
+        int64_t now = Timestamp::now().microSecondsSinceEpoch();
+        put(&now, sizeof now);
+    }
+
+    void add(char v) { tag('c') && put(&v, 1); }
+    void add(bool v) { addUnsigned(v); }
+    void add(signed char v) { addSigned(v); }
+    void add(short v) { addSigned(v); }
+    void add(int v) { addSigned(v); }
+    void add(long v) { addSigned(v); }
+    void add(long long v) { addSigned(v); }
+    void add(unsigned char v) { addUnsigned(v); }
+    void add(unsigned short v) { addUnsigned(v); }
+    void add(unsigned int v) { addUnsigned(v); }
+    void add(unsigned long v) { addUnsigned(v); }
+    void add(unsigned long long v) { addUnsigned(v); }
+    void add(float v) { add(static_cast<double>(v)); }
+    void add(double v) { tag('d') && put(&v, sizeof v); }
+    void add(const char* s) { addString(s, s ? strlen(s) : 0); }
+    void add(const std::string& s) { addString(s.data(), s.size()); }
+    void add(const void* p)
+    {
+        uint64_t v = reinterpret_cast<uintptr_t>(p);
+        tag('p') && put(&v, sizeof v);
+    }
+
+    // 填好头部，返回整条记录的长度
+    size_t finish()
+    {
+        LogRecordHeader header;
+        header.size = static_cast<uint32_t>(cur_ - buf_);
+        header.format = format_;
+        memcpy(buf_, &header, sizeof header);
+        return header.size;
+    }
+
+private:
+    void addSigned(int64_t v) { tag('i') && put(&v, sizeof v); }
+    void addUnsigned(uint64_t v) { tag('u') && put(&v, sizeof v); }
+    void addString(const char* s, size_t len)
+    {
+        // 放不下的部分截掉
+        size_t avail = static_cast<size_t>(end_ - cur_);
+        if (avail < 1 + sizeof(uint32_t))
+        {
+            return;
+        }
+        len = std::min(len, avail - 1 - sizeof(uint32_t));
+        uint32_t n = static_cast<uint32_t>(len);
+        tag('s');
+        put(&n, sizeof n);
+        put(s, len);
+    }
+    bool tag(char t) { return put(&t, 1); }
+    bool put(const void* data, size_t len)
+    {
+        if (static_cast<size_t>(end_ - cur_) < len)
+        {
+            return false;
+        }
+        memcpy(cur_, data, len);
+        cur_ += len;
+        return true;
+    }
+
+    char* buf_;
+    char* cur_;
+    char* end_;
+    uint32_t format_;
+};
+
+class BinaryLogging
+{
+public:
+    // 登记一个调用点，返回它的 id，由宏里的局部静态变量保证每个调用点只登记一次
+    static uint32_t registerFormat(Logger::LogLevel level, const char* file, int line,
+                                   const char* func, const char* fmt);
+    // id 对应的格式，不存在时返回 nullptr
+    static const LogFormat* format(uint32_t id);
+    // 已经登记的格式个数，id 从 1 开始连续分配
+    static uint32_t formatCount();
+
+    // 记录交给 sink 的暂存缓冲区，传 nullptr 恢复成在调用线程直接格式化
+    static void setSink(AsyncLogging* sink);
+
+    template <typename... Args>
+    static void log(uint32_t id, const Args&... args)
+    {
+        char buf[kMaxLogRecord];
+        BinaryLogRecord record(buf, sizeof buf, id);
+        int expand[] = {0, (record.add(args), 0)...};
+        (void)expand;
+        commit(buf, record.finish());
+    }
+
+    /**
+     * 把一条二进制记录还原成和 Logger 一样格式的一行文本，后端线程和离线解码工具共用
+     * record 是包括头部在内的整条记录；lineFormat 是 JSON/logfmt 时格式化好的内容作为 msg，tid 是写这条记录的线程
+     */
+    static bool formatRecord(const LogFormat& format, const char* record, size_t len, LogStream& out,
+                             LogFieldFormat lineFormat = LogFieldFormat::TEXT, int tid = 0);
+
+    /**
+     * 二进制日志文件里的格式串定义，也是一条 format 为 kLogFormatDefinition 的记录：
+     * uint32 id, int32 level, int32 line，然后是 file、func、fmt 三个字符串，每个前面是 uint16 长度
+     */
+    static std::string encodeFormat(uint32_t id, const LogFormat& format);
+
+private:
+    static void commit(const char* record, size_t len);
+};
+
+/**
+ * 离线还原二进制日志文件，tools/myweb-logdecode 用它
+ * 先把文件里的格式串定义都交给 addDefinition，再用 decode 还原其他记录
+ */
+class BinaryLogDecoder
+{
+public:
+    // 解析一条 kLogFormatDefinition 记录，同一个 id 后出现的定义覆盖前面的
+    bool addDefinition(const char* record, size_t len);
+    // 还原一条二进制记录，没有它的格式串定义时返回 false
+    bool decode(const char* record, size_t len, LogStream& out) const;
+
+    // 依次取出 data 里的记录交给 cb，遇到不完整的记录返回 false
+    template <typename Callback>
+    static bool forEachRecord(const std::string& data, Callback cb)
+    {
+        size_t pos = 0;
+        while (pos + sizeof(LogRecordHeader) <= data.size())
+        {
+            LogRecordHeader header;
+            memcpy(&header, data.data() + pos, sizeof header);
+            if (header.size < sizeof header || pos + header.size > data.size())
+            {
+                return false;
+            }
+            cb(header, data.data() + pos, header.size);
+            pos += header.size;
+        }
+        return pos == data.size();
+    }
+
+private:
+    // LogFormat 里的指针指向这里的字符串，map 的节点不会移动
+    struct DecodedFormat
+    {
+        std::string file;
+        std::string func;
+        std::string fmt;
+        LogFormat format;
+    };
+
+    std::map<uint32_t, DecodedFormat> formats_;
+};
+
+#define LOG_BIN_IMPL(level, fmt, ...) \
+    do { \
+        if (logLevel() <= level) { \
+            static const uint32_t logFormatId_ = BinaryLogging::registerFormat(level, __FILE__, __LINE__, __func__, fmt); \
+            BinaryLogging::log(logFormatId_, ##__VA_ARGS__); \
+        } \
+    } while (0)
+
+#define LOG_TRACE_BIN(fmt, ...) LOG_BIN_IMPL(Logger::TRACE, fmt, ##__VA_ARGS__)
+#define LOG_DEBUG_BIN(fmt, ...) LOG_BIN_IMPL(Logger::DEBUG, fmt, ##__VA_ARGS__)
+#define LOG_INFO_BIN(fmt, ...) LOG_BIN_IMPL(Logger::INFO, fmt, ##__VA_ARGS__)
+#define LOG_WARN_BIN(fmt, ...) LOG_BIN_IMPL(Logger::WARN, fmt, ##__VA_ARGS__)
+#define LOG_ERROR_BIN(fmt, ...) LOG_BIN_IMPL(Logger::ERROR, fmt, ##__VA_ARGS__)
@@ -1,57 +1,136 @@
 #include "FileUtil.h"
 #include "Logging.h"
 
+#include <fcntl.h>
+#include <limits.h>
+#include <unistd.h>
+#include <algorithm>
+
 FileUtil::FileUtil(std::string& fileName)
-    : fp_(::fopen(fileName.c_str(), "ae")),
+    : fd_(::open(fileName.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)),
+      buffered_(0),
+      preallocated_(false),
       writtenBytes_(0)
 {
-    // 将fd_缓冲区设置为本地的buffer_
-    ::setbuffer(fp_, buffer_, sizeof(buffer_));
+    if (fd_ < 0)
+    {
+        fprintf(stderr, "FileUtil::FileUtil() open %s failed %s\n", fileName.c_str(), getErrnoMsg(errno));
+    }
 }
 
 FileUtil::~FileUtil()
 {
-    ::fclose(fp_);
+    flush();
+    if (fd_ >= 0)
+    {
+        if (preallocated_)
+        {
+            // 没写满就关掉的文件(按天滚动、进程退出)把多分配的磁盘块还回去
+            ::ftruncate(fd_, ::lseek(fd_, 0, SEEK_END));
+        }
+        ::close(fd_);
+    }
 }
 
 void FileUtil::append(const char* data, size_t len)
 {
-    // 记录已经写入的数据大小
-    size_t written = 0;
-
-    while (written != len)
+    if (buffered_ + len > sizeof buffer_)
     {
-        // 还需写入的数据大小
-        size_t remain = len - written;
-        size_t n = write(data + written, remain);
-        if (n != remain)
-        {
-            int err = ferror(fp_);
-            if (err)
-            {
-                fprintf(stderr, "FileUtil::append() failed %s\n", getErrnoMsg(err));
-            }
-        }
-        // 更新写入的数据大小
-        written += n;
+        flush();
+    }
+    if (len >= sizeof buffer_)
+    {
+        // 大块数据不必再拷一次
+        struct iovec iov;
+        iov.iov_base = const_cast<char*>(data);
+        iov.iov_len = len;
+        writeFully(&iov, 1);
+    }
+    else
+    {
+        memcpy(buffer_ + buffered_, data, len);
+        buffered_ += len;
     }
     // 记录目前为止写入的数据大小，超过限制会滚动日志
-    writtenBytes_ += written;
+    writtenBytes_ += len;
+}
+
+void FileUtil::appendv(const struct iovec* iov, int count)
+{
+    flush();
+    writeFully(iov, count);
+    for (int i = 0; i < count; ++i)
+    {
+        writtenBytes_ += iov[i].iov_len;
+    }
 }
 
 void FileUtil::flush()
 {
-    ::fflush(fp_);
+    if (buffered_ > 0)
+    {
+        struct iovec iov;
+        iov.iov_base = buffer_;
+        iov.iov_len = buffered_;
+        buffered_ = 0;
+        writeFully(&iov, 1);
+    }
+}
+
+void FileUtil::sync()
+{
+    flush();
+    if (fd_ >= 0 && ::fdatasync(fd_) < 0)
+    {
+        fprintf(stderr, "FileUtil::sync() failed %s\n", getErrnoMsg(errno));
+    }
+}
+
+void FileUtil::preallocate(off_t bytes)
+{
+    // KEEP_SIZE 只占磁盘块不改文件长度，O_APPEND 仍然写在已有内容后面；文件系统不支持时忽略
+    if (fd_ >= 0 && bytes > 0 && ::fallocate(fd_, FALLOC_FL_KEEP_SIZE, 0, bytes) == 0)
+    {
+        preallocated_ = true;
+    }
 }
 
-size_t FileUtil::write(const char* data, size_t len)
+// 写完所有数据，处理部分写和 IOV_MAX 的限制，出错时丢掉剩下的数据
+void FileUtil::writeFully(const struct iovec* iov, int count)
 {
-    /**
-     * size_t fwrite(const void* buffer, size_t size, size_t count, FILE* stream);
-     * -- buffer:指向数据块的指针
-     * -- size:每个数据的大小，单位为Byte(例如：sizeof(int)就是4)
-     * -- count:数据个数
-     * -- stream:文件指针
-     */
-    return ::fwrite_unlocked(data, 1, len, fp_);
-}
\ No newline at end of file
+    if (fd_ < 0)
+    {
+        return;
+    }
+    struct iovec partial;
+    while (count > 0)
+    {
+        int batch = std::min(count, IOV_MAX);
+        ssize_t n = ::writev(fd_, iov, batch);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "FileUtil::append() failed %s\n", getErrnoMsg(errno));
+            return;
+        }
+        // 跳过已经写完的 iovec，写了一半的那个从剩下的位置接着写
+        size_t written = static_cast<size_t>(n);
+        while (count > 0 && written >= iov->iov_len)
+        {
+            written -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0 && written > 0)
+        {
+            partial.iov_base = static_cast<char*>(iov->iov_base) + written;
+            partial.iov_len = iov->iov_len - written;
+            writeFully(&partial, 1);
+            ++iov;
+            --count;
+        }
+    }
+}
@@ -1,7 +1,13 @@
 #pragma once
 #include <iostream>
 #include <string>
+#include <sys/uio.h>
 
+/**
+ * 日志文件，直接用 fd 写，不经过 stdio
+ * append 的小块数据先攒在自己的缓冲区里；appendv 把一批 iovec 用 writev 一次交给内核，
+ * 之前攒的数据会先写出去，保证顺序
+ */
 class FileUtil
 {
 public:
@@ -9,15 +15,22 @@ public:
     ~FileUtil();
 
     void append(const char* data, size_t len);
+    void appendv(const struct iovec* iov, int count);
 
     void flush();
+    // fdatasync，确保写出去的数据真正落盘
+    void sync();
+    // 预先给文件分配 bytes 大小的磁盘空间，不改变文件长度
+    void preallocate(off_t bytes);
 
     off_t writtenBytes() const { return writtenBytes_; }
 
 private:    
-    size_t write(const char* data, size_t len);
+    void writeFully(const struct iovec* iov, int count);
 
-    FILE* fp_;
-    char buffer_[64 * 1024]; // fp_的缓冲区
+    int fd_;
+    char buffer_[64 * 1024]; // append 的缓冲区
+    size_t buffered_;
+    bool preallocated_;
     off_t writtenBytes_; // off_t用于指示文件的偏移量
-};
\ No newline at end of file
+};
@@ -36,6 +36,8 @@ public:
     void add(size_t len) { cur_ += len; }
 
     void reset() { cur_ = data_; }
+    // 截到 len 字节，只能往回截
+    void truncate(int len) { cur_ = data_ + len; }
     // void bzero() { ::bzero(data_, SIZE); }
     void bzero() { ::bzero(data_, sizeof(data_)); }
 
@@ -0,0 +1,279 @@
+#include "LogArchiver.h"
+#include "Logging.h"
+#include "CurrentThread.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+
+const size_t kChunkSize = 64 * 1024;
+
+// linux/ioprio.h 里的定义，glibc 没有封装
+const int kIoprioWhoProcess = 1;
+const int kIoprioClassIdle = 3;
+const int kIoprioClassShift = 13;
+
+// 写完所有数据，失败返回 false
+bool writeAll(int fd, const unsigned char* data, size_t len)
+{
+    while (len > 0)
+    {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return false;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+} // namespace
+
+LogArchiver::LogArchiver(const std::string& basename, int level)
+    : basename_(basename),
+      level_(level),
+      maxFiles_(0),
+      maxTotalBytes_(0),
+      running_(false),
+      archived_(0),
+      thread_(std::bind(&LogArchiver::threadFunc, this), "LogArchiver")
+{
+}
+
+LogArchiver::~LogArchiver()
+{
+    if (running_)
+    {
+        stop();
+    }
+}
+
+void LogArchiver::start()
+{
+    running_ = true;
+    thread_.start();
+}
+
+void LogArchiver::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        running_ = false;
+    }
+    cond_.notify_one();
+    thread_.join();
+}
+
+void LogArchiver::submit(const std::string& filename)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(filename);
+    }
+    cond_.notify_one();
+}
+
+void LogArchiver::threadFunc()
+{
+    // 压缩不能和业务线程抢 cpu 和磁盘，失败了也只是慢一点
+    ::setpriority(PRIO_PROCESS, CurrentThread::tid(), 19);
+    ::syscall(SYS_ioprio_set, kIoprioWhoProcess, CurrentThread::tid(), kIoprioClassIdle << kIoprioClassShift);
+
+    while (true)
+    {
+        std::string filename;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (running_ && queue_.empty())
+            {
+                cond_.wait(lock);
+            }
+            if (!running_)
+            {
+                break;
+            }
+            filename = queue_.front();
+            queue_.pop_front();
+        }
+        archive(filename);
+    }
+}
+
+void LogArchiver::archive(const std::string& filename)
+{
+    std::string archive = filename + ".gz";
+    std::string tmp = archive + ".tmp";
+    if (!compressFile(filename, tmp, level_, &running_))
+    {
+        ::unlink(tmp.c_str());
+        return;
+    }
+    // 先改名再删原文件，中途崩溃最多留下两份，不会两份都没有
+    if (::rename(tmp.c_str(), archive.c_str()) < 0)
+    {
+        fprintf(stderr, "LogArchiver rename %s failed %s\n", tmp.c_str(), getErrnoMsg(errno));
+        ::unlink(tmp.c_str());
+        return;
+    }
+    ::unlink(filename.c_str());
+    archived_.fetch_add(1, std::memory_order_relaxed);
+    if (shipCallback_)
+    {
+        shipCallback_(archive);
+    }
+    enforceRetention();
+}
+
+bool LogArchiver::compressFile(const std::string& src, const std::string& dst, int level,
+                               const std::atomic<bool>* running)
+{
+    int in = ::open(src.c_str(), O_RDONLY | O_CLOEXEC);
+    if (in < 0)
+    {
+        fprintf(stderr, "LogArchiver open %s failed %s\n", src.c_str(), getErrnoMsg(errno));
+        return false;
+    }
+    int out = ::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (out < 0)
+    {
+        fprintf(stderr, "LogArchiver open %s failed %s\n", dst.c_str(), getErrnoMsg(errno));
+        ::close(in);
+        return false;
+    }
+    // 读完就不再需要，别把页缓存占着
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    z_stream zs;
+    memset(&zs, 0, sizeof zs);
+    // windowBits 15 + 16 表示输出 gzip 格式，可以直接用 zcat 查看
+    bool ok = deflateInit2(&zs, level, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+    std::vector<unsigned char> inBuf(kChunkSize);
+    std::vector<unsigned char> outBuf(kChunkSize);
+    int flush = Z_NO_FLUSH;
+    while (ok && flush != Z_FINISH)
+    {
+        if (running != nullptr && !running->load(std::memory_order_relaxed))
+        {
+            ok = false;
+            break;
+        }
+        ssize_t n = ::read(in, inBuf.data(), inBuf.size());
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            ok = false;
+            break;
+        }
+        flush = n == 0 ? Z_FINISH : Z_NO_FLUSH;
+        zs.next_in = inBuf.data();
+        zs.avail_in = static_cast<uInt>(n);
+        do
+        {
+            zs.next_out = outBuf.data();
+            zs.avail_out = static_cast<uInt>(outBuf.size());
+            if (deflate(&zs, flush) == Z_STREAM_ERROR
+                || !writeAll(out, outBuf.data(), outBuf.size() - zs.avail_out))
+            {
+                ok = false;
+                break;
+            }
+        } while (zs.avail_out == 0);
+    }
+    deflateEnd(&zs);
+    ::posix_fadvise(in, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(in);
+    // 原文件马上会被删掉，归档要先落盘
+    ok = ok && ::fdatasync(out) == 0;
+    ok = ::close(out) == 0 && ok;
+    if (!ok)
+    {
+        fprintf(stderr, "LogArchiver compress %s failed\n", src.c_str());
+    }
+    return ok;
+}
+
+// 文件名里的时间保证按名字排序就是按时间排序，从最旧的开始删
+void LogArchiver::enforceRetention()
+{
+    if (maxFiles_ <= 0 && maxTotalBytes_ == 0)
+    {
+        return;
+    }
+    std::string dir = ".";
+    std::string prefix = basename_;
+    size_t slash = basename_.rfind('/');
+    if (slash != std::string::npos)
+    {
+        dir = slash == 0 ? "/" : basename_.substr(0, slash);
+        prefix = basename_.substr(slash + 1);
+    }
+    prefix += '.';
+    const std::string suffix = ".log.gz";
+
+    struct Archive
+    {
+        std::string path;
+        uint64_t size;
+        bool operator<(const Archive& rhs) const { return path < rhs.path; }
+    };
+    std::vector<Archive> archives;
+    DIR* d = ::opendir(dir.c_str());
+    if (d == nullptr)
+    {
+        return;
+    }
+    struct dirent* entry;
+    while ((entry = ::readdir(d)) != nullptr)
+    {
+        std::string name = entry->d_name;
+        if (name.size() > prefix.size() + suffix.size()
+            && name.compare(0, prefix.size(), prefix) == 0
+            && name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0)
+        {
+            Archive archive;
+            archive.path = dir + "/" + name;
+            struct stat st;
+            archive.size = ::stat(archive.path.c_str(), &st) == 0 ? static_cast<uint64_t>(st.st_size) : 0;
+            archives.push_back(archive);
+        }
+    }
+    ::closedir(d);
+    std::sort(archives.begin(), archives.end());
+
+    uint64_t total = 0;
+    for (const Archive& archive : archives)
+    {
+        total += archive.size;
+    }
+    size_t remaining = archives.size();
+    for (const Archive& archive : archives)
+    {
+        bool tooMany = maxFiles_ > 0 && remaining > static_cast<size_t>(maxFiles_);
+        bool tooBig = maxTotalBytes_ > 0 && total > maxTotalBytes_;
+        if (!tooMany && !tooBig)
+        {
+            break;
+        }
+        ::unlink(archive.path.c_str());
+        total -= archive.size;
+        --remaining;
+    }
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "Thread.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+
+/**
+ * 滚动下来的日志文件在后台压缩成 .gz，并按个数和总大小清理旧的归档
+ *
+ *   LogArchiver archiver("/var/log/myweb/http_test");
+ *   archiver.setMaxFiles(30);
+ *   archiver.start();
+ *   asyncLog.setRollCallback(std::bind(&LogArchiver::submit, &archiver, std::placeholders::_1));
+ *
+ * 压缩在自己的线程里做，线程优先级和 io 优先级都调到最低；submit 只是把文件名放进队列，
+ * 不会让 AsyncLogging 的后端等。压缩是流式的，每次读 64KB，内存占用和文件大小无关。
+ * 清理只看 basename.*.log.gz，正在写和还没压缩完的 .log 不会被删。
+ */
+class LogArchiver : noncopyable
+{
+public:
+    // 一个文件压缩完之后调用，参数是 .gz 的路径，可以在这里通知日志收集程序
+    using ShipCallback = std::function<void(const std::string& archive)>;
+
+    explicit LogArchiver(const std::string& basename, int level = 6);
+    ~LogArchiver();
+
+    // 0 表示不限制
+    void setMaxFiles(int n) { maxFiles_ = n; }
+    void setMaxTotalBytes(uint64_t bytes) { maxTotalBytes_ = bytes; }
+    void setShipCallback(const ShipCallback& cb) { shipCallback_ = cb; }
+
+    void start();
+    // 正在压缩的文件放弃，留下原来的 .log，下次启动不会自动补压
+    void stop();
+
+    // 把一个已经关闭的日志文件交给后台压缩，可以在任何线程调用
+    void submit(const std::string& filename);
+
+    // 压缩完成的文件数，测试和监控用
+    uint64_t archivedFiles() const { return archived_.load(std::memory_order_relaxed); }
+
+    // 把 src 流式压缩成 gzip 格式的 dst，running 变成 false 时中途放弃；成功返回 true
+    static bool compressFile(const std::string& src, const std::string& dst, int level,
+                             const std::atomic<bool>* running = nullptr);
+
+private:
+    void threadFunc();
+    void archive(const std::string& filename);
+    void enforceRetention();
+
+    const std::string basename_;
+    const int level_;
+    int maxFiles_;
+    uint64_t maxTotalBytes_;
+    ShipCallback shipCallback_;
+
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> archived_;
+    Thread thread_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+    std::deque<std::string> queue_;
+};
@@ -0,0 +1,191 @@
+#include "LogField.h"
+
+#include <algorithm>
+
+namespace
+{
+
+const char kHexDigits[] = "0123456789abcdef";
+
+// 每个字节转义之后多出几个字节：引号、反斜杠、\t \n \r 多 1 个，其他控制字符写成 \u00XX 多 5 个
+const unsigned char kEscapeExtra[256] = {
+    5, 5, 5, 5, 5, 5, 5, 5, 5, 1, 1, 5, 5, 1, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5,
+    0, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+inline int escapeExtra(unsigned char c)
+{
+    return kEscapeExtra[c];
+}
+
+// logfmt 的值里没有空格、引号和等号时可以不加引号
+bool needQuote(const char* data, int len)
+{
+    if (len == 0)
+    {
+        return true;
+    }
+    for (int i = 0; i < len; ++i)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c <= ' ' || c == '"' || c == '=' || c == '\\')
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace
+
+int escapeLogString(char* begin, int len, const char* limit)
+{
+    int room = static_cast<int>(limit - begin);
+    // 先算出转义后的长度，放不下就从后面截掉原文
+    int extra = 0;
+    int keep = 0;
+    while (keep < len)
+    {
+        int n = escapeExtra(static_cast<unsigned char>(begin[keep]));
+        if (keep + 1 + extra + n > room)
+        {
+            break;
+        }
+        extra += n;
+        ++keep;
+    }
+    if (extra == 0)
+    {
+        return keep;
+    }
+
+    // 从后往前挪，每个字节只搬一次
+    char* src = begin + keep;
+    char* dst = begin + keep + extra;
+    while (src != dst)
+    {
+        unsigned char c = static_cast<unsigned char>(*--src);
+        switch (c)
+        {
+        case '"': *--dst = '"'; *--dst = '\\'; break;
+        case '\\': *--dst = '\\'; *--dst = '\\'; break;
+        case '\n': *--dst = 'n'; *--dst = '\\'; break;
+        case '\r': *--dst = 'r'; *--dst = '\\'; break;
+        case '\t': *--dst = 't'; *--dst = '\\'; break;
+        default:
+            if (c < 0x20)
+            {
+                *--dst = kHexDigits[c & 0xF];
+                *--dst = kHexDigits[c >> 4];
+                *--dst = '0';
+                *--dst = '0';
+                *--dst = 'u';
+                *--dst = '\\';
+            }
+            else
+            {
+                *--dst = static_cast<char>(c);
+            }
+        }
+    }
+    return keep + extra;
+}
+
+int encodeLogField(char* cur, const char* end, LogFieldFormat format, const LogField& field)
+{
+    const LogKey& key = field.key_;
+    // 最长的数字加上名字和标点，字符串另算
+    const int fixedSize = key.len_ + kMaxNumericSize + 8;
+    if (end - cur < fixedSize)
+    {
+        return 0;
+    }
+    char* p = cur;
+    switch (format)
+    {
+    case LogFieldFormat::JSON:
+        *p++ = ',';
+        *p++ = '"';
+        memcpy(p, key.data_, key.len_);
+        p += key.len_;
+        *p++ = '"';
+        *p++ = ':';
+        break;
+    case LogFieldFormat::LOGFMT:
+        *p++ = ' ';
+        // fall through
+    case LogFieldFormat::TEXT:
+        memcpy(p, key.data_, key.len_);
+        p += key.len_;
+        *p++ = '=';
+        break;
+    }
+
+    switch (field.type_)
+    {
+    case LogField::kInt:
+        p += formatInteger(p, field.value_.i);
+        break;
+    case LogField::kUint:
+        p += formatInteger(p, field.value_.u);
+        break;
+    case LogField::kDouble:
+    {
+        double v = field.value_.d;
+        // JSON 里没有 nan 和 inf
+        if (format == LogFieldFormat::JSON && (v != v || v - v != 0))
+        {
+            memcpy(p, "null", 4);
+            p += 4;
+        }
+        else
+        {
+            p += formatDouble(p, v);
+        }
+        break;
+    }
+    case LogField::kBool:
+        if (field.value_.b)
+        {
+            memcpy(p, "true", 4);
+            p += 4;
+        }
+        else
+        {
+            memcpy(p, "false", 5);
+            p += 5;
+        }
+        break;
+    case LogField::kFixed:
+        p += formatFixed(p, field.value_.i, field.decimals_);
+        break;
+    case LogField::kString:
+    {
+        const char* data = field.value_.s.data;
+        int len = field.value_.s.len;
+        bool quote = format == LogFieldFormat::JSON
+                     || (format == LogFieldFormat::LOGFMT && needQuote(data, len));
+        // 至少要放得下引号和一个字节，不然整个字段都不写
+        if (end - p < (quote ? 3 : 1))
+        {
+            return 0;
+        }
+        const char* limit = quote ? end - 1 : end;
+        if (quote)
+        {
+            *p++ = '"';
+        }
+        len = std::min(len, static_cast<int>(limit - p));
+        memcpy(p, data, len);
+        p += quote ? escapeLogString(p, len, limit) : len;
+        if (quote)
+        {
+            *p++ = '"';
+        }
+        break;
+    }
+    }
+    return static_cast<int>(p - cur);
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "LogStream.h"
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * 结构化日志的字段
+ *
+ *   LOG_INFO << "response" << LogField("conn", conn->name()) << LogField("bytes", n)
+ *            << LogField("latency_ms", FixedPoint(costUs, 3));
+ *
+ * 文本格式下字段直接写成行里的 key=value；Logger::setFormat(LogFieldFormat::JSON) 之后整行变成一个 JSON 对象，
+ * 时间、等级、线程和源码位置也都是字段，<< 进来的文字变成 "msg"，下游不用再拿正则去拆。
+ * 字段名必须是字面量，长度在编译期就知道，不做转义也不用 strlen；字符串的值在缓冲区里原地转义。
+ */
+class LogKey
+{
+public:
+    template <size_t N>
+    LogKey(const char (&name)[N])
+        : data_(name),
+          len_(static_cast<int>(N - 1))
+    {}
+
+    const char* data_;
+    int len_;
+};
+
+class LogField
+{
+public:
+    enum Type
+    {
+        kInt,
+        kUint,
+        kDouble,
+        kBool,
+        kString,
+        kFixed,
+    };
+
+    LogField(LogKey key, int v) : key_(key), type_(kInt) { value_.i = v; }
+    LogField(LogKey key, long v) : key_(key), type_(kInt) { value_.i = v; }
+    LogField(LogKey key, long long v) : key_(key), type_(kInt) { value_.i = v; }
+    LogField(LogKey key, unsigned int v) : key_(key), type_(kUint) { value_.u = v; }
+    LogField(LogKey key, unsigned long v) : key_(key), type_(kUint) { value_.u = v; }
+    LogField(LogKey key, unsigned long long v) : key_(key), type_(kUint) { value_.u = v; }
+    LogField(LogKey key, double v) : key_(key), type_(kDouble) { value_.d = v; }
+    LogField(LogKey key, bool v) : key_(key), type_(kBool) { value_.b = v; }
+    LogField(LogKey key, const FixedPoint& v) : key_(key), type_(kFixed)
+    {
+        value_.i = v.value_;
+        decimals_ = v.decimals_;
+    }
+    // 字符串只保存指针，字段要在这条日志结束之前写出去
+    LogField(LogKey key, const char* v) : key_(key), type_(kString)
+    {
+        value_.s.data = v != nullptr ? v : "(null)";
+        value_.s.len = static_cast<int>(strlen(value_.s.data));
+    }
+    LogField(LogKey key, const std::string& v) : key_(key), type_(kString)
+    {
+        value_.s.data = v.data();
+        value_.s.len = static_cast<int>(v.size());
+    }
+
+    LogKey key_;
+    Type type_;
+    int decimals_;
+    union
+    {
+        int64_t i;
+        uint64_t u;
+        double d;
+        bool b;
+        struct
+        {
+            const char* data;
+            int len;
+        } s;
+    } value_;
+};
+
+// 日志行的格式，Logger::setFormat 设置
+enum class LogFieldFormat
+{
+    TEXT,       // 原来的文本行，字段写成 key=value
+    JSON,       // 每行一个 JSON 对象
+    LOGFMT,     // key=value 用空格隔开
+};
+
+/**
+ * 把字段编码到 [cur, end)，返回写了多少字节；剩下的地方不够写名字和数字时一个字节也不写，字符串放不下时截断
+ * TEXT 写成 key=value，JSON 写成 ,"key":value，LOGFMT 写成 ␣key=value
+ */
+int encodeLogField(char* cur, const char* end, LogFieldFormat format, const LogField& field);
+
+/**
+ * 把 [begin, begin + len) 按 JSON 字符串的规则原地转义(引号、反斜杠、控制字符)，logfmt 的引号里也用同样的规则
+ * 转义后超过 limit 的部分截掉，不会截在转义序列中间；返回转义后的长度
+ */
+int escapeLogString(char* begin, int len, const char* limit);
+
+// 一条结构化日志的字段先攒在这里，Logger 结束这一行时拼到 msg 后面
+class LogFieldBuffer : noncopyable
+{
+public:
+    explicit LogFieldBuffer(LogFieldFormat format)
+        : format_(format)
+    {}
+
+    void add(const LogField& field)
+    {
+        buffer_.add(encodeLogField(buffer_.current(), buffer_.current() + buffer_.avail(), format_, field));
+    }
+
+    LogFieldFormat format() const { return format_; }
+    const char* data() const { return buffer_.data(); }
+    int length() const { return buffer_.length(); }
+
+private:
+    static const int kFieldBufferSize = 1024;
+
+    LogFieldFormat format_;
+    FixedBuffer<kFieldBufferSize> buffer_;
+};
@@ -12,7 +12,11 @@ LogFile::LogFile(const std::string& basename,
       mutex_(new std::mutex),
       startOfPeriod_(0),
       lastRoll_(0),
-      lastFlush_(0)
+      lastFlush_(0),
+      lastSync_(0),
+      syncInterval_(0),
+      preallocate_(false),
+      fileCount_(0)
 {
     rollFile();
 }
@@ -25,9 +29,22 @@ void LogFile::append(const char* data, int len)
     appendInLock(data, len);
 }
 
+void LogFile::appendv(const struct iovec* iov, int count)
+{
+    std::lock_guard<std::mutex> lock(*mutex_);
+    file_->appendv(iov, count);
+    afterAppend();
+}
+
 void LogFile::appendInLock(const char* data, int len)
 {
     file_->append(data, len);
+    afterAppend();
+}
+
+// 写完之后检查要不要滚动和刷盘
+void LogFile::afterAppend()
+{
     // std::cout<<flushInterval_<<std::endl;
     // 当写入的字节数大于
     if (file_->writtenBytes() > rollSize_)
@@ -63,6 +80,24 @@ void LogFile::flush()
 {
     // std::lock_guard lock(*mutex_);
     file_->flush();
+    if (syncInterval_ > 0)
+    {
+        time_t now = ::time(NULL);
+        if (now - lastSync_ >= syncInterval_)
+        {
+            lastSync_ = now;
+            file_->sync();
+        }
+    }
+}
+
+void LogFile::setPreallocate(bool on)
+{
+    preallocate_ = on;
+    if (on)
+    {
+        file_->preallocate(rollSize_);
+    }
 }
 
 // 滚动日志
@@ -80,7 +115,25 @@ bool LogFile::rollFile()
         lastFlush_ = now;
         startOfPeriod_ = start;
         // 让file_指向一个名为filename的文件，相当于新建了一个文件
+        // 旧文件在这里关掉，开了定期落盘的话先把它落盘
+        if (file_ && syncInterval_ > 0)
+        {
+            file_->sync();
+        }
         file_.reset(new FileUtil(filename));
+        if (preallocate_)
+        {
+            file_->preallocate(rollSize_);
+        }
+        ++fileCount_;
+        // 旧文件已经关掉了，交给回调做压缩之类的事
+        std::string closed;
+        closed.swap(filename_);
+        filename_ = filename;
+        if (rollCallback_ && !closed.empty())
+        {
+            rollCallback_(closed);
+        }
         return true;
     }
     return false;
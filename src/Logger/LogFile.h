@@ -4,10 +4,14 @@
 
 #include <mutex>
 #include <memory>
+#include <functional>
 
 class LogFile
 {
 public:
+    // 滚动之后调用，参数是刚关掉的旧文件名
+    using RollCallback = std::function<void(const std::string& closedFile)>;
+
     LogFile(const std::string& basename,
             off_t rollSize,
             int flushInterval = 3,
@@ -15,12 +19,22 @@ public:
     ~LogFile();
 
     void append(const char* data, int len);
+    // 一批数据一次 writev 写进文件
+    void appendv(const struct iovec* iov, int count);
+    // 写出缓冲区，设置了 syncInterval 时距上次落盘超过这么多秒还会 fdatasync
     void flush();
+    // 每隔 seconds 秒 fdatasync 一次，0 表示交给内核决定什么时候落盘
+    void setSyncInterval(int seconds) { syncInterval_ = seconds; }
+    // 新文件按 rollSize 预先分配磁盘空间，减少写的过程中分配块和产生碎片
+    void setPreallocate(bool on);
+    void setRollCallback(const RollCallback& cb) { rollCallback_ = cb; }
     bool rollFile(); // 滚动日志
     time_t getLastFlush(){return lastFlush_;} //获得上一次刷日志的时间
+    int fileCount() const { return fileCount_; } // 一共打开过几个文件，用来判断有没有滚动
 private:
     static std::string getLogFileName(const std::string& basename, time_t* now);
     void appendInLock(const char* data, int len);
+    void afterAppend();
 
     const std::string basename_;
     const off_t rollSize_;
@@ -33,7 +47,13 @@ private:
     time_t startOfPeriod_;
     time_t lastRoll_;
     time_t lastFlush_;
+    time_t lastSync_;
+    int syncInterval_;
+    bool preallocate_;
     std::unique_ptr<FileUtil> file_;
+    std::string filename_;
+    RollCallback rollCallback_;
+    int fileCount_;
 
     const static int kRollPerSeconds_ = 60*60*24;
 };
@@ -1,33 +1,13 @@
 #include "LogStream.h"
-#include <algorithm>
-
-static const char digits[] = {'9', '8', '7', '6', '5', '4', '3', '2', '1', '0',
-                               '1', '2', '3', '4', '5', '6', '7', '8', '9'};
+#include "LogField.h"
 
+// 直接写进缓冲区，写法见 NumberFormat.h
 template <typename T>
 void LogStream::formatInteger(T num)
 {
     if (buffer_.avail() >= kMaxNumericSize)
     {
-        char* start = buffer_.current();
-        char* cur = start;
-        const char* zero = digits + 9;
-        bool negative = (num < 0); // 是否为负数
-
-        // 末尾取值加入，最后反转
-        do {
-            int remainder = static_cast<int>(num % 10);
-            *(cur++) = zero[remainder];
-            num = num / 10;
-        } while (num != 0);
-
-        if (negative) {
-            *(cur++) = '-';
-        }
-        *cur = '\0';
-
-        std::reverse(start, cur);
-        buffer_.add(static_cast<int>(cur - start)); // cur_向后移动
+        buffer_.add(::formatInteger(buffer_.current(), num));
     }
 }
 
@@ -81,7 +61,10 @@ LogStream& LogStream::operator<<(unsigned long long v)
 
 LogStream& LogStream::operator<<(float v) 
 {
-    *this << static_cast<double>(v);
+    if (buffer_.avail() >= kMaxNumericSize)
+    {
+        buffer_.add(formatFloat(buffer_.current(), v));
+    }
     return *this;
 }
 
@@ -89,11 +72,9 @@ LogStream& LogStream::operator<<(double v)
 {
     if (buffer_.avail() >= kMaxNumericSize)
     {
-        char buf[32];
-        int len = snprintf(buffer_.current(), kMaxNumericSize, "%.12g", v); 
-        buffer_.add(len);
-        return *this;
+        buffer_.add(formatDouble(buffer_.current(), v));
     }
+    return *this;
 }
 
 LogStream& LogStream::operator<<(char c)
@@ -102,9 +83,13 @@ LogStream& LogStream::operator<<(char c)
     return *this;
 }
 
+// 指针按地址输出，字符串要用 const char*
 LogStream& LogStream::operator<<(const void* data) 
 {
-    *this << static_cast<const char*>(data); 
+    if (buffer_.avail() >= kMaxNumericSize)
+    {
+        buffer_.add(formatHex(buffer_.current(), reinterpret_cast<uintptr_t>(data)));
+    }
     return *this;
 }
 
@@ -142,4 +127,37 @@ LogStream& LogStream::operator<<(const GeneralTemplate& g)
 {
     buffer_.append(g.data_, g.len_);
     return *this;
+}
+
+LogStream& LogStream::operator<<(const FixedPoint& v)
+{
+    if (buffer_.avail() >= kMaxNumericSize)
+    {
+        buffer_.add(formatFixed(buffer_.current(), v.value_, v.decimals_));
+    }
+    return *this;
+}
+
+LogStream& LogStream::operator<<(const LogField& field)
+{
+    if (fields_ != nullptr)
+    {
+        fields_->add(field);
+        return *this;
+    }
+    // 和前面的文字隔一个空格，字段放不下时空格也不留
+    const int length = buffer_.length();
+    if (length > 0 && buffer_.current()[-1] != ' ' && buffer_.avail() > 1)
+    {
+        buffer_.append(" ", 1);
+    }
+    char* cur = buffer_.current();
+    // FixedBuffer::append 要求留一个字节
+    int n = encodeLogField(cur, cur + buffer_.avail() - 1, LogFieldFormat::TEXT, field);
+    if (n == 0)
+    {
+        buffer_.truncate(length);
+    }
+    buffer_.add(n);
+    return *this;
 }
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 
 #include "FixedBuffer.h"
+#include "NumberFormat.h"
 #include "noncopyable.h"
 
 #include <string>
@@ -29,13 +30,36 @@ public:
     int len_;
 };
 
+/**
+ * 定点小数，耗时之类的字段不用 double 也不会丢精度
+ *   LOG_INFO << "cost=" << FixedPoint(costUs, 3) << "ms";   // cost=1.543ms
+ */
+struct FixedPoint
+{
+    FixedPoint(int64_t value, int decimals)
+        : value_(value),
+          decimals_(decimals)
+    {}
+
+    int64_t value_;
+    int decimals_;
+};
+
+class LogField;
+class LogFieldBuffer;
+
 class LogStream : noncopyable
 {
 public:
     using Buffer = FixedBuffer<kSmallBuffer>;
+
+    LogStream()
+        : fields_(nullptr)
+    {}
     
     void append(const char* data, int len) { buffer_.append(data, len); }
     const Buffer& buffer() const { return buffer_; }
+    Buffer& buffer() { return buffer_; }
     void resetBuffer() { buffer_.reset(); }
 
     /**
@@ -62,13 +86,18 @@ public:
 
     // (const char*, int)的重载
     LogStream& operator<<(const GeneralTemplate& g);
+    LogStream& operator<<(const FixedPoint& v);
+    // 结构化字段，见 LogField.h
+    LogStream& operator<<(const LogField& field);
 
-private:
-    static const int kMaxNumericSize = 48;
+    // 设置之后字段写到 fields 里，由 Logger 按 JSON/logfmt 拼到行尾；没有设置时字段直接写成 key=value
+    void setFields(LogFieldBuffer* fields) { fields_ = fields; }
 
+private:
     // 对于整型需要特殊处理
     template <typename T>
     void formatInteger(T);
 
     Buffer buffer_;
+    LogFieldBuffer* fields_;
 };
\ No newline at end of file
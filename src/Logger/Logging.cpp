@@ -1,13 +1,83 @@
 #include "Logging.h"
 #include "CurrentThread.h"
 
+#include <algorithm>
+
 namespace ThreadInfo
 {
     __thread char t_errnobuf[512];
     __thread char t_time[64];
-    __thread time_t t_lastSecond;
+    __thread time_t t_lastSecond = -1;
+    __thread time_t t_zoneExpire = 0;     // 时区偏移在这个时间之前有效
+    __thread time_t t_zoneBegin = 0;
+    __thread int t_zoneOffset = 0;        // 本地时间比 UTC 快多少秒
+    __thread Logger::LogLevel t_outputLevel = Logger::INFO;
+};
+
+namespace
+{
+
+// 时区规则和夏令时切换都落在整 15 分钟上，这个区间里偏移不会变
+const time_t kZoneCheckInterval = 15 * 60;
+const int kSecondsPerDay = 24 * 60 * 60;
+
+void updateZoneOffset(time_t seconds)
+{
+    struct tm tm_time;
+    localtime_r(&seconds, &tm_time);
+    ThreadInfo::t_zoneOffset = static_cast<int>(tm_time.tm_gmtoff);
+    ThreadInfo::t_zoneBegin = seconds - seconds % kZoneCheckInterval;
+    ThreadInfo::t_zoneExpire = ThreadInfo::t_zoneBegin + kZoneCheckInterval;
+}
+
+// 从 1970-01-01 起的天数换算成年月日，不经过 libc，见 Howard Hinnant 的 civil_from_days
+void civilFromDays(int64_t days, int* year, int* month, int* day)
+{
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const int64_t doe = days - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    *day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+    *month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+    *year = static_cast<int>(yoe + era * 400 + (*month <= 2 ? 1 : 0));
+}
+
+struct LinePrefix
+{
+    const char* data;
+    int len;
+};
+
+#define LINE_PREFIX(s) { s, static_cast<int>(sizeof(s) - 1) }
+
+// 时间后面到线程号之前的部分，每个等级事先拼好
+const LinePrefix kJsonLevel[Logger::LEVEL_COUNT] = {
+    LINE_PREFIX("\",\"level\":\"TRACE\",\"tid\":"),
+    LINE_PREFIX("\",\"level\":\"DEBUG\",\"tid\":"),
+    LINE_PREFIX("\",\"level\":\"INFO\",\"tid\":"),
+    LINE_PREFIX("\",\"level\":\"WARN\",\"tid\":"),
+    LINE_PREFIX("\",\"level\":\"ERROR\",\"tid\":"),
+    LINE_PREFIX("\",\"level\":\"FATAL\",\"tid\":"),
+};
+
+const LinePrefix kLogfmtLevel[Logger::LEVEL_COUNT] = {
+    LINE_PREFIX(" level=trace tid="),
+    LINE_PREFIX(" level=debug tid="),
+    LINE_PREFIX(" level=info tid="),
+    LINE_PREFIX(" level=warn tid="),
+    LINE_PREFIX(" level=error tid="),
+    LINE_PREFIX(" level=fatal tid="),
 };
 
+#undef LINE_PREFIX
+
+// 行尾的 suppressed、func、src 三个字段最多占的地方，不含函数名和文件名本身
+const int kStructuredTailSize = 3 * (kMaxNumericSize + 16) + 4;
+
+} // namespace
+
 const char* getErrnoMsg(int savedErrno)
 {
     return strerror_r(savedErrno, ThreadInfo::t_errnobuf, sizeof(ThreadInfo::t_errnobuf));
@@ -43,14 +113,32 @@ static void defaultFlush()
 
 Logger::OutputFunc g_output = defaultOutput;
 Logger::FlushFunc g_flush = defaultFlush;
+LogFieldFormat g_format = LogFieldFormat::TEXT;
 
-Logger::Impl::Impl(Logger::LogLevel level, int savedErrno, const char* file, int line)
+Logger::Impl::Impl(Logger::LogLevel level, int savedErrno, const char* file, int line, const char* func)
     : time_(Timestamp::now()),
       stream_(),
       level_(level),
       line_(line),
-      basename_(file)
+      basename_(file),
+      suppressed_(0),
+      func_(func),
+      msgBegin_(0),
+      fields_(g_format)
 {
+    if (fields_.format() != LogFieldFormat::TEXT)
+    {
+        // 后面 << 进来的文字都是 msg，字段另外攒着
+        msgBegin_ = beginStructuredLog(stream_, fields_.format(), level, time_.microSecondsSinceEpoch(),
+                                       CurrentThread::tid());
+        stream_.setFields(&fields_);
+        if (savedErrno != 0)
+        {
+            fields_.add(LogField("errno", savedErrno));
+            fields_.add(LogField("error", getErrnoMsg(savedErrno)));
+        }
+        return;
+    }
     // 输出流 -> time
     formatTime();
     // 写入日志等级
@@ -60,57 +148,170 @@ Logger::Impl::Impl(Logger::LogLevel level, int savedErrno, const char* file, int
     {
         stream_ << getErrnoMsg(savedErrno) << " (errno=" << savedErrno << ") ";
     }
+    if (func != nullptr)
+    {
+        stream_ << func << ' ';
+    }
+}
+
+const char* formatLogTime(int64_t microSecondsSinceEpoch)
+{
+    time_t seconds = static_cast<time_t>(microSecondsSinceEpoch / Timestamp::kMicroSecondsPerSecond);
+    int microseconds = static_cast<int>(microSecondsSinceEpoch % Timestamp::kMicroSecondsPerSecond);
+    if (microseconds < 0)
+    {
+        microseconds += Timestamp::kMicroSecondsPerSecond;
+        --seconds;
+    }
+
+    // 换了一秒才重新生成 "YYYY/MM/DD HH:MM:SS."，同一秒内的日志直接复用
+    if (seconds != ThreadInfo::t_lastSecond)
+    {
+        if (seconds >= ThreadInfo::t_zoneExpire || seconds < ThreadInfo::t_zoneBegin)
+        {
+            updateZoneOffset(seconds);
+        }
+        int64_t local = static_cast<int64_t>(seconds) + ThreadInfo::t_zoneOffset;
+        int64_t days = local / kSecondsPerDay;
+        int secondsOfDay = static_cast<int>(local % kSecondsPerDay);
+        if (secondsOfDay < 0)
+        {
+            secondsOfDay += kSecondsPerDay;
+            --days;
+        }
+        int year, month, day;
+        civilFromDays(days, &year, &month, &day);
+        snprintf(ThreadInfo::t_time, sizeof(ThreadInfo::t_time), "%4d/%02d/%02d %02d:%02d:%02d.",
+                 year, month, day,
+                 secondsOfDay / 3600, secondsOfDay / 60 % 60, secondsOfDay % 60);
+        ThreadInfo::t_time[kLogTimeLength - 1] = ' ';
+        ThreadInfo::t_lastSecond = seconds;
+    }
+
+    // 只改写 6 位微秒，每次两位
+    char* p = ThreadInfo::t_time + kLogTimeLength - 1;
+    for (int i = 0; i < 3; ++i)
+    {
+        const int pair = microseconds % 100 * 2;
+        microseconds /= 100;
+        *--p = kDigitPairs[pair + 1];
+        *--p = kDigitPairs[pair];
+    }
+    return ThreadInfo::t_time;
 }
 
-// Timestamp::toString方法的思路，只不过这里需要输出到流
+// 用构造时记下的 time_，不再重新取一次时间
 void Logger::Impl::formatTime()
 {
-    Timestamp now = Timestamp::now();
-    time_t seconds = static_cast<time_t>(now.microSecondsSinceEpoch() / Timestamp::kMicroSecondsPerSecond);
-    int microseconds = static_cast<int>(now.microSecondsSinceEpoch() % Timestamp::kMicroSecondsPerSecond);
+    stream_ << GeneralTemplate(formatLogTime(time_.microSecondsSinceEpoch()), kLogTimeLength);
+}
 
-    struct tm *tm_time = localtime(&seconds);
-    // 写入此线程存储的时间buf中
-    snprintf(ThreadInfo::t_time, sizeof(ThreadInfo::t_time), "%4d/%02d/%02d %02d:%02d:%02d",
-        tm_time->tm_year + 1900,
-        tm_time->tm_mon + 1,
-        tm_time->tm_mday,
-        tm_time->tm_hour,
-        tm_time->tm_min,
-        tm_time->tm_sec);
-    // 更新最后一次时间调用
-    ThreadInfo::t_lastSecond = seconds;
+int beginStructuredLog(LogStream& stream, LogFieldFormat format, Logger::LogLevel level,
+                       int64_t microSecondsSinceEpoch, int tid)
+{
+    LogStream::Buffer& buf = stream.buffer();
+    const bool json = format == LogFieldFormat::JSON;
+    buf.append(json ? "{\"ts\":\"" : "ts=", json ? 7 : 3);
+    // 沿用缓存的时间串，改成 ISO 8601 的 2024-01-01T12:00:00.123456
+    char* ts = buf.current();
+    buf.append(formatLogTime(microSecondsSinceEpoch), kLogTimeLength - 1);
+    ts[4] = '-';
+    ts[7] = '-';
+    ts[10] = 'T';
+    const LinePrefix& prefix = json ? kJsonLevel[level] : kLogfmtLevel[level];
+    buf.append(prefix.data, prefix.len);
+    stream << tid;
+    buf.append(json ? ",\"msg\":\"" : " msg=\"", json ? 8 : 6);
+    return buf.length();
+}
 
-    // muduo使用Fmt格式化整数，这里我们直接写入buf
-    char buf[32] = {0};
-    snprintf(buf, sizeof(buf), "%06d ", microseconds);
+void endStructuredLog(LogStream& stream, int msgBegin, const LogFieldBuffer& fields,
+                      const char* func, const SourceFile* source, int line, int64_t suppressed)
+{
+    LogStream::Buffer& buf = stream.buffer();
+    const LogFieldFormat format = fields.format();
+    const int funcLen = func != nullptr ? static_cast<int>(strlen(func)) : 0;
+    const int sourceLen = source != nullptr ? source->size_ : 0;
+    // 先给行尾留够地方，剩下的才给 msg
+    char* msg = buf.current() - (buf.length() - msgBegin);
+    const char* end = buf.current() + buf.avail() - 1;
+    const char* limit = end - (1 + fields.length() + funcLen + sourceLen + kStructuredTailSize);
+    if (limit < msg)
+    {
+        limit = msg;
+    }
+    int msgLen = std::min(buf.length() - msgBegin, static_cast<int>(limit - msg));
+    buf.truncate(msgBegin + escapeLogString(msg, msgLen, limit));
+    buf.append("\"", 1);
+    buf.append(fields.data(), fields.length());
 
-    // 输出时间，附有微妙(之前是(buf, 6),少了一个空格)
-    stream_ << GeneralTemplate(ThreadInfo::t_time, 17) << GeneralTemplate(buf, 7);
+    char* p = buf.current();
+    if (suppressed > 0)
+    {
+        p += encodeLogField(p, end, format, LogField("suppressed", suppressed));
+    }
+    if (func != nullptr)
+    {
+        p += encodeLogField(p, end, format, LogField("func", func));
+    }
+    if (source != nullptr)
+    {
+        // "file.cpp:88" 先在栈上拼好，再作为字符串字段写出去
+        char src[256];
+        int n = std::min(sourceLen, static_cast<int>(sizeof src) - kMaxNumericSize - 2);
+        memcpy(src, source->data_, n);
+        src[n++] = ':';
+        n += formatInteger(src + n, line);
+        src[n] = '\0';
+        p += encodeLogField(p, end, format, LogField("src", static_cast<const char*>(src)));
+    }
+    buf.add(p - buf.current());
+    if (format == LogFieldFormat::JSON)
+    {
+        buf.append("}\n", 2);
+    }
+    else
+    {
+        buf.append("\n", 1);
+    }
 }
 
 void Logger::Impl::finish()
 {
+    if (fields_.format() != LogFieldFormat::TEXT)
+    {
+        endStructuredLog(stream_, msgBegin_, fields_, func_, &basename_, line_, suppressed_);
+        return;
+    }
+    if (suppressed_ > 0)
+    {
+        stream_ << " [" << suppressed_ << " suppressed]";
+    }
     stream_ << " - " << GeneralTemplate(basename_.data_, basename_.size_) 
             << ':' << line_ << '\n';
 }
 
 // level默认为INFO等级
 Logger::Logger(const char* file, int line)  
-    : impl_(INFO, 0, file, line)
+    : impl_(INFO, 0, file, line, nullptr)
 {
 }
 
 Logger::Logger(const char* file, int line, Logger::LogLevel level)
-    : impl_(level, 0, file, line)
+    : impl_(level, 0, file, line, nullptr)
 {
 }
 
 // 可以打印调用函数
 Logger::Logger(const char* file, int line, Logger::LogLevel level, const char* func)
-  : impl_(level, 0, file, line)
+  : impl_(level, 0, file, line, func)
 {
-    impl_.stream_ << func << ' ';
+}
+
+Logger::Logger(const char* file, int line, Logger::LogLevel level, const char* func, int64_t suppressed)
+  : impl_(level, 0, file, line, func)
+{
+    impl_.suppressed_ = suppressed;
 }
 
 
@@ -121,6 +322,7 @@ Logger::~Logger()
     const LogStream::Buffer& buf(stream().buffer());
     // 输出(默认向终端输出),
     // 值得注意的是每一个 LOG_XXX 都会调用析构函数，因为每一次日志的打印都会进行一次构造和析构
+    ThreadInfo::t_outputLevel = impl_.level_;
     g_output(buf.data(), buf.length());
     // FATAL情况终止程序
     if (impl_.level_ == FATAL)
@@ -144,3 +346,18 @@ void Logger::setFlush(FlushFunc flush)
 {
     g_flush = flush;
 }
+
+Logger::LogLevel Logger::outputLevel()
+{
+    return ThreadInfo::t_outputLevel;
+}
+
+void Logger::setFormat(LogFieldFormat format)
+{
+    g_format = format;
+}
+
+LogFieldFormat Logger::format()
+{
+    return g_format;
+}
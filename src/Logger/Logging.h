@@ -3,11 +3,14 @@
 
 #include "Timestamp.h"
 #include "LogStream.h"
+#include "LogField.h"
 
 #include <stdio.h>
 #include <sys/time.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
+#include <atomic>
 #include <functional>
 
 // SourceFile的作用是提取文件名
@@ -50,6 +53,8 @@ public:
     Logger(const char* file, int line);
     Logger(const char* file, int line, LogLevel level);
     Logger(const char* file, int line, LogLevel level, const char* func);
+    // suppressed 是这个调用点上次输出之后被限流压掉的条数，大于 0 时写在行尾
+    Logger(const char* file, int line, LogLevel level, const char* func, int64_t suppressed);
     ~Logger();
 
     // 流是会改变的
@@ -64,6 +69,11 @@ public:
     using FlushFunc = std::function<void()>;
     static void setOutput(OutputFunc);
     static void setFlush(FlushFunc);
+    // 正在交给 OutputFunc 的这条日志的等级，只在 OutputFunc 里面调用才有意义
+    static LogLevel outputLevel();
+    // 行的格式，默认 TEXT；JSON/LOGFMT 下时间、等级、线程、函数和源码位置都是字段，见 LogField.h
+    static void setFormat(LogFieldFormat format);
+    static LogFieldFormat format();
 
 private:
     // 内部类
@@ -71,7 +81,7 @@ private:
     {
     public:
         using LogLevel = Logger::LogLevel;
-        Impl(LogLevel level, int savedErrno, const char* file, int line);
+        Impl(LogLevel level, int savedErrno, const char* file, int line, const char* func);
         void formatTime();
         void finish();
 
@@ -80,6 +90,11 @@ private:
         LogLevel level_;
         int line_;
         SourceFile basename_;
+        int64_t suppressed_;
+        const char* func_;
+        // 结构化格式下 msg 在 stream_ 里开始的位置，以及攒下来的字段
+        int msgBegin_;
+        LogFieldBuffer fields_;
     };
 
     // Logger's member variable 
@@ -96,9 +111,89 @@ inline Logger::LogLevel logLevel()
 // 获取errno信息
 const char* getErrnoMsg(int savedErrno);
 
+// "2024/01/01 12:00:00.123456 " 的长度，包括末尾的空格
+const int kLogTimeLength = 27;
+
+/**
+ * 把微秒时间戳格式化成日志行开头的本地时间，返回线程自己的缓冲区，长度为 kLogTimeLength，不以 '\0' 结尾
+ * 同一秒内只改写微秒部分；日期自己从秒数换算，时区偏移每个线程每 15 分钟才向 libc 要一次
+ */
+const char* formatLogTime(int64_t microSecondsSinceEpoch);
+
+/**
+ * JSON/logfmt 的一行分三段写：beginStructuredLog 写时间、等级、线程号(tid 是写这条日志的线程)和 msg 的开头，返回 msg 开始的位置；
+ * 接着调用方往 stream 里写 msg 的文字；endStructuredLog 原地转义 msg，再接上 fields、函数名和源码位置
+ * msg 太长时截掉 msg，保证行尾完整。AsyncLogging 自己报告丢弃的日志时也用这两个函数
+ */
+int beginStructuredLog(LogStream& stream, LogFieldFormat format, Logger::LogLevel level,
+                       int64_t microSecondsSinceEpoch, int tid);
+void endStructuredLog(LogStream& stream, int msgBegin, const LogFieldBuffer& fields,
+                      const char* func, const SourceFile* source, int line, int64_t suppressed);
+
+/**
+ * 一个调用点的限流器，每秒最多放行 perSecond 条
+ * 多个线程可以同时用，窗口切换时的计数可能有一两条误差
+ */
+class LogRateLimiter
+{
+public:
+    explicit LogRateLimiter(int perSecond)
+        : perSecond_(perSecond),
+          second_(0),
+          count_(0),
+          suppressed_(0)
+    {
+    }
+
+    // 放行时返回上次放行之后压掉的条数，不放行返回 -1
+    int64_t acquire()
+    {
+        int64_t now = static_cast<int64_t>(::time(NULL));
+        int64_t second = second_.load(std::memory_order_relaxed);
+        if (now != second && second_.compare_exchange_strong(second, now, std::memory_order_relaxed))
+        {
+            count_.store(0, std::memory_order_relaxed);
+        }
+        if (count_.fetch_add(1, std::memory_order_relaxed) < perSecond_)
+        {
+            return suppressed_.exchange(0, std::memory_order_relaxed);
+        }
+        suppressed_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+private:
+    const int perSecond_;
+    std::atomic<int64_t> second_;
+    std::atomic<int> count_;
+    std::atomic<int64_t> suppressed_;
+};
+
+// 一个调用点的采样器，每 n 条放行一条
+class LogSampler
+{
+public:
+    explicit LogSampler(int n)
+        : n_(n > 0 ? n : 1),
+          count_(0)
+    {
+    }
+
+    // 放行时返回 0，不放行返回 -1
+    int64_t acquire()
+    {
+        return count_.fetch_add(1, std::memory_order_relaxed) % n_ == 0 ? 0 : -1;
+    }
+
+private:
+    const int n_;
+    std::atomic<uint64_t> count_;
+};
+
 /**
  * 当日志等级小于对应等级才会输出
  * 比如设置等级为FATAL，则logLevel等级大于DEBUG和INFO，DEBUG和INFO等级的日志就不会输出
+ * FATAL 总是输出，保证程序会 abort
  */
 #define LOG_TRACE if (logLevel() <= Logger::TRACE) \
   Logger(__FILE__, __LINE__, Logger::TRACE, __func__).stream()
@@ -106,6 +201,34 @@ const char* getErrnoMsg(int savedErrno);
   Logger(__FILE__, __LINE__, Logger::DEBUG, __func__).stream()
 #define LOG_INFO if (logLevel() <= Logger::INFO) \
   Logger(__FILE__, __LINE__).stream()
-#define LOG_WARN Logger(__FILE__, __LINE__, Logger::WARN,__func__).stream()
-#define LOG_ERROR Logger(__FILE__, __LINE__, Logger::ERROR,__func__).stream()
-#define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL,__func__).stream()
\ No newline at end of file
+#define LOG_WARN if (logLevel() <= Logger::WARN) \
+  Logger(__FILE__, __LINE__, Logger::WARN,__func__).stream()
+#define LOG_ERROR if (logLevel() <= Logger::ERROR) \
+  Logger(__FILE__, __LINE__, Logger::ERROR,__func__).stream()
+#define LOG_FATAL Logger(__FILE__, __LINE__, Logger::FATAL,__func__).stream()
+
+/**
+ * 会反复出现的日志用限流或者采样的版本，避免出错时日志本身把情况搞得更糟(比如 fd 用完之后 accept 一直失败)
+ *
+ *   LOG_ERROR_LIMIT(10) << "accept4() failed";    // 这个调用点每秒最多 10 条，行尾带上被压掉的条数
+ *   LOG_DEBUG_SAMPLE(100) << "read " << n;        // 每 100 条输出一条
+ *
+ * 每个调用点有自己的计数器(宏展开出的 lambda 里的静态变量)，用 for 展开，后面可以直接接 <<，也不会吞掉外层的 else
+ */
+#define LOG_LIMITER_IMPL(Type, n) \
+  ([]() -> Type& { static Type logLimiter_(n); return logLimiter_; }())
+
+#define LOG_GATED_IMPL(level, Type, n) \
+  for (int64_t logSuppressed_ = logLevel() <= level ? LOG_LIMITER_IMPL(Type, n).acquire() : -1; \
+       logSuppressed_ >= 0; logSuppressed_ = -1) \
+    Logger(__FILE__, __LINE__, level, __func__, logSuppressed_).stream()
+
+#define LOG_DEBUG_LIMIT(perSecond) LOG_GATED_IMPL(Logger::DEBUG, LogRateLimiter, perSecond)
+#define LOG_INFO_LIMIT(perSecond) LOG_GATED_IMPL(Logger::INFO, LogRateLimiter, perSecond)
+#define LOG_WARN_LIMIT(perSecond) LOG_GATED_IMPL(Logger::WARN, LogRateLimiter, perSecond)
+#define LOG_ERROR_LIMIT(perSecond) LOG_GATED_IMPL(Logger::ERROR, LogRateLimiter, perSecond)
+
+#define LOG_TRACE_SAMPLE(n) LOG_GATED_IMPL(Logger::TRACE, LogSampler, n)
+#define LOG_DEBUG_SAMPLE(n) LOG_GATED_IMPL(Logger::DEBUG, LogSampler, n)
+#define LOG_INFO_SAMPLE(n) LOG_GATED_IMPL(Logger::INFO, LogSampler, n)
+#define LOG_WARN_SAMPLE(n) LOG_GATED_IMPL(Logger::WARN, LogSampler, n)
\ No newline at end of file
@@ -0,0 +1,170 @@
+#include "MmapLogRing.h"
+#include "Logging.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace
+{
+
+const char kMagic[8] = {'M', 'Y', 'W', 'E', 'B', 'R', 'N', 'G'};
+const uint32_t kVersion = 1;
+const size_t kRecordHeader = sizeof(uint64_t);
+
+inline uint64_t alignUp(uint64_t n)
+{
+    return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+inline uint32_t positionCheck(uint64_t pos)
+{
+    return static_cast<uint32_t>(pos >> 3) ^ MmapLogRing::kRecordMagic;
+}
+
+} // namespace
+
+const size_t MmapLogRing::kHeaderSize;
+const uint32_t MmapLogRing::kRecordMagic;
+const size_t MmapLogRing::kMaxRecord;
+
+MmapLogRing::MmapLogRing(const std::string& filename, size_t capacity)
+    : filename_(filename),
+      header_(nullptr),
+      data_(nullptr),
+      capacity_(0),
+      mappedSize_(0)
+{
+    long page = ::sysconf(_SC_PAGESIZE);
+    capacity_ = (std::max(capacity, kMaxRecord * 2) + page - 1) / page * page;
+    mappedSize_ = kHeaderSize + capacity_;
+
+    int fd = ::open(filename.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+    {
+        fprintf(stderr, "MmapLogRing open %s failed %s\n", filename.c_str(), getErrnoMsg(errno));
+        return;
+    }
+    struct stat st;
+    bool reuse = ::fstat(fd, &st) == 0 && static_cast<size_t>(st.st_size) == mappedSize_;
+    if (!reuse)
+    {
+        // 一次把空间分配好，否则磁盘满的时候写映射会收到 SIGBUS
+        int err = ::ftruncate(fd, 0) == 0 ? ::posix_fallocate(fd, 0, static_cast<off_t>(mappedSize_)) : errno;
+        if (err != 0)
+        {
+            fprintf(stderr, "MmapLogRing allocate %s failed %s\n", filename.c_str(), getErrnoMsg(err));
+            ::close(fd);
+            return;
+        }
+    }
+    void* addr = ::mmap(nullptr, mappedSize_, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        fprintf(stderr, "MmapLogRing mmap %s failed %s\n", filename.c_str(), getErrnoMsg(errno));
+        return;
+    }
+    header_ = static_cast<MmapLogRingHeader*>(addr);
+    data_ = static_cast<char*>(addr) + kHeaderSize;
+    if (!reuse || !validHeader(*header_, mappedSize_))
+    {
+        // 逐个字段初始化，头里有 atomic 不能整体 memset；先清掉 magic，初始化完成之前文件都算无效
+        memset(header_->magic, 0, sizeof header_->magic);
+        header_->version = kVersion;
+        header_->headerSize = static_cast<uint32_t>(kHeaderSize);
+        header_->capacity = capacity_;
+        header_->writeOffset.store(0, std::memory_order_relaxed);
+        // magic 最后写，写到一半崩溃的文件下次会被重新初始化
+        memcpy(header_->magic, kMagic, sizeof kMagic);
+    }
+}
+
+MmapLogRing::~MmapLogRing()
+{
+    if (header_ != nullptr)
+    {
+        ::munmap(header_, mappedSize_);
+    }
+}
+
+bool MmapLogRing::validHeader(const MmapLogRingHeader& header, size_t fileSize)
+{
+    return memcmp(header.magic, kMagic, sizeof kMagic) == 0
+        && header.version == kVersion
+        && header.headerSize == kHeaderSize
+        && header.capacity % 8 == 0
+        && header.capacity + kHeaderSize == fileSize;
+}
+
+void MmapLogRing::copyIn(uint64_t pos, const char* data, size_t len)
+{
+    size_t offset = static_cast<size_t>(pos % capacity_);
+    size_t first = std::min(len, capacity_ - offset);
+    memcpy(data_ + offset, data, first);
+    memcpy(data_, data + first, len - first);
+}
+
+void MmapLogRing::append(const char* data, int len)
+{
+    if (header_ == nullptr || len <= 0)
+    {
+        return;
+    }
+    size_t n = std::min(static_cast<size_t>(len), kMaxRecord);
+    uint64_t total = alignUp(kRecordHeader + n);
+    uint64_t pos = header_->writeOffset.fetch_add(total, std::memory_order_relaxed);
+    copyIn(pos + kRecordHeader, data, n);
+    // 头最后写，读的一方看到头就能看到完整的数据；pos 8 字节对齐，头不会跨过数据区的末尾
+    uint64_t recordHeader = (static_cast<uint64_t>(n) << 32) | positionCheck(pos);
+    reinterpret_cast<std::atomic<uint64_t>*>(data_ + pos % capacity_)->store(recordHeader, std::memory_order_release);
+}
+
+void MmapLogRing::flush()
+{
+    if (header_ != nullptr)
+    {
+        ::msync(header_, mappedSize_, MS_SYNC);
+    }
+}
+
+uint64_t MmapLogRing::forEachRecord(const MmapLogRingHeader& header, const char* data,
+                                    const std::function<void(const char* data, size_t len)>& cb)
+{
+    const uint64_t capacity = header.capacity;
+    const uint64_t end = header.writeOffset.load(std::memory_order_acquire);
+    // 数据区里只剩最近 capacity 字节，最前面那条可能已经被覆盖了一半
+    uint64_t pos = end > capacity ? alignUp(end - capacity) : 0;
+    uint64_t skipped = 0;
+    std::string record;
+    while (pos + kRecordHeader <= end)
+    {
+        uint64_t recordHeader;
+        memcpy(&recordHeader, data + pos % capacity, sizeof recordHeader);
+        uint64_t len = recordHeader >> 32;
+        uint64_t next = pos + alignUp(kRecordHeader + len);
+        if (static_cast<uint32_t>(recordHeader) != positionCheck(pos) || len > kMaxRecord || next > end)
+        {
+            // 不是这个位置写的记录，往后挪 8 字节重新找
+            pos += 8;
+            skipped += 8;
+            continue;
+        }
+        uint64_t offset = (pos + kRecordHeader) % capacity;
+        if (offset + len <= capacity)
+        {
+            cb(data + offset, static_cast<size_t>(len));
+        }
+        else
+        {
+            // 跨过数据区末尾的记录拼起来
+            record.assign(data + offset, static_cast<size_t>(capacity - offset));
+            record.append(data, static_cast<size_t>(len - (capacity - offset)));
+            cb(record.data(), record.size());
+        }
+        pos = next;
+    }
+    return skipped;
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stdint.h>
+#include <atomic>
+#include <functional>
+#include <string>
+
+/**
+ * 写在内存映射文件里的环形日志
+ *
+ *   MmapLogRing ring("http_test.ring", 64 * 1024 * 1024);
+ *   Logger::setOutput(std::bind(&MmapLogRing::append, &ring, _1, _2));
+ *
+ * 每条日志在调用线程里直接拷进 MAP_SHARED 的映射，没有进程内的缓冲和系统调用，
+ * 进程崩溃时已经写进去的内容都在内核的页缓存里，会照常落到文件上；机器掉电不在保护范围内。
+ * 写满之后覆盖最旧的内容，重启后接着上次的位置写，用 tools/myweb-logring 按顺序取出来。
+ *
+ * 文件布局：第一页是 MmapLogRingHeader，后面是 capacity 字节的数据区。
+ * 每条记录 8 字节对齐，前面是 8 字节的头：高 32 位是长度，低 32 位是 (位置 / 8) ^ kRecordMagic。
+ * 写的时候先用 fetch_add 占位置，拷完数据再用 release 写头，读的时候位置对不上的就是没写完或者上一圈的旧数据。
+ */
+struct MmapLogRingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t capacity;
+    std::atomic<uint64_t> writeOffset;      // 从第一次创建起一共占用了多少字节，不回绕
+};
+
+class MmapLogRing : noncopyable
+{
+public:
+    static const size_t kHeaderSize = 4096;
+    static const uint32_t kRecordMagic = 0x9e3779b9;
+    static const size_t kMaxRecord = 1024 * 1024;
+
+    // 文件已经存在并且容量相同时接着写，否则重新创建；capacity 会向上取整到页大小
+    MmapLogRing(const std::string& filename, size_t capacity);
+    ~MmapLogRing();
+
+    bool valid() const { return header_ != nullptr; }
+
+    void append(const char* data, int len);
+    // msync 到磁盘，FATAL 之前可以调用
+    void flush();
+
+    /**
+     * 按从旧到新的顺序取出 header/data 里所有完整的记录，tools/myweb-logring 也用这个函数
+     * 返回跳过的字节数，被覆盖了一半的最旧记录和崩溃时没写完的记录会被跳过
+     */
+    static uint64_t forEachRecord(const MmapLogRingHeader& header, const char* data,
+                                  const std::function<void(const char* data, size_t len)>& cb);
+    // 检查文件头是不是有效的环形日志
+    static bool validHeader(const MmapLogRingHeader& header, size_t fileSize);
+
+private:
+    void copyIn(uint64_t pos, const char* data, size_t len);
+
+    std::string filename_;
+    MmapLogRingHeader* header_;
+    char* data_;
+    size_t capacity_;
+    size_t mappedSize_;
+};
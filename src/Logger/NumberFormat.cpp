@@ -0,0 +1,400 @@
+#include "NumberFormat.h"
+
+#include <string.h>
+
+const char kDigitPairs[200] = {
+    '0','0','0','1','0','2','0','3','0','4','0','5','0','6','0','7','0','8','0','9',
+    '1','0','1','1','1','2','1','3','1','4','1','5','1','6','1','7','1','8','1','9',
+    '2','0','2','1','2','2','2','3','2','4','2','5','2','6','2','7','2','8','2','9',
+    '3','0','3','1','3','2','3','3','3','4','3','5','3','6','3','7','3','8','3','9',
+    '4','0','4','1','4','2','4','3','4','4','4','5','4','6','4','7','4','8','4','9',
+    '5','0','5','1','5','2','5','3','5','4','5','5','5','6','5','7','5','8','5','9',
+    '6','0','6','1','6','2','6','3','6','4','6','5','6','6','6','7','6','8','6','9',
+    '7','0','7','1','7','2','7','3','7','4','7','5','7','6','7','7','7','8','7','9',
+    '8','0','8','1','8','2','8','3','8','4','8','5','8','6','8','7','8','8','8','9',
+    '9','0','9','1','9','2','9','3','9','4','9','5','9','6','9','7','9','8','9','9'
+};
+
+namespace
+{
+
+/**
+ * Grisu2，见 Florian Loitsch, "Printing Floating-Point Numbers Quickly and Accurately with Integers"
+ * 结构照着 RapidJSON 的 dtoa：把 v 和它的舍入区间乘上一个缓存的 10 的幂，
+ * 让结果落在 64 位整数里，再在区间内逐位生成数字，生成到能唯一确定 v 为止。
+ * 输出一定能原样读回来；极少数输入会比最短表示多一位。
+ */
+struct DiyFp
+{
+    DiyFp() : f(0), e(0) {}
+    DiyFp(uint64_t fp, int exp) : f(fp), e(exp) {}
+
+    DiyFp operator-(const DiyFp& rhs) const { return DiyFp(f - rhs.f, e); }
+
+    // 只保留高 64 位，按最低被丢掉的一位四舍五入
+    DiyFp operator*(const DiyFp& rhs) const
+    {
+        unsigned __int128 p = static_cast<unsigned __int128>(f) * rhs.f;
+        uint64_t h = static_cast<uint64_t>(p >> 64);
+        uint64_t l = static_cast<uint64_t>(p);
+        if (l & (static_cast<uint64_t>(1) << 63))
+        {
+            ++h;
+        }
+        return DiyFp(h, e + rhs.e + 64);
+    }
+
+    DiyFp normalize() const
+    {
+        int s = __builtin_clzll(f);
+        return DiyFp(f << s, e - s);
+    }
+
+    // 舍入区间的上下界，上界规格化，下界和上界用同一个指数；hiddenBit 是规格化数隐含的最高位
+    void normalizedBoundaries(uint64_t hiddenBit, DiyFp* minus, DiyFp* plus) const
+    {
+        DiyFp pl = DiyFp((f << 1) + 1, e - 1).normalize();
+        // 2 的整数次幂下面的间隔只有上面的一半
+        DiyFp mi = f == hiddenBit ? DiyFp((f << 2) - 1, e - 2) : DiyFp((f << 1) - 1, e - 1);
+        mi.f <<= mi.e - pl.e;
+        mi.e = pl.e;
+        *plus = pl;
+        *minus = mi;
+    }
+
+    uint64_t f;
+    int e;
+};
+
+/**
+ * 把 IEEE 754 的位拆成 f * 2^e，double 和 float 只是位数不同；
+ * float 按自己的精度算舍入区间，0.1f 输出 "0.1" 而不是转成 double 后的 "0.10000000149011612"
+ */
+template <int kSignificand, int kExponent>
+struct IeeeTraits
+{
+    static const int kSignificandSize = kSignificand;
+    static const int kExponentSize = kExponent;
+    static const int kExponentBias = (1 << (kExponentSize - 1)) - 1 + kSignificandSize;
+    static const uint64_t kHiddenBit = static_cast<uint64_t>(1) << kSignificandSize;
+    static const uint64_t kSignificandMask = kHiddenBit - 1;
+    static const int kMaxExponent = (1 << kExponentSize) - 1;
+};
+
+using DoubleTraits = IeeeTraits<52, 11>;
+using FloatTraits = IeeeTraits<23, 8>;
+
+// 10^-348, 10^-340, ..., 10^340 规格化到 64 位后的尾数和二进制指数，由精确的有理数运算生成
+const uint64_t kCachedPowersF[] = {
+    0xfa8fd5a0081c0288ULL, 0xbaaee17fa23ebf76ULL, 0x8b16fb203055ac76ULL,
+    0xcf42894a5dce35eaULL, 0x9a6bb0aa55653b2dULL, 0xe61acf033d1a45dfULL,
+    0xab70fe17c79ac6caULL, 0xff77b1fcbebcdc4fULL, 0xbe5691ef416bd60cULL,
+    0x8dd01fad907ffc3cULL, 0xd3515c2831559a83ULL, 0x9d71ac8fada6c9b5ULL,
+    0xea9c227723ee8bcbULL, 0xaecc49914078536dULL, 0x823c12795db6ce57ULL,
+    0xc21094364dfb5637ULL, 0x9096ea6f3848984fULL, 0xd77485cb25823ac7ULL,
+    0xa086cfcd97bf97f4ULL, 0xef340a98172aace5ULL, 0xb23867fb2a35b28eULL,
+    0x84c8d4dfd2c63f3bULL, 0xc5dd44271ad3cdbaULL, 0x936b9fcebb25c996ULL,
+    0xdbac6c247d62a584ULL, 0xa3ab66580d5fdaf6ULL, 0xf3e2f893dec3f126ULL,
+    0xb5b5ada8aaff80b8ULL, 0x87625f056c7c4a8bULL, 0xc9bcff6034c13053ULL,
+    0x964e858c91ba2655ULL, 0xdff9772470297ebdULL, 0xa6dfbd9fb8e5b88fULL,
+    0xf8a95fcf88747d94ULL, 0xb94470938fa89bcfULL, 0x8a08f0f8bf0f156bULL,
+    0xcdb02555653131b6ULL, 0x993fe2c6d07b7facULL, 0xe45c10c42a2b3b06ULL,
+    0xaa242499697392d3ULL, 0xfd87b5f28300ca0eULL, 0xbce5086492111aebULL,
+    0x8cbccc096f5088ccULL, 0xd1b71758e219652cULL, 0x9c40000000000000ULL,
+    0xe8d4a51000000000ULL, 0xad78ebc5ac620000ULL, 0x813f3978f8940984ULL,
+    0xc097ce7bc90715b3ULL, 0x8f7e32ce7bea5c70ULL, 0xd5d238a4abe98068ULL,
+    0x9f4f2726179a2245ULL, 0xed63a231d4c4fb27ULL, 0xb0de65388cc8ada8ULL,
+    0x83c7088e1aab65dbULL, 0xc45d1df942711d9aULL, 0x924d692ca61be758ULL,
+    0xda01ee641a708deaULL, 0xa26da3999aef774aULL, 0xf209787bb47d6b85ULL,
+    0xb454e4a179dd1877ULL, 0x865b86925b9bc5c2ULL, 0xc83553c5c8965d3dULL,
+    0x952ab45cfa97a0b3ULL, 0xde469fbd99a05fe3ULL, 0xa59bc234db398c25ULL,
+    0xf6c69a72a3989f5cULL, 0xb7dcbf5354e9beceULL, 0x88fcf317f22241e2ULL,
+    0xcc20ce9bd35c78a5ULL, 0x98165af37b2153dfULL, 0xe2a0b5dc971f303aULL,
+    0xa8d9d1535ce3b396ULL, 0xfb9b7cd9a4a7443cULL, 0xbb764c4ca7a44410ULL,
+    0x8bab8eefb6409c1aULL, 0xd01fef10a657842cULL, 0x9b10a4e5e9913129ULL,
+    0xe7109bfba19c0c9dULL, 0xac2820d9623bf429ULL, 0x80444b5e7aa7cf85ULL,
+    0xbf21e44003acdd2dULL, 0x8e679c2f5e44ff8fULL, 0xd433179d9c8cb841ULL,
+    0x9e19db92b4e31ba9ULL, 0xeb96bf6ebadf77d9ULL, 0xaf87023b9bf0ee6bULL
+};
+
+const int16_t kCachedPowersE[] = {
+    -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007, -980,
+    -954, -927, -901, -874, -847, -821, -794, -768, -741, -715,
+    -688, -661, -635, -608, -582, -555, -529, -502, -475, -449,
+    -422, -396, -369, -343, -316, -289, -263, -236, -210, -183,
+    -157, -130, -103, -77, -50, -24, 3, 30, 56, 83,
+    109, 136, 162, 189, 216, 242, 269, 295, 322, 348,
+    375, 402, 428, 455, 481, 508, 534, 561, 588, 614,
+    641, 667, 694, 720, 747, 774, 800, 827, 853, 880,
+    907, 933, 960, 986, 1013, 1039, 1066
+};
+
+const uint64_t kPow10[] = {
+    1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL,
+    1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL, 10000000000000ULL,
+    100000000000000ULL, 1000000000000000ULL, 10000000000000000ULL, 100000000000000000ULL,
+    1000000000000000000ULL, 10000000000000000000ULL
+};
+
+// 选一个 10^-k，让 e 乘上去以后的二进制指数落在 [-60, -32]，整数部分能放进 32 位
+DiyFp cachedPower(int e, int* k)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;    // 0.30102999566398114 = log10(2)
+    int ik = static_cast<int>(dk);
+    if (dk - ik > 0.0)
+    {
+        ++ik;
+    }
+    unsigned index = static_cast<unsigned>((ik >> 3) + 1);
+    *k = -(-348 + static_cast<int>(index) * 8);
+    return DiyFp(kCachedPowersF[index], kCachedPowersE[index]);
+}
+
+int countDecimalDigit32(uint32_t n)
+{
+    int count = 1;
+    for (uint32_t p = 10; count < 10 && n >= p; p *= 10)
+    {
+        ++count;
+    }
+    return count;
+}
+
+// 最后一位往下调，让结果在不离开区间的前提下尽量靠近 v
+void grisuRound(char* buffer, int len, uint64_t delta, uint64_t rest, uint64_t tenKappa, uint64_t distance)
+{
+    while (rest < distance && delta - rest >= tenKappa
+           && (rest + tenKappa < distance || distance - rest > rest + tenKappa - distance))
+    {
+        buffer[len - 1]--;
+        rest += tenKappa;
+    }
+}
+
+void digitGen(const DiyFp& w, const DiyFp& mp, uint64_t delta, char* buffer, int* len, int* k)
+{
+    const DiyFp one(static_cast<uint64_t>(1) << -mp.e, mp.e);
+    const DiyFp distance = mp - w;
+    uint32_t p1 = static_cast<uint32_t>(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = countDecimalDigit32(p1);
+    *len = 0;
+
+    // 整数部分
+    while (kappa > 0)
+    {
+        uint32_t d = p1 / static_cast<uint32_t>(kPow10[kappa - 1]);
+        p1 %= static_cast<uint32_t>(kPow10[kappa - 1]);
+        if (d != 0 || *len != 0)
+        {
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        }
+        --kappa;
+        uint64_t rest = (static_cast<uint64_t>(p1) << -one.e) + p2;
+        if (rest <= delta)
+        {
+            *k += kappa;
+            grisuRound(buffer, *len, delta, rest, kPow10[kappa] << -one.e, distance.f);
+            return;
+        }
+    }
+
+    // 小数部分
+    while (true)
+    {
+        p2 *= 10;
+        delta *= 10;
+        char d = static_cast<char>(p2 >> -one.e);
+        if (d != 0 || *len != 0)
+        {
+            buffer[(*len)++] = static_cast<char>('0' + d);
+        }
+        p2 &= one.f - 1;
+        --kappa;
+        if (p2 < delta)
+        {
+            *k += kappa;
+            int index = -kappa;
+            grisuRound(buffer, *len, delta, p2, one.f, distance.f * (index < 20 ? kPow10[index] : 0));
+            return;
+        }
+    }
+}
+
+// 生成 v 的十进制数字，v = buffer * 10^k
+void grisu2(const DiyFp& v, uint64_t hiddenBit, char* buffer, int* len, int* k)
+{
+    DiyFp minus, plus;
+    v.normalizedBoundaries(hiddenBit, &minus, &plus);
+
+    const DiyFp cached = cachedPower(plus.e, k);
+    const DiyFp w = v.normalize() * cached;
+    DiyFp wPlus = plus * cached;
+    DiyFp wMinus = minus * cached;
+    // 乘法有误差，区间两头各收回 1 ulp，保证生成的数字读回来还是 v
+    wMinus.f++;
+    wPlus.f--;
+    digitGen(w, wPlus, wPlus.f - wMinus.f, buffer, len, k);
+}
+
+int writeExponent(char* buf, int e)
+{
+    char* p = buf;
+    *p++ = 'e';
+    if (e < 0)
+    {
+        *p++ = '-';
+        e = -e;
+    }
+    else
+    {
+        *p++ = '+';
+    }
+    // 和 printf 一样至少两位
+    if (e < 10)
+    {
+        *p++ = '0';
+    }
+    p += formatInteger(p, e);
+    return static_cast<int>(p - buf);
+}
+
+// 把 digits * 10^k 排成 printf("%g") 的样子：指数在 [-5, 17) 之间用定点，否则用科学计数法
+int prettify(char* buf, int len, int k)
+{
+    const int point = len + k;     // 小数点在第几位数字后面
+    if (point > 0 && point <= 17)
+    {
+        if (k >= 0)
+        {
+            // 1234e3 -> 1234000
+            memset(buf + len, '0', static_cast<size_t>(k));
+            return point;
+        }
+        // 1234e-2 -> 12.34
+        memmove(buf + point + 1, buf + point, static_cast<size_t>(len - point));
+        buf[point] = '.';
+        return len + 1;
+    }
+    if (point <= 0 && point > -4)
+    {
+        // 1234e-6 -> 0.001234
+        const int zeros = 2 - point;
+        memmove(buf + zeros, buf, static_cast<size_t>(len));
+        buf[0] = '0';
+        buf[1] = '.';
+        memset(buf + 2, '0', static_cast<size_t>(-point));
+        return len + zeros;
+    }
+    if (len == 1)
+    {
+        // 1e30
+        return 1 + writeExponent(buf + 1, point - 1);
+    }
+    // 1234e30 -> 1.234e+33
+    memmove(buf + 2, buf + 1, static_cast<size_t>(len - 1));
+    buf[1] = '.';
+    return len + 1 + writeExponent(buf + len + 1, point - 1);
+}
+
+template <typename Traits>
+int formatFloating(char* buf, uint64_t bits)
+{
+    const bool negative = (bits >> (Traits::kSignificandSize + Traits::kExponentSize)) & 1;
+    const int biasedExponent = static_cast<int>((bits >> Traits::kSignificandSize) & Traits::kMaxExponent);
+    const uint64_t significand = bits & Traits::kSignificandMask;
+    if (biasedExponent == Traits::kMaxExponent && significand != 0)
+    {
+        memcpy(buf, "nan", 3);
+        return 3;
+    }
+    char* p = buf;
+    if (negative)
+    {
+        *p++ = '-';
+    }
+    if (biasedExponent == Traits::kMaxExponent)
+    {
+        memcpy(p, "inf", 3);
+        return static_cast<int>(p - buf) + 3;
+    }
+    if (biasedExponent == 0 && significand == 0)
+    {
+        *p++ = '0';
+        return static_cast<int>(p - buf);
+    }
+    DiyFp v;
+    if (biasedExponent != 0)
+    {
+        v = DiyFp(significand + Traits::kHiddenBit, biasedExponent - Traits::kExponentBias);
+    }
+    else
+    {
+        // 非规格化数
+        v = DiyFp(significand, 1 - Traits::kExponentBias);
+    }
+    int len, k;
+    grisu2(v, Traits::kHiddenBit, p, &len, &k);
+    return static_cast<int>(p - buf) + prettify(p, len, k);
+}
+
+} // namespace
+
+int formatDouble(char* buf, double v)
+{
+    uint64_t bits;
+    memcpy(&bits, &v, sizeof bits);
+    return formatFloating<DoubleTraits>(buf, bits);
+}
+
+int formatFloat(char* buf, float v)
+{
+    uint32_t bits;
+    memcpy(&bits, &v, sizeof bits);
+    return formatFloating<FloatTraits>(buf, bits);
+}
+
+int formatFixed(char* buf, int64_t value, int decimals)
+{
+    char* p = buf;
+    uint64_t u = static_cast<uint64_t>(value);
+    if (value < 0)
+    {
+        *p++ = '-';
+        u = 0 - u;
+    }
+    if (decimals <= 0)
+    {
+        return static_cast<int>(p - buf) + formatInteger(p, u);
+    }
+    if (decimals > 19)
+    {
+        decimals = 19;
+    }
+    const uint64_t scale = kPow10[decimals];
+    p += formatInteger(p, u / scale);
+    *p++ = '.';
+    // 小数部分固定 decimals 位，不足的前面补 0
+    uint64_t fraction = u % scale;
+    for (int i = decimals - 1; i >= 0; --i)
+    {
+        p[i] = static_cast<char>('0' + fraction % 10);
+        fraction /= 10;
+    }
+    return static_cast<int>(p - buf) + decimals;
+}
+
+int formatHex(char* buf, uintptr_t v)
+{
+    static const char kHexDigits[] = "0123456789abcdef";
+    char* p = buf;
+    *p++ = '0';
+    *p++ = 'x';
+    int n = v == 0 ? 1 : (sizeof(v) * 8 - __builtin_clzl(v) + 3) / 4;
+    for (int i = n - 1; i >= 0; --i)
+    {
+        p[i] = kHexDigits[v & 0xF];
+        v >>= 4;
+    }
+    return n + 2;
+}
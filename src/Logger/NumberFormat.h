@@ -0,0 +1,86 @@
+#pragma once
+
+#include <stdint.h>
+#include <type_traits>
+
+/**
+ * 日志和 HTTP 首部共用的数字格式化，直接写进调用方给的缓冲区，返回写了多少字节，不补 '\0'
+ *
+ *   char buf[kMaxNumericSize];
+ *   int n = formatInteger(buf, body.size());
+ *
+ * 整数先数出位数，再从后往前每次查表写两位，不需要反转；
+ * 浮点数用 Grisu2 生成能原样读回的最短数字，不经过 snprintf。
+ */
+
+// 任何一个函数最多写这么多字节
+const int kMaxNumericSize = 48;
+
+// "00" "01" ... "99"
+extern const char kDigitPairs[200];
+
+template <typename T>
+inline int countDigits(T v)
+{
+    int n = 1;
+    while (true)
+    {
+        // 每次判断四位，大部分数字一两次比较就能确定
+        if (v < 10) return n;
+        if (v < 100) return n + 1;
+        if (v < 1000) return n + 2;
+        if (v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+template <typename T>
+inline int formatUnsigned(char* buf, T v)
+{
+    const int n = countDigits(v);
+    char* p = buf + n;
+    while (v >= 100)
+    {
+        const unsigned i = static_cast<unsigned>(v % 100) * 2;
+        v /= 100;
+        *--p = kDigitPairs[i + 1];
+        *--p = kDigitPairs[i];
+    }
+    if (v < 10)
+    {
+        *--p = static_cast<char>('0' + v);
+    }
+    else
+    {
+        const unsigned i = static_cast<unsigned>(v) * 2;
+        *--p = kDigitPairs[i + 1];
+        *--p = kDigitPairs[i];
+    }
+    return n;
+}
+
+template <typename T>
+inline int formatInteger(char* buf, T v)
+{
+    using U = typename std::make_unsigned<T>::type;
+    U u = static_cast<U>(v);
+    if (std::is_signed<T>::value && v < 0)
+    {
+        *buf = '-';
+        // 先转成无符号再取反，最小的负数也不会溢出
+        return formatUnsigned(buf + 1, static_cast<U>(0 - u)) + 1;
+    }
+    return formatUnsigned(buf, u);
+}
+
+// 和 printf("%g") 一样的排版，但数字是能读回同一个 double 的最短形式：0.1 输出 "0.1"，1e21 输出 "1e+21"
+int formatDouble(char* buf, double v);
+// 按 float 的精度取最短，0.1f 输出 "0.1"
+int formatFloat(char* buf, float v);
+
+// value / 10^decimals，小数部分固定 decimals 位：formatFixed(buf, 1543, 3) 输出 "1.543"，适合写耗时
+int formatFixed(char* buf, int64_t value, int decimals);
+
+// 指针之类的值，带 "0x" 前缀
+int formatHex(char* buf, uintptr_t v);
@@ -0,0 +1,161 @@
+#include "BinaryLogging.h"
+#include "AsyncLogging.h"
+
+#include <assert.h>
+#include <glob.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+// 每种参数都经过 BinaryLogging::log 写成二进制日志文件，
+// 再分别用进程内登记的格式和文件里的格式串定义(encodeFormat)还原，两边的文本必须一样
+
+static const char* kBasename = "/tmp/binary_logging_test";
+
+static void removeLogs(std::vector<std::string>* files)
+{
+    glob_t g;
+    if (glob((std::string(kBasename) + ".*.log").c_str(), 0, nullptr, &g) == 0)
+    {
+        for (size_t i = 0; i < g.gl_pathc; ++i)
+        {
+            if (files)
+            {
+                files->push_back(g.gl_pathv[i]);
+            }
+            else
+            {
+                unlink(g.gl_pathv[i]);
+            }
+        }
+    }
+    globfree(&g);
+}
+
+static std::string readFile(const std::string& path)
+{
+    std::string data;
+    FILE* fp = fopen(path.c_str(), "rb");
+    assert(fp != nullptr);
+    char buf[65536];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        data.append(buf, n);
+    }
+    fclose(fp);
+    return data;
+}
+
+// 去掉时间、等级、函数名和源码位置，只留内容
+static std::string message(const std::string& line)
+{
+    size_t begin = line.find("] ");
+    assert(begin != std::string::npos);
+    begin = line.find(' ', begin + 2) + 1;
+    size_t end = line.rfind(" - ");
+    assert(end != std::string::npos && line.back() == '\n');
+    return line.substr(begin, end - begin);
+}
+
+static void writeLogs()
+{
+    int i = -42;
+    unsigned u = 42;
+    long long big = -9223372036854775807LL - 1;
+    unsigned long long ubig = 18446744073709551615ULL;
+    const void* p = reinterpret_cast<const void*>(0x1234abcd);
+    const char* cstr = "c-string";
+    std::string str("std-string");
+    std::string huge(10000, 'x');
+
+    LOG_INFO_BIN("int {} unsigned {} min {} max {}", i, u, big, ubig);
+    LOG_INFO_BIN("char {} bool {} short {}", 'z', true, static_cast<short>(-7));
+    LOG_INFO_BIN("double {} float {}", 1.5, 0.25f);
+    LOG_INFO_BIN("cstr {} str {} empty [{}]", cstr, str, "");
+    LOG_INFO_BIN("ptr {}", p);
+    LOG_INFO_BIN("missing {} {}", 1);
+    LOG_INFO_BIN("extra {}", 1, 2, "three");
+    LOG_INFO_BIN("no args");
+    LOG_INFO_BIN("huge {} tail {}", huge, 7);
+}
+
+int main()
+{
+    removeLogs(nullptr);
+    {
+        AsyncLogging log(kBasename, 64 * 1024 * 1024);
+        log.setBinaryOutput(true);
+        BinaryLogging::setSink(&log);
+        log.start();
+        writeLogs();
+        log.stop();
+        BinaryLogging::setSink(nullptr);
+    }
+
+    std::vector<std::string> files;
+    removeLogs(&files);
+    assert(files.size() == 1);
+    std::string data = readFile(files[0]);
+    unlink(files[0].c_str());
+
+    BinaryLogDecoder decoder;
+    int definitions = 0;
+    assert(BinaryLogDecoder::forEachRecord(data, [&](const LogRecordHeader& header, const char* record, size_t len) {
+        if (header.format == kLogFormatDefinition)
+        {
+            assert(decoder.addDefinition(record, len));
+            ++definitions;
+        }
+    }));
+    assert(definitions == static_cast<int>(BinaryLogging::formatCount()));
+
+    std::vector<std::string> messages;
+    BinaryLogDecoder::forEachRecord(data, [&](const LogRecordHeader& header, const char* record, size_t len) {
+        if (header.format == kLogFormatDefinition || header.format == kLogTextRecord)
+        {
+            return;
+        }
+        LogStream local;
+        LogStream decoded;
+        const LogFormat* format = BinaryLogging::format(header.format);
+        assert(format != nullptr && BinaryLogging::formatRecord(*format, record, len, local));
+        assert(decoder.decode(record, len, decoded));
+        std::string line(local.buffer().data(), local.buffer().length());
+        assert(line == std::string(decoded.buffer().data(), decoded.buffer().length()));
+        assert(line.find(" writeLogs ") != std::string::npos);
+        assert(line.find(" - binary_logging_test.cpp:") != std::string::npos);
+        messages.push_back(message(line));
+    });
+
+    assert(messages.size() == 9);
+    assert(messages[0] == "int -42 unsigned 42 min -9223372036854775808 max 18446744073709551615");
+    assert(messages[1] == "char z bool 1 short -7");
+    assert(messages[2] == "double 1.5 float 0.25");
+    assert(messages[3] == "cstr c-string str std-string empty []");
+    assert(messages[4] == "ptr 0x1234abcd");
+    // 占位符多了原样留下，参数多了接在后面
+    assert(messages[5] == "missing 1 {}");
+    assert(messages[6] == "extra 1 2 three");
+    assert(messages[7] == "no args");
+    // 放不下的字符串在记录里截断，后面的参数也放不下了，行尾的源码位置还在
+    const std::string& huge = messages[8];
+    assert(huge.compare(0, 5, "huge ") == 0);
+    size_t xs = huge.find_first_not_of('x', 5);
+    assert(xs != std::string::npos && xs - 5 > 3000);
+    assert(huge.substr(xs) == " tail {}");
+
+    // 还原不认识的格式
+    BinaryLogDecoder empty;
+    LogStream out;
+    BinaryLogDecoder::forEachRecord(data, [&](const LogRecordHeader& header, const char* record, size_t len) {
+        if (header.format != kLogFormatDefinition && header.format != kLogTextRecord)
+        {
+            assert(!empty.decode(record, len, out));
+        }
+    });
+
+    printf("binary logging test passed\n");
+    return 0;
+}
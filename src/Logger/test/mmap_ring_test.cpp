@@ -0,0 +1,173 @@
+#include "MmapLogRing.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <vector>
+
+static const char* kFile = "/tmp/mmap_ring_test.ring";
+static const size_t kCapacity = 2 * MmapLogRing::kMaxRecord;
+
+static uint64_t alignUp(uint64_t n)
+{
+    return (n + 7) & ~static_cast<uint64_t>(7);
+}
+
+// 和 tools/myweb-logring 一样把文件映射进来取出所有记录，返回跳过的字节数
+struct RingFile
+{
+    RingFile()
+    {
+        int fd = ::open(kFile, O_RDWR | O_CLOEXEC);
+        struct stat st;
+        assert(fd >= 0 && ::fstat(fd, &st) == 0);
+        size = static_cast<size_t>(st.st_size);
+        addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        ::close(fd);
+        assert(addr != MAP_FAILED);
+        header = static_cast<MmapLogRingHeader*>(addr);
+        data = static_cast<char*>(addr) + MmapLogRing::kHeaderSize;
+        assert(MmapLogRing::validHeader(*header, size));
+    }
+
+    ~RingFile() { ::munmap(addr, size); }
+
+    uint64_t read(std::vector<std::string>* records)
+    {
+        records->clear();
+        return MmapLogRing::forEachRecord(*header, data, [records](const char* record, size_t len) {
+            records->push_back(std::string(record, len));
+        });
+    }
+
+    void* addr;
+    size_t size;
+    MmapLogRingHeader* header;
+    char* data;
+};
+
+// 第 i 条记录的内容，长度不一，保证有记录跨过数据区的末尾
+static std::string makeRecord(int i)
+{
+    char prefix[32];
+    int n = snprintf(prefix, sizeof prefix, "record %d ", i);
+    std::string record(prefix, n);
+    record.append(1000 + i * 37 % 3001, static_cast<char>('a' + i % 26));
+    record.push_back('\n');
+    return record;
+}
+
+// 没有回绕：全部按顺序取出来
+static void testSimple()
+{
+    unlink(kFile);
+    MmapLogRing ring(kFile, kCapacity);
+    assert(ring.valid());
+    for (int i = 0; i < 100; ++i)
+    {
+        std::string record = makeRecord(i);
+        ring.append(record.data(), static_cast<int>(record.size()));
+    }
+    RingFile file;
+    std::vector<std::string> records;
+    assert(file.read(&records) == 0);
+    assert(records.size() == 100);
+    for (int i = 0; i < 100; ++i)
+    {
+        assert(records[i] == makeRecord(i));
+    }
+}
+
+// 写了三圈多：只剩最近 capacity 字节里完整的记录，最旧的那条被覆盖了一半，跳过的正好是它剩下的部分
+static void testWrapAround()
+{
+    unlink(kFile);
+    MmapLogRing ring(kFile, kCapacity);
+    std::vector<uint64_t> positions;
+    uint64_t end = 0;
+    int count = 0;
+    while (end < 3 * kCapacity + kCapacity / 3)
+    {
+        std::string record = makeRecord(count++);
+        ring.append(record.data(), static_cast<int>(record.size()));
+        positions.push_back(end);
+        end += alignUp(8 + record.size());
+    }
+
+    RingFile file;
+    assert(file.header->capacity == kCapacity && file.header->writeOffset.load() == end);
+    uint64_t start = alignUp(end - kCapacity);
+    int first = 0;
+    while (positions[first] < start)
+    {
+        ++first;
+    }
+    assert(positions[first] > start);   // 最旧的一条确实只剩一半
+
+    std::vector<std::string> records;
+    uint64_t skipped = file.read(&records);
+    assert(skipped == positions[first] - start);
+    assert(static_cast<int>(records.size()) == count - first);
+    bool wrapped = false;
+    for (size_t i = 0; i < records.size(); ++i)
+    {
+        int id = first + static_cast<int>(i);
+        assert(records[i] == makeRecord(id));
+        if ((positions[id] + 8) % kCapacity + records[i].size() > kCapacity)
+        {
+            wrapped = true;
+        }
+    }
+    assert(wrapped);
+}
+
+// 占了位置还没写头就崩溃的记录被跳过；重新打开同样容量的文件接着写，容量不同就重新创建
+static void testTornAndReopen()
+{
+    unlink(kFile);
+    std::string before = makeRecord(1);
+    std::string after = makeRecord(2);
+    {
+        MmapLogRing ring(kFile, kCapacity);
+        ring.append(before.data(), static_cast<int>(before.size()));
+    }
+    uint64_t torn = alignUp(8 + 500);
+    {
+        // 模拟写的一方 fetch_add 之后、写头之前被杀掉：只有数据没有头
+        RingFile file;
+        uint64_t pos = file.header->writeOffset.fetch_add(torn);
+        memset(file.data + pos % kCapacity + 8, 'z', 500);
+    }
+    {
+        MmapLogRing ring(kFile, kCapacity);
+        ring.append(after.data(), static_cast<int>(after.size()));
+    }
+    {
+        RingFile file;
+        std::vector<std::string> records;
+        assert(file.read(&records) == torn);
+        assert(records.size() == 2 && records[0] == before && records[1] == after);
+    }
+    {
+        MmapLogRing ring(kFile, kCapacity * 2);
+        RingFile file;
+        std::vector<std::string> records;
+        assert(file.header->writeOffset.load() == 0);
+        assert(file.read(&records) == 0 && records.empty());
+    }
+}
+
+int main()
+{
+    testSimple();
+    testWrapAround();
+    testTornAndReopen();
+    unlink(kFile);
+    printf("mmap ring test passed\n");
+    return 0;
+}
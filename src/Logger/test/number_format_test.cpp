@@ -0,0 +1,197 @@
+#include "NumberFormat.h"
+
+#include <assert.h>
+#include <float.h>
+#include <inttypes.h>
+#include <limits.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <random>
+#include <string>
+
+static const int kRandomCount = 1000000;
+
+template <typename T>
+static std::string integer(T v)
+{
+    char buf[kMaxNumericSize];
+    return std::string(buf, formatInteger(buf, v));
+}
+
+static std::string dbl(double v)
+{
+    char buf[kMaxNumericSize];
+    return std::string(buf, formatDouble(buf, v));
+}
+
+static std::string flt(float v)
+{
+    char buf[kMaxNumericSize];
+    return std::string(buf, formatFloat(buf, v));
+}
+
+static std::string fixed(int64_t value, int decimals)
+{
+    char buf[kMaxNumericSize];
+    return std::string(buf, formatFixed(buf, value, decimals));
+}
+
+static std::string hex(uintptr_t v)
+{
+    char buf[kMaxNumericSize];
+    return std::string(buf, formatHex(buf, v));
+}
+
+static std::string printed(const char* fmt, ...) __attribute__((format(printf, 1, 2)));
+static std::string printed(const char* fmt, ...)
+{
+    char buf[64];
+    va_list args;
+    va_start(args, fmt);
+    int n = vsnprintf(buf, sizeof buf, fmt, args);
+    va_end(args);
+    return std::string(buf, n);
+}
+
+static void testInteger()
+{
+    assert(integer(0) == "0");
+    assert(integer(INT64_MIN) == "-9223372036854775808");
+    assert(integer(INT64_MAX) == "9223372036854775807");
+    assert(integer(UINT64_MAX) == "18446744073709551615");
+    assert(integer(INT_MIN) == "-2147483648");
+    assert(integer(static_cast<short>(-32768)) == "-32768");
+    assert(integer(static_cast<signed char>(-128)) == "-128");
+    assert(integer(static_cast<unsigned char>(255)) == "255");
+
+    // 位数变化的边界：10^n - 1、10^n、10^n + 1
+    uint64_t p = 1;
+    for (int i = 0; i < 20; ++i)
+    {
+        for (uint64_t v : {p - 1, p, p + 1})
+        {
+            assert(integer(v) == printed("%" PRIu64, v));
+            int64_t s = static_cast<int64_t>(v);
+            assert(integer(s) == printed("%" PRId64, s));
+            assert(integer(-s) == printed("%" PRId64, -s));
+        }
+        p *= 10;
+    }
+
+    std::mt19937_64 rng(1);
+    for (int i = 0; i < kRandomCount; ++i)
+    {
+        uint64_t v = rng() >> (rng() % 64);
+        assert(integer(v) == printed("%" PRIu64, v));
+        int64_t s = static_cast<int64_t>(rng());
+        assert(integer(s) == printed("%" PRId64, s));
+    }
+}
+
+static void testDouble()
+{
+    assert(dbl(0.0) == "0");
+    assert(dbl(-0.0) == "-0");
+    assert(dbl(0.1) == "0.1");
+    assert(dbl(-1.5) == "-1.5");
+    assert(dbl(123456.0) == "123456");
+    assert(dbl(1e16) == "10000000000000000");
+    assert(dbl(1e17) == "1e+17");
+    assert(dbl(1e21) == "1e+21");
+    assert(dbl(0.0001) == "0.0001");
+    assert(dbl(0.00001) == "1e-05");
+    assert(dbl(1.0 / 3) == "0.3333333333333333");
+    assert(dbl(DBL_MAX) == "1.7976931348623157e+308");
+    assert(dbl(DBL_MIN) == "2.2250738585072014e-308");
+    assert(dbl(5e-324) == "5e-324");                    // 最小的非规格化数
+    assert(dbl(2.225073858507201e-308) == "2.225073858507201e-308");  // 最大的非规格化数
+    assert(dbl(HUGE_VAL) == "inf");
+    assert(dbl(-HUGE_VAL) == "-inf");
+    assert(dbl(NAN) == "nan");
+    assert(dbl(-NAN) == "nan");
+
+    // 随机的位模式覆盖所有指数，读回来必须是同一个 double
+    std::mt19937_64 rng(2);
+    for (int i = 0; i < kRandomCount; ++i)
+    {
+        uint64_t bits = rng();
+        double v;
+        memcpy(&v, &bits, sizeof v);
+        if (v != v)
+        {
+            continue;
+        }
+        std::string s = dbl(v);
+        assert(s.size() <= 24);
+        double back = strtod(s.c_str(), nullptr);
+        assert(memcmp(&back, &v, sizeof v) == 0);
+    }
+}
+
+static void testFloat()
+{
+    assert(flt(0.0f) == "0");
+    assert(flt(-0.0f) == "-0");
+    assert(flt(0.1f) == "0.1");
+    assert(flt(0.25f) == "0.25");
+    assert(flt(16777216.0f) == "16777216");
+    assert(flt(FLT_MAX) == "3.4028235e+38");
+    assert(flt(FLT_MIN) == "1.1754944e-38");
+    assert(flt(1e-45f) == "1e-45");                      // 最小的非规格化数
+    assert(flt(HUGE_VALF) == "inf");
+    assert(flt(-HUGE_VALF) == "-inf");
+    assert(flt(NAN) == "nan");
+
+    std::mt19937 rng(3);
+    for (int i = 0; i < kRandomCount; ++i)
+    {
+        uint32_t bits = static_cast<uint32_t>(rng());
+        float v;
+        memcpy(&v, &bits, sizeof v);
+        if (v != v)
+        {
+            continue;
+        }
+        std::string s = flt(v);
+        float back = strtof(s.c_str(), nullptr);
+        assert(memcmp(&back, &v, sizeof v) == 0);
+    }
+}
+
+static void testFixed()
+{
+    assert(fixed(1543, 3) == "1.543");
+    assert(fixed(-1543, 3) == "-1.543");
+    assert(fixed(5, 3) == "0.005");
+    assert(fixed(-5, 3) == "-0.005");
+    assert(fixed(0, 3) == "0.000");
+    assert(fixed(42, 0) == "42");
+    assert(fixed(-42, 0) == "-42");
+    assert(fixed(-42, -1) == "-42");
+    assert(fixed(INT64_MIN, 3) == "-9223372036854775.808");
+    assert(fixed(INT64_MAX, 19) == "0.9223372036854775807");
+    assert(fixed(INT64_MIN, 25) == "-0.9223372036854775808");   // 超过 19 位按 19 位
+}
+
+static void testHex()
+{
+    assert(hex(0) == "0x0");
+    assert(hex(0xf) == "0xf");
+    assert(hex(0x10) == "0x10");
+    assert(hex(0x1234abcd) == "0x1234abcd");
+    assert(hex(UINTPTR_MAX) == printed("0x%" PRIxPTR, UINTPTR_MAX));
+}
+
+int main()
+{
+    testInteger();
+    testDouble();
+    testFloat();
+    testFixed();
+    testHex();
+    printf("number format test passed\n");
+    return 0;
+}
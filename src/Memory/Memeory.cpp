@@ -1,23 +1,68 @@
-
 #include "Memory.h"
 
+#include <mutex>
+#include <vector>
 
-Memory *Memory::getInstance(){
-    if(!memory){
-        memory=new Memory();
+namespace {
+
+std::mutex g_idleMutex;
+std::vector<MemoryPool *> g_idlePools; // 线程退出后留下来的内存池
+
+// 线程退出时把内存池交出去，别的线程拿到的对象还要还给它，所以不销毁
+struct LocalPool {
+    MemoryPool *pool = nullptr;
+    ~LocalPool(){
+        if(pool){
+            std::lock_guard<std::mutex> locker(g_idleMutex);
+            g_idlePools.push_back(pool);
+        }
     }
-    return memory;
+};
+
+thread_local LocalPool t_localPool;
+
+} // namespace
+
+Memory *Memory::getInstance(){
+    static Memory memory;
+    return &memory;
 }
 
 Memory::Memory(){
-    pool_.createPool();
 }
 
 Memory::~Memory(){
-    pool_.destroyPool();
+}
+
+MemoryPool *Memory::localPool(){
+    MemoryPool *pool = t_localPool.pool;
+    if(pool){
+        return pool;
+    }
+    {
+        std::lock_guard<std::mutex> locker(g_idleMutex);
+        if(!g_idlePools.empty()){
+            pool = g_idlePools.back();
+            g_idlePools.pop_back();
+        }
+    }
+    if(!pool){
+        pool = new MemoryPool();
+        pool->createPool();
+    }
+    t_localPool.pool = pool;
+    return pool;
+}
+
+void Memory::freeMemory(void *p){
+    MemoryPool *owner = MemoryPool::ownerOf(p);
+    if(owner == t_localPool.pool){
+        owner->freeMemory(p);
+    }else{
+        owner->remoteFree(p);
+    }
 }
 
 void Memory::resetPool(){
-    std::lock_guard<std::shared_mutex> locker(poolMutex_);
-    pool_.resetPool();
-}
\ No newline at end of file
+    localPool()->resetPool();
+}
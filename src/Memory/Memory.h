@@ -2,8 +2,6 @@
 
 #include <iostream>
 #include "MemoryPool.h"
-#include <unordered_set>
-#include <shared_mutex>
 #define PAGE_SIZE 4096
 
 
@@ -35,72 +33,41 @@ public:
 };
 
 
+/**
+ * 内存池的对外接口，每个线程(也就是每个 EventLoop)有自己的 MemoryPool，申请时不加锁
+ * 对象可以交给别的线程释放：deallocate 发现不是本线程的内存池分配的，就挂回拥有者的无锁链表，
+ * 由拥有者下次申请时收回。线程退出后它的内存池留给之后新建的线程接着用，还没释放的对象照常可以释放。
+ */
 class Memory {
 public:
     Memory();
     ~Memory();
-        
 
-    Memory *getInstance();
+    static Memory *getInstance();
+    // 重置当前线程的内存池，这个线程分配出去的内存全部作废，包括已经交给别的线程的
     void resetPool();
-    //我这样分配会使得内存给保护字节分配位置。
-    // 分配内存，添加前后保护字节 这个只能在.h中否则一定要在cpp中实例化
+
+    // 分配 size 个 T，返回的 MemoryView 带越界检查
     template <typename T>
     MemoryView<T> allocate(size_t size=1){
-        std::lock_guard<std::shared_mutex> locker(poolMutex_);
-        size_t totalSize = size*sizeof(T); // 计算总分配大小，包含前后保护字节
-        char* ptr = (char*)pool_.malloc(totalSize);     // 分配内存
+        size_t totalSize = size*sizeof(T);
+        char* ptr = (char*)localPool()->malloc(totalSize);     // 分配内存
         if (!ptr) return MemoryView<T>(nullptr, 0);                // 分配失败返回空指针
-        return MemoryView<T>((T*)(ptr), size); // 返回用户可用内地址，跳过前保护字节 强转
+        return MemoryView<T>((T*)(ptr), size);
     }
 
-    // 释放内存，并检查是否越界访问  这个只能在.h中否则一定要在cpp中实例化
-    // 这个可能要设计成，大块内存就到获取锁的队列，而小块内存优先级更高，因为它不归还给操作系统，所以我们可以直接先释放。
+    // 释放内存，可以在任意线程调用，之后 memView 被清空
     template<typename T>
     void deallocate(MemoryView<T>& memView) {
-        std::unique_lock<std::shared_mutex> locker(poolMutex_);
         if (!memView.getBasePtr()) return;
         T* basePtr = memView.getBasePtr();
-        int count=memView.count;
         memView.count=0;
         memView.basePtr=nullptr; //将这个对象进行清空
-        if(count*sizeof(T)<PAGE_SIZE){
-            // 小块内存独占锁不释放，因为这个涉及到里边的一个hash表的修改
-            pool_.freeMemory((void *)basePtr); // 释放完整内存块
-        }else {
-            locker.unlock(); 
-            bool insertBool = false;
-            {
-                std::lock_guard<std::mutex> locker1(largeSetMutex_); 
-                insertBool = largeDeal_.insert((void *)basePtr).second; //用来保存插入成功还是失败
-            }
-            if(insertBool){    //如果是第一次对这个节点进行  
-                /*
-                下边的释放后再获取共享锁，这个我是有一个想法的（假设u代表独占锁，s代表共享锁） ，
-                如果A：u，B: 等待释放，C: 申请地址。   
-                    1. A由u到unlock时，这个瞬间B获得了锁，如果释放的地址是小块的，此时锁不释放直接freeMemory，
-                                                        如果地址是大块的，1 地址相同，则不会insert成功，return
-                                                                        2  地址不同，插入成功，释放独占锁，如果它能获取共享锁，
-                                                                            则A肯定也可以获取，它俩删除的内存不一样，不会有问题。
-                    2. A由u到unlock时，这个瞬间C获得了锁，C去申请地址，这个不会影响到这个largeDeal_
-                */
-                std::shared_lock<std::shared_mutex> locker(poolMutex_); //加上共享锁
-                pool_.freeMemory((void *)basePtr); // 释放完整内存块
-                //给删除的这个加上一个额外的锁，只在这一个位置使用。这个锁不会影响到别的，也不会被卡住。
-                std::lock_guard<std::mutex> locker1(largeSetMutex_); 
-                largeDeal_.erase((void *)basePtr); // 删除largeDeal_中刚刚的元素，表明删除结束。
-            }
-        }
+        freeMemory((void *)basePtr);
     }
 
 private:
-    Memory *memory;
-    MemoryPool pool_; //内存池模块
-    std::shared_mutex poolMutex_;
-    std::mutex largeSetMutex_;
-    std::unordered_set<void *> largeDeal_; //保存此时正在删除的大块内存的首地址
+    // 当前线程的内存池，第一次调用时创建或者接手一个退出的线程留下的
+    static MemoryPool *localPool();
+    static void freeMemory(void *p);
 };
-
-
-
-
@@ -1,146 +1,226 @@
 #include "MemoryPool.h"
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
 #include <string.h>
+#include <sys/mman.h>
+#include <atomic>
 
-void MemoryPool::createPool()
+namespace
 {
-    // if (size < PAGE_SIZE || size % PAGE_SIZE != 0)
-    // {
-    //     size = PAGE_SIZE;
-    // }
-
-    /**
-     * int posix_memalign (void **memptr, size_t alignment, size_t size);
-     * posix_memalign分配的内存块更大，malloc可能分配不了太大的内存块
-     * 内部要让这个p指针指向新的内存，所以需要使用二级指针。如果只是返回一个指针，可以使
-     */
-    int ret = posix_memalign((void **)&pool_, MP_ALIGNMENT, PAGE_SIZE);
-    if (ret) 
-    {
-        printf("posix_memalign failed\n");
-        return;
+
+// slab 头占用的空间，对象从这之后开始切
+const size_t kSlabHeader = mp_align(sizeof(SmallNode), MP_ALIGNMENT);
+// 大块前面的头，保证返回的地址仍然 16 字节对齐
+const size_t kLargeHeader = mp_align(sizeof(LargeNode), MP_ALIGNMENT);
+
+/**
+ * 记录哪些 64KB 窗口是 slab，所有内存池共用
+ * 地址右移 16 位之后，高 16 位查根数组，低 16 位查叶子里的一个字节，覆盖 48 位的用户地址空间
+ * 叶子第一次用到时才映射，之后不再释放；只在 slab 映射和归还时写，查的时候不加锁
+ */
+class SlabMap
+{
+public:
+    static bool contains(const void* p)
+    {
+        uintptr_t n = (uintptr_t)p >> kSlabShift;
+        unsigned char* leaf = root_[(n >> kLeafBits) & kRootMask].load(std::memory_order_acquire);
+        return leaf != nullptr && leaf[n & kLeafMask] != 0;
     }
 
-    // 分配 PAGE_SIZE 内存：Pool + SmallNode + 剩余可用内存
-    pool_->largeList_ = nullptr;
-    pool_->head_ = (SmallNode *)((unsigned char*)pool_ + sizeof(Pool));
-    pool_->head_->last_ = (unsigned char*)pool_ + sizeof(Pool) + sizeof(SmallNode);
-    pool_->head_->end_ = (unsigned char*)pool_ + PAGE_SIZE;
-    pool_->head_->failed_ = 0;
-    pool_->current_ = pool_->head_;
+    static bool set(const void* slab, bool isSlab)
+    {
+        uintptr_t n = (uintptr_t)slab >> kSlabShift;
+        std::atomic<unsigned char*>& entry = root_[(n >> kLeafBits) & kRootMask];
+        unsigned char* leaf = entry.load(std::memory_order_acquire);
+        if (leaf == nullptr)
+        {
+            void* map = mmap(nullptr, kLeafSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (map == MAP_FAILED)
+            {
+                return false;
+            }
+            // 别的线程先建好了就用它的
+            if (!entry.compare_exchange_strong(leaf, (unsigned char*)map, std::memory_order_acq_rel))
+            {
+                munmap(map, kLeafSize);
+            }
+            else
+            {
+                leaf = (unsigned char*)map;
+            }
+        }
+        leaf[n & kLeafMask] = isSlab ? 1 : 0;
+        return true;
+    }
+
+private:
+    static const int kSlabShift = 16;
+    static const int kLeafBits = 16;
+    static const size_t kLeafSize = (size_t)1 << kLeafBits;
+    static const uintptr_t kLeafMask = kLeafSize - 1;
+    static const uintptr_t kRootMask = ((uintptr_t)1 << 16) - 1;
 
-    return;
+    static std::atomic<unsigned char*> root_[1 << 16];
+};
+
+static_assert(MP_SLAB_SIZE == 1 << 16, "SlabMap assumes 64KB slabs");
+
+std::atomic<unsigned char*> SlabMap::root_[1 << 16];
+
+inline SmallNode* slabOf(void* p)
+{
+    return (SmallNode*)((uintptr_t)p & ~(uintptr_t)(MP_SLAB_SIZE - 1));
 }
 
-void MemoryPool::destroyPool()
+// 双向链表的头插和摘除，每个 slab 同一时间只在 partial_ 或 full_ 里的一个链表上
+inline void pushSlab(SmallNode** list, SmallNode* slab)
 {
-    LargeNode* large = pool_->largeList_;
-    while (large != nullptr)
+    slab->prev_ = nullptr;
+    slab->next_ = *list;
+    if (*list != nullptr)
     {
-        if (large->address_ != nullptr)
-        {
-            free(large->address_);
-            large->address_ = nullptr;
-        }
-        large = large->next_;
+        (*list)->prev_ = slab;
     }
+    *list = slab;
+}
 
-    SmallNode* cur = pool_->head_->next_;
-    SmallNode* next = nullptr;
-    while (cur != nullptr)
+inline void unlinkSlab(SmallNode** list, SmallNode* slab)
+{
+    if (slab->prev_ != nullptr)
     {
-        next = cur->next_;
-        free(cur);
-        cur = cur->next_;
+        slab->prev_->next_ = slab->next_;
     }
-    // TODO:有错误
-    free(pool_);
+    else
+    {
+        *list = slab->next_;
+    }
+    if (slab->next_ != nullptr)
+    {
+        slab->next_->prev_ = slab->prev_;
+    }
+    slab->prev_ = nullptr;
+    slab->next_ = nullptr;
 }
 
-// 分配大块内存
-void* MemoryPool::mallocLargeNode(unsigned long size)
+} // namespace
+
+void MemoryPool::createPool()
 {
-    unsigned char* addr;
-    int ret = posix_memalign((void**)&addr, MP_ALIGNMENT, size);
-    if (ret)
+    pool_ = (Pool*)::calloc(1, sizeof(Pool));
+    if (pool_ == nullptr)
     {
-        return nullptr;
+        printf("calloc pool failed\n");
+        return;
     }
 
-    int count = 0;
-    LargeNode* largeNode = pool_->largeList_;
-    while (largeNode != nullptr)
+    // 16 字节一档到 128，之后每翻一倍分四档，规格内部浪费不超过 20%
+    unsigned int n = 0;
+    for (unsigned int size = MP_ALIGNMENT; size <= 128; size += MP_ALIGNMENT)
+    {
+        pool_->classSize_[n++] = size;
+    }
+    for (unsigned int base = 128; base < MP_MAX_SMALL; base *= 2)
     {
-        if (largeNode->address_ == nullptr)
+        for (unsigned int step = 1; step <= 4; ++step)
         {
-            largeNode->size_ = size;
-            largeNode->address_ = addr;
-            return addr;
+            pool_->classSize_[n++] = base + base / 4 * step;
         }
-        if (count++ > 3)
+    }
+
+    unsigned int sizeClass = 0;
+    for (unsigned int i = 0; i <= MP_MAX_SMALL / MP_ALIGNMENT; ++i)
+    {
+        while (pool_->classSize_[sizeClass] < i * MP_ALIGNMENT)
         {
-            // 为了避免过多的遍历，限制次数
-            break;
+            ++sizeClass;
         }
-        largeNode = largeNode->next_;
+        pool_->classIndex_[i] = (unsigned char)sizeClass;
     }
+}
 
-    // 没有找到空闲的large结构体，分配一个新的large
-    // 比如第一次分配large的时候
-    largeNode = (LargeNode*)this->malloc(sizeof(LargeNode));
-    if (largeNode == nullptr)
+void MemoryPool::destroyPool()
+{
+    if (pool_ == nullptr)
     {
-        free(addr); // 申请节点内存失败，需要释放之前申请的大内存
-        return nullptr;
+        return;
     }
-
-    largeNode->size_ = size;    // 设置新块大小
-    largeNode->address_ = addr; // 设置新块地址
-    // 下面用头插法方式将新块加入到 largeList 的头部
-    largeNode->next_ = pool_->largeList_; 
-    pool_->largeList_ = largeNode;
-    return addr;
+    resetPool();
+    free(pool_);
+    pool_ = nullptr;
 }
 
-// 分配小块内存
-void* MemoryPool::mallocSmallNode(unsigned long size)
+// 分配大块内存
+void* MemoryPool::mallocLargeNode(unsigned long size)
 {
     unsigned char* block;
-    int ret = posix_memalign((void**)&block, MP_ALIGNMENT, PAGE_SIZE);
+    int ret = posix_memalign((void**)&block, MP_ALIGNMENT, kLargeHeader + size);
     if (ret)
     {
         return nullptr;
     }
 
-    // 获取新块的 smallnode 节点
-    SmallNode* smallNode = (SmallNode*)block;
-    smallNode->end_ = block + PAGE_SIZE;
-    smallNode->next_ = nullptr;
+    // 头插到 largeList 里，释放时直接摘掉
+    LargeNode* largeNode = (LargeNode*)block;
+    largeNode->size_ = size;
+    largeNode->owner_ = this;
+    largeNode->prev_ = nullptr;
+    largeNode->next_ = pool_->largeList_;
+    if (pool_->largeList_ != nullptr)
+    {
+        pool_->largeList_->prev_ = largeNode;
+    }
+    pool_->largeList_ = largeNode;
+    return block + kLargeHeader;
+}
 
-    // 分配新块的起始位置
-    unsigned char* addr = (unsigned char*)mp_align_ptr(block + sizeof(SmallNode), MP_ALIGNMENT);
-    smallNode->last_ = addr + size;
-    smallNode->quote_++;
+// 分配新的 slab
+SmallNode* MemoryPool::mallocSmallNode(unsigned int sizeClass)
+{
+    // 多映射一个 slab 的大小，把首尾不对齐的部分还回去，剩下的正好按 MP_SLAB_SIZE 对齐
+    size_t mapSize = MP_SLAB_SIZE * 2;
+    void* map = mmap(nullptr, mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+    {
+        return nullptr;
+    }
+    uintptr_t begin = (uintptr_t)map;
+    uintptr_t aligned = (begin + MP_SLAB_SIZE - 1) & ~(uintptr_t)(MP_SLAB_SIZE - 1);
+    if (aligned > begin)
+    {
+        munmap(map, aligned - begin);
+    }
+    if (begin + mapSize > aligned + MP_SLAB_SIZE)
+    {
+        munmap((void*)(aligned + MP_SLAB_SIZE), begin + mapSize - aligned - MP_SLAB_SIZE);
+    }
 
-    // 重新设置current
-    SmallNode* current = pool_->current_;
-    SmallNode* cur = current;
-    while (cur->next_ != nullptr)
+    SmallNode* slab = (SmallNode*)aligned;
+    if (!SlabMap::set(slab, true))
     {
-        // 失效 block 数量过大，我们直接跳过这些 block，减少遍历次数
-        // 超过五个不能用的块，我们再更新current指针
-        if (cur->failed_ >= 5)
-        {
-            current = cur->next_;
-        }
-        cur->failed_++;
-        cur = cur->next_;
+        munmap(slab, MP_SLAB_SIZE);
+        return nullptr;
     }
-    // now cur = last node
-    cur->next_ = smallNode;
-    pool_->current_ = current;
-    return addr;
+    unsigned int size = pool_->classSize_[sizeClass];
+    slab->end_ = (unsigned char*)slab + MP_SLAB_SIZE;
+    slab->last_ = (unsigned char*)slab + kSlabHeader;
+    slab->freeList_ = nullptr;
+    slab->quote_ = 0;
+    slab->capacity_ = (unsigned int)((MP_SLAB_SIZE - kSlabHeader) / size);
+    slab->size_ = size;
+    slab->class_ = sizeClass;
+    slab->owner_ = this;
+    pushSlab(&pool_->partial_[sizeClass], slab);
+    pool_->slabs_++;
+    return slab;
+}
+
+void MemoryPool::freeSmallNode(SmallNode* slab)
+{
+    SlabMap::set(slab, false);
+    munmap(slab, MP_SLAB_SIZE);
+    pool_->slabs_--;
 }
 
 void* MemoryPool::malloc(unsigned long size)
@@ -150,33 +230,52 @@ void* MemoryPool::malloc(unsigned long size)
         return nullptr;
     }
 
+    // 先收回别的线程还回来的对象，没有的时候只是一次读
+    if (remoteFree_.load(std::memory_order_relaxed) != nullptr)
+    {
+        drainRemoteFree();
+    }
+
     // 申请大块内存
-    if (size > PAGE_SIZE - sizeof(SmallNode))
+    if (size > MP_MAX_SMALL)
     {
         return mallocLargeNode(size);
     }
 
-    // 申请小块内存
-    unsigned char* addr = nullptr;
-    SmallNode* cur = pool_->current_;
-    while (cur) 
+    // 申请小块内存，从这个规格第一个有空位的 slab 里取
+    unsigned int sizeClass = pool_->classIndex_[(size + MP_ALIGNMENT - 1) / MP_ALIGNMENT];
+    SmallNode* slab = pool_->partial_[sizeClass];
+    if (slab == nullptr)
     {
-        // 将cur->last指向处，格式化成16整数倍
-        // 比如 15->16 31->32
-        addr = (unsigned char*)mp_align_ptr(cur->last_, MP_ALIGNMENT);
-        // 「当前 block 结尾 - 初始地址」 >= 「申请地址」
-        // 说明该 block 剩余位置足够分配
-        if (cur->end_ - addr >= size)
+        slab = mallocSmallNode(sizeClass);
+        if (slab == nullptr)
         {
-            cur->quote_++; // 该 block 被引用次数增加
-            cur->last_ = addr + size; // 更新已使用位置
-            return addr;
+            return nullptr;
         }
-        // 此block不够用，去下一个block
-        cur = cur->next_;
     }
-    // 说明已有的 block 都不够用，需要创建新的 block
-    return mallocSmallNode(size);
+
+    void* addr = slab->freeList_;
+    if (addr != nullptr)
+    {
+        slab->freeList_ = *(void**)addr;
+    }
+    else
+    {
+        // 空闲链表用完了，从没切过的部分再切一个
+        addr = slab->last_;
+        slab->last_ += slab->size_;
+    }
+
+    if (slab->quote_++ == 0 && pool_->empty_[sizeClass] == slab)
+    {
+        pool_->empty_[sizeClass] = nullptr;
+    }
+    if (slab->quote_ == slab->capacity_)
+    {
+        unlinkSlab(&pool_->partial_[sizeClass], slab);
+        pushSlab(&pool_->full_[sizeClass], slab);
+    }
+    return addr;
 }
 
 
@@ -192,69 +291,127 @@ void* MemoryPool::calloc(unsigned long size)
 
 void MemoryPool::freeMemory(void* p)
 {
-    LargeNode* large = pool_->largeList_;
-    while (large != nullptr)
+    if (p == nullptr)
+    {
+        return;
+    }
+
+    if (!SlabMap::contains(p))
     {
-        if (large->address_ == p)
+        // 不在任何 slab 里就是大块，头就在前面
+        LargeNode* large = (LargeNode*)((unsigned char*)p - kLargeHeader);
+        if (large->prev_ != nullptr)
         {
-            free(large->address_);
-            large->size_ = 0;
-            large->address_ = nullptr;
-            return;
+            large->prev_->next_ = large->next_;
         }
-        large = large->next_;
+        else
+        {
+            pool_->largeList_ = large->next_;
+        }
+        if (large->next_ != nullptr)
+        {
+            large->next_->prev_ = large->prev_;
+        }
+        free(large);
+        return;
+    }
+
+    // 地址取整就是所在的 slab
+    SmallNode* slab = slabOf(p);
+    unsigned int sizeClass = slab->class_;
+    *(void**)p = slab->freeList_;
+    slab->freeList_ = p;
+
+    if (slab->quote_-- == slab->capacity_)
+    {
+        // 原来是满的，挂回有空位的链表，下次申请优先用它
+        unlinkSlab(&pool_->full_[sizeClass], slab);
+        pushSlab(&pool_->partial_[sizeClass], slab);
+    }
+    else if (slab != pool_->partial_[sizeClass])
+    {
+        // 刚释放过的 slab 挪到前面，申请集中在少数几个 slab 上，其余的更容易整个空出来
+        unlinkSlab(&pool_->partial_[sizeClass], slab);
+        pushSlab(&pool_->partial_[sizeClass], slab);
     }
 
-    SmallNode* small = pool_->head_;
-    while (small != nullptr)
+    if (slab->quote_ == 0)
     {
-        if ((unsigned char*)small <= (unsigned char*)p &&
-            (unsigned char *) p <= (unsigned char *)small->end_)
+        // 整个 slab 都空了，这个规格已经留了一个空 slab 的话就还给系统
+        if (pool_->empty_[sizeClass] == nullptr)
         {
-            small->quote_--;
-            // 引用计数为0才释放
-            if (small->quote_ == 0)
-            {
-                if (small == pool_->head_)
-                {
-                    pool_->head_->last_ = (unsigned char *)pool_ + sizeof(Pool) + sizeof(SmallNode);
-                }
-                else
-                {
-                    // last指针回到node节点尾处
-                    small->last_ = (unsigned char *)small + sizeof(SmallNode);
-                }
-                small->failed_ = 0;
-                pool_->current_ = pool_->head_;
-            }
-            return;
+            pool_->empty_[sizeClass] = slab;
         }
-        small = small->next_;
+        else
+        {
+            unlinkSlab(&pool_->partial_[sizeClass], slab);
+            freeSmallNode(slab);
+        }
+    }
+}
+
+void MemoryPool::remoteFree(void* p)
+{
+    if (p == nullptr)
+    {
+        return;
     }
+    // 只有拥有者一次取走整个链表，不会有 ABA
+    void* head = remoteFree_.load(std::memory_order_relaxed);
+    do
+    {
+        *(void**)p = head;
+    } while (!remoteFree_.compare_exchange_weak(head, p, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void MemoryPool::drainRemoteFree()
+{
+    void* p = remoteFree_.exchange(nullptr, std::memory_order_acquire);
+    while (p != nullptr)
+    {
+        void* next = *(void**)p;
+        freeMemory(p);
+        p = next;
+    }
+}
+
+MemoryPool* MemoryPool::ownerOf(void* p)
+{
+    if (SlabMap::contains(p))
+    {
+        return slabOf(p)->owner_;
+    }
+    return ((LargeNode*)((unsigned char*)p - kLargeHeader))->owner_;
 }
 
 void MemoryPool::resetPool()
 {
-    SmallNode* small = pool_->head_;
-    LargeNode* large = pool_->largeList_;
+    // 还没收回的对象马上就随 slab 和大块一起释放了
+    remoteFree_.store(nullptr, std::memory_order_relaxed);
 
+    LargeNode* large = pool_->largeList_;
     while (large != nullptr)
     {
-        if (large->address_)
-        {
-            free(large->address_);
-        }
-        large = large->next_;
+        LargeNode* next = large->next_;
+        free(large);
+        large = next;
     }
-
     pool_->largeList_ = nullptr;
-    pool_->current_ = pool_->head_;
-    while (small != nullptr)
+
+    for (int i = 0; i < MP_SIZE_CLASSES; ++i)
     {
-        small->last_ = (unsigned char*)small + sizeof(SmallNode);
-        small->failed_ = 0;
-        small->quote_ = 0;
-        small = small->next_;
+        SmallNode* lists[2] = {pool_->partial_[i], pool_->full_[i]};
+        for (SmallNode* slab : lists)
+        {
+            while (slab != nullptr)
+            {
+                SmallNode* next = slab->next_;
+                freeSmallNode(slab);
+                slab = next;
+            }
+        }
+        pool_->partial_[i] = nullptr;
+        pool_->full_[i] = nullptr;
+        pool_->empty_[i] = nullptr;
     }
 }
-
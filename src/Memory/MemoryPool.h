@@ -1,34 +1,73 @@
 #pragma once
 
+#include <stddef.h>
+#include <atomic>
 
 #define PAGE_SIZE 4096
 #define MP_ALIGNMENT 16
 #define mp_align(n, alignment) (((n)+(alignment-1)) & ~(alignment-1))
 #define mp_align_ptr(p, alignment) (void *)((((size_t)p)+(alignment-1)) & ~(alignment-1))
 
+#define MP_SLAB_SIZE (64 * 1024)    // 每个 slab 的大小，slab 按这个大小对齐
+#define MP_MAX_SMALL 4096           // 不超过这个大小的申请走 slab，更大的走大块
+#define MP_SIZE_CLASSES 28          // 16 ~ 4096 字节一共 28 个规格
+
+class MemoryPool;
+
+/**
+ * 一个 slab：MP_SLAB_SIZE 对齐的一段内存，开头是这个头，后面切成同样大小的对象
+ * 对象地址按 MP_SLAB_SIZE 取整就是所在 slab 的头，释放时不用查找
+ */
 struct SmallNode
 {
-    unsigned char* end_;     // 该块的结尾
-    unsigned char* last_;    // 该块目前使用位置
-    unsigned int quote_;     // 该块被引用次数
-    unsigned int failed_;    // 该块失效次数
-    struct SmallNode* next_; // 指向下一个块
-}; 
+    unsigned char* end_;     // 该 slab 的结尾
+    unsigned char* last_;    // 还没切出去过的位置，新 slab 不用一次把空闲链表串好
+    void* freeList_;         // 释放回来的对象，对象的前 8 个字节存下一个空闲对象
+    unsigned int quote_;     // 已经分配出去的对象数
+    unsigned int capacity_;  // 一共能切出多少个对象
+    unsigned int size_;      // 对象大小
+    unsigned int class_;     // 规格下标
+    MemoryPool* owner_;      // 分配出这个 slab 的内存池，别的线程释放时还给它
+    struct SmallNode* prev_; // 同一规格同一链表里的前一个 slab
+    struct SmallNode* next_; // 同一规格同一链表里的后一个 slab
+};
 
+/**
+ * 大块内存前面的头，申请的时候多申请这么大，返回头后面的地址
+ * 释放时往前退一个头就找到了节点，不用遍历链表
+ */
 struct LargeNode
 {
-    void* address_;          // 该块的起始地址
-    unsigned int size_;      // 该块大小
+    size_t size_;            // 该块大小，不含头
+    MemoryPool* owner_;      // 分配出这个大块的内存池
+    struct LargeNode* prev_; // 指向上一个大块
     struct LargeNode* next_; // 指向下一个大块
 };
 
 struct Pool
 {
-    LargeNode* largeList_;   // 管理大块内存链表
-    SmallNode* head_;        // 头节点
-    SmallNode* current_;     // 指向当前分配的块，这样可以避免遍历前面已经不能分配的块  
+    LargeNode* largeList_;                  // 所有还没释放的大块，resetPool 和 destroyPool 时统一释放
+    SmallNode* partial_[MP_SIZE_CLASSES];   // 每个规格还有空位的 slab，刚释放过的排在前面
+    SmallNode* full_[MP_SIZE_CLASSES];      // 每个规格已经分完的 slab
+    SmallNode* empty_[MP_SIZE_CLASSES];     // 每个规格留一个空 slab 不还给系统，避免在边界上反复 mmap/munmap
+    unsigned char classIndex_[MP_MAX_SMALL / MP_ALIGNMENT + 1]; // (size + 15) / 16 到规格下标
+    unsigned int classSize_[MP_SIZE_CLASSES];                   // 每个规格的对象大小
+    size_t slabs_;                          // 当前从系统拿了多少个 slab
 };
 
+/**
+ * 按大小分级的 slab 内存池
+ *
+ * 小块申请按大小取整到 28 个规格之一(16 字节一档到 128，之后每翻一倍分四档)，每个规格有自己的 slab，
+ * 申请从最近释放过对象的 slab 里取，释放直接挂回所在 slab 的空闲链表，两边都是 O(1)。
+ * 一个 slab 里的对象全部释放后就用 munmap 还给系统，每个规格最多留一个空 slab。
+ * 大块申请单独 posix_memalign，前面带一个 LargeNode 头。
+ * 释放时先查一张按 64KB 窗口记录的两级页表：窗口是 slab 就按小块处理，否则是大块，往前退一个头，也是 O(1)。
+ *
+ * 一个内存池只能由一个线程申请和释放(见 Memory，每个线程一个)。
+ * 别的线程拿到的对象用 ownerOf 找到所属的内存池，调用它的 remoteFree 挂到一个无锁链表上，
+ * 拥有者下次 malloc 时一次全部取走再真正释放。
+ */
 class MemoryPool
 {
 public:
@@ -43,12 +82,12 @@ public:
     ~MemoryPool() = default;
 
     /**
-     * @brief 初始化内存池，为 pool_ 分配 PAGE_SIZE 内存
+     * @brief 初始化内存池，建好规格表，slab 在第一次申请时才分配
      */
     void createPool();
 
     /**
-     * @brief 销毁内存池，遍历大块内存和小块内存且释放它们
+     * @brief 销毁内存池，释放所有大块内存和 slab
      */
     void destroyPool();
 
@@ -61,20 +100,37 @@ public:
     /**
      * @brief 申请内存且将内存清零，内部调用 malloc
      * @param[in] size 分配内存大小
-     */    
+     */
     void* calloc(unsigned long size);
 
     /**
-     * @brief 释放内存指定内存
+     * @brief 释放内存指定内存，p 必须是这个内存池分配出去的
      * @param[in] p 释放内存头地址
-     */    
+     */
     void freeMemory(void* p);
 
     /**
-     * @brief 重置内存池
-     */    
+     * @brief 重置内存池，之前分配出去的内存全部作废，slab 和大块都还给系统
+     */
     void resetPool();
 
+    /**
+     * @brief 别的线程释放这个内存池分配出去的对象，可以在任意线程调用
+     * @param[in] p 释放内存头地址
+     */
+    void remoteFree(void* p);
+
+    /**
+     * @brief 把别的线程还回来的对象真正释放掉，只能在拥有者线程调用，malloc 里会自动调用
+     */
+    void drainRemoteFree();
+
+    /**
+     * @brief 找到分配出 p 的内存池
+     * @param[in] p 任意内存池分配出去的地址
+     */
+    static MemoryPool* ownerOf(void* p);
+
     Pool* getPool() { return pool_; }
 
 private:
@@ -85,10 +141,17 @@ private:
     void* mallocLargeNode(unsigned long size);
 
     /**
-     * @brief 分配小块节点，被 malloc 调用
-     * @param[in] size 分配内存大小
+     * @brief 某个规格没有空位时分配新的 slab，被 malloc 调用
+     * @param[in] sizeClass 规格下标
      */
-    void* mallocSmallNode(unsigned long size);
-    
-    Pool* pool_ = nullptr;    
-};
\ No newline at end of file
+    SmallNode* mallocSmallNode(unsigned int sizeClass);
+
+    /**
+     * @brief 把 slab 还给系统
+     * @param[in] slab 要释放的 slab
+     */
+    void freeSmallNode(SmallNode* slab);
+
+    Pool* pool_ = nullptr;
+    std::atomic<void*> remoteFree_{nullptr};    // 别的线程还回来的对象，对象的前 8 个字节存下一个
+};
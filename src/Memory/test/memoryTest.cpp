@@ -1,180 +1,240 @@
-// #include "MemoryPool.h"
 #include "Memory.h"
 
+#include <iostream>
 #include <vector>
+#include <algorithm>
 #include <chrono>
+#include <random>
+#include <thread>
 #include <stdio.h>
 #include <stdlib.h>
 using std::cout;
 using std::endl;
 using std::vector;
 
-void showInfo(MemoryPool *Mpool, char *str) {
-    printf("\r\n\r\n------start pool status %s------\r\n\r\n", str);
-    Pool* pool = Mpool->getPool();
-    SmallNode* head = nullptr;
-    int i = 1;
-    for (head = pool->head_; head; head = head->next_, i++) 
+// MemoryPool 和 glibc malloc 的对比：同样的申请/释放序列分别跑一遍，输出每次操作的平均耗时
+
+#define ALLOCATE_COUNT 1000000
+#define LIVE_COUNT 10000
+
+struct Allocator
+{
+    const char* name;
+    void* (*alloc)(void* ctx, size_t size);
+    void (*release)(void* ctx, void* p);
+    void* ctx;
+};
+
+void* poolAlloc(void* ctx, size_t size) { return static_cast<MemoryPool*>(ctx)->malloc(size); }
+void poolFree(void* ctx, void* p) { static_cast<MemoryPool*>(ctx)->freeMemory(p); }
+void* glibcAlloc(void*, size_t size) { return malloc(size); }
+void glibcFree(void*, void* p) { free(p); }
+// 走 Memory，每个线程用自己的内存池
+void* memoryAlloc(void*, size_t size) { return Memory::getInstance()->allocate<char>(size).getBasePtr(); }
+void memoryFree(void*, void* p)
+{
+    MemoryView<char> view(static_cast<char*>(p), 1);
+    Memory::getInstance()->deallocate(view);
+}
+
+double elapsedNs(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* name, const char* what, double ns, long ops)
+{
+    printf("%-8s %-36s %8.1f ms %8.2f ns/op\n", name, what, ns / 1e6, ns / ops);
+}
+
+// 固定大小，先全部申请再按申请顺序全部释放
+void fixedSize(Allocator& a, size_t size, vector<void*>& ptrs)
+{
+    char what[64];
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
     {
-        if (pool->current_ == head) 
-        {
-            printf("current==>第%d块\n", i);
-        }
-        if (i == 1) 
-        {
-            printf("第%02d块small block  已使用:%4ld  剩余空间:%4ld  引用:%4d  failed:%4d\n", i,
-                   (unsigned char *) head->last_ - (unsigned char *) pool,
-                   head->end_ - head->last_, head->quote_, head->failed_);
-        }
-        else 
+        ptrs[i] = a.alloc(a.ctx, size);
+        *static_cast<char*>(ptrs[i]) = 1;
+    }
+    snprintf(what, sizeof what, "malloc %zu x %d", size, ALLOCATE_COUNT);
+    report(a.name, what, elapsedNs(start), ALLOCATE_COUNT);
+
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
+    {
+        a.release(a.ctx, ptrs[i]);
+    }
+    snprintf(what, sizeof what, "free   %zu x %d", size, ALLOCATE_COUNT);
+    report(a.name, what, elapsedNs(start), ALLOCATE_COUNT);
+}
+
+// 16 ~ 4096 的随机大小，保持 LIVE_COUNT 个对象存活，每次随机换掉一个，模拟生命周期交错的连接和请求
+void mixedLifetime(Allocator& a, const vector<size_t>& sizes, const vector<int>& slots)
+{
+    vector<void*> live(LIVE_COUNT, nullptr);
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
+    {
+        void*& p = live[slots[i]];
+        if (p != nullptr)
         {
-            printf("第%02d块small block  已使用:%4ld  剩余空间:%4ld  引用:%4d  failed:%4d\n", i,
-                   (unsigned char *) head->last_ - (unsigned char *) head,
-                   head->end_ - head->last_, head->quote_, head->failed_);
+            a.release(a.ctx, p);
         }
+        p = a.alloc(a.ctx, sizes[i]);
+        *static_cast<char*>(p) = 1;
     }
-
-    LargeNode *large;
-    i = 0;
-    for (large = pool->largeList_; large; large = large->next_, i++) {
-        if (large->address_ != nullptr) 
+    for (void* p : live)
+    {
+        if (p != nullptr)
         {
-            printf("第%d块large block  size=%d\n", i, large->size_);
+            a.release(a.ctx, p);
         }
     }
-    printf("\r\n\r\n------end pool status------\r\n\r\n");
+    report(a.name, "mixed 16~4096 malloc+free", elapsedNs(start), ALLOCATE_COUNT);
 }
 
-void test1()
+// 先申请 ALLOCATE_COUNT 个 16 ~ 256 字节的对象(每 256 个里有一个 8192 字节的大块)，再按打乱的顺序全部释放，只统计释放
+void randomFree(Allocator& a, const vector<size_t>& sizes, const vector<int>& order, vector<void*>& ptrs)
 {
-    printf("sizeof(Pool) = %ld sizeof(SmallNode) = %ld\n", sizeof(Pool), sizeof(SmallNode));
-    
-    vector<void*> memoryVector(50);
-    MemoryPool pool; 
-    pool.createPool();
-    
-    // 申请30个512字节的内存块
-    for (int i = 0; i < 50; i++) 
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
     {
-        memoryVector[i] = pool.malloc(512);
+        ptrs[i] = a.alloc(a.ctx, i % 256 == 0 ? 8192 : 16 + sizes[i] % 241);
+        *static_cast<char*>(ptrs[i]) = 1;
     }
-    showInfo(&pool, "申请50个512字节的内存块");
-    
-    // 销毁30个512字节的内存块
-    for (int i = 0; i < 50; i++) 
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
     {
-        pool.freeMemory(memoryVector[i]);
+        a.release(a.ctx, ptrs[order[i]]);
     }
-    showInfo(&pool, "销毁50个512字节的内存块");
-    
-    // 申请30个5120字节的内存块
-    for (int i = 0; i < 30; i++)
+    report(a.name, "free 1000000 in random order", elapsedNs(start), ALLOCATE_COUNT);
+}
+
+// threads 个线程同时跑混合负载，每个线程 ALLOCATE_COUNT 次，输出总吞吐
+void mixedThreads(Allocator& a, int threads, const vector<size_t>& sizes, const vector<int>& slots)
+{
+    auto start = std::chrono::steady_clock::now();
+    vector<std::thread> workers;
+    for (int t = 0; t < threads; t++)
     {
-        memoryVector[i] = pool.malloc(5120);
+        workers.emplace_back([&]() {
+            vector<void*> live(LIVE_COUNT, nullptr);
+            for (int i = 0; i < ALLOCATE_COUNT; i++)
+            {
+                void*& p = live[slots[i]];
+                if (p != nullptr)
+                {
+                    a.release(a.ctx, p);
+                }
+                p = a.alloc(a.ctx, sizes[i]);
+                *static_cast<char*>(p) = 1;
+            }
+            for (void* p : live)
+            {
+                if (p != nullptr)
+                {
+                    a.release(a.ctx, p);
+                }
+            }
+        });
     }
-    showInfo(&pool, "申请30个5120字节的内存块");
-    
-    // 销毁30个5120字节的内存块
-    for (int i = 0; i < 30; i++)
+    for (auto& w : workers)
     {
-        pool.freeMemory(memoryVector[i]);
+        w.join();
     }
-    showInfo(&pool, "销毁30个5120字节的内存块");
-
-    pool.resetPool();
-    showInfo(&pool, "重置内存池");
-
-    pool.destroyPool();
+    double ns = elapsedNs(start);
+    printf("%-8s %d threads mixed 16~4096             %8.1f ms %8.2f Mops/s\n",
+           a.name, threads, ns / 1e6, ALLOCATE_COUNT * threads / (ns / 1e3));
 }
 
-#define ALLOCATE_COUNT 1000000
-#define ALLOCATE_SIZE 10
-
-void test2()
-{   
-    // vector<void*> memoryVector(100);
-    void* memory[ALLOCATE_COUNT];
+// 一个线程申请，另一个线程全部释放，再回到申请的线程申请一遍，释放的对象要被收回来重新用上
+void remoteFree()
+{
+    vector<void*> ptrs(ALLOCATE_COUNT);
+    std::thread producer([&]() {
+        for (int i = 0; i < ALLOCATE_COUNT; i++)
+        {
+            ptrs[i] = memoryAlloc(nullptr, 64);
+        }
+    });
+    producer.join();
 
-    cout << "use malloc free time" << endl;
-    cout << "--------------------" << endl;
     auto start = std::chrono::steady_clock::now();
-    for (int i = 0; i < ALLOCATE_COUNT; i++) 
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
     {
-        memory[i] = malloc(10);//分配10字节的内存
+        memoryFree(nullptr, ptrs[i]);
     }
-    auto end = std::chrono::steady_clock::now();
-    cout << "the time cost " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << endl;
+    report("memory", "remote free 64 x 1000000", elapsedNs(start), ALLOCATE_COUNT);
+
+    // 新线程接手刚才退出的线程留下的内存池，第一次申请时收回所有远程释放的对象
+    MemoryPool* pool = nullptr;
+    std::thread adopter([&]() {
+        void* p = memoryAlloc(nullptr, 64);
+        pool = MemoryPool::ownerOf(p);
+        memoryFree(nullptr, p);
+    });
+    adopter.join();
+    printf("slabs held after remote free: %zu\n", pool->getPool()->slabs_);
+}
 
-    start = std::chrono::steady_clock::now();
-    for (int i = 0; i < ALLOCATE_COUNT; i++) 
+int main()
+{
+    std::mt19937 rng(12345);
+    vector<size_t> sizes(ALLOCATE_COUNT);
+    vector<int> slots(ALLOCATE_COUNT);
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
     {
-        free(memory[i]);
+        // 小对象居多，和服务器里的实际分布接近
+        size_t size = 16u << (rng() % 9);
+        sizes[i] = size / 2 + rng() % size;
+        if (sizes[i] > MP_MAX_SMALL)
+        {
+            sizes[i] = MP_MAX_SMALL;
+        }
+        slots[i] = static_cast<int>(rng() % LIVE_COUNT);
     }
-    end = std::chrono::steady_clock::now();
-    cout << "the time cost " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << endl;
-    cout << "--------------------" << endl;
-    cout << endl;
+    vector<int> order(ALLOCATE_COUNT);
+    for (int i = 0; i < ALLOCATE_COUNT; i++)
+    {
+        order[i] = i;
+    }
+    std::shuffle(order.begin(), order.end(), rng);
+    vector<void*> ptrs(ALLOCATE_COUNT);
 
-    MemoryPool pool; 
+    MemoryPool pool;
     pool.createPool();
+    Allocator allocators[] = {
+        {"glibc", glibcAlloc, glibcFree, nullptr},
+        {"pool", poolAlloc, poolFree, &pool},
+    };
 
-    cout << "use MemoryPool time" << endl;
-    cout << "--------------------" << endl;
-    start = std::chrono::steady_clock::now();
-    for (int i = 0; i < ALLOCATE_COUNT; i++) 
+    for (Allocator& a : allocators)
     {
-        memory[i] = pool.malloc(10);
+        fixedSize(a, 10, ptrs);
+        fixedSize(a, 64, ptrs);
+        fixedSize(a, 1000, ptrs);
+        mixedLifetime(a, sizes, slots);
+        randomFree(a, sizes, order, ptrs);
+        cout << "--------------------" << endl;
     }
-    end = std::chrono::steady_clock::now();
-    cout << "the time cost " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << endl;
 
-    start = std::chrono::steady_clock::now();
+    // 全部释放之后每个规格最多留一个空 slab，其余都还给了系统
+    printf("slabs held by pool after free: %zu\n", pool.getPool()->slabs_);
     pool.destroyPool();
-    end = std::chrono::steady_clock::now();
-    cout << "the time cost " << std::chrono::duration_cast<std::chrono::microseconds>(end - start).count() << "us" << endl;
     cout << "--------------------" << endl;
-    cout << endl;
-}
-
-void test3(){
-    MemoryPool pool; 
-    pool.createPool();
-    int *ptr=(int*)pool.malloc(5*sizeof(int));
-    ptr[5]=10;
-    cout<<ptr[5]<<endl;
-}
-int test4(){
-    int *ptr = (int*)malloc(5 * sizeof(int));
-    if (!ptr) return -1;
-
-    ptr[1000] = 999; // 
-    printf("Data: %d\n", ptr[1000]);
-
-    free(ptr);
-    return 0;
-}
-
 
-void test5(){
-    Memory mem;
-    MemoryView<int> arr = mem.allocate<int>(10);
-    arr[1]=10;
-    arr[2]=11;
-    cout<<arr[1]<<arr[2]<<endl;
-    mem.deallocate(arr);
-    std::cout<<"删除了分配的空间"<<endl;
-    MemoryView<int> arr1 = mem.allocate<int>(2);
-    arr1[1]=10;
-    cout<<arr1[1]<<endl;
-    arr1[11]=10;
-}
-int main()
-{
-    // test1();
-    // cout<<"###################################"<<endl;
-    // test2();
-    // test3();
-    // test4();
-    test5();
+    Allocator threaded[] = {
+        {"glibc", glibcAlloc, glibcFree, nullptr},
+        {"memory", memoryAlloc, memoryFree, nullptr},
+    };
+    for (Allocator& a : threaded)
+    {
+        for (int threads = 1; threads <= 8; threads *= 2)
+        {
+            mixedThreads(a, threads, sizes, slots);
+        }
+        cout << "--------------------" << endl;
+    }
+    remoteFree();
     return 0;
 }
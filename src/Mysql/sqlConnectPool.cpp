@@ -1,4 +1,6 @@
 #include "sqlConnectPool.h"
+#include "Metrics.h"
+#include "Timestamp.h"
 
 
 SqlConnPool *SqlConnPool::getInstance()
@@ -8,6 +10,9 @@ SqlConnPool *SqlConnPool::getInstance()
 }
 std::shared_ptr<MysqlConn> SqlConnPool::getConnection()
 {
+    static Histogram* waitTime = MetricsRegistry::instance().histogram("myweb_sql_pool_wait_seconds",
+                                                                       "Time spent waiting for a pooled SQL connection");
+    Timestamp start = Timestamp::now();
 
     //这个连接有可能长时间不用被数据库给主动断开连接了，所以这个位置要判断一下，如果超时了，就清除队列中的所有连接，然后重新连接
     // 这个位置用代码快的原因是因为如果去掉的话，我们加了locksql锁，但是没进if，会导致下边再死锁。
@@ -49,6 +54,7 @@ std::shared_ptr<MysqlConn> SqlConnPool::getConnection()
     // 使用共享智能指针并规定其删除器
     // 规定销毁后调用删除器，在互斥的情况下更新空闲时间并加入数据库连接池
     // 这个位置不能使用unique_ptr，因为我们禁止发生拷贝，如果是unique的话是会发生拷贝的，而share是对对象的一个引用。
+    waitTime->record(Timestamp::now().microSecondsSinceEpoch() - start.microSecondsSinceEpoch());
     std::shared_ptr<MysqlConn> connptr(connectionQueue_.front(),
                                        [this](MysqlConn *conn)
                                        {
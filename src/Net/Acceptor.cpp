@@ -81,14 +81,13 @@ void Acceptor::handleRead()
     }
     else
     {
-        LOG_ERROR << "accept() failed";
-
+        int savedErrno = errno;
         // 当前进程的fd已经用完了
         // 可以调整单个服务器的fd上限
         // 也可以分布式部署
-        if (errno == EMFILE)
+        if (savedErrno == EMFILE)
         {
-            LOG_ERROR << "sockfd reached limit";
+            LOG_ERROR_LIMIT(1) << "sockfd reached limit";
         }
     }
 }
\ No newline at end of file
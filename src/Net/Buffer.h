@@ -42,12 +42,25 @@ public:
      */    
     size_t prependableBytes() const { return readerIndex_; }
 
+    void swap(Buffer& rhs)
+    {
+        buffer_.swap(rhs.buffer_);
+        std::swap(readerIndex_, rhs.readerIndex_);
+        std::swap(writerIndex_, rhs.writerIndex_);
+    }
+
     // 返回缓冲区中可读数据的起始地址
     const char* peek() const
     {
         return begin() + readerIndex_;
     }
 
+    // 可以原地修改的可读数据起始地址，比如 WebSocket 直接在缓冲区里解掩码
+    char* beginRead()
+    {
+        return begin() + readerIndex_;
+    }
+
     void retrieveUntil(const char *end)
     {
         retrieve(end - peek());
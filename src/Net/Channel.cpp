@@ -1,5 +1,6 @@
 #include "Channel.h"
 #include "EventLoop.h"
+#include "BinaryLogging.h"
 
 const int Channel::kNoneEvent = 0;
 const int Channel::kReadEvent = EPOLLIN | EPOLLPRI;
@@ -58,7 +59,7 @@ void Channel::handleEvent(Timestamp receiveTime)
      * 如果tied_为false，说明还没有绑定新连接，这个时候是处于连接建立前的监听状态，这个是连接建立的执行。
      * 如果tied_为true，说明已经绑定好了新连接，这个时候是执行的对方发来的消息。
      */
-    LOG_DEBUG<<"handle";
+    LOG_DEBUG_BIN("handle fd {} revents {}", fd_, revents_);
     if (tied_)
     {
         // 变成shared_ptr增加引用计数，防止误删
@@ -78,7 +79,7 @@ void Channel::handleEvent(Timestamp receiveTime)
 // 根据相应事件执行回调操作
 void Channel::handleEventWithGuard(Timestamp receiveTime)
 {    
-    LOG_DEBUG<<"handleEventWithGuard";
+    LOG_DEBUG_BIN("handleEventWithGuard fd {}", fd_);
     // 对端关闭事件
     // 当TcpConnection对应Channel，通过shutdown关闭写端，epoll触发EPOLLHUP
     if ((revents_ & EPOLLHUP) && !(revents_ & EPOLLIN))
@@ -103,10 +104,10 @@ void Channel::handleEventWithGuard(Timestamp receiveTime)
     // 读事件
     if (revents_ & (EPOLLIN | EPOLLPRI))
     {
-        LOG_DEBUG << "channel have read events, the fd = " << this->fd();
+        LOG_DEBUG_BIN("channel have read events, the fd = {}", fd_);
         if (readCallback_)
         {
-            LOG_DEBUG<< "channel call the readCallback_(), the fd = " << this->fd();
+            LOG_DEBUG_BIN("channel call the readCallback_(), the fd = {}", fd_);
             readCallback_(receiveTime);
         }
     }
@@ -0,0 +1,234 @@
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+#include "Connector.h"
+#include "Channel.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+static int getSocketError(int sockfd)
+{
+    int optval;
+    socklen_t optlen = sizeof optval;
+    if (::getsockopt(sockfd, SOL_SOCKET, SO_ERROR, &optval, &optlen) < 0)
+    {
+        return errno;
+    }
+    return optval;
+}
+
+// 本机连接本机的临时端口时可能连到自己身上(源地址和目的地址相同)
+static bool isSelfConnect(int sockfd)
+{
+    sockaddr_in local, peer;
+    socklen_t len = sizeof local;
+    ::memset(&local, 0, sizeof local);
+    ::memset(&peer, 0, sizeof peer);
+    if (::getsockname(sockfd, (sockaddr *)&local, &len) < 0)
+    {
+        return false;
+    }
+    len = sizeof peer;
+    if (::getpeername(sockfd, (sockaddr *)&peer, &len) < 0)
+    {
+        return false;
+    }
+    return local.sin_port == peer.sin_port && local.sin_addr.s_addr == peer.sin_addr.s_addr;
+}
+
+Connector::Connector(EventLoop *loop, const InetAddress &serverAddr)
+    : loop_(loop),
+      serverAddr_(serverAddr),
+      connect_(false),
+      state_(kDisconnected),
+      retry_(false),
+      retryDelayMs_(kInitRetryDelayMs)
+{
+    LOG_DEBUG << "Connector ctor " << serverAddr_.toIpPort();
+}
+
+Connector::~Connector()
+{
+    LOG_DEBUG << "Connector dtor " << serverAddr_.toIpPort();
+}
+
+void Connector::start()
+{
+    connect_ = true;
+    loop_->runInLoop(std::bind(&Connector::startInLoop, shared_from_this()));
+}
+
+void Connector::startInLoop()
+{
+    // 重试的定时器到期时可能已经又 start 过一次，正在连接了
+    if (connect_ && state_ != kConnecting)
+    {
+        connect();
+    }
+}
+
+void Connector::restart()
+{
+    setState(kDisconnected);
+    retryDelayMs_ = kInitRetryDelayMs;
+    connect_ = true;
+    startInLoop();
+}
+
+void Connector::stop()
+{
+    connect_ = false;
+    loop_->queueInLoop(std::bind(&Connector::stopInLoop, shared_from_this()));
+}
+
+void Connector::stopInLoop()
+{
+    if (state_ == kConnecting)
+    {
+        setState(kDisconnected);
+        int sockfd = removeAndResetChannel();
+        ::close(sockfd);
+    }
+}
+
+void Connector::connect()
+{
+    int sockfd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    if (sockfd < 0)
+    {
+        // fd 用完了，和连接失败一样处理，重试的话等一会儿可能就有了
+        LOG_ERROR << "Connector::connect socket create err " << errno;
+        setState(kDisconnected);
+        if (retry_)
+        {
+            retry();
+        }
+        else if (connect_ && errorCallback_)
+        {
+            errorCallback_();
+        }
+        return;
+    }
+    int ret = ::connect(sockfd, (const sockaddr *)serverAddr_.getSockAddr(), sizeof(sockaddr_in));
+    int savedErrno = (ret == 0) ? 0 : errno;
+    switch (savedErrno)
+    {
+    case 0:
+    case EINPROGRESS:   // 非阻塞连接正在进行
+    case EINTR:
+    case EISCONN:
+        connecting(sockfd);
+        break;
+    default:            // ECONNREFUSED、ENETUNREACH、EADDRNOTAVAIL(临时端口用完)等
+        LOG_ERROR << "Connector::connect " << serverAddr_.toIpPort() << " error " << savedErrno;
+        fail(sockfd);
+        break;
+    }
+}
+
+// 连接结果要等 socket 可写才知道
+void Connector::connecting(int sockfd)
+{
+    setState(kConnecting);
+    channel_.reset(new Channel(loop_, sockfd));
+    channel_->setWriteCallback(std::bind(&Connector::handleWrite, this));
+    channel_->setErrorCallback(std::bind(&Connector::handleError, this));
+    channel_->tie(shared_from_this());
+    channel_->enableWriting();
+}
+
+int Connector::removeAndResetChannel()
+{
+    channel_->disableAll();
+    channel_->remove();
+    int sockfd = channel_->fd();
+    // 现在还在 Channel::handleEvent 里面，不能直接析构 channel_
+    loop_->queueInLoop(std::bind(&Connector::resetChannel, shared_from_this()));
+    return sockfd;
+}
+
+void Connector::resetChannel()
+{
+    channel_.reset();
+}
+
+void Connector::handleWrite()
+{
+    if (state_ != kConnecting)
+    {
+        return;
+    }
+    int sockfd = removeAndResetChannel();
+    int err = getSocketError(sockfd);
+    if (err)
+    {
+        LOG_DEBUG << "Connector::handleWrite " << serverAddr_.toIpPort() << " SO_ERROR = " << err;
+        fail(sockfd);
+    }
+    else if (isSelfConnect(sockfd))
+    {
+        LOG_DEBUG << "Connector::handleWrite self connect";
+        fail(sockfd);
+    }
+    else
+    {
+        setState(kConnected);
+        if (connect_)
+        {
+            newConnectionCallback_(sockfd);
+        }
+        else
+        {
+            ::close(sockfd);
+        }
+    }
+}
+
+void Connector::handleError()
+{
+    if (state_ == kConnecting)
+    {
+        int sockfd = removeAndResetChannel();
+        LOG_DEBUG << "Connector::handleError SO_ERROR = " << getSocketError(sockfd);
+        fail(sockfd);
+    }
+}
+
+void Connector::fail(int sockfd)
+{
+    ::close(sockfd);
+    setState(kDisconnected);
+    if (retry_)
+    {
+        retry();
+    }
+    else if (connect_ && errorCallback_)
+    {
+        errorCallback_();
+    }
+}
+
+// 定时器不能取消，只持有弱引用，stop 之后或者 Connector 析构之后到期什么都不做
+void Connector::retry()
+{
+    if (!connect_)
+    {
+        return;
+    }
+    LOG_INFO << "Connector::retry connecting to " << serverAddr_.toIpPort() << " in " << retryDelayMs_ << " ms";
+    std::weak_ptr<Connector> weak(shared_from_this());
+    loop_->runAfter(retryDelayMs_ / 1000.0, [weak]() {
+        ConnectorPtr self = weak.lock();
+        if (self)
+        {
+            self->startInLoop();
+        }
+    });
+    retryDelayMs_ *= 2;
+    if (retryDelayMs_ > kMaxRetryDelayMs)
+    {
+        retryDelayMs_ = kMaxRetryDelayMs;
+    }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+
+#include "noncopyable.h"
+#include "InetAddress.h"
+
+class Channel;
+class EventLoop;
+
+/**
+ * 主动发起连接，和 Acceptor 相对
+ * 非阻塞 connect 返回 EINPROGRESS 之后把 socket 注册到 Poller 上等可写事件，
+ * 可写时用 SO_ERROR 判断连接是否成功，成功后把 sockfd 交给回调，由回调创建 TcpConnection。
+ * 默认只连接一次，失败时调用错误回调；打开重试之后失败不调用错误回调，
+ * 而是用定时器隔一段时间再连，间隔从 kInitRetryDelayMs 开始每次翻倍，最多 kMaxRetryDelayMs。
+ * 回调里会用到 shared_from_this，所以 Connector 必须由 shared_ptr 管理。
+ */
+class Connector : noncopyable,
+    public std::enable_shared_from_this<Connector>
+{
+public:
+    using NewConnectionCallback = std::function<void(int sockfd)>;
+    using ErrorCallback = std::function<void()>;
+
+    static const int kInitRetryDelayMs = 500;
+    static const int kMaxRetryDelayMs = 30 * 1000;
+
+    Connector(EventLoop *loop, const InetAddress &serverAddr);
+    ~Connector();
+
+    void setNewConnectionCallback(const NewConnectionCallback &cb) { newConnectionCallback_ = cb; }
+    void setErrorCallback(const ErrorCallback &cb) { errorCallback_ = cb; }
+    // 连接失败时按退避时间重试，需要在 start 之前设置
+    void setRetry(bool on) { retry_ = on; }
+
+    const InetAddress& serverAddress() const { return serverAddr_; }
+
+    void start();   // 可以在任意线程调用
+    void stop();    // 还在连接中或者等待重试就放弃，之后不会再调用任何回调
+    void restart(); // 只能在 loop 线程调用，重试间隔从头开始
+
+private:
+    enum States
+    {
+        kDisconnected,
+        kConnecting,
+        kConnected,
+    };
+    void setState(States s) { state_ = s; }
+    void startInLoop();
+    void stopInLoop();
+    void connect();
+    void connecting(int sockfd);
+    void handleWrite();
+    void handleError();
+    void fail(int sockfd);
+    void retry();
+    int removeAndResetChannel();
+    void resetChannel();
+
+    EventLoop *loop_;
+    InetAddress serverAddr_;
+    bool connect_;          // 是否还要连接，stop 之后为 false
+    States state_;
+    bool retry_;
+    int retryDelayMs_;
+    std::unique_ptr<Channel> channel_;  // 只在连接过程中存在
+    NewConnectionCallback newConnectionCallback_;
+    ErrorCallback errorCallback_;
+};
+
+using ConnectorPtr = std::shared_ptr<Connector>;
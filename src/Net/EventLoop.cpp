@@ -1,6 +1,8 @@
 #include "EventLoop.h"
 #include "Logging.h"
+#include "BinaryLogging.h"
 #include "Poller.h"
+#include "Metrics.h"
 #include <unistd.h>
 #include <sys/eventfd.h>
 #include <fcntl.h>
@@ -33,6 +35,9 @@ EventLoop::EventLoop() :
     wakeupChannel_(new Channel(this, wakeupFd_)),
     currentActiveChannel_(nullptr)
 {
+    std::string labels = "loop=\"" + std::to_string(threadId_) + "\"";
+    connectionGauge_ = MetricsRegistry::instance().gauge("myweb_connections", "Open connections per EventLoop", labels);
+    pendingGauge_ = MetricsRegistry::instance().gauge("myweb_pending_functors", "Functors queued to an EventLoop and not run yet", labels);
     LOG_DEBUG << "EventLoop created " << this << " the index is " << threadId_;
     LOG_DEBUG << "EventLoop created wakeupFd " << wakeupChannel_->fd();
     if (t_loopInThisThread)
@@ -74,12 +79,12 @@ void EventLoop::loop()
         activeChannels_.clear();
         // 获取
         pollReturnTime_ = poller_->poll(kPollTimeMs, &activeChannels_);
-        LOG_DEBUG<<"is loop.loop: ";
+        LOG_DEBUG_BIN("poll returned {} active channels", activeChannels_.size());
         for (Channel *channel : activeChannels_)
         {
             channel->handleEvent(pollReturnTime_);
         }
-        LOG_DEBUG<<"dssssss";
+        LOG_DEBUG_BIN("active channels handled");
         // 执行当前EventLoop事件循环需要处理的回调操作
         /**
          * IO thread：mainLoop accept fd 打包成 chennel 分发给 subLoop
@@ -99,9 +104,9 @@ void EventLoop::quit()
      * TODO:生产者消费者队列派发方式和muduo的派发方式
      * 有可能是别的线程调用quit(调用线程不是生成EventLoop对象的那个线程)
      * 比如在工作线程(subLoop)中调用了IO线程(mainLoop)
-     * 这种情况会唤醒主线程
+     * 这种情况会唤醒主线程，否则要等 poll 超时才能退出
      */
-    if (isInLoopThread())
+    if (!isInLoopThread())
     {
         wakeup();
     }
@@ -129,6 +134,7 @@ void EventLoop::queueInLoop(Functor cb)
         std::lock_guard<std::mutex> lock(mutex_);//这里用的是小锁
         pendingFunctors_.emplace_back(cb); // 使用了std::move
     }
+    pendingGauge_->inc();
 
     // 唤醒相应的，需要执行上面回调操作的loop线程
     /** 
@@ -194,6 +200,7 @@ void EventLoop::doPendingFunctors()
         std::lock_guard<std::mutex> lock(mutex_);
         functors.swap(pendingFunctors_);
     }
+    pendingGauge_->add(-static_cast<int64_t>(functors.size()));
 
     for (const Functor &functor : functors)
     {
@@ -13,6 +13,7 @@
 
 class Channel;
 class Poller;
+class Gauge;
 // 事件循环类 主要包含了两大模块，channel poller
 class EventLoop : noncopyable
 {
@@ -69,6 +70,9 @@ public:
     pid_t getpid__(){
         return threadId_;
     }
+
+    // 这个loop上的连接数，由 TcpConnection 增减
+    Gauge* connectionGauge() const { return connectionGauge_; }
 private:
     void handleRead();
     void doPendingFunctors();
@@ -94,4 +98,8 @@ private:
     Channel* currentActiveChannel_;         // 当前处理的活跃channel
     std::mutex mutex_;                      // 用于保护pendingFunctors_线程安全操作
     std::vector<Functor> pendingFunctors_;  // 存储loop跨线程需要执行的所有回调操作
+
+    // 指标，标签是loop所在线程的tid
+    Gauge* connectionGauge_;
+    Gauge* pendingGauge_;                   // pendingFunctors_ 的长度
 };
@@ -5,8 +5,10 @@ InetAddress::InetAddress(uint16_t port, std::string ip)
     ::bzero(&addr_, sizeof(addr_));
     addr_.sin_family = AF_INET; // Ipv4
     addr_.sin_port = ::htons(port);
-    // addr_.sin_addr.s_addr = ::inet_addr(ip.c_str());
-    addr_.sin_addr.s_addr = htonl(INADDR_ANY);  // FIXME : it should be addr.ip() and need some conversion
+    if (::inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) != 1)
+    {
+        addr_.sin_addr.s_addr = htonl(INADDR_ANY);
+    }
 }
 
 std::string InetAddress::toIp() const
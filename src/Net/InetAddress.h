@@ -9,8 +9,8 @@
 class InetAddress
 {
 public:
-    //默认的ip是127.0.0.1 
-    explicit InetAddress(uint16_t port = 0, std::string ip = "127.0.0.1");
+    // 默认监听所有网卡；主动连接的时候传入对端的 ip
+    explicit InetAddress(uint16_t port = 0, std::string ip = "0.0.0.0");
     explicit InetAddress(const sockaddr_in &addr)
         : addr_(addr)
     {
@@ -0,0 +1,137 @@
+#include "RateLimiter.h"
+#include "InetAddress.h"
+#include "Metrics.h"
+
+namespace
+{
+// 只支持 IPv4，地址本身就可以作为键
+uint32_t ipOf(const InetAddress& peer)
+{
+    return peer.getSockAddr()->sin_addr.s_addr;
+}
+} // namespace
+
+RateLimiter::RateLimiter(double requestsPerSecond, double burst, int maxConnectionsPerIp, int maxConnections)
+    : rate_(requestsPerSecond / Timestamp::kMicroSecondsPerSecond),
+      burst_(burst < 1 ? 1 : burst),
+      maxConnectionsPerIp_(maxConnectionsPerIp),
+      maxConnections_(maxConnections),
+      connections_(0)
+{
+    MetricsRegistry& registry = MetricsRegistry::instance();
+    rejectedConnections_ = registry.counter("myweb_rate_limited_connections_total",
+                                            "Connections refused by per-IP or global connection limits");
+    rejectedRequests_ = registry.counter("myweb_rate_limited_requests_total",
+                                         "Requests answered with 429 by per-IP token buckets");
+    peers_ = registry.gauge("myweb_rate_limit_peers", "Peer IPs tracked by the rate limiter");
+}
+
+void RateLimiter::refill(Entry& entry, int64_t now) const
+{
+    if (now > entry.lastRefill)
+    {
+        entry.tokens += (now - entry.lastRefill) * rate_;
+        if (entry.tokens > burst_)
+        {
+            entry.tokens = burst_;
+        }
+        entry.lastRefill = now;
+    }
+}
+
+RateLimiter::Entry& RateLimiter::entryOf(Shard& shard, uint32_t ip, int64_t now)
+{
+    auto it = shard.peers.find(ip);
+    if (it != shard.peers.end())
+    {
+        return it->second;
+    }
+    peers_->inc();
+    Entry entry = { burst_, now, 0 };
+    return shard.peers.emplace(ip, entry).first->second;
+}
+
+bool RateLimiter::acquireConnection(const InetAddress& peer)
+{
+    // 总数先占上，失败了再还回去，并发的时候不会超过上限
+    int total = connections_.fetch_add(1, std::memory_order_relaxed);
+    if (maxConnections_ > 0 && total >= maxConnections_)
+    {
+        connections_.fetch_sub(1, std::memory_order_relaxed);
+        rejectedConnections_->inc();
+        return false;
+    }
+
+    uint32_t ip = ipOf(peer);
+    Shard& shard = shardOf(ip);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry& entry = entryOf(shard, ip, Timestamp::now().microSecondsSinceEpoch());
+    if (maxConnectionsPerIp_ > 0 && entry.connections >= maxConnectionsPerIp_)
+    {
+        connections_.fetch_sub(1, std::memory_order_relaxed);
+        rejectedConnections_->inc();
+        return false;
+    }
+    ++entry.connections;
+    return true;
+}
+
+void RateLimiter::releaseConnection(const InetAddress& peer)
+{
+    connections_.fetch_sub(1, std::memory_order_relaxed);
+    uint32_t ip = ipOf(peer);
+    Shard& shard = shardOf(ip);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.peers.find(ip);
+    if (it != shard.peers.end() && it->second.connections > 0)
+    {
+        --it->second.connections;
+    }
+}
+
+bool RateLimiter::allowRequest(const InetAddress& peer, Timestamp now)
+{
+    if (rate_ <= 0)
+    {
+        return true;
+    }
+    uint32_t ip = ipOf(peer);
+    Shard& shard = shardOf(ip);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry& entry = entryOf(shard, ip, now.microSecondsSinceEpoch());
+    refill(entry, now.microSecondsSinceEpoch());
+    if (entry.tokens < 1)
+    {
+        rejectedRequests_->inc();
+        return false;
+    }
+    entry.tokens -= 1;
+    return true;
+}
+
+size_t RateLimiter::expire(Timestamp now)
+{
+    size_t removed = 0;
+    int64_t us = now.microSecondsSinceEpoch();
+    for (Shard& shard : shards_)
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.peers.begin(); it != shard.peers.end();)
+        {
+            Entry& entry = it->second;
+            refill(entry, us);
+            // 没有连接、令牌桶也满了，删掉和重新创建没有区别
+            if (entry.connections == 0 && (rate_ <= 0 || entry.tokens >= burst_))
+            {
+                it = shard.peers.erase(it);
+                ++removed;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    peers_->add(-static_cast<int64_t>(removed));
+    return removed;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <unordered_map>
+
+#include "noncopyable.h"
+#include "Timestamp.h"
+
+class InetAddress;
+class Counter;
+class Gauge;
+
+/**
+ * 按对端 IP 限流
+ * - 连接数：每个 IP 同时打开的连接数和总连接数都有上限，超过的在 accept 之后直接关掉
+ * - 请求数：每个 IP 一个令牌桶，每秒补充 requestsPerSecond 个令牌，最多攒 burst 个，没有令牌的请求返回 429
+ *
+ * 表按 IP 哈希分成 kShards 片，每片一把锁，不同 IP 的请求基本不会争同一把锁；
+ * 连接已经全部关闭、令牌桶也已经补满的 IP 由定时器调用 expire 清理，表不会无限增长。
+ * 参数在开始使用之前设置，之后所有函数都是线程安全的。
+ */
+class RateLimiter : noncopyable
+{
+public:
+    // 0 表示不限制
+    RateLimiter(double requestsPerSecond, double burst, int maxConnectionsPerIp, int maxConnections);
+
+    // 新连接到来时调用，返回 false 表示超过了连接数上限，连接不应该被接受
+    bool acquireConnection(const InetAddress& peer);
+    // 之前 acquireConnection 成功的连接关闭时调用
+    void releaseConnection(const InetAddress& peer);
+    // 一个新请求开始时调用，返回 false 表示这个 IP 的令牌用完了
+    bool allowRequest(const InetAddress& peer, Timestamp now);
+
+    // 清理空闲的 IP，返回清理的个数，由定时器每 kExpireInterval 秒调用一次
+    size_t expire(Timestamp now);
+    static const int kExpireInterval = 10;
+
+    int connections() const { return connections_.load(std::memory_order_relaxed); }
+
+private:
+    struct Entry
+    {
+        double tokens;
+        int64_t lastRefill;     // 微秒
+        int connections;
+    };
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_map<uint32_t, Entry> peers;
+        char pad[64];           // 相邻分片的锁不在同一个缓存行
+    };
+    static const int kShards = 64;
+
+    Shard& shardOf(uint32_t ip) { return shards_[(ip * 2654435761u) >> 26]; }
+    Entry& entryOf(Shard& shard, uint32_t ip, int64_t now);
+    void refill(Entry& entry, int64_t now) const;
+
+    const double rate_;         // 每微秒补充的令牌数
+    const double burst_;
+    const int maxConnectionsPerIp_;
+    const int maxConnections_;
+    std::atomic<int> connections_;
+    Shard shards_[kShards];
+
+    Counter* rejectedConnections_;
+    Counter* rejectedRequests_;
+    Gauge* peers_;
+};
@@ -67,9 +67,12 @@ int Socket::accept(InetAddress *peeraddr)
         peeraddr->setSockAddr(addr);
         LOG_DEBUG<<"setSockAddr successed !";
     }
-    else
+    else if (errno != EAGAIN)
     {
-        LOG_ERROR << "accept4() failed";
+        // fd 用完之类的错误会在每次 poll 之后重复出现，限流并保留 errno 给调用方判断
+        int savedErrno = errno;
+        LOG_ERROR_LIMIT(10) << "accept4() failed " << getErrnoMsg(savedErrno);
+        errno = savedErrno;
     }
     return connfd;
 }
@@ -0,0 +1,136 @@
+#include <string.h>
+#include <sys/socket.h>
+
+#include "TcpClient.h"
+#include "EventLoop.h"
+#include "Logging.h"
+
+// 客户端析构之后连接才断开，这时候不能再回到 TcpClient 里
+static void removeConnectionAfterClient(EventLoop *loop, const TcpConnectionPtr &conn)
+{
+    loop->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+}
+
+static void defaultConnectionCallback(const TcpConnectionPtr &conn)
+{
+    LOG_DEBUG << conn->localAddress().toIpPort() << " -> " << conn->peerAddress().toIpPort()
+              << (conn->connected() ? " is UP" : " is DOWN");
+}
+
+static void defaultMessageCallback(const TcpConnectionPtr &, Buffer *buf, Timestamp)
+{
+    buf->retrieveAll();
+}
+
+TcpClient::TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg)
+    : loop_(loop),
+      connector_(new Connector(loop, serverAddr)),
+      name_(nameArg),
+      connectionCallback_(defaultConnectionCallback),
+      messageCallback_(defaultMessageCallback),
+      retry_(false),
+      connect_(false),
+      nextConnId_(1)
+{
+    connector_->setRetry(true);
+    connector_->setNewConnectionCallback(
+        std::bind(&TcpClient::newConnection, this, std::placeholders::_1));
+    LOG_INFO << "TcpClient::TcpClient[" << name_ << "] - connector " << serverAddr.toIpPort();
+}
+
+TcpClient::~TcpClient()
+{
+    LOG_INFO << "TcpClient::~TcpClient[" << name_ << "]";
+    TcpConnectionPtr conn;
+    bool unique = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        unique = connection_.use_count() == 1;
+        conn = connection_;
+    }
+    if (conn)
+    {
+        // 连接可能比 TcpClient 活得久，关闭回调换成不依赖 TcpClient 的
+        EventLoop *loop = loop_;
+        loop_->runInLoop([loop, conn]() {
+            conn->setCloseCallback(std::bind(&removeConnectionAfterClient, loop, std::placeholders::_1));
+        });
+        if (unique)
+        {
+            conn->forceClose();
+        }
+    }
+    else
+    {
+        connector_->stop();
+    }
+}
+
+void TcpClient::connect()
+{
+    LOG_INFO << "TcpClient::connect[" << name_ << "] - connecting to "
+             << connector_->serverAddress().toIpPort();
+    connect_ = true;
+    connector_->start();
+}
+
+void TcpClient::disconnect()
+{
+    connect_ = false;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (connection_)
+    {
+        connection_->shutdown();
+    }
+}
+
+void TcpClient::stop()
+{
+    connect_ = false;
+    connector_->stop();
+}
+
+TcpConnectionPtr TcpClient::createConnection(EventLoop *loop, const std::string &name,
+                                             int sockfd, const InetAddress &peerAddr)
+{
+    sockaddr_in local;
+    ::memset(&local, 0, sizeof local);
+    socklen_t addrlen = sizeof local;
+    if (::getsockname(sockfd, (sockaddr *)&local, &addrlen) < 0)
+    {
+        LOG_ERROR << "TcpClient::createConnection getsockname failed";
+    }
+    return TcpConnectionPtr(new TcpConnection(loop, name, sockfd, InetAddress(local), peerAddr));
+}
+
+void TcpClient::newConnection(int sockfd)
+{
+    char buf[64];
+    snprintf(buf, sizeof buf, ":%s#%d", connector_->serverAddress().toIpPort().c_str(), nextConnId_);
+    ++nextConnId_;
+    TcpConnectionPtr conn = createConnection(loop_, name_ + buf, sockfd, connector_->serverAddress());
+    conn->setConnectionCallback(connectionCallback_);
+    conn->setMessageCallback(messageCallback_);
+    conn->setWriteCompleteCallback(writeCompleteCallback_);
+    conn->setCloseCallback(std::bind(&TcpClient::removeConnection, this, std::placeholders::_1));
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_ = conn;
+    }
+    conn->connectEstablished();
+}
+
+void TcpClient::removeConnection(const TcpConnectionPtr &conn)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connection_.reset();
+    }
+    loop_->queueInLoop(std::bind(&TcpConnection::connectDestroyed, conn));
+    if (retry_ && connect_)
+    {
+        LOG_INFO << "TcpClient::removeConnection[" << name_ << "] - reconnecting to "
+                 << connector_->serverAddress().toIpPort();
+        connector_->restart();
+    }
+}
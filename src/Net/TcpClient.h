@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <string>
+
+#include "noncopyable.h"
+#include "Callback.h"
+#include "Connector.h"
+#include "InetAddress.h"
+#include "TcpConnection.h"
+
+class EventLoop;
+
+/**
+ * 客户端，和 TcpServer 相对，管理一条到 serverAddr 的连接
+ * 用 Connector 非阻塞地发起连接，连不上按退避时间一直重试；连上之后创建普通的 TcpConnection，
+ * 回调和服务端的连接完全一样。打开 enableRetry 之后连接断开会自动重连。
+ * 所有回调都在 loop 线程执行，connect/disconnect/stop 可以在任意线程调用。
+ * 析构时连接还在的话不会把它关掉，只是让它断开之后自己销毁。
+ */
+class TcpClient : noncopyable
+{
+public:
+    TcpClient(EventLoop *loop, const InetAddress &serverAddr, const std::string &nameArg);
+    ~TcpClient();
+
+    void connect();
+    void disconnect();  // 已经连上的发完数据再关闭
+    void stop();        // 还在连接的放弃连接
+
+    // 已经连上的连接，没有连上时返回空
+    TcpConnectionPtr connection() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return connection_;
+    }
+
+    EventLoop* getLoop() const { return loop_; }
+    const std::string& name() const { return name_; }
+    bool retry() const { return retry_; }
+    void enableRetry() { retry_ = true; }
+
+    // 需要在 connect 之前设置
+    void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
+    void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
+    void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+
+    /**
+     * 用连接成功的 sockfd 创建 TcpConnection，本端地址从 sockfd 上取。
+     * 只创建对象，回调由调用方设置之后再调用 connectEstablished，
+     * 给不通过 TcpClient、自己管理一批连接的使用者(比如连接池)用
+     */
+    static TcpConnectionPtr createConnection(EventLoop *loop, const std::string &name,
+                                             int sockfd, const InetAddress &peerAddr);
+
+private:
+    void newConnection(int sockfd);
+    void removeConnection(const TcpConnectionPtr &conn);
+
+    EventLoop *loop_;
+    ConnectorPtr connector_;
+    const std::string name_;
+    ConnectionCallback connectionCallback_;
+    MessageCallback messageCallback_;
+    WriteCompleteCallback writeCompleteCallback_;
+    std::atomic_bool retry_;    // 连接断开后是否重连
+    std::atomic_bool connect_;  // disconnect/stop 之后为 false
+    int nextConnId_; // 只在 loop 线程访问
+    mutable std::mutex mutex_;
+    TcpConnectionPtr connection_;
+};
@@ -8,9 +8,24 @@
 
 #include "TcpConnection.h"
 #include "Logging.h"
+#include "BinaryLogging.h"
 #include "Socket.h"
 #include "Channel.h"
 #include "EventLoop.h"
+#include "Metrics.h"
+
+// 所有连接收发的字节数
+static Counter* bytesReceived()
+{
+    static Counter* counter = MetricsRegistry::instance().counter("myweb_bytes_received_total", "Bytes read from sockets");
+    return counter;
+}
+
+static Counter* bytesSent()
+{
+    static Counter* counter = MetricsRegistry::instance().counter("myweb_bytes_sent_total", "Bytes written to sockets");
+    return counter;
+}
 
 static EventLoop *CheckLoopNotNull(EventLoop *loop)
 {
@@ -48,14 +63,15 @@ TcpConnection::TcpConnection(EventLoop *loop,
     channel_->setErrorCallback(
         std::bind(&TcpConnection::handleError, this));
 
-    LOG_INFO << "TcpConnection::ctor[" << name_.c_str() << "] at fd =" << sockfd;
+    LOG_INFO << "TcpConnection::ctor" << LogField("conn", name_) << LogField("fd", sockfd);
     socket_->setKeepAlive(true);
     // socket_->setKeepAlive(false);//这个是为了压测
 }
 
 TcpConnection::~TcpConnection()
 {
-    LOG_DEBUG << "TcpConnection::dtor[" << name_.c_str() << "] at fd=" << channel_->fd() << " state=" << static_cast<int>(state_);
+    LOG_DEBUG << "TcpConnection::dtor" << LogField("conn", name_) << LogField("fd", channel_->fd())
+              << LogField("state", static_cast<int>(state_));
 }
 
 
@@ -129,12 +145,13 @@ void TcpConnection::sendInLoop(const void* data, size_t len)
     if (!channel_->isWriting() && outputBuffer_.readableBytes() == 0)
     {
         nwrote = ::write(channel_->fd(), data, len);
-        LOG_DEBUG << channel_->fd() <<" write num: "<<nwrote<<"\tsize:"<<len;
+        LOG_DEBUG_BIN("fd {} write num: {}\tsize: {}", channel_->fd(), nwrote, len);
         if (nwrote >= 0)
         {
+            bytesSent()->inc(nwrote);
             // 判断有没有一次性写完
             remaining = len - nwrote;
-            LOG_DEBUG<<"remain: "<<remaining;
+            LOG_DEBUG_BIN("remain: {}", remaining);
             if (remaining == 0 && writeCompleteCallback_)
             {
                 // 既然一次性发送完事件就不用让channel对epollout事件感兴趣了
@@ -210,10 +227,59 @@ void TcpConnection::shutdownInLoop()
     }
 }
 
+void TcpConnection::forceClose()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        setState(kDisconnecting);
+        loop_->queueInLoop(
+            std::bind(&TcpConnection::forceCloseInLoop, shared_from_this()));
+    }
+}
+
+void TcpConnection::forceCloseInLoop()
+{
+    if (state_ == kConnected || state_ == kDisconnecting)
+    {
+        // 和对端关闭走同样的流程
+        handleClose();
+    }
+}
+
+void TcpConnection::startRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::startReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::startReadInLoop()
+{
+    // 连接已经关闭的话 channel 已经从 Poller 上注销了，不能再注册回去
+    if (state_ != kDisconnected && (!reading_ || !channel_->isReading()))
+    {
+        channel_->enableReading();
+        reading_ = true;
+    }
+}
+
+void TcpConnection::stopRead()
+{
+    loop_->runInLoop(std::bind(&TcpConnection::stopReadInLoop, shared_from_this()));
+}
+
+void TcpConnection::stopReadInLoop()
+{
+    if (reading_ || channel_->isReading())
+    {
+        channel_->disableReading();
+        reading_ = false;
+    }
+}
+
 // 连接建立
 void TcpConnection::connectEstablished()
 {
     setState(kConnected); // 建立连接，设置一开始状态为连接态
+    loop_->connectionGauge()->inc();
     /**
      * TODO:tie
      * channel_->tie(shared_from_this());
@@ -233,6 +299,7 @@ void TcpConnection::connectDestroyed()
 {
     if (state_ == kConnected)
     {
+        loop_->connectionGauge()->dec();
         setState(kDisconnected);
         channel_->disableAll(); // 把channel的所有感兴趣的事件从poller中删除掉
         connectionCallback_(shared_from_this()); //这个会走到
@@ -247,6 +314,7 @@ void TcpConnection::handleRead(Timestamp receiveTime)
     ssize_t n = inputBuffer_.readFd(channel_->fd(), &savedErrno);
     if (n > 0)
     {
+        bytesReceived()->inc(n);
         // 已建立连接的用户，有可读事件发生，调用用户传入的回调操作 HttpServer::onMessage
         // TODO:shared_from_this
         messageCallback_(shared_from_this(), &inputBuffer_, receiveTime);
@@ -276,6 +344,7 @@ void TcpConnection::handleWrite()
         // 正确读取数据
         if (n > 0)
         {
+            bytesSent()->inc(n);
             outputBuffer_.retrieve(n);
             // 说明buffer可读数据都被TcpConnection读取完毕并写入给了客户端
             // 此时就可以关闭连接，否则还需继续提醒写事件
@@ -308,6 +377,7 @@ void TcpConnection::handleWrite()
 
 void TcpConnection::handleClose()
 {
+    loop_->connectionGauge()->dec();
     setState(kDisconnected);    // 设置状态为关闭连接状态
     channel_->disableAll();     // 注销Channel所有感兴趣事件
     
@@ -40,6 +40,8 @@ public:
     const InetAddress& peerAddress() const { return peerAddr_; }
 
     bool connected() const { return state_ == kConnected; }
+    // 还没有写进 socket 的数据
+    Buffer* outputBuffer() { return &outputBuffer_; }
 
     // 发送数据
     void send(const std::string &buf);
@@ -47,6 +49,11 @@ public:
 
     // 关闭连接
     void shutdown();
+    // 不等输出缓冲区发完，直接关闭连接
+    void forceClose();
+    // 暂停/恢复读，暂停期间对端发来的数据留在内核缓冲区里，TCP 的窗口会让对端慢下来
+    void startRead();
+    void stopRead();
 
     // 保存用户自定义的回调函数
     void setConnectionCallback(const ConnectionCallback &cb){ 
@@ -71,6 +78,10 @@ public:
          LOG_DEBUG<<"setHighWaterMarkCallback";
     }
     
+    // 保存上层协议的上下文（比如http的解析状态），muduo中用的是boost::any，这里用shared_ptr<void>代替
+    void setContext(const std::shared_ptr<void>& context) { context_ = context; }
+    const std::shared_ptr<void>& getContext() const { return context_; }
+
     // TcpServer会调用
     void connectEstablished(); // 连接建立
     void connectDestroyed();   // 连接销毁
@@ -98,6 +109,9 @@ private:
     void sendInLoop(const void* message, size_t len);
     void sendInLoop(const std::string& message);
     void shutdownInLoop();
+    void forceCloseInLoop();
+    void startReadInLoop();
+    void stopReadInLoop();
     void highWaterMarkInLoop();
     EventLoop *loop_;           // 属于哪个subLoop（如果是单线程则为mainLoop）
     const std::string name_;
@@ -123,4 +137,6 @@ private:
 
     Buffer inputBuffer_;    // 读取数据的缓冲区
     Buffer outputBuffer_;   // 发送数据的缓冲区
+
+    std::shared_ptr<void> context_; // 上层协议的上下文
 };
\ No newline at end of file
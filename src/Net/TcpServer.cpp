@@ -1,5 +1,7 @@
 #include <functional>
 #include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
 
 #include "TcpServer.h"
 #include "TcpConnection.h"
@@ -29,6 +31,7 @@ TcpServer::TcpServer(EventLoop *loop,
     writeCompleteCallback_(),
     threadInitCallback_(),
     started_(0),
+    limiter_(nullptr),
     nextConnId_(1)    
 {
     LOG_DEBUG<<"init tcpserver";
@@ -75,6 +78,15 @@ void TcpServer::start()
 void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
 {
     LOG_DEBUG<<"newConnection peerAdder"<<peerAddr.toIpPort();
+    if (limiter_ && !limiter_->acquireConnection(peerAddr))
+    {
+        // 直接发 RST 关闭，不进入 TIME_WAIT，也不用分给 subLoop
+        LOG_DEBUG << "connection from " << peerAddr.toIpPort() << " refused by rate limiter";
+        struct linger lg = { 1, 0 };
+        ::setsockopt(sockfd, SOL_SOCKET, SO_LINGER, &lg, sizeof lg);
+        ::close(sockfd);
+        return;
+    }
     // 轮询算法 选择一个subLoop 来管理connfd对应的channel
     EventLoop *ioLoop = threadPool_->getNextLoop();
     // 提示信息
@@ -85,7 +97,8 @@ void TcpServer::newConnection(int sockfd, const InetAddress &peerAddr)
     // 新连接名字
     std::string connName = name_ + buf;
 
-    LOG_INFO << "TcpServer::newConnection [" << name_.c_str() << "] - new connection [" << connName.c_str() << "] from " << peerAddr.toIpPort().c_str();
+    LOG_INFO << "TcpServer::newConnection" << LogField("server", name_) << LogField("conn", connName)
+             << LogField("peer", peerAddr.toIpPort());
     
     // 通过sockfd获取其绑定的本机的ip地址和端口信息
     sockaddr_in local;
@@ -143,6 +156,10 @@ void TcpServer::removeConnectionInLoop(const TcpConnectionPtr &conn)
     LOG_DEBUG << "TcpServer::removeConnectionInLoop [" << name_.c_str() << "] - connection " << conn->name().c_str();
 
     connections_.erase(conn->name());
+    if (limiter_)
+    {
+        limiter_->releaseConnection(conn->peerAddress());
+    }
     EventLoop *ioLoop = conn->getLoop();
     ioLoop->queueInLoop(
         std::bind(&TcpConnection::connectDestroyed, conn));
@@ -13,6 +13,7 @@
 #include "noncopyable.h"
 #include "Callback.h"
 #include "TcpConnection.h"
+#include "RateLimiter.h"
 
 /**
  * 我们用户编写的时候就是使用的TcpServer
@@ -40,6 +41,8 @@ public:
     void setConnectionCallback(const ConnectionCallback &cb) { connectionCallback_ = cb; }
     void setMessageCallback(const MessageCallback &cb) { messageCallback_ = cb; }
     void setWriteCompleteCallback(const WriteCompleteCallback &cb) { writeCompleteCallback_ = cb; }
+    // 按对端 IP 限制连接数，超过上限的连接 accept 之后直接关闭，不分配 TcpConnection
+    void setRateLimiter(RateLimiter* limiter) { limiter_ = limiter; }
     // 设置底层subLoop的个数
     void setThreadNum(int numThreads);
 
@@ -77,6 +80,7 @@ private:
     ThreadInitCallback threadInitCallback_;  // loop线程初始化的回调函数
     std::atomic_int started_;                // TcpServer
 
+    RateLimiter* limiter_;      // 不为空时新连接要先通过它的检查
     int nextConnId_;            // 连接索引
     ConnectionMap connections_; // 保存所有的连接
 };
\ No newline at end of file
@@ -41,10 +41,10 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
             events_.resize(events_.size() * 2);
         }
     }
-    // 超时
+    // 超时，空闲的 loop 每次 poll 都会走到这里，不是异常
     else if (numEvents == 0)
     {
-        LOG_WARN << "timeout!";
+        LOG_TRACE << "timeout!";
     }
     // 出错
     else
@@ -53,7 +53,7 @@ Timestamp EPollPoller::poll(int timeoutMs, ChannelList *activeChannels)
         if (saveErrno != EINTR)
         {
             errno = saveErrno;
-            LOG_ERROR << "EPollPoller::poll() failed";
+            LOG_ERROR_LIMIT(10) << "EPollPoller::poll() failed " << getErrnoMsg(saveErrno);
         }
     }
     return now;
@@ -0,0 +1,92 @@
+/**
+ * 把 AsyncLogging::setBinaryOutput 写出的二进制日志还原成文本
+ *
+ *   myweb-logdecode http_test.20240101-120000.log [更多文件...] > http_test.txt
+ *
+ * 每个文件里都带有它用到的格式串定义，文件按给出的顺序输出，定义在前面的文件里出现过也可以用
+ */
+#include "BinaryLogging.h"
+
+#include <stdio.h>
+#include <string>
+
+namespace
+{
+
+bool readFile(const char* path, std::string* data)
+{
+    FILE* fp = fopen(path, "rb");
+    if (fp == nullptr)
+    {
+        return false;
+    }
+    char buf[64 * 1024];
+    size_t n;
+    while ((n = fread(buf, 1, sizeof buf, fp)) > 0)
+    {
+        data->append(buf, n);
+    }
+    fclose(fp);
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s binary-log [binary-log...]\n", argv[0]);
+        return 1;
+    }
+    BinaryLogDecoder decoder;
+    int status = 0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string data;
+        if (!readFile(argv[i], &data))
+        {
+            fprintf(stderr, "cannot read %s\n", argv[i]);
+            status = 1;
+            continue;
+        }
+        // 文件滚动之后，定义可能写在用到它的记录后面，先把整个文件的定义收集起来
+        BinaryLogDecoder::forEachRecord(data, [&](const LogRecordHeader& header, const char* record, size_t len) {
+            if (header.format == kLogFormatDefinition)
+            {
+                decoder.addDefinition(record, len);
+            }
+        });
+        uint64_t unknown = 0;
+        bool complete = BinaryLogDecoder::forEachRecord(data, [&](const LogRecordHeader& header, const char* record, size_t len) {
+            if (header.format == kLogFormatDefinition)
+            {
+                return;
+            }
+            if (header.format == kLogTextRecord)
+            {
+                fwrite(record + sizeof header, 1, len - sizeof header, stdout);
+                return;
+            }
+            LogStream stream;
+            if (!decoder.decode(record, len, stream))
+            {
+                ++unknown;
+                return;
+            }
+            fwrite(stream.buffer().data(), 1, stream.buffer().length(), stdout);
+        });
+        if (unknown > 0)
+        {
+            fprintf(stderr, "%s: %llu records without a format definition\n", argv[i],
+                    static_cast<unsigned long long>(unknown));
+            status = 1;
+        }
+        if (!complete)
+        {
+            // 进程被杀掉时最后一条记录可能只写了一半
+            fprintf(stderr, "%s: truncated record at end of file\n", argv[i]);
+        }
+    }
+    return status;
+}
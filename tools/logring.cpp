@@ -0,0 +1,57 @@
+/**
+ * 按从旧到新的顺序取出 MmapLogRing 文件里的日志
+ *
+ *   myweb-logring http_test.ring > http_test.txt
+ *
+ * 进程还在写或者已经崩溃都可以读；崩溃时没写完的最后几条会被跳过
+ */
+#include "MmapLogRing.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int main(int argc, char* argv[])
+{
+    if (argc != 2)
+    {
+        fprintf(stderr, "usage: %s ring-file\n", argv[0]);
+        return 1;
+    }
+    int fd = ::open(argv[1], O_RDONLY | O_CLOEXEC);
+    struct stat st;
+    if (fd < 0 || ::fstat(fd, &st) < 0)
+    {
+        perror(argv[1]);
+        return 1;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    void* addr = size >= MmapLogRing::kHeaderSize
+                     ? ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0)
+                     : MAP_FAILED;
+    ::close(fd);
+    if (addr == MAP_FAILED)
+    {
+        fprintf(stderr, "%s: not a log ring\n", argv[1]);
+        return 1;
+    }
+    const MmapLogRingHeader* header = static_cast<const MmapLogRingHeader*>(addr);
+    if (!MmapLogRing::validHeader(*header, size))
+    {
+        fprintf(stderr, "%s: not a log ring\n", argv[1]);
+        return 1;
+    }
+    const char* data = static_cast<const char*>(addr) + MmapLogRing::kHeaderSize;
+    uint64_t skipped = MmapLogRing::forEachRecord(*header, data, [](const char* record, size_t len) {
+        fwrite(record, 1, len, stdout);
+    });
+    if (skipped > 0)
+    {
+        fprintf(stderr, "%s: skipped %llu bytes of overwritten or unfinished records\n", argv[1],
+                static_cast<unsigned long long>(skipped));
+    }
+    ::munmap(addr, size);
+    return 0;
+}
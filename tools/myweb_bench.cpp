@@ -0,0 +1,575 @@
+/**
+ * myweb-bench: 用库自己的 EventLoop 和 TcpClient 写的 HTTP 压测工具
+ *
+ *   myweb-bench [-c 连接数] [-t 线程数] [-d 秒数] [-R 每秒请求数] [-f 请求文件] [-a cpu列表] http://host:port/path
+ *
+ * - 每个线程一个 EventLoop，连接平均分到各个线程上，都是长连接，一个连接上同时只有一个请求
+ * - 不加 -R 是闭环模式：收到响应马上发下一个，测的是最大吞吐
+ * - 加了 -R 是固定速率的开环模式：每个连接按 连接数/R 的间隔安排请求的发送时间，
+ *   延迟从"应该发出"的时间算起，服务端卡住时排队的时间也算进去，避免协调遗漏(coordinated omission)
+ *   让尾延迟看起来比实际好；同时也输出从实际发出算起的延迟作对比
+ * - -f 指定请求文件，每行一个请求：METHOD PATH [BODY]，# 开头的是注释，连接按顺序轮流使用
+ * - -a 把第 i 个线程绑到列表里的第 i 个 cpu 上，比如 -a 4,5,6,7
+ * 延迟用 Metrics.h 的直方图统计，输出 p50/p90/p99/p999 和最大值
+ */
+#include "EventLoop.h"
+#include "EventLoopThreadPool.h"
+#include "TcpClient.h"
+#include "Metrics.h"
+#include "Logging.h"
+#include "Socket.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace
+{
+
+struct Options
+{
+    Options()
+        : connections(64),
+          threads(4),
+          duration(10),
+          rate(0),
+          port(80)
+    {
+    }
+
+    int connections;
+    int threads;
+    double duration;
+    double rate;            // 0 表示闭环
+    std::string host;
+    uint16_t port;
+    std::string path;
+    std::string corpus;
+    std::vector<int> cpus;
+};
+
+// 所有线程共用的统计，计数器和直方图都按线程分片，记录时没有争用
+struct Stats
+{
+    Counter completed;
+    Counter errors;         // 连接断开时没有收到响应的请求
+    Counter non2xx;
+    Counter bytes;
+    Histogram latency;      // 从计划发送时间算起，微秒
+    Histogram service;      // 从实际发送时间算起，微秒
+};
+
+int64_t nowUs()
+{
+    return Timestamp::now().microSecondsSinceEpoch();
+}
+
+/**
+ * 一个连接，只在所属的 loop 线程里访问
+ * 回调里只持有弱引用，结束时在 loop 线程里释放 Session，之后连接上的回调都不会再进来
+ */
+class Session : public std::enable_shared_from_this<Session>
+{
+public:
+    Session(EventLoop* loop, const InetAddress& server, int id, const std::vector<std::string>* requests,
+            Stats* stats, int64_t intervalUs, int64_t startUs)
+        : loop_(loop),
+          client_(loop, server, "bench-" + std::to_string(id)),
+          requests_(requests),
+          stats_(stats),
+          next_(id % requests->size()),
+          intervalUs_(intervalUs),
+          intendedUs_(startUs),
+          sentUs_(0),
+          inFlight_(false),
+          timerArmed_(false)
+    {
+        client_.enableRetry();
+    }
+
+    void start()
+    {
+        std::weak_ptr<Session> weak(shared_from_this());
+        client_.setConnectionCallback([weak](const TcpConnectionPtr& conn) {
+            std::shared_ptr<Session> self = weak.lock();
+            if (self)
+            {
+                self->onConnection(conn);
+            }
+        });
+        client_.setMessageCallback([weak](const TcpConnectionPtr& conn, Buffer* buf, Timestamp) {
+            std::shared_ptr<Session> self = weak.lock();
+            if (self)
+            {
+                self->onMessage(conn, buf);
+            }
+            else
+            {
+                buf->retrieveAll();
+            }
+        });
+        client_.connect();
+    }
+
+private:
+    enum State
+    {
+        kStatusLine,
+        kHeaders,
+        kBody,
+        kChunkSize,
+        kChunkData,
+        kChunkCrlf,
+        kTrailers,
+    };
+
+    void onConnection(const TcpConnectionPtr& conn)
+    {
+        if (conn->connected())
+        {
+            conn->socket_->setTcpNoDelay(true);
+            state_ = kStatusLine;
+            schedule();
+        }
+        else if (inFlight_)
+        {
+            // 请求丢了，重连之后从下一个请求继续
+            inFlight_ = false;
+            stats_->errors.inc();
+            advance();
+        }
+    }
+
+    // 闭环模式马上发；开环模式等到计划时间，已经过了就马上发
+    void schedule()
+    {
+        if (inFlight_ || timerArmed_)
+        {
+            return;
+        }
+        int64_t delay = intervalUs_ > 0 ? intendedUs_ - nowUs() : 0;
+        if (delay <= 0)
+        {
+            send();
+            return;
+        }
+        timerArmed_ = true;
+        std::weak_ptr<Session> weak(shared_from_this());
+        loop_->runAfter(static_cast<double>(delay) / Timestamp::kMicroSecondsPerSecond, [weak]() {
+            std::shared_ptr<Session> self = weak.lock();
+            if (self)
+            {
+                self->timerArmed_ = false;
+                self->send();
+            }
+        });
+    }
+
+    void send()
+    {
+        TcpConnectionPtr conn = client_.connection();
+        if (!conn || !conn->connected())
+        {
+            return;     // 连上之后 onConnection 会再安排
+        }
+        inFlight_ = true;
+        sentUs_ = nowUs();
+        if (intervalUs_ == 0)
+        {
+            intendedUs_ = sentUs_;
+        }
+        conn->send((*requests_)[next_]);
+    }
+
+    void advance()
+    {
+        next_ = (next_ + 1) % requests_->size();
+        if (intervalUs_ > 0)
+        {
+            intendedUs_ += intervalUs_;
+        }
+    }
+
+    void onMessage(const TcpConnectionPtr& conn, Buffer* buf)
+    {
+        stats_->bytes.inc(buf->readableBytes());
+        while (inFlight_)
+        {
+            int ret = parse(buf);
+            if (ret < 0)
+            {
+                LOG_ERROR << "bad response on " << conn->name();
+                stats_->errors.inc();
+                inFlight_ = false;
+                advance();
+                conn->forceClose();
+                return;
+            }
+            if (ret == 0)
+            {
+                return;
+            }
+            int64_t now = nowUs();
+            stats_->completed.inc();
+            stats_->latency.record(static_cast<uint64_t>(now - intendedUs_));
+            stats_->service.record(static_cast<uint64_t>(now - sentUs_));
+            if (code_ < 200 || code_ >= 300)
+            {
+                stats_->non2xx.inc();
+            }
+            inFlight_ = false;
+            advance();
+            if (close_)
+            {
+                conn->shutdown();   // 重连之后继续
+                return;
+            }
+            schedule();
+        }
+        buf->retrieveAll();
+    }
+
+    // 1 表示收完了一个响应，0 表示还要更多数据，-1 表示格式错误
+    int parse(Buffer* buf)
+    {
+        while (true)
+        {
+            if (state_ == kBody || state_ == kChunkData)
+            {
+                size_t n = std::min(remaining_, buf->readableBytes());
+                buf->retrieve(n);
+                remaining_ -= n;
+                if (remaining_ > 0)
+                {
+                    return 0;
+                }
+                if (state_ == kBody)
+                {
+                    state_ = kStatusLine;
+                    return 1;
+                }
+                state_ = kChunkCrlf;
+                continue;
+            }
+            const char* crlf = buf->findCRLF();
+            if (crlf == nullptr)
+            {
+                return 0;
+            }
+            const char* line = buf->peek();
+            size_t len = crlf - line;
+            int ret = 0;
+            switch (state_)
+            {
+            case kStatusLine:
+                if (len < 12 || strncmp(line, "HTTP/1.", 7) != 0)
+                {
+                    return -1;
+                }
+                code_ = atoi(line + 9);
+                close_ = line[7] == '0';
+                chunked_ = false;
+                remaining_ = 0;
+                state_ = kHeaders;
+                break;
+            case kHeaders:
+                if (len == 0)
+                {
+                    if (code_ < 200)
+                    {
+                        state_ = kStatusLine;   // 100 Continue
+                    }
+                    else if (chunked_)
+                    {
+                        state_ = kChunkSize;
+                    }
+                    else if (remaining_ > 0)
+                    {
+                        state_ = kBody;
+                    }
+                    else
+                    {
+                        state_ = kStatusLine;
+                        ret = 1;
+                    }
+                }
+                else if (len > 15 && strncasecmp(line, "Content-Length:", 15) == 0)
+                {
+                    remaining_ = strtoull(line + 15, nullptr, 10);
+                }
+                else if (len > 18 && strncasecmp(line, "Transfer-Encoding:", 18) == 0)
+                {
+                    chunked_ = memmem(line, len, "chunked", 7) != nullptr;
+                }
+                else if (len > 11 && strncasecmp(line, "Connection:", 11) == 0)
+                {
+                    close_ = memmem(line, len, "close", 5) != nullptr;
+                }
+                break;
+            case kChunkSize:
+                remaining_ = strtoull(line, nullptr, 16);
+                state_ = remaining_ > 0 ? kChunkData : kTrailers;
+                break;
+            case kChunkCrlf:
+                state_ = kChunkSize;
+                break;
+            case kTrailers:
+                if (len == 0)
+                {
+                    state_ = kStatusLine;
+                    ret = 1;
+                }
+                break;
+            default:
+                break;
+            }
+            buf->retrieveUntil(crlf + 2);
+            if (ret)
+            {
+                return ret;
+            }
+        }
+    }
+
+    EventLoop* loop_;
+    TcpClient client_;
+    const std::vector<std::string>* requests_;
+    Stats* stats_;
+    size_t next_;               // 下一个要发的请求
+    const int64_t intervalUs_;  // 开环模式的发送间隔，闭环为 0
+    int64_t intendedUs_;        // 当前请求计划的发送时间
+    int64_t sentUs_;            // 当前请求实际的发送时间
+    bool inFlight_;
+    bool timerArmed_;
+
+    State state_;
+    int code_;
+    bool close_;
+    bool chunked_;
+    size_t remaining_;
+};
+
+void usage(const char* argv0)
+{
+    fprintf(stderr, "usage: %s [-c connections] [-t threads] [-d seconds] [-R requests/s] "
+                    "[-f corpus] [-a cpu,cpu,...] http://host:port/path\n", argv0);
+    exit(1);
+}
+
+bool parseUrl(const std::string& url, Options* opt)
+{
+    std::string rest = url;
+    if (rest.compare(0, 7, "http://") == 0)
+    {
+        rest = rest.substr(7);
+    }
+    size_t slash = rest.find('/');
+    std::string hostPort = rest.substr(0, slash);
+    opt->path = slash == std::string::npos ? "/" : rest.substr(slash);
+    size_t colon = hostPort.find(':');
+    opt->host = hostPort.substr(0, colon);
+    if (colon != std::string::npos)
+    {
+        opt->port = static_cast<uint16_t>(atoi(hostPort.c_str() + colon + 1));
+    }
+    return !opt->host.empty() && opt->port != 0;
+}
+
+std::string buildRequest(const std::string& method, const std::string& path, const std::string& body,
+                         const std::string& host)
+{
+    std::string req = method + " " + path + " HTTP/1.1\r\nHost: " + host + "\r\nUser-Agent: myweb-bench\r\n";
+    if (!body.empty() || method == "POST" || method == "PUT")
+    {
+        req += "Content-Length: " + std::to_string(body.size()) + "\r\n";
+    }
+    return req + "\r\n" + body;
+}
+
+// 请求文件每行 METHOD PATH [BODY]
+bool loadCorpus(const Options& opt, std::vector<std::string>* requests)
+{
+    std::string host = opt.host + ":" + std::to_string(opt.port);
+    if (opt.corpus.empty())
+    {
+        requests->push_back(buildRequest("GET", opt.path, std::string(), host));
+        return true;
+    }
+    std::ifstream in(opt.corpus.c_str());
+    if (!in)
+    {
+        fprintf(stderr, "cannot open %s\n", opt.corpus.c_str());
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line))
+    {
+        if (line.empty() || line[0] == '#')
+        {
+            continue;
+        }
+        size_t sp1 = line.find(' ');
+        if (sp1 == std::string::npos)
+        {
+            fprintf(stderr, "bad corpus line: %s\n", line.c_str());
+            return false;
+        }
+        size_t sp2 = line.find(' ', sp1 + 1);
+        std::string method = line.substr(0, sp1);
+        std::string path = line.substr(sp1 + 1, sp2 == std::string::npos ? std::string::npos : sp2 - sp1 - 1);
+        std::string body = sp2 == std::string::npos ? std::string() : line.substr(sp2 + 1);
+        requests->push_back(buildRequest(method, path, body, host));
+    }
+    return !requests->empty();
+}
+
+void printLatency(const char* name, const HdrHistogram& h)
+{
+    printf("  %-24s %9.3f %9.3f %9.3f %9.3f %9.3f %9.3f\n", name,
+           h.mean() / 1000.0,
+           h.percentile(0.5) / 1000.0,
+           h.percentile(0.9) / 1000.0,
+           h.percentile(0.99) / 1000.0,
+           h.percentile(0.999) / 1000.0,
+           h.max() / 1000.0);
+}
+
+} // namespace
+
+int main(int argc, char* argv[])
+{
+    Options opt;
+    int c;
+    while ((c = getopt(argc, argv, "c:t:d:R:f:a:")) != -1)
+    {
+        switch (c)
+        {
+        case 'c': opt.connections = atoi(optarg); break;
+        case 't': opt.threads = atoi(optarg); break;
+        case 'd': opt.duration = atof(optarg); break;
+        case 'R': opt.rate = atof(optarg); break;
+        case 'f': opt.corpus = optarg; break;
+        case 'a':
+            for (char* p = strtok(optarg, ","); p; p = strtok(nullptr, ","))
+            {
+                opt.cpus.push_back(atoi(p));
+            }
+            break;
+        default: usage(argv[0]);
+        }
+    }
+    if (optind >= argc || !parseUrl(argv[optind], &opt) || opt.connections <= 0 || opt.threads <= 0)
+    {
+        usage(argv[0]);
+    }
+    std::vector<std::string> requests;
+    if (!loadCorpus(opt, &requests))
+    {
+        return 1;
+    }
+    Logger::setLogLevel(Logger::ERROR);
+
+    EventLoop loop;
+    EventLoopThreadPool pool(&loop, "bench");
+    pool.setThreadNum(opt.threads);
+    std::atomic<int> nextCpu(0);
+    pool.start([&opt, &nextCpu](EventLoop*) {
+        int i = nextCpu.fetch_add(1);
+        if (i < static_cast<int>(opt.cpus.size()))
+        {
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(opt.cpus[i], &set);
+            pthread_setaffinity_np(pthread_self(), sizeof set, &set);
+        }
+    });
+
+    Stats stats;
+    InetAddress server(opt.port, opt.host);
+    // 开环模式下每个连接的间隔，各个连接的起点错开，不要一起发
+    int64_t intervalUs = opt.rate > 0
+        ? static_cast<int64_t>(opt.connections * Timestamp::kMicroSecondsPerSecond / opt.rate) : 0;
+    int64_t startUs = nowUs();
+    std::vector<EventLoop*> loops = pool.getAllLoops();
+    std::map<EventLoop*, std::vector<std::shared_ptr<Session>>> sessions;
+    for (int i = 0; i < opt.connections; ++i)
+    {
+        EventLoop* ioLoop = loops[i % loops.size()];
+        int64_t offset = intervalUs * i / opt.connections;
+        std::shared_ptr<Session> session(new Session(ioLoop, server, i, &requests, &stats, intervalUs, startUs + offset));
+        sessions[ioLoop].push_back(session);
+        ioLoop->runInLoop([session]() { session->start(); });
+    }
+
+    printf("Running %.0fs test @ http://%s:%u%s\n", opt.duration, opt.host.c_str(), opt.port,
+           requests.size() == 1 ? opt.path.c_str() : " (corpus)");
+    printf("  %d threads and %d connections, %s\n", opt.threads, opt.connections,
+           opt.rate > 0 ? ("open loop at " + std::to_string(static_cast<long>(opt.rate)) + " req/s").c_str()
+                        : "closed loop");
+    fflush(stdout);
+
+    HdrHistogram latency;
+    HdrHistogram service;
+    uint64_t completed = 0;
+    uint64_t errors = 0;
+    uint64_t non2xx = 0;
+    uint64_t bytes = 0;
+    double elapsed = 0;
+    loop.runAfter(opt.duration, [&]() {
+        elapsed = static_cast<double>(nowUs() - startUs) / Timestamp::kMicroSecondsPerSecond;
+        latency = stats.latency.snapshot();
+        service = stats.service.snapshot();
+        completed = stats.completed.value();
+        errors = stats.errors.value();
+        non2xx = stats.non2xx.value();
+        bytes = stats.bytes.value();
+        loop.quit();
+    });
+    loop.loop();
+
+    // 在各自的 loop 线程里释放连接，之后再停线程
+    std::vector<std::future<void>> done;
+    for (auto& item : sessions)
+    {
+        std::shared_ptr<std::promise<void>> promise(new std::promise<void>);
+        done.push_back(promise->get_future());
+        std::vector<std::shared_ptr<Session>>* list = &item.second;
+        item.first->runInLoop([list, promise]() {
+            list->clear();
+            promise->set_value();
+        });
+    }
+    for (auto& f : done)
+    {
+        f.wait();
+    }
+
+    printf("  Latency (ms)                 mean       p50       p90       p99      p999       max\n");
+    printLatency(opt.rate > 0 ? "corrected" : "response", latency);
+    if (opt.rate > 0)
+    {
+        printLatency("uncorrected", service);
+    }
+    printf("  %lu requests in %.2fs, %.2f MB read\n", static_cast<unsigned long>(completed), elapsed,
+           bytes / 1024.0 / 1024.0);
+    if (errors || non2xx)
+    {
+        printf("  Errors: %lu, non-2xx responses: %lu\n", static_cast<unsigned long>(errors),
+               static_cast<unsigned long>(non2xx));
+    }
+    printf("Requests/sec: %.2f\n", completed / elapsed);
+    printf("Transfer/sec: %.2f MB\n", bytes / elapsed / 1024.0 / 1024.0);
+    return 0;
+}